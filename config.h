@@ -2,25 +2,114 @@
 #define CONFIG_H
 
 // Queue and Process Configuration
+// Values marked [runtime] are only defaults: the scheduler's config file
+// and command line override them, and SIGHUP reloads them live.
+#ifndef MAX_TASKS
 #define MAX_TASKS 100
-#define NUM_WORKERS 3
-#define MAX_THREADS_PER_WORKER 4
+#endif
+#define NUM_WORKERS 3               // [runtime] Initial pool size (and the fixed size without autoscaling)
+#define MAX_WORKERS 16              // Worker stat slots in shared memory (highest worker id + 1)
+#ifndef MAX_THREADS_PER_WORKER
+#define MAX_THREADS_PER_WORKER 4    // [runtime] Tasks a thread-mode worker runs at once
+#endif
+
+// Async execution mode (worker started with "async")
+#define ASYNC_LOOP_THREADS 2        // Event-loop threads per worker
+#define ASYNC_MAX_INFLIGHT 16384    // Tasks a single async worker keeps in flight
 
 // IPC Keys (using ftok or fixed keys)
-#define SHM_KEY 0x12345678
+#ifndef SHM_KEY
+#define SHM_KEY 0x12345678          // shm_key in the config file overrides it (restart needed)
+#endif
 #define SEM_KEY 0x87654321
 #define MSG_KEY 0xABCDEF00
+#define SHM_KEY_ENV "TASK_SCHEDULER_SHM_KEY"   // Overrides SHM_KEY; set by the scheduler for its workers
+
+// Named queues (scheduler --queue): each has its own segment, workers and socket
+#define MAX_QUEUES 8                        // Queues one scheduler supervises
+#define DEFAULT_QUEUE_NAME "default"        // Uses SHM_KEY and SUBMIT_SOCKET_PATH
+#define QUEUE_NAME_ENV "TASK_SCHEDULER_QUEUE"   // Queue that clients and workers attach to
 
 // Paths
 #define LOG_DIR "logs"
 #define PID_FILE "scheduler.pid"
-#define TASK_PIPE_PATH "/tmp/task_scheduler_pipe"
+#define SUBMIT_SOCKET_PATH "/tmp/task_scheduler.sock"  // Binary task submission (--submit-socket)
+#define SUBMIT_SOCKET_ENV "TASK_SCHEDULER_SOCKET"     // Where clients look first
+#define SUBMIT_QUEUE_SOCKET_FMT "/tmp/task_scheduler.%s.sock"  // Socket of a named queue
+#define CONFIG_FILE "scheduler.conf"    // Read at startup if present, and on SIGHUP
+
+// Scheduling
+#define DEFAULT_SCHED_POLICY SCHED_POLICY_PRIORITY  // [runtime] priority or fifo
 
 // Timeout values (in seconds)
-#define WORKER_CHECK_INTERVAL 5
-#define MONITOR_REFRESH_INTERVAL 2
-#define CLEANUP_INTERVAL 60  // Clean up completed tasks every 60 seconds
-#define COMPLETED_TASK_MAX_AGE 300  // Remove completed tasks older than 5 minutes
+#define WORKER_CHECK_INTERVAL 1     // Autoscaling/rolling restart tick (exits are seen at once)
+#define MONITOR_REFRESH_INTERVAL 2  // schedctl watch default
+#define CLEANUP_INTERVAL 60  // [runtime] Clean up completed tasks every 60 seconds
+#define COMPLETED_TASK_MAX_AGE 300  // [runtime] Remove completed tasks older than 5 minutes
+
+#define WORKER_HEARTBEAT_TIMEOUT 3  // A worker silent this long is reported as not alive
+#define WORKER_DRAIN_TIMEOUT 30     // In-flight tasks still running this long after a drain are requeued
+#define WORKER_ATTACH_TIMEOUT 10    // Rolling restart gives up on a replacement that hasn't attached
+
+// Worker autoscaling (scheduler --min-workers/--max-workers)
+#define AUTOSCALE_UP_PENDING_PER_WORKER 2   // Pending tasks per live worker that ask for more
+#define AUTOSCALE_UP_MAX_WAIT 5             // Oldest pending task age (s) that asks for more
+#define AUTOSCALE_UP_UTILIZATION 75         // Pool must be at least this % busy to grow
+#define AUTOSCALE_DOWN_UTILIZATION 25       // Pool must be at most this % busy to shrink
+#define AUTOSCALE_UP_TICKS 2                // Consecutive checks before growing
+#define AUTOSCALE_DOWN_TICKS 30             // Consecutive checks before shrinking
+#define AUTOSCALE_UP_COOLDOWN 5             // Seconds after any change before growing again
+#define AUTOSCALE_DOWN_COOLDOWN 60          // Seconds after any change before shrinking
+
+// Retry backoff defaults for tasks submitted with max_retries > 0
+#define RETRY_BACKOFF_BASE_MS 500       // Delay before the first retry
+#define RETRY_BACKOFF_CAP_MS 30000      // Delays double per attempt up to this
+#define RETRY_BACKOFF_JITTER 50         // % of each delay randomized away (1-100)
+
+// Federation (scheduler --listen/--peer): schedulers on other hosts share load
+#define MAX_PEERS 8                         // Peers a node tracks
+#define FEDERATION_LISTEN_ADDRESS "localhost" // --listen binds here; peers are not authenticated
+#define FEDERATION_GOSSIP_INTERVAL_MS 1000  // Queue depth sent to every peer this often
+#define FEDERATION_PEER_TIMEOUT 5           // A peer silent this long (s) isn't stolen from
+#define FEDERATION_RECONNECT_INTERVAL 2     // Seconds between connection attempts to a peer
+#define FEDERATION_STEAL_MIN_PENDING 4      // Pending tasks a peer needs before we steal
+#define FEDERATION_STEAL_BATCH 8            // Most tasks asked for in one steal
+#define FEDERATION_HANDOFF_TIMEOUT 30       // Ask the peer about an offer unanswered this long (s)
+#define FEDERATION_PEER_GONE_TIMEOUT 3600  // Run offers to a peer away this long (s) here
+#define HANDOFF_LOG_SIZE 1024               // Peer offers remembered, to answer resends alike
+
+// Binary task submission over SUBMIT_SOCKET_PATH (wire format in src/submit_proto.h)
+#define SUBMIT_MAX_CLIENTS 64               // Producers connected at once
+#define SUBMIT_MAX_BATCH 256                // Most tasks in one frame
+#define SUBMIT_MAX_FRAME (128 * 1024)       // Largest frame in bytes, header included
+#define SUBMIT_ACK_BACKLOG (64 * 1024)      // Unsent ack bytes before a producer stops being read
+#define SUBMIT_WINDOW 32                    // Frames a producer sends ahead of their ACKs
+
+// Lock-free queue snapshots (schedctl): copies retried while writers overlap
+#define SNAPSHOT_MAX_RETRIES 64             // Then the mutex is taken instead
+
+// Task change log in shared memory, followed by the dashboard's event stream
+#define CHANGE_LOG_SIZE 1024                // Newest changes kept (power of 2); older readers resync
+#define EVENT_PUSH_INTERVAL_MS 250          // web_server batches changes for /api/events this often
+#define EVENT_PING_INTERVAL 15              // Seconds between keepalive comments on an idle stream
+
+// Filtered task queries (/api/tasks?status=...)
+#define TASK_QUERY_DEFAULT_LIMIT 100        // Tasks per page unless limit= says otherwise
+#define TASK_QUERY_MAX_LIMIT 1000           // Largest page
+
+// Asynchronous logging: callers queue records, a per-process thread writes them
+#define LOG_RING_SLOTS 1024                 // Records waiting to be written (power of 2)
+#define LOG_MESSAGE_MAX 480                 // Longer messages are truncated
+#define LOG_FLUSH_INTERVAL_MS 50            // Flusher wakes at least this often
+#define LOG_OVERFLOW_DEFAULT LOG_OVERFLOW_DROP  // Full ring: drop (counted) or block the caller
+#define LOG_OVERFLOW_ENV "TASK_SCHEDULER_LOG_OVERFLOW"  // "drop" or "block"; overrides the default
+
+// Binary event trace (scheduler --trace, decoded by tracedump)
+#define TRACE_ENV "TASK_SCHEDULER_TRACE"    // Non-zero: each process writes logs/<name>_<pid>.trace
+#define TRACE_RECORDS (1 << 18)             // Newest events kept per process (32 bytes each)
+
+// Running-task control (milliseconds)
+#define CANCEL_POLL_INTERVAL_MS 100  // How often a worker looks for cancel requests
 
 #endif // CONFIG_H
 
@@ -1,9 +1,11 @@
 #!/bin/bash
 
-# Add Task Script
-# Usage: ./add_task.sh <name> <priority> <duration_ms>
+# Add Task Script (a wrapper around ./schedctl submit)
+# Usage: ./add_task.sh <name> <priority> <duration_ms> [timeout_ms] [max_retries]
 # Priority: HIGH, MEDIUM, or LOW
 # Duration: execution time in milliseconds
+# Timeout: optional limit; the task fails if it runs longer
+# Max retries: optional; failed attempts are retried with exponential backoff
 
 SCRIPT_DIR="$(cd "$(dirname "${BASH_SOURCE[0]}")" && pwd)"
 PROJECT_ROOT="$(cd "$SCRIPT_DIR/.." && pwd)"
@@ -11,10 +13,12 @@ PROJECT_ROOT="$(cd "$SCRIPT_DIR/.." && pwd)"
 cd "$PROJECT_ROOT" || exit 1
 
 if [ $# -lt 3 ]; then
-    echo "Usage: $0 <name> <priority> <duration_ms>"
+    echo "Usage: $0 <name> <priority> <duration_ms> [timeout_ms] [max_retries]"
     echo "  name: Task name (use quotes if it contains spaces)"
     echo "  priority: HIGH, MEDIUM, or LOW"
     echo "  duration_ms: Execution time in milliseconds"
+    echo "  timeout_ms: Optional run-time limit in milliseconds (0 = none)"
+    echo "  max_retries: Optional number of retries after a failed attempt (default 0)"
     echo ""
     echo "Example: $0 \"Data Processing\" HIGH 5000"
     exit 1
@@ -23,30 +27,8 @@ fi
 TASK_NAME="$1"
 PRIORITY_STR="$2"
 DURATION_MS="$3"
-
-# Validate priority
-PRIORITY_NUM=-1
-case "$PRIORITY_STR" in
-    HIGH|high|High)
-        PRIORITY_NUM=0
-        ;;
-    MEDIUM|medium|Medium)
-        PRIORITY_NUM=1
-        ;;
-    LOW|low|Low)
-        PRIORITY_NUM=2
-        ;;
-    *)
-        echo "Error: Invalid priority. Must be HIGH, MEDIUM, or LOW"
-        exit 1
-        ;;
-esac
-
-# Validate duration
-if ! [[ "$DURATION_MS" =~ ^[0-9]+$ ]]; then
-    echo "Error: Duration must be a positive integer"
-    exit 1
-fi
+TIMEOUT_MS="${4:-0}"
+MAX_RETRIES="${5:-0}"
 
 # Check if scheduler is running
 if [ ! -f scheduler.pid ]; then
@@ -60,67 +42,16 @@ if ! ps -p "$PID" > /dev/null 2>&1; then
     exit 1
 fi
 
-# Create named pipe if it doesn't exist
-PIPE_PATH="/tmp/task_scheduler_pipe"
-if [ ! -p "$PIPE_PATH" ]; then
-    mkfifo "$PIPE_PATH" 2>/dev/null || {
-        echo "Error: Failed to create task pipe"
-        exit 1
-    }
-fi
-
-# Create a helper program to add tasks via shared memory
-# We'll use a simple C program for this
-if [ ! -f add_task_helper ]; then
-    cat > add_task_helper.c << 'EOF'
-#include <stdio.h>
-#include <stdlib.h>
-#include <string.h>
-#include <sys/ipc.h>
-#include <sys/shm.h>
-#include "config.h"
-#include "src/task_queue.h"
-#include "src/common.h"
-
-int main(int argc, char* argv[]) {
-    if (argc != 4) {
-        fprintf(stderr, "Usage: %s <name> <priority> <duration>\n", argv[0]);
-        return 1;
-    }
-    
-    char* name = argv[1];
-    int priority = atoi(argv[2]);
-    unsigned int duration = (unsigned int)atoi(argv[3]);
-    
-    TaskQueue* queue = attach_shared_memory(-1);
-    if (queue == NULL) {
-        fprintf(stderr, "Error: Failed to attach to shared memory\n");
-        return 1;
-    }
-    
-    int task_id = enqueue_task(queue, name, priority, duration);
-    if (task_id > 0) {
-        printf("Task added successfully. ID: %d\n", task_id);
-    } else {
-        fprintf(stderr, "Error: Failed to add task (queue might be full)\n");
-        detach_shared_memory(queue);
-        return 1;
-    }
-    
-    detach_shared_memory(queue);
-    return 0;
-}
-EOF
-    gcc -o add_task_helper add_task_helper.c src/task_queue.c src/common.c -lpthread -I. || {
-        echo "Error: Failed to compile add_task_helper"
-        rm -f add_task_helper.c
+# Build the admin CLI if needed; it validates the arguments and submits
+# over the scheduler's socket
+if [ ! -x schedctl ]; then
+    make -s schedctl || {
+        echo "Error: Failed to build schedctl"
         exit 1
     }
-    rm -f add_task_helper.c
 fi
 
-# Add the task
-./add_task_helper "$TASK_NAME" "$PRIORITY_NUM" "$DURATION_MS"
+./schedctl submit "$TASK_NAME" "$PRIORITY_STR" "$DURATION_MS" "$TIMEOUT_MS" "$MAX_RETRIES"
 RESULT=$?
 
 if [ $RESULT -eq 0 ]; then
@@ -128,4 +59,3 @@ if [ $RESULT -eq 0 ]; then
 fi
 
 exit $RESULT
-
@@ -0,0 +1,149 @@
+#!/bin/bash
+
+# Executor Benchmark Script
+# Compares thread-per-task and async (epoll/timerfd) worker execution using
+# the dashboard's "concurrent" scenario (all HIGH priority, 5000 ms each).
+# Usage: ./bench_executor.sh [task_count] [duration_ms]
+
+SCRIPT_DIR="$(cd "$(dirname "${BASH_SOURCE[0]}")" && pwd)"
+PROJECT_ROOT="$(cd "$SCRIPT_DIR/.." && pwd)"
+
+TASK_COUNT="${1:-10000}"
+DURATION_MS="${2:-5000}"
+
+if ! [[ "$TASK_COUNT" =~ ^[0-9]+$ ]] || ! [[ "$DURATION_MS" =~ ^[0-9]+$ ]]; then
+    echo "Usage: $0 [task_count] [duration_ms]"
+    exit 1
+fi
+
+# Build a private copy with a queue big enough for the run (and thread-mode
+# workers allowed to run all of it at once) and its own shared memory key,
+# so a running scheduler is left alone
+BENCH_SHM_KEY=0x1234567a
+BENCH_DIR=$(mktemp -d /tmp/bench_executor.XXXXXX)
+trap 'rm -rf "$BENCH_DIR"' EXIT
+
+cp -r "$PROJECT_ROOT/src" "$PROJECT_ROOT/config.h" "$PROJECT_ROOT/Makefile" "$BENCH_DIR/"
+cd "$BENCH_DIR" || exit 1
+
+BENCH_CFLAGS="-Wall -Wextra -O2 -std=c11 -pthread -D_GNU_SOURCE -DMAX_TASKS=$TASK_COUNT -DMAX_THREADS_PER_WORKER=$TASK_COUNT -DSHM_KEY=$BENCH_SHM_KEY"
+echo "Building benchmark binaries (MAX_TASKS=$TASK_COUNT)..."
+make scheduler worker CFLAGS="$BENCH_CFLAGS" > build.log 2>&1 || {
+    echo "Error: Build failed"
+    cat build.log
+    exit 1
+}
+
+cat > bench_driver.c << 'EOF'
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "config.h"
+#include "src/task_queue.h"
+#include "src/common.h"
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Read a "Key:   value" line from /proc/<pid>/status
+static long proc_status_value(pid_t pid, const char* key) {
+    char path[64], line[256];
+    snprintf(path, sizeof(path), "/proc/%d/status", (int)pid);
+    FILE* f = fopen(path, "r");
+    if (f == NULL) return 0;
+    long value = 0;
+    size_t key_len = strlen(key);
+    while (fgets(line, sizeof(line), f)) {
+        if (strncmp(line, key, key_len) == 0 && line[key_len] == ':') {
+            value = atol(line + key_len + 1);
+            break;
+        }
+    }
+    fclose(f);
+    return value;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 3) {
+        fprintf(stderr, "Usage: %s <count> <duration_ms> [worker_pid...]\n", argv[0]);
+        return 1;
+    }
+    int count = atoi(argv[1]);
+    unsigned int duration = (unsigned int)atoi(argv[2]);
+
+    TaskQueue* queue = attach_shared_memory(-1);
+    if (queue == NULL) return 1;
+
+    double start = now_seconds();
+    for (int i = 0; i < count; i++) {
+        char name[64];
+        snprintf(name, sizeof(name), "Concurrent Task %d", i + 1);
+        if (enqueue_task(queue, name, PRIORITY_HIGH, duration) <= 0) {
+            fprintf(stderr, "enqueue failed at task %d\n", i + 1);
+            return 1;
+        }
+    }
+    double enqueued = now_seconds();
+
+    long peak_threads = 0, peak_rss_kb = 0;
+    int done = 0;
+    while (done < count) {
+        long threads = 0, rss_kb = 0;
+        for (int w = 3; w < argc; w++) {
+            threads += proc_status_value(atoi(argv[w]), "Threads");
+            rss_kb += proc_status_value(atoi(argv[w]), "VmHWM");
+        }
+        if (threads > peak_threads) peak_threads = threads;
+        if (rss_kb > peak_rss_kb) peak_rss_kb = rss_kb;
+
+        lock_queue(queue);
+        done = queue->completed_tasks + queue->failed_tasks;
+        unlock_queue(queue);
+        usleep(20000);
+    }
+    double finished = now_seconds();
+
+    printf("  enqueue time:     %.3f s\n", enqueued - start);
+    printf("  makespan:         %.3f s (ideal %.3f s)\n", finished - start, duration / 1000.0);
+    printf("  throughput:       %.0f tasks/s\n", count / (finished - start));
+    printf("  failed tasks:     %d\n", queue->failed_tasks);
+    printf("  peak threads:     %ld (all workers)\n", peak_threads);
+    printf("  peak worker RSS:  %ld KB (sum of VmHWM)\n", peak_rss_kb);
+
+    detach_shared_memory(queue);
+    return 0;
+}
+EOF
+gcc -O2 -D_GNU_SOURCE -DMAX_TASKS="$TASK_COUNT" -DSHM_KEY="$BENCH_SHM_KEY" -I. -o bench_driver \
+    bench_driver.c src/task_queue.c src/trace.c src/common.c src/logger.c -lpthread || {
+    echo "Error: Failed to compile bench_driver"
+    exit 1
+}
+
+remove_segment() {
+    SHM_ID=$(ipcs -m | grep "$(printf '0x%08x' $BENCH_SHM_KEY)" | awk '{print $2}')
+    if [ -n "$SHM_ID" ]; then
+        ipcrm -m "$SHM_ID" 2>/dev/null
+    fi
+}
+
+for MODE in thread async; do
+    remove_segment
+    ./scheduler --exec-mode "$MODE" > /dev/null 2>&1 &
+    SCHED_PID=$!
+    sleep 1
+
+    WORKER_PIDS=$(pgrep -P "$SCHED_PID" | tr '\n' ' ')
+    echo ""
+    echo "Mode: $MODE ($TASK_COUNT tasks x ${DURATION_MS}ms, workers: $WORKER_PIDS)"
+    # shellcheck disable=SC2086
+    ./bench_driver "$TASK_COUNT" "$DURATION_MS" $WORKER_PIDS
+
+    kill -TERM "$SCHED_PID" 2>/dev/null
+    wait "$SCHED_PID" 2>/dev/null
+    remove_segment
+done
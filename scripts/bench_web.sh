@@ -0,0 +1,269 @@
+#!/bin/bash
+
+# Web Server Benchmark Script
+# Compares the dashboard server of a baseline revision with the working tree:
+# closed-loop GET /api/status clients on keep-alive connections, once on their
+# own and once next to a client that sends half a request and stalls.
+# Usage: ./bench_web.sh [baseline_rev] [connections] [seconds]
+
+SCRIPT_DIR="$(cd "$(dirname "${BASH_SOURCE[0]}")" && pwd)"
+PROJECT_ROOT="$(cd "$SCRIPT_DIR/.." && pwd)"
+
+BASELINE_REV="${1:-HEAD}"
+CONNECTIONS="${2:-32}"
+SECONDS_PER_RUN="${3:-5}"
+
+if ! [[ "$CONNECTIONS" =~ ^[0-9]+$ ]] || ! [[ "$SECONDS_PER_RUN" =~ ^[0-9]+$ ]]; then
+    echo "Usage: $0 [baseline_rev] [connections] [seconds]"
+    exit 1
+fi
+
+if pgrep -x web_server > /dev/null; then
+    echo "Error: a web_server is already running (the benchmark needs port 8080)"
+    exit 1
+fi
+
+# Both servers read a private scheduler's queue, so a running one is left alone
+BENCH_SHM_KEY=0x1234567b
+BENCH_DIR=$(mktemp -d /tmp/bench_web.XXXXXX)
+SCHED_PID=""
+cleanup() {
+    [ -n "$SCHED_PID" ] && kill -TERM "$SCHED_PID" 2>/dev/null && wait "$SCHED_PID" 2>/dev/null
+    rm -rf "$BENCH_DIR"
+}
+trap cleanup EXIT
+
+echo "Building baseline ($BASELINE_REV) and current web_server..."
+mkdir -p "$BENCH_DIR/baseline"
+(cd "$PROJECT_ROOT" && git archive "$BASELINE_REV") | tar -x -C "$BENCH_DIR/baseline" || {
+    echo "Error: Cannot export $BASELINE_REV"
+    exit 1
+}
+make -C "$BENCH_DIR/baseline" web_server > "$BENCH_DIR/build.log" 2>&1 &&
+    make -C "$PROJECT_ROOT" scheduler worker web_server >> "$BENCH_DIR/build.log" 2>&1 || {
+    echo "Error: Build failed"
+    cat "$BENCH_DIR/build.log"
+    exit 1
+}
+
+cat > "$BENCH_DIR/bench_client.c" << 'EOF'
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#define MAX_SAMPLES 1000000
+
+typedef struct {
+    double* latency;
+    long capacity;
+    long count;
+    long errors;
+    long connects;
+} ClientStats;
+
+static double deadline;
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int connect_server(void) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) return -1;
+    struct timeval tv = { 2, 0 };
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));  // Bounds connect too
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    struct sockaddr_in addr = { .sin_family = AF_INET, .sin_port = htons(8080) };
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (connect(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// Read one response; returns 1 if the connection can be reused, 0 if the
+// server closes it, -1 on error
+static int read_response(int fd) {
+    char buf[65536];
+    size_t len = 0;
+    char* body = NULL;
+    long content_length = -1;
+    int keep = 0;
+    for (;;) {
+        if (len == sizeof(buf) - 1) return -1;
+        ssize_t n = recv(fd, buf + len, sizeof(buf) - 1 - len, 0);
+        if (n < 0) return -1;
+        if (n == 0) return body != NULL && content_length < 0 ? 0 : -1;
+        len += (size_t)n;
+        buf[len] = '\0';
+        if (body == NULL) {
+            body = strstr(buf, "\r\n\r\n");
+            if (body == NULL) continue;
+            body += 4;
+            for (char* line = strstr(buf, "\r\n"); line != NULL && line + 2 < body;
+                 line = strstr(line + 2, "\r\n")) {
+                if (strncasecmp(line + 2, "Content-Length:", 15) == 0) {
+                    content_length = atol(line + 17);
+                } else if (strncasecmp(line + 2, "Connection: keep-alive", 22) == 0) {
+                    keep = 1;
+                }
+            }
+        }
+        if (content_length >= 0 && (long)(buf + len - body) >= content_length) {
+            return keep;
+        }
+    }
+}
+
+static void* client_thread(void* arg) {
+    ClientStats* stats = arg;
+    static const char request[] =
+        "GET /api/status HTTP/1.1\r\nHost: localhost\r\nConnection: keep-alive\r\n\r\n";
+    int fd = -1;
+    while (now_seconds() < deadline) {
+        if (fd < 0) {
+            fd = connect_server();
+            if (fd < 0) {
+                stats->errors++;
+                usleep(1000);
+                continue;
+            }
+            stats->connects++;
+        }
+        double start = now_seconds();
+        int rc = send(fd, request, sizeof(request) - 1, MSG_NOSIGNAL) < 0 ? -1 : read_response(fd);
+        if (rc < 0) {
+            stats->errors++;
+        } else if (stats->count < stats->capacity) {
+            stats->latency[stats->count++] = now_seconds() - start;
+        }
+        if (rc <= 0) {
+            close(fd);
+            fd = -1;
+        }
+    }
+    if (fd >= 0) close(fd);
+    return NULL;
+}
+
+static int compare_doubles(const void* a, const void* b) {
+    double x = *(const double*)a, y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 4) {
+        fprintf(stderr, "Usage: %s <connections> <seconds> <stall 0|1>\n", argv[0]);
+        return 1;
+    }
+    int connections = atoi(argv[1]);
+    int seconds = atoi(argv[2]);
+
+    // Half a request the server will never see the end of
+    int staller = -1;
+    if (atoi(argv[3])) {
+        staller = connect_server();
+        if (staller >= 0) send(staller, "GET /api/sta", 12, MSG_NOSIGNAL);
+        usleep(100000);
+    }
+
+    pthread_t* threads = calloc((size_t)connections, sizeof(pthread_t));
+    ClientStats* stats = calloc((size_t)connections, sizeof(ClientStats));
+    double start = now_seconds();
+    deadline = start + seconds;
+    for (int i = 0; i < connections; i++) {
+        stats[i].capacity = MAX_SAMPLES / connections;
+        stats[i].latency = malloc((size_t)stats[i].capacity * sizeof(double));
+        pthread_create(&threads[i], NULL, client_thread, &stats[i]);
+    }
+
+    long total = 0, errors = 0, connects = 0;
+    for (int i = 0; i < connections; i++) {
+        pthread_join(threads[i], NULL);
+        total += stats[i].count;
+        errors += stats[i].errors;
+        connects += stats[i].connects;
+    }
+    double elapsed = now_seconds() - start;
+
+    double* all = malloc((size_t)(total + 1) * sizeof(double));
+    long n = 0;
+    for (int i = 0; i < connections; i++) {
+        memcpy(all + n, stats[i].latency, (size_t)stats[i].count * sizeof(double));
+        n += stats[i].count;
+    }
+    qsort(all, (size_t)n, sizeof(double), compare_doubles);
+
+    printf("  requests:     %ld in %.1f s (%.0f req/s)\n", total, elapsed, total / elapsed);
+    if (n > 0) {
+        printf("  latency:      p50 %.3f ms, p99 %.3f ms, max %.3f ms\n",
+               all[n / 2] * 1e3, all[n * 99 / 100] * 1e3, all[n - 1] * 1e3);
+    }
+    printf("  connections:  %ld opened, %ld errors/timeouts\n", connects, errors);
+
+    if (staller >= 0) close(staller);
+    return 0;
+}
+EOF
+gcc -O2 -Wall -pthread -o "$BENCH_DIR/bench_client" "$BENCH_DIR/bench_client.c" || {
+    echo "Error: Failed to compile bench_client"
+    exit 1
+}
+
+remove_segment() {
+    SHM_ID=$(ipcs -m | grep "$(printf '0x%08x' $BENCH_SHM_KEY)" | awk '{print $2}')
+    if [ -n "$SHM_ID" ]; then
+        ipcrm -m "$SHM_ID" 2>/dev/null
+    fi
+}
+
+cd "$PROJECT_ROOT" || exit 1
+remove_segment
+./scheduler --workers 1 --shm-key "$BENCH_SHM_KEY" --pid-file "$BENCH_DIR/scheduler.pid" \
+    --submit-socket "$BENCH_DIR/submit.sock" > /dev/null 2>&1 &
+SCHED_PID=$!
+sleep 1
+export TASK_SCHEDULER_SHM_KEY="$BENCH_SHM_KEY"
+
+for SERVER in baseline current; do
+    if [ "$SERVER" = baseline ]; then
+        BINARY="$BENCH_DIR/baseline/web_server"
+    else
+        BINARY="$PROJECT_ROOT/web_server"
+    fi
+    for STALL in 0 1; do
+        # The baseline binary serves files relative to its working directory
+        (cd "$PROJECT_ROOT" && exec "$BINARY") > /dev/null 2>&1 &
+        WEB_PID=$!
+        sleep 0.5
+
+        echo ""
+        if [ "$STALL" = 1 ]; then
+            echo "Server: $SERVER ($CONNECTIONS connections, ${SECONDS_PER_RUN}s, one stalled client)"
+        else
+            echo "Server: $SERVER ($CONNECTIONS connections, ${SECONDS_PER_RUN}s)"
+        fi
+        "$BENCH_DIR/bench_client" "$CONNECTIONS" "$SECONDS_PER_RUN" "$STALL"
+
+        kill -KILL "$WEB_PID" 2>/dev/null
+        wait "$WEB_PID" 2>/dev/null
+    done
+done
+
+kill -TERM "$SCHED_PID" 2>/dev/null
+wait "$SCHED_PID" 2>/dev/null
+SCHED_PID=""
+remove_segment
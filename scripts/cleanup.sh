@@ -2,6 +2,7 @@
 
 # Cleanup Script
 # Removes shared memory segments and kills scheduler/worker processes
+# Usage: ./cleanup.sh [QUEUE...]   (named queues to remove besides the default)
 
 SCRIPT_DIR="$(cd "$(dirname "${BASH_SOURCE[0]}")" && pwd)"
 PROJECT_ROOT="$(cd "$SCRIPT_DIR/.." && pwd)"
@@ -45,23 +46,39 @@ pkill -f "worker [0-9]" 2>/dev/null
 sleep 1
 pkill -9 -f "worker [0-9]" 2>/dev/null
 
-# Remove shared memory segments
-echo "Removing shared memory segments..."
-SHM_KEY=0x12345678
-SHM_ID=$(ipcs -m | grep "$(printf '%x' $SHM_KEY)" | awk '{print $2}')
+# Remove each queue's shared memory segment and the submission socket a
+# killed scheduler left behind: the default queue's, plus any named queue
+# given on the command line
+remove_queue() {
+    local queue=$1
+    local shm_key socket
+    if [ -x schedctl ]; then
+        shm_key=$(./schedctl -q "$queue" info | awk '$1 == "shm_key" {print $2}')
+        socket=$(./schedctl -q "$queue" info | awk '$1 == "socket" {print $2}')
+    else
+        shm_key=${TASK_SCHEDULER_SHM_KEY:-0x12345678}   # shm_key in scheduler.conf needs this exported
+        socket=${TASK_SCHEDULER_SOCKET:-/tmp/task_scheduler.sock}
+    fi
 
-if [ -n "$SHM_ID" ]; then
-    ipcrm -m "$SHM_ID" 2>/dev/null
-    echo "Removed shared memory segment $SHM_ID"
-else
-    echo "No shared memory segment found"
-fi
+    local shm_id
+    shm_id=$(ipcs -m | grep "$(printf '0x%08x' "$shm_key")" | awk '{print $2}')
+    if [ -n "$shm_id" ]; then
+        ipcrm -m "$shm_id" 2>/dev/null
+        echo "Removed shared memory segment $shm_id (queue $queue)"
+    else
+        echo "No shared memory segment found for queue $queue"
+    fi
 
-# Remove named pipe
-if [ -p /tmp/task_scheduler_pipe ]; then
-    rm -f /tmp/task_scheduler_pipe
-    echo "Removed named pipe"
-fi
+    if [ -S "$socket" ]; then
+        rm -f "$socket"
+        echo "Removed submission socket $socket"
+    fi
+}
+
+echo "Removing shared memory segments..."
+for QUEUE in default "$@"; do
+    remove_queue "$QUEUE"
+done
 
 # Clean up helper binaries
 rm -f add_task_helper monitor_helper report_helper
@@ -0,0 +1,40 @@
+#!/bin/bash
+
+# Rolling Restart Script
+# Rebuilds the worker binary and has the running scheduler replace its
+# workers one at a time. Each replacement starts before the worker it
+# replaces drains, so the queue keeps being served throughout.
+# Usage: ./rolling_restart.sh [--no-build]
+
+SCRIPT_DIR="$(cd "$(dirname "${BASH_SOURCE[0]}")" && pwd)"
+PROJECT_ROOT="$(cd "$SCRIPT_DIR/.." && pwd)"
+
+cd "$PROJECT_ROOT" || exit 1
+
+if [ ! -f scheduler.pid ]; then
+    echo "Error: Scheduler is not running. Start it with ./scripts/start_scheduler.sh"
+    exit 1
+fi
+
+PID=$(cat scheduler.pid)
+if ! ps -p "$PID" > /dev/null 2>&1; then
+    echo "Error: Scheduler is not running (stale PID file)"
+    exit 1
+fi
+
+if [ "$1" != "--no-build" ]; then
+    echo "Building worker..."
+    make worker
+    if [ $? -ne 0 ]; then
+        echo "Error: Build failed, workers left untouched"
+        exit 1
+    fi
+fi
+
+kill -USR2 "$PID" || {
+    echo "Error: Failed to signal scheduler"
+    exit 1
+}
+
+echo "Rolling restart requested (scheduler PID $PID)"
+echo "Follow progress with: grep 'Rolling restart' logs/scheduler_$PID.log"
@@ -2,6 +2,7 @@
 
 # Start Scheduler Script
 # This script initializes and starts the scheduler process
+# Usage: ./start_scheduler.sh [scheduler options, e.g. --exec-mode async]
 
 SCRIPT_DIR="$(cd "$(dirname "${BASH_SOURCE[0]}")" && pwd)"
 PROJECT_ROOT="$(cd "$SCRIPT_DIR/.." && pwd)"
@@ -44,7 +45,7 @@ fi
 
 # Start scheduler in background
 echo "Starting scheduler..."
-./scheduler > logs/scheduler_startup.log 2>&1 &
+./scheduler "$@" > logs/scheduler_startup.log 2>&1 &
 
 # Wait a moment for scheduler to start
 sleep 2
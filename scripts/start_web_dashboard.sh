@@ -2,6 +2,7 @@
 
 # Start Web Dashboard Script
 # This script starts the web server for the dashboard
+# Usage: ./start_web_dashboard.sh [--queue NAME]... [--threads N]   (queues to serve; default: the default queue)
 
 SCRIPT_DIR="$(cd "$(dirname "${BASH_SOURCE[0]}")" && pwd)"
 PROJECT_ROOT="$(cd "$SCRIPT_DIR/.." && pwd)"
@@ -49,7 +50,7 @@ fi
 
 # Start web server in background
 echo "Starting web server..."
-./web_server > logs/web_server.log 2>&1 &
+./web_server "$@" > logs/web_server.log 2>&1 &
 WEB_PID=$!
 
 # Wait a moment for server to start
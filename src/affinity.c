@@ -0,0 +1,166 @@
+#include "affinity.h"
+#include <ctype.h>
+#include <stdint.h>
+#include <sys/syscall.h>
+
+// Memory policy constants from <numaif.h>, so we don't need libnuma
+#ifndef MPOL_PREFERRED
+#define MPOL_PREFERRED 1
+#define MPOL_BIND 2
+#define MPOL_INTERLEAVE 3
+#endif
+#ifndef MPOL_MF_MOVE
+#define MPOL_MF_MOVE (1 << 1)
+#endif
+
+int parse_cpu_list(const char* str, cpu_set_t* set) {
+    if (str == NULL || set == NULL) return -1;
+
+    CPU_ZERO(set);
+    const char* p = str;
+    while (*p != '\0') {
+        if (!isdigit((unsigned char)*p)) return -1;
+        char* end;
+        long first = strtol(p, &end, 10);
+        long last = first;
+        p = end;
+        if (*p == '-') {
+            p++;
+            if (!isdigit((unsigned char)*p)) return -1;
+            last = strtol(p, &end, 10);
+            p = end;
+        }
+        if (first < 0 || last < first || last >= CPU_SETSIZE) return -1;
+        for (long cpu = first; cpu <= last; cpu++) {
+            CPU_SET((int)cpu, set);
+        }
+        if (*p == ',') {
+            p++;
+        } else if (*p != '\0' && *p != '\n') {
+            return -1;
+        } else {
+            break;
+        }
+    }
+    return CPU_COUNT(set) > 0 ? 0 : -1;
+}
+
+void format_cpu_list(const cpu_set_t* set, char* buffer, size_t size) {
+    size_t offset = 0;
+    buffer[0] = '\0';
+    for (int cpu = 0; cpu < CPU_SETSIZE && offset < size; cpu++) {
+        if (!CPU_ISSET(cpu, set)) continue;
+        int last = cpu;
+        while (last + 1 < CPU_SETSIZE && CPU_ISSET(last + 1, set)) last++;
+        if (last == cpu) {
+            offset += snprintf(buffer + offset, size - offset, "%s%d",
+                               offset ? "," : "", cpu);
+        } else {
+            offset += snprintf(buffer + offset, size - offset, "%s%d-%d",
+                               offset ? "," : "", cpu, last);
+        }
+        cpu = last;
+    }
+}
+
+int cpus_of_numa_node(int node, cpu_set_t* set) {
+    char path[128];
+    char line[1024];
+    snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist", node);
+
+    FILE* f = fopen(path, "r");
+    if (f == NULL) return -1;
+    if (fgets(line, sizeof(line), f) == NULL) {
+        fclose(f);
+        return -1;
+    }
+    fclose(f);
+    return parse_cpu_list(line, set);
+}
+
+unsigned long numa_nodes_of_cpus(const cpu_set_t* set) {
+    unsigned long mask = 0;
+    for (int node = 0; node < MAX_NUMA_NODES; node++) {
+        cpu_set_t node_cpus;
+        if (cpus_of_numa_node(node, &node_cpus) != 0) continue;
+        CPU_AND(&node_cpus, &node_cpus, set);
+        if (CPU_COUNT(&node_cpus) > 0) {
+            mask |= 1UL << node;
+        }
+    }
+    return mask;
+}
+
+int bind_memory_to_nodes(void* addr, size_t len, unsigned long nodemask) {
+    if (addr == NULL || nodemask == 0) return -1;
+
+    // mbind wants a page-aligned range
+    long page_size = sysconf(_SC_PAGESIZE);
+    uintptr_t start = (uintptr_t)addr & ~((uintptr_t)page_size - 1);
+    size_t span = (size_t)((uintptr_t)addr + len - start);
+
+    int mode = (nodemask & (nodemask - 1)) ? MPOL_INTERLEAVE : MPOL_PREFERRED;
+    return (int)syscall(SYS_mbind, start, span, mode, &nodemask,
+                        (unsigned long)MAX_NUMA_NODES + 1, MPOL_MF_MOVE);
+}
+
+int pin_thread_round_robin(pthread_t thread, const cpu_set_t* set, int n) {
+    int count = CPU_COUNT(set);
+    if (count == 0) return -1;
+
+    int target = n % count;
+    for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+        if (!CPU_ISSET(cpu, set)) continue;
+        if (target-- == 0) {
+            cpu_set_t single;
+            CPU_ZERO(&single);
+            CPU_SET(cpu, &single);
+            return pthread_setaffinity_np(thread, sizeof(single), &single);
+        }
+    }
+    return -1;
+}
+
+int pin_thread_to_set(pthread_t thread, const cpu_set_t* set) {
+    if (CPU_COUNT(set) == 0) return -1;
+    return pthread_setaffinity_np(thread, sizeof(*set), set);
+}
+
+int placement_init(ThreadPlacement* placement, int pin_threads, const char* isolated_list) {
+    memset(placement, 0, sizeof(*placement));
+    placement->pin_threads = pin_threads;
+
+    if (sched_getaffinity(0, sizeof(placement->general_cpus), &placement->general_cpus) != 0) {
+        return -1;
+    }
+
+    if (isolated_list != NULL && isolated_list[0] != '\0') {
+        if (parse_cpu_list(isolated_list, &placement->isolated_cpus) != 0) return -1;
+        // Isolated cores are only for HIGH-priority work
+        for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+            if (CPU_ISSET(cpu, &placement->isolated_cpus)) {
+                CPU_CLR(cpu, &placement->general_cpus);
+            }
+        }
+        if (CPU_COUNT(&placement->general_cpus) == 0) return -1;
+        placement->has_isolated = 1;
+    }
+    return 0;
+}
+
+int placement_apply(const ThreadPlacement* placement, pthread_t thread, Priority priority, int n) {
+    if (placement == NULL) return 0;
+
+    const cpu_set_t* set = &placement->general_cpus;
+    if (placement->has_isolated && priority == PRIORITY_HIGH) {
+        set = &placement->isolated_cpus;
+    }
+
+    if (placement->pin_threads) {
+        return pin_thread_round_robin(thread, set, n);
+    }
+    if (placement->has_isolated) {
+        return pin_thread_to_set(thread, set);
+    }
+    return 0;
+}
@@ -0,0 +1,42 @@
+#ifndef AFFINITY_H
+#define AFFINITY_H
+
+#include "common.h"
+#include <sched.h>
+
+#define MAX_NUMA_NODES 64
+
+// CPU list strings use the kernel's cpulist format: "0-3,8,10-11"
+int parse_cpu_list(const char* str, cpu_set_t* set);
+void format_cpu_list(const cpu_set_t* set, char* buffer, size_t size);
+
+// CPUs belonging to a NUMA node (from sysfs)
+int cpus_of_numa_node(int node, cpu_set_t* set);
+
+// Bitmask of NUMA nodes the given CPUs live on (bit n = node n)
+unsigned long numa_nodes_of_cpus(const cpu_set_t* set);
+
+// Set the memory policy of an attached mapping to match a node mask:
+// one node binds (preferred) to it, several nodes interleave across them.
+// Existing pages are migrated where the kernel allows.
+int bind_memory_to_nodes(void* addr, size_t len, unsigned long nodemask);
+
+// Pin a thread to the n-th CPU (round-robin) of a set
+int pin_thread_round_robin(pthread_t thread, const cpu_set_t* set, int n);
+int pin_thread_to_set(pthread_t thread, const cpu_set_t* set);
+
+// Where a worker places its pool threads (task threads or event loops)
+typedef struct {
+    int pin_threads;            // Pin each thread to a single CPU, round-robin
+    int has_isolated;           // HIGH-priority work runs on isolated_cpus only
+    cpu_set_t general_cpus;     // Process affinity minus the isolated CPUs
+    cpu_set_t isolated_cpus;
+} ThreadPlacement;
+
+int placement_init(ThreadPlacement* placement, int pin_threads, const char* isolated_list);
+
+// Place a thread that runs work of the given priority; n picks the CPU
+// when pinning round-robin
+int placement_apply(const ThreadPlacement* placement, pthread_t thread, Priority priority, int n);
+
+#endif // AFFINITY_H
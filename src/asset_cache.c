@@ -0,0 +1,269 @@
+#include "asset_cache.h"
+#include "logger.h"
+#include <poll.h>
+#include <stdint.h>
+#include <sys/inotify.h>
+#include <zlib.h>
+#ifdef HAVE_BROTLI
+#include <brotli/encode.h>
+#endif
+
+#define ASSET_GZIP_LEVEL 9
+#define ASSET_BROTLI_QUALITY 11
+
+typedef struct {
+    const char* name;
+    const char* content_type;
+    AssetBody* bodies[ASSET_ENCODING_COUNT];    // NULL: missing, or not worth it
+    uint64_t hash;                              // Of the identity bytes
+} Asset;
+
+static Asset assets[] = {
+    { "index.html", "text/html; charset=utf-8", { NULL }, 0 },
+    { "dashboard.js", "application/javascript; charset=utf-8", { NULL }, 0 },
+    { "dashboard.css", "text/css; charset=utf-8", { NULL }, 0 },
+};
+#define ASSET_COUNT (int)(sizeof(assets) / sizeof(assets[0]))
+
+static const char* const encoding_names[ASSET_ENCODING_COUNT] = { NULL, "gzip", "br" };
+static const char* const etag_suffixes[ASSET_ENCODING_COUNT] = { "", "-gz", "-br" };
+
+static pthread_mutex_t assets_mutex = PTHREAD_MUTEX_INITIALIZER;
+static char asset_dir[256];
+static int inotify_fd = -1;
+static volatile int watcher_running = 0;
+static pthread_t watcher_thread;
+
+static AssetBody* body_alloc(size_t len) {
+    AssetBody* body = malloc(sizeof(AssetBody) + len);
+    if (body == NULL) return NULL;
+    body->refs = 1;
+    body->len = len;
+    return body;
+}
+
+void asset_release(AssetBody* body) {
+    if (body != NULL && __atomic_sub_fetch(&body->refs, 1, __ATOMIC_ACQ_REL) == 0) {
+        free(body);
+    }
+}
+
+// FNV-1a; only needs to change when the content does
+static uint64_t content_hash(const char* data, size_t len) {
+    uint64_t hash = 14695981039346656037ULL;
+    for (size_t i = 0; i < len; i++) {
+        hash ^= (unsigned char)data[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+static AssetBody* read_file(const char* path) {
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return NULL;
+    struct stat st;
+    AssetBody* body = NULL;
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode)) {
+        body = body_alloc((size_t)st.st_size);
+    }
+    size_t done = 0;
+    while (body != NULL && done < body->len) {
+        ssize_t n = read(fd, body->data + done, body->len - done);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) {
+            body->len = done;   // Truncated under us; the next event rereads it
+            break;
+        }
+        done += (size_t)n;
+    }
+    close(fd);
+    return body;
+}
+
+static AssetBody* compress_gzip(const AssetBody* src) {
+    z_stream zs;
+    memset(&zs, 0, sizeof(zs));
+    // windowBits 15 + 16: a gzip wrapper rather than zlib's
+    if (deflateInit2(&zs, ASSET_GZIP_LEVEL, Z_DEFLATED, 15 + 16, 9, Z_DEFAULT_STRATEGY) != Z_OK) {
+        return NULL;
+    }
+    AssetBody* out = body_alloc(deflateBound(&zs, src->len));
+    if (out != NULL) {
+        zs.next_in = (Bytef*)src->data;
+        zs.avail_in = (uInt)src->len;
+        zs.next_out = (Bytef*)out->data;
+        zs.avail_out = (uInt)out->len;
+        if (deflate(&zs, Z_FINISH) == Z_STREAM_END) {
+            out->len = zs.total_out;
+        } else {
+            free(out);
+            out = NULL;
+        }
+    }
+    deflateEnd(&zs);
+    return out;
+}
+
+static AssetBody* compress_brotli(const AssetBody* src) {
+#ifdef HAVE_BROTLI
+    size_t len = BrotliEncoderMaxCompressedSize(src->len);
+    AssetBody* out = len > 0 ? body_alloc(len) : NULL;
+    if (out == NULL) return NULL;
+    if (!BrotliEncoderCompress(ASSET_BROTLI_QUALITY, BROTLI_DEFAULT_WINDOW, BROTLI_MODE_TEXT,
+                               src->len, (const uint8_t*)src->data, &len, (uint8_t*)out->data)) {
+        free(out);
+        return NULL;
+    }
+    out->len = len;
+    return out;
+#else
+    (void)src;
+    return NULL;
+#endif
+}
+
+// Read and compress one asset, then swap it in. Responses holding the old
+// bodies keep them until they are sent.
+static void load_asset(Asset* asset) {
+    char path[512];
+    snprintf(path, sizeof(path), "%s/%s", asset_dir, asset->name);
+    AssetBody* bodies[ASSET_ENCODING_COUNT] = { NULL };
+    bodies[ASSET_IDENTITY] = read_file(path);
+    uint64_t hash = 0;
+    if (bodies[ASSET_IDENTITY] != NULL) {
+        AssetBody* identity = bodies[ASSET_IDENTITY];
+        hash = content_hash(identity->data, identity->len);
+        bodies[ASSET_GZIP] = compress_gzip(identity);
+        bodies[ASSET_BROTLI] = compress_brotli(identity);
+        for (int e = ASSET_IDENTITY + 1; e < ASSET_ENCODING_COUNT; e++) {
+            if (bodies[e] != NULL && bodies[e]->len >= identity->len) {
+                asset_release(bodies[e]);
+                bodies[e] = NULL;
+            }
+        }
+        LOG_INFO_F("Loaded %s: %zu bytes, gzip %zu, br %zu", path, identity->len,
+                   bodies[ASSET_GZIP] ? bodies[ASSET_GZIP]->len : 0,
+                   bodies[ASSET_BROTLI] ? bodies[ASSET_BROTLI]->len : 0);
+    } else {
+        LOG_WARN_F("Cannot read %s: %s", path, strerror(errno));
+    }
+
+    pthread_mutex_lock(&assets_mutex);
+    AssetBody* old[ASSET_ENCODING_COUNT];
+    memcpy(old, asset->bodies, sizeof(old));
+    memcpy(asset->bodies, bodies, sizeof(bodies));
+    asset->hash = hash;
+    pthread_mutex_unlock(&assets_mutex);
+
+    for (int e = 0; e < ASSET_ENCODING_COUNT; e++) {
+        asset_release(old[e]);
+    }
+}
+
+static Asset* find_asset(const char* name) {
+    for (int i = 0; i < ASSET_COUNT; i++) {
+        if (strcmp(assets[i].name, name) == 0) return &assets[i];
+    }
+    return NULL;
+}
+
+int asset_lookup(const char* name, unsigned accepted, AssetVariant* out) {
+    Asset* asset = find_asset(name);
+    if (asset == NULL) return -1;
+    accepted |= ASSET_ACCEPT(ASSET_IDENTITY);
+
+    pthread_mutex_lock(&assets_mutex);
+    int best = -1;
+    for (int e = 0; e < ASSET_ENCODING_COUNT; e++) {
+        AssetBody* body = asset->bodies[e];
+        if (body == NULL || !(accepted & ASSET_ACCEPT(e))) continue;
+        if (best < 0 || body->len < asset->bodies[best]->len) best = e;
+    }
+    if (best >= 0) {
+        out->body = asset->bodies[best];
+        __atomic_add_fetch(&out->body->refs, 1, __ATOMIC_RELAXED);
+        out->content_type = asset->content_type;
+        out->encoding = encoding_names[best];
+        snprintf(out->etag, sizeof(out->etag), "\"%016llx%s\"",
+                 (unsigned long long)asset->hash, etag_suffixes[best]);
+    }
+    pthread_mutex_unlock(&assets_mutex);
+    return best >= 0 ? 0 : -1;
+}
+
+// Editors save by rewriting in place (IN_CLOSE_WRITE) or by renaming a
+// new file over the old one (IN_MOVED_TO); either way the name is reread
+static void* watcher_main(void* arg) {
+    (void)arg;
+    char buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    while (watcher_running) {
+        struct pollfd pfd = { .fd = inotify_fd, .events = POLLIN };
+        if (poll(&pfd, 1, 1000) <= 0) continue;
+        ssize_t n = read(inotify_fd, buf, sizeof(buf));
+        if (n <= 0) continue;
+
+        int changed[ASSET_COUNT] = { 0 };
+        for (char* p = buf; p < buf + n;) {
+            struct inotify_event* ev = (struct inotify_event*)p;
+            p += sizeof(struct inotify_event) + ev->len;
+            if (ev->mask & IN_Q_OVERFLOW) {
+                for (int i = 0; i < ASSET_COUNT; i++) changed[i] = 1;
+                continue;
+            }
+            Asset* asset = ev->len > 0 ? find_asset(ev->name) : NULL;
+            if (asset != NULL) changed[asset - assets] = 1;
+        }
+        for (int i = 0; i < ASSET_COUNT; i++) {
+            if (changed[i]) load_asset(&assets[i]);
+        }
+    }
+    return NULL;
+}
+
+int asset_cache_start(const char* dir) {
+    snprintf(asset_dir, sizeof(asset_dir), "%s", dir);
+    struct stat st;
+    if (stat(asset_dir, &st) != 0 || !S_ISDIR(st.st_mode)) {
+        LOG_ERROR_F("Asset directory %s not found", asset_dir);
+        return -1;
+    }
+    for (int i = 0; i < ASSET_COUNT; i++) {
+        load_asset(&assets[i]);
+    }
+
+    // Without inotify the files are served as they were at startup
+    inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (inotify_fd < 0 ||
+        inotify_add_watch(inotify_fd, asset_dir,
+                          IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_DELETE) < 0) {
+        LOG_WARN_F("Not watching %s for changes: %s", asset_dir, strerror(errno));
+        if (inotify_fd >= 0) close(inotify_fd);
+        inotify_fd = -1;
+        return 0;
+    }
+    watcher_running = 1;
+    if (pthread_create(&watcher_thread, NULL, watcher_main, NULL) != 0) {
+        LOG_WARN_F("Failed to start asset watcher");
+        watcher_running = 0;
+        close(inotify_fd);
+        inotify_fd = -1;
+    }
+    return 0;
+}
+
+void asset_cache_stop(void) {
+    if (watcher_running) {
+        watcher_running = 0;
+        pthread_join(watcher_thread, NULL);
+    }
+    if (inotify_fd >= 0) {
+        close(inotify_fd);
+        inotify_fd = -1;
+    }
+    for (int i = 0; i < ASSET_COUNT; i++) {
+        for (int e = 0; e < ASSET_ENCODING_COUNT; e++) {
+            asset_release(assets[i].bodies[e]);
+            assets[i].bodies[e] = NULL;
+        }
+    }
+}
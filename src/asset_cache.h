@@ -0,0 +1,46 @@
+#ifndef ASSET_CACHE_H
+#define ASSET_CACHE_H
+
+#include "common.h"
+
+// The dashboard's static files, held in memory. Each is read once at
+// startup, compressed once per encoding (gzip, and brotli when built
+// with HAVE_BROTLI), and read again when inotify says it changed.
+// Responses share the cached bytes by reference, so a reload never
+// pulls the body out from under a response still being written.
+
+typedef enum {
+    ASSET_IDENTITY,
+    ASSET_GZIP,
+    ASSET_BROTLI,
+    ASSET_ENCODING_COUNT
+} AssetEncoding;
+
+#define ASSET_ACCEPT(encoding) (1u << (encoding))
+
+// One encoded copy of a file; freed by the last asset_release
+typedef struct {
+    int refs;
+    size_t len;
+    char data[];
+} AssetBody;
+
+typedef struct {
+    AssetBody* body;            // Hold until sent, then asset_release
+    const char* content_type;
+    const char* encoding;       // Content-Encoding value, or NULL for identity
+    char etag[32];              // Strong; differs per encoding
+} AssetVariant;
+
+// Load the assets from dir and start watching it. Returns -1 if the
+// directory can't be read at all; missing files are only logged.
+int asset_cache_start(const char* dir);
+void asset_cache_stop(void);
+
+// The smallest variant of name among the encodings in the accepted mask
+// (identity is always acceptable). Returns -1 for an unknown or missing file.
+int asset_lookup(const char* name, unsigned accepted, AssetVariant* out);
+
+void asset_release(AssetBody* body);
+
+#endif // ASSET_CACHE_H
@@ -0,0 +1,553 @@
+#include "async_executor.h"
+#include "logger.h"
+#include "resource_usage.h"
+#include "task_control.h"
+#include "worker_stats.h"
+#include "trace.h"
+#include <stdint.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+
+#define LOOP_MAX_EVENTS 16
+
+// Per-task state machine driven by the owning event loop
+typedef enum {
+    ASYNC_TASK_STARTING = 0,   // Handed over, not yet scheduled
+    ASYNC_TASK_WAITING = 1,    // Waiting for its deadline on the loop's timer
+    ASYNC_TASK_DONE = 2        // Status written back, ready to be freed
+} AsyncTaskState;
+
+typedef struct AsyncTask {
+    Task task;
+    AsyncTaskState state;
+    uint64_t started_ns;       // CLOCK_MONOTONIC
+    uint64_t deadline_ns;
+    int heap_index;            // Slot in the loop's heap while WAITING
+    int loop_index;
+    TaskUsage usage;           // Loop-thread resources spent in this task's steps
+    struct AsyncTask* next;    // Inbox linkage
+
+    // Timeout/cancel handling; cancel fields are guarded by the inbox mutex
+    TaskControlEntry* control;
+    TaskCancelReason cancel_reason;
+    int cancel_queued;
+    struct AsyncTask* cancel_next;
+} AsyncTask;
+
+typedef struct {
+    pthread_t thread;
+    int index;
+    int high_lane;             // Serves HIGH-priority tasks on isolated cores
+    int busy;                  // Counted as a busy (vs idle) thread in the worker stats
+    int epoll_fd;
+    int timer_fd;
+    int wake_fd;
+
+    // Tasks submitted by the claim loop, not yet seen by this loop
+    pthread_mutex_t inbox_mutex;
+    AsyncTask* inbox_head;
+    AsyncTask* inbox_tail;
+    AsyncTask* cancel_head;    // Tasks the control thread asked to stop
+
+    // Min-heap of waiting tasks ordered by deadline (loop thread only)
+    AsyncTask** heap;
+    int heap_size;
+    int heap_capacity;
+    uint64_t armed_deadline_ns;
+} EventLoop;
+
+static EventLoop* loops = NULL;
+static int num_event_loops = 0;
+static int first_general_loop = 0;
+static int next_loop = 0;
+static TaskQueue* exec_queue = NULL;
+static int exec_worker_id = -1;
+static volatile int loops_running = 0;
+
+static pthread_mutex_t capacity_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t capacity_cond = PTHREAD_COND_INITIALIZER;
+static int inflight = 0;
+
+static uint64_t monotonic_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static void heap_swap(AsyncTask** heap, int a, int b) {
+    AsyncTask* tmp = heap[a];
+    heap[a] = heap[b];
+    heap[b] = tmp;
+    heap[a]->heap_index = a;
+    heap[b]->heap_index = b;
+}
+
+static void heap_sift_up(EventLoop* loop, int i) {
+    while (i > 0) {
+        int parent = (i - 1) / 2;
+        if (loop->heap[parent]->deadline_ns <= loop->heap[i]->deadline_ns) break;
+        heap_swap(loop->heap, parent, i);
+        i = parent;
+    }
+}
+
+static void heap_sift_down(EventLoop* loop, int i) {
+    for (;;) {
+        int left = 2 * i + 1;
+        int right = left + 1;
+        int smallest = i;
+        if (left < loop->heap_size && loop->heap[left]->deadline_ns < loop->heap[smallest]->deadline_ns) {
+            smallest = left;
+        }
+        if (right < loop->heap_size && loop->heap[right]->deadline_ns < loop->heap[smallest]->deadline_ns) {
+            smallest = right;
+        }
+        if (smallest == i) break;
+        heap_swap(loop->heap, i, smallest);
+        i = smallest;
+    }
+}
+
+static int heap_push(EventLoop* loop, AsyncTask* t) {
+    if (loop->heap_size == loop->heap_capacity) {
+        int new_capacity = loop->heap_capacity ? loop->heap_capacity * 2 : 64;
+        AsyncTask** grown = realloc(loop->heap, new_capacity * sizeof(AsyncTask*));
+        if (grown == NULL) return -1;
+        loop->heap = grown;
+        loop->heap_capacity = new_capacity;
+    }
+
+    int i = loop->heap_size++;
+    loop->heap[i] = t;
+    t->heap_index = i;
+    heap_sift_up(loop, i);
+    return 0;
+}
+
+// Take a task out of the heap wherever it sits
+static void heap_remove(EventLoop* loop, AsyncTask* t) {
+    int i = t->heap_index;
+    if (i < 0) return;
+    t->heap_index = -1;
+
+    AsyncTask* last = loop->heap[--loop->heap_size];
+    if (i == loop->heap_size) return;
+    loop->heap[i] = last;
+    last->heap_index = i;
+    heap_sift_up(loop, i);
+    heap_sift_down(loop, last->heap_index);
+}
+
+static AsyncTask* heap_pop(EventLoop* loop) {
+    if (loop->heap_size == 0) return NULL;
+
+    AsyncTask* top = loop->heap[0];
+    heap_remove(loop, top);
+    return top;
+}
+
+// Re-arm the loop's single timerfd for the earliest deadline (or disarm it)
+static void arm_timer(EventLoop* loop) {
+    uint64_t deadline = loop->heap_size > 0 ? loop->heap[0]->deadline_ns : 0;
+    if (deadline == loop->armed_deadline_ns) return;
+
+    struct itimerspec spec;
+    memset(&spec, 0, sizeof(spec));
+    if (deadline > 0) {
+        spec.it_value.tv_sec = (time_t)(deadline / 1000000000ULL);
+        spec.it_value.tv_nsec = (long)(deadline % 1000000000ULL);
+    }
+    timerfd_settime(loop->timer_fd, TFD_TIMER_ABSTIME, &spec, NULL);
+    loop->armed_deadline_ns = deadline;
+}
+
+static void release_capacity(void) {
+    pthread_mutex_lock(&capacity_mutex);
+    inflight--;
+    pthread_cond_signal(&capacity_cond);
+    pthread_mutex_unlock(&capacity_mutex);
+}
+
+// Called by the control thread on timeout or cancel request; the loop
+// finishes the task on its next wakeup
+static void async_task_cancel_request(void* ctx, TaskCancelReason reason) {
+    AsyncTask* t = (AsyncTask*)ctx;
+    EventLoop* loop = &loops[t->loop_index];
+
+    pthread_mutex_lock(&loop->inbox_mutex);
+    t->cancel_reason = reason;
+    t->cancel_queued = 1;
+    t->cancel_next = loop->cancel_head;
+    loop->cancel_head = t;
+    pthread_mutex_unlock(&loop->inbox_mutex);
+
+    uint64_t one = 1;
+    if (write(loop->wake_fd, &one, sizeof(one)) < 0) {
+        LOG_WARN_F("Worker %d: Failed to wake loop %d to cancel task %d",
+                   exec_worker_id, loop->index, t->task.id);
+    }
+}
+
+// Drop a finished task and hand its slot back to the claim loop
+static void async_task_release(EventLoop* loop, AsyncTask* t, TaskStatus final_status) {
+    task_control_unregister(t->control);
+    TRACE(TRACE_TASK_END, t->task.id, final_status);
+    uint64_t busy_ns = t->started_ns ? monotonic_ns() - t->started_ns : 0;
+    worker_stats_task_finished(t->task.priority, final_status, busy_ns / 1000ULL);
+
+    // A cancel may have been queued just before the task finished
+    pthread_mutex_lock(&loop->inbox_mutex);
+    if (t->cancel_queued) {
+        AsyncTask** link = &loop->cancel_head;
+        while (*link != NULL && *link != t) link = &(*link)->cancel_next;
+        if (*link != NULL) *link = t->cancel_next;
+    }
+    pthread_mutex_unlock(&loop->inbox_mutex);
+
+    free(t);
+    release_capacity();
+}
+
+// Advance a task's state machine by one step. The loop thread is shared, so
+// a task is charged only for the CPU and context switches of its own steps.
+static void async_task_step(EventLoop* loop, AsyncTask* t) {
+    UsageSample start_sample, end_sample;
+    usage_sample_thread(&start_sample, 0);
+    TaskStatus final_status = STATUS_COMPLETED;
+
+    switch (t->state) {
+        case ASYNC_TASK_STARTING:
+            TRACE(TRACE_TASK_BEGIN, t->task.id, loop->index);
+            LOG_INFO_F("Worker %d: Loop %d executing task %d: %s (priority: %s, duration: %u ms)",
+                       exec_worker_id, loop->index, t->task.id, t->task.name,
+                       priority_to_string(t->task.priority), t->task.execution_time_ms);
+            t->started_ns = monotonic_ns();
+            t->deadline_ns = t->started_ns + (uint64_t)t->task.execution_time_ms * 1000000ULL;
+            t->state = ASYNC_TASK_WAITING;
+            if (heap_push(loop, t) != 0) {
+                LOG_ERROR_F("Worker %d: Loop %d out of memory scheduling task %d",
+                            exec_worker_id, loop->index, t->task.id);
+                fail_task_logged(exec_queue, exec_worker_id, &t->task, "out of memory", NULL);
+                final_status = STATUS_FAILED;
+                t->state = ASYNC_TASK_DONE;
+            } else {
+                t->control = task_control_register(&t->task, async_task_cancel_request, t);
+            }
+            usage_sample_thread(&end_sample, 0);
+            usage_accumulate(&t->usage, &start_sample, &end_sample);
+            break;
+
+        case ASYNC_TASK_WAITING:
+            usage_sample_thread(&end_sample, 0);
+            usage_accumulate(&t->usage, &start_sample, &end_sample);
+            if (finish_task(exec_queue, t->task.id, STATUS_COMPLETED, &t->usage) == 0) {
+                LOG_INFO_F("Worker %d: Task %d completed successfully", exec_worker_id, t->task.id);
+            } else {
+                LOG_ERROR_F("Worker %d: Failed to update status for task %d", exec_worker_id, t->task.id);
+                update_task_status(exec_queue, t->task.id, STATUS_FAILED, NULL);
+                final_status = STATUS_FAILED;
+            }
+            t->state = ASYNC_TASK_DONE;
+            break;
+
+        case ASYNC_TASK_DONE:
+            break;
+    }
+
+    if (t->state == ASYNC_TASK_DONE) {
+        async_task_release(loop, t, final_status);
+    }
+}
+
+// Stop a waiting task early: it leaves the heap and fails right away, or
+// goes back to the queue when the worker is draining
+static void async_task_cancel(EventLoop* loop, AsyncTask* t, TaskCancelReason reason) {
+    if (t->state != ASYNC_TASK_WAITING) return;
+
+    UsageSample start_sample, end_sample;
+    usage_sample_thread(&start_sample, 0);
+    heap_remove(loop, t);
+    usage_sample_thread(&end_sample, 0);
+    usage_accumulate(&t->usage, &start_sample, &end_sample);
+
+    TaskStatus final_status = STATUS_FAILED;
+    if (reason == CANCEL_REASON_HANDBACK) {
+        final_status = STATUS_PENDING;
+        requeue_task(exec_queue, t->task.id);
+        LOG_WARN_F("Worker %d: Task %d handed back to the queue", exec_worker_id, t->task.id);
+    } else {
+        char error[MAX_TASK_ERROR_LEN];
+        task_cancel_error(&t->task, reason, error, sizeof(error));
+        fail_task_logged(exec_queue, exec_worker_id, &t->task, error, &t->usage);
+    }
+    t->state = ASYNC_TASK_DONE;
+    async_task_release(loop, t, final_status);
+}
+
+static void drain_inbox(EventLoop* loop) {
+    uint64_t counter;
+    if (read(loop->wake_fd, &counter, sizeof(counter)) < 0 && errno != EAGAIN) {
+        LOG_WARN_F("Worker %d: Loop %d eventfd read failed: %s",
+                   exec_worker_id, loop->index, strerror(errno));
+    }
+
+    pthread_mutex_lock(&loop->inbox_mutex);
+    AsyncTask* t = loop->inbox_head;
+    loop->inbox_head = NULL;
+    loop->inbox_tail = NULL;
+    AsyncTask* cancels = loop->cancel_head;
+    loop->cancel_head = NULL;
+    for (AsyncTask* c = cancels; c != NULL; c = c->cancel_next) {
+        c->cancel_queued = 0;
+    }
+    pthread_mutex_unlock(&loop->inbox_mutex);
+
+    while (t != NULL) {
+        AsyncTask* next = t->next;
+        t->next = NULL;
+        async_task_step(loop, t);
+        t = next;
+    }
+
+    while (cancels != NULL) {
+        AsyncTask* next = cancels->cancel_next;
+        async_task_cancel(loop, cancels, cancels->cancel_reason);
+        cancels = next;
+    }
+}
+
+static void fire_timers(EventLoop* loop) {
+    uint64_t expirations;
+    if (read(loop->timer_fd, &expirations, sizeof(expirations)) < 0 && errno != EAGAIN) {
+        LOG_WARN_F("Worker %d: Loop %d timerfd read failed: %s",
+                   exec_worker_id, loop->index, strerror(errno));
+    }
+    // The kernel disarmed the timer when it fired
+    loop->armed_deadline_ns = 0;
+
+    uint64_t now = monotonic_ns();
+    while (loop->heap_size > 0 && loop->heap[0]->deadline_ns <= now) {
+        async_task_step(loop, heap_pop(loop));
+    }
+}
+
+// A loop counts as busy while it has tasks waiting on its timer
+static void update_loop_stats(EventLoop* loop, int busy) {
+    if (busy == loop->busy) return;
+    loop->busy = busy;
+    worker_stats_threads(busy ? 1 : -1, busy ? -1 : 1);
+}
+
+static void* event_loop_thread(void* arg) {
+    EventLoop* loop = (EventLoop*)arg;
+    struct epoll_event events[LOOP_MAX_EVENTS];
+
+    worker_stats_threads(0, 1);
+    while (loops_running) {
+        int n = epoll_wait(loop->epoll_fd, events, LOOP_MAX_EVENTS, -1);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            LOG_ERROR_F("Worker %d: Loop %d epoll_wait failed: %s",
+                        exec_worker_id, loop->index, strerror(errno));
+            break;
+        }
+
+        for (int i = 0; i < n; i++) {
+            if (events[i].data.fd == loop->wake_fd) {
+                drain_inbox(loop);
+            } else if (events[i].data.fd == loop->timer_fd) {
+                fire_timers(loop);
+            }
+        }
+
+        arm_timer(loop);
+        update_loop_stats(loop, loop->heap_size > 0);
+    }
+    update_loop_stats(loop, 0);
+    worker_stats_threads(0, -1);
+
+    return NULL;
+}
+
+static int init_loop(EventLoop* loop, int index) {
+    memset(loop, 0, sizeof(*loop));
+    loop->index = index;
+    pthread_mutex_init(&loop->inbox_mutex, NULL);
+
+    loop->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    loop->timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    loop->wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (loop->epoll_fd < 0 || loop->timer_fd < 0 || loop->wake_fd < 0) {
+        return -1;
+    }
+
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.fd = loop->wake_fd;
+    if (epoll_ctl(loop->epoll_fd, EPOLL_CTL_ADD, loop->wake_fd, &ev) < 0) return -1;
+    ev.data.fd = loop->timer_fd;
+    if (epoll_ctl(loop->epoll_fd, EPOLL_CTL_ADD, loop->timer_fd, &ev) < 0) return -1;
+
+    return 0;
+}
+
+static void close_loop(EventLoop* loop) {
+    if (loop->epoll_fd >= 0) close(loop->epoll_fd);
+    if (loop->timer_fd >= 0) close(loop->timer_fd);
+    if (loop->wake_fd >= 0) close(loop->wake_fd);
+
+    // Tasks still in flight are abandoned, as with detached task threads
+    AsyncTask* t = loop->inbox_head;
+    while (t != NULL) {
+        AsyncTask* next = t->next;
+        free(t);
+        t = next;
+    }
+    for (int i = 0; i < loop->heap_size; i++) {
+        free(loop->heap[i]);
+    }
+    free(loop->heap);
+    pthread_mutex_destroy(&loop->inbox_mutex);
+}
+
+int async_executor_start(TaskQueue* queue, int worker_id, int num_loops,
+                         const ThreadPlacement* placement) {
+    if (queue == NULL || num_loops <= 0) return -1;
+
+    exec_queue = queue;
+    exec_worker_id = worker_id;
+    first_general_loop = (placement != NULL && placement->has_isolated) ? 1 : 0;
+    num_loops += first_general_loop;
+    loops = calloc(num_loops, sizeof(EventLoop));
+    if (loops == NULL) return -1;
+
+    loops_running = 1;
+    for (int i = 0; i < num_loops; i++) {
+        if (init_loop(&loops[i], i) != 0) {
+            LOG_ERROR_F("Worker %d: Failed to set up event loop %d: %s",
+                        worker_id, i, strerror(errno));
+            close_loop(&loops[i]);
+            num_event_loops = i;
+            async_executor_stop();
+            return -1;
+        }
+        if (pthread_create(&loops[i].thread, NULL, event_loop_thread, &loops[i]) != 0) {
+            LOG_ERROR_F("Worker %d: Failed to start event loop %d", worker_id, i);
+            close_loop(&loops[i]);
+            num_event_loops = i;
+            async_executor_stop();
+            return -1;
+        }
+        num_event_loops = i + 1;
+
+        loops[i].high_lane = i < first_general_loop;
+        Priority lane = loops[i].high_lane ? PRIORITY_HIGH : PRIORITY_MEDIUM;
+        if (placement_apply(placement, loops[i].thread, lane, i) != 0) {
+            LOG_WARN_F("Worker %d: Failed to set CPU affinity of event loop %d", worker_id, i);
+        }
+    }
+
+    LOG_INFO_F("Worker %d: Async executor started with %d event loops%s", worker_id, num_loops,
+               first_general_loop ? " (loop 0 on isolated cores for HIGH tasks)" : "");
+    return 0;
+}
+
+void async_executor_stop(void) {
+    loops_running = 0;
+
+    uint64_t one = 1;
+    for (int i = 0; i < num_event_loops; i++) {
+        if (write(loops[i].wake_fd, &one, sizeof(one)) < 0) {
+            LOG_WARN_F("Worker %d: Failed to wake loop %d", exec_worker_id, i);
+        }
+    }
+    for (int i = 0; i < num_event_loops; i++) {
+        pthread_join(loops[i].thread, NULL);
+        close_loop(&loops[i]);
+    }
+
+    pthread_mutex_lock(&capacity_mutex);
+    pthread_cond_broadcast(&capacity_cond);
+    pthread_mutex_unlock(&capacity_mutex);
+
+    free(loops);
+    loops = NULL;
+    num_event_loops = 0;
+    next_loop = 0;
+}
+
+int async_executor_submit(const Task* task) {
+    if (task == NULL || num_event_loops == 0) return -1;
+
+    AsyncTask* t = malloc(sizeof(AsyncTask));
+    if (t == NULL) return -1;
+    t->task = *task;
+    t->state = ASYNC_TASK_STARTING;
+    t->started_ns = 0;
+    t->deadline_ns = 0;
+    t->heap_index = -1;
+    memset(&t->usage, 0, sizeof(t->usage));
+    t->next = NULL;
+    t->control = NULL;
+    t->cancel_reason = CANCEL_REASON_NONE;
+    t->cancel_queued = 0;
+    t->cancel_next = NULL;
+
+    pthread_mutex_lock(&capacity_mutex);
+    inflight++;
+    pthread_mutex_unlock(&capacity_mutex);
+
+    // HIGH tasks go to the isolated-core loop when there is one; everything
+    // else round-robins across the general loops. Only the claim loop submits.
+    EventLoop* loop;
+    if (first_general_loop > 0 && task->priority == PRIORITY_HIGH) {
+        loop = &loops[0];
+    } else {
+        int general = num_event_loops - first_general_loop;
+        loop = &loops[first_general_loop + next_loop];
+        next_loop = (next_loop + 1) % general;
+    }
+
+    t->loop_index = loop->index;
+
+    pthread_mutex_lock(&loop->inbox_mutex);
+    if (loop->inbox_tail != NULL) {
+        loop->inbox_tail->next = t;
+    } else {
+        loop->inbox_head = t;
+    }
+    loop->inbox_tail = t;
+    pthread_mutex_unlock(&loop->inbox_mutex);
+
+    uint64_t one = 1;
+    if (write(loop->wake_fd, &one, sizeof(one)) < 0) {
+        LOG_WARN_F("Worker %d: Failed to wake loop %d for task %d",
+                   exec_worker_id, loop->index, task->id);
+    }
+    return 0;
+}
+
+void async_executor_wait_capacity(volatile int* shutdown_requested) {
+    pthread_mutex_lock(&capacity_mutex);
+    while (inflight >= ASYNC_MAX_INFLIGHT && loops_running && !*shutdown_requested) {
+        // Bounded wait so a shutdown signal is noticed promptly
+        struct timespec ts;
+        clock_gettime(CLOCK_REALTIME, &ts);
+        ts.tv_nsec += 100000000L;
+        if (ts.tv_nsec >= 1000000000L) {
+            ts.tv_sec++;
+            ts.tv_nsec -= 1000000000L;
+        }
+        pthread_cond_timedwait(&capacity_cond, &capacity_mutex, &ts);
+    }
+    pthread_mutex_unlock(&capacity_mutex);
+}
+
+int async_executor_inflight(void) {
+    pthread_mutex_lock(&capacity_mutex);
+    int count = inflight;
+    pthread_mutex_unlock(&capacity_mutex);
+    return count;
+}
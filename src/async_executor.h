@@ -0,0 +1,26 @@
+#ifndef ASYNC_EXECUTOR_H
+#define ASYNC_EXECUTOR_H
+
+#include "common.h"
+#include "task_queue.h"
+#include "affinity.h"
+
+// Async executor: a few event-loop threads per worker, each driving many
+// task state machines off one epoll instance and one timerfd. A running
+// task costs a heap entry instead of a whole OS thread.
+
+// With isolated cores in the placement, one extra loop is started on them
+// and serves HIGH-priority tasks only
+int async_executor_start(TaskQueue* queue, int worker_id, int num_loops,
+                         const ThreadPlacement* placement);
+void async_executor_stop(void);
+
+// Hand a claimed (already RUNNING) task to one of the event loops
+int async_executor_submit(const Task* task);
+
+// Block until the executor can accept another task or shutdown is requested
+void async_executor_wait_capacity(volatile int* shutdown_requested);
+
+int async_executor_inflight(void);
+
+#endif // ASYNC_EXECUTOR_H
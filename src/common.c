@@ -1,4 +1,5 @@
 #include "common.h"
+#include <strings.h>
 
 const char* priority_to_string(Priority p) {
     switch (p) {
@@ -15,16 +16,85 @@ const char* status_to_string(TaskStatus s) {
         case STATUS_RUNNING:  return "RUNNING";
         case STATUS_COMPLETED: return "COMPLETED";
         case STATUS_FAILED:   return "FAILED";
+        case STATUS_RETRY_WAIT: return "RETRY_WAIT";
+        case STATUS_HANDOFF:  return "HANDOFF";
+        case STATUS_FORWARDED: return "FORWARDED";
         default:              return "UNKNOWN";
     }
 }
 
+int parse_status(const char* str, TaskStatus* status) {
+    if (str == NULL || status == NULL) return -1;
+    for (int s = 0; s < TASK_STATUS_COUNT; s++) {
+        if (strcasecmp(str, status_to_string((TaskStatus)s)) == 0) {
+            *status = (TaskStatus)s;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+const char* exec_mode_to_string(ExecMode m) {
+    switch (m) {
+        case EXEC_MODE_THREAD: return "thread";
+        case EXEC_MODE_ASYNC:  return "async";
+        default:               return "unknown";
+    }
+}
+
+int parse_exec_mode(const char* str, ExecMode* mode) {
+    if (str == NULL || mode == NULL) return -1;
+    if (strcmp(str, "thread") == 0) {
+        *mode = EXEC_MODE_THREAD;
+    } else if (strcmp(str, "async") == 0) {
+        *mode = EXEC_MODE_ASYNC;
+    } else {
+        return -1;
+    }
+    return 0;
+}
+
+const char* sched_policy_to_string(SchedPolicy p) {
+    switch (p) {
+        case SCHED_POLICY_PRIORITY: return "priority";
+        case SCHED_POLICY_FIFO:     return "fifo";
+        default:                    return "unknown";
+    }
+}
+
+int parse_priority(const char* str, Priority* priority) {
+    if (str == NULL || priority == NULL) return -1;
+    if (strcasecmp(str, "HIGH") == 0) {
+        *priority = PRIORITY_HIGH;
+    } else if (strcasecmp(str, "MEDIUM") == 0) {
+        *priority = PRIORITY_MEDIUM;
+    } else if (strcasecmp(str, "LOW") == 0) {
+        *priority = PRIORITY_LOW;
+    } else {
+        return -1;
+    }
+    return 0;
+}
+
+int parse_sched_policy(const char* str, SchedPolicy* policy) {
+    if (str == NULL || policy == NULL) return -1;
+    if (strcmp(str, "priority") == 0) {
+        *policy = SCHED_POLICY_PRIORITY;
+    } else if (strcmp(str, "fifo") == 0) {
+        *policy = SCHED_POLICY_FIFO;
+    } else {
+        return -1;
+    }
+    return 0;
+}
+
 time_t get_current_time(void) {
     return time(NULL);
 }
 
 void format_timestamp(time_t t, char* buffer, size_t size) {
-    struct tm* tm_info = localtime(&t);
-    strftime(buffer, size, "%Y-%m-%d %H:%M:%S", tm_info);
+    struct tm tm_info;
+    localtime_r(&t, &tm_info);
+    strftime(buffer, size, "%Y-%m-%d %H:%M:%S", &tm_info);
 }
 
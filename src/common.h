@@ -27,21 +27,49 @@ typedef enum {
     PRIORITY_LOW = 2
 } Priority;
 
+#define PRIORITY_COUNT 3
+
 // Task Status
 typedef enum {
     STATUS_PENDING = 0,
     STATUS_RUNNING = 1,
     STATUS_COMPLETED = 2,
-    STATUS_FAILED = 3
+    STATUS_FAILED = 3,
+    STATUS_RETRY_WAIT = 4,      // Failed attempt waiting out its backoff
+    STATUS_HANDOFF = 5,         // Offered to a federation peer, awaiting its answer
+    STATUS_FORWARDED = 6        // Accepted by a federation peer, which runs it
 } TaskStatus;
 
+#define TASK_STATUS_COUNT 7
+
+// How a worker runs the tasks it claims
+typedef enum {
+    EXEC_MODE_THREAD = 0,   // One detached thread per task
+    EXEC_MODE_ASYNC = 1     // Tasks multiplexed on a few epoll event loops
+} ExecMode;
+
+// Which PENDING task a worker claims next
+typedef enum {
+    SCHED_POLICY_PRIORITY = 0,  // Highest priority first, FIFO within a priority
+    SCHED_POLICY_FIFO = 1       // Oldest first, priority ignored
+} SchedPolicy;
+
 // Utility macros
 #define MAX_TASK_NAME_LEN 256
+#define MAX_TASK_ERROR_LEN 96
+#define MAX_PEER_NAME_LEN 64
+#define MAX_QUEUE_NAME_LEN 32
 #define MAX_LOG_MESSAGE_LEN 512
 
 // Priority string conversion
 const char* priority_to_string(Priority p);
+int parse_priority(const char* str, Priority* priority);  // HIGH/MEDIUM/LOW, any case
 const char* status_to_string(TaskStatus s);
+int parse_status(const char* str, TaskStatus* status);    // PENDING, RUNNING, ..., any case
+const char* exec_mode_to_string(ExecMode m);
+int parse_exec_mode(const char* str, ExecMode* mode);
+const char* sched_policy_to_string(SchedPolicy p);
+int parse_sched_policy(const char* str, SchedPolicy* policy);
 
 // Time utilities
 time_t get_current_time(void);
@@ -0,0 +1,764 @@
+#include "federation.h"
+#include "logger.h"
+#include "worker_stats.h"
+#include <stdarg.h>
+#include <stdint.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/timerfd.h>
+
+#define FED_MAX_CONNS (2 * MAX_PEERS + 4)   // Both directions per peer, plus a few strays
+#define FED_LINE_MAX 512
+#define FED_OFFER_BATCH 64                  // Offers resent per reconnect
+
+typedef struct {
+    int fd;
+    int outbound;           // We dialed it: index into peer_addrs
+    int connecting;         // Nonblocking connect still in progress
+    int peer;               // PeerSlot index once its HELLO arrived, else -1
+    int dead;               // Close once the current event is handled
+    char in[4096];
+    size_t in_len;
+} Connection;
+
+// Peers we dial; inbound connections are identified by their HELLO
+typedef struct {
+    char host[256];
+    char port[16];
+    Connection* conn;
+    time_t next_attempt;
+} PeerAddr;
+
+static TaskQueue* fed_queue = NULL;
+static char node_name[MAX_PEER_NAME_LEN];
+static pthread_t fed_thread;
+static int fed_running = 0;
+
+static int epoll_fd = -1;
+static int listen_fd = -1;
+static int timer_fd = -1;
+static int wake_fd = -1;
+static int listen_tag, timer_tag, wake_tag;   // Their epoll data.ptr
+
+static Connection conns[FED_MAX_CONNS];
+static PeerAddr peer_addrs[MAX_PEERS];
+static int peer_addr_count = 0;
+static time_t steal_sent_at[MAX_PEERS];
+static int peer_gone_timeout = 0;  // 0 = wait for a silent peer forever
+static time_t fed_started_at = 0;
+
+// PeerSlots live in shared memory so the web server can show them; only
+// this thread writes them, under the queue mutex
+
+static int find_peer(const char* name) {
+    int index = -1;
+    lock_queue(fed_queue);
+    for (int i = 0; i < fed_queue->peer_count; i++) {
+        if (strcmp(fed_queue->peers[i].name, name) == 0) {
+            index = i;
+            break;
+        }
+    }
+    unlock_queue(fed_queue);
+    return index;
+}
+
+static int find_or_add_peer(const char* name) {
+    int index = -1;
+    char replaced[MAX_PEER_NAME_LEN] = "";
+    lock_queue(fed_queue);
+    for (int i = 0; i < fed_queue->peer_count; i++) {
+        if (strcmp(fed_queue->peers[i].name, name) == 0) {
+            index = i;
+            break;
+        }
+    }
+    if (index < 0 && fed_queue->peer_count < MAX_PEERS) {
+        index = fed_queue->peer_count++;
+        PeerSlot* slot = &fed_queue->peers[index];
+        memset(slot, 0, sizeof(*slot));
+        strncpy(slot->name, name, MAX_PEER_NAME_LEN - 1);
+        steal_sent_at[index] = 0;
+    } else if (index < 0) {
+        // Full: take over the slot of the peer disconnected longest. Offers
+        // are kept by peer name, so nothing else refers to the slot.
+        for (int i = 0; i < fed_queue->peer_count; i++) {
+            PeerSlot* slot = &fed_queue->peers[i];
+            if (slot->connected) continue;
+            if (index < 0 || slot->last_seen < fed_queue->peers[index].last_seen) index = i;
+        }
+    }
+    if (index >= 0 && strcmp(fed_queue->peers[index].name, name) != 0) {
+        PeerSlot* slot = &fed_queue->peers[index];
+        memcpy(replaced, slot->name, sizeof(replaced));
+        memset(slot, 0, sizeof(*slot));
+        strncpy(slot->name, name, MAX_PEER_NAME_LEN - 1);
+        steal_sent_at[index] = 0;
+    }
+    unlock_queue(fed_queue);
+    if (replaced[0] != '\0') {
+        LOG_INFO_F("Federation: peer %s takes the slot of %s, disconnected longest", name, replaced);
+    }
+    return index;
+}
+
+static void set_peer_connected(int peer, int connected) {
+    lock_queue(fed_queue);
+    fed_queue->peers[peer].connected = connected;
+    if (connected) fed_queue->peers[peer].last_seen = time(NULL);
+    unlock_queue(fed_queue);
+}
+
+static Connection* alloc_conn(int fd) {
+    for (int i = 0; i < FED_MAX_CONNS; i++) {
+        if (conns[i].fd < 0) {
+            Connection* c = &conns[i];
+            memset(c, 0, sizeof(*c));
+            c->fd = fd;
+            c->outbound = -1;
+            c->peer = -1;
+            return c;
+        }
+    }
+    return NULL;
+}
+
+static Connection* conn_to_peer(int peer) {
+    for (int i = 0; i < FED_MAX_CONNS; i++) {
+        Connection* c = &conns[i];
+        if (c->fd >= 0 && c->peer == peer && !c->connecting && !c->dead) return c;
+    }
+    return NULL;
+}
+
+static void close_conn(Connection* c) {
+    epoll_ctl(epoll_fd, EPOLL_CTL_DEL, c->fd, NULL);
+    close(c->fd);
+    c->fd = -1;
+
+    if (c->outbound >= 0) {
+        peer_addrs[c->outbound].conn = NULL;
+        peer_addrs[c->outbound].next_attempt = time(NULL) + FEDERATION_RECONNECT_INTERVAL;
+    }
+    if (c->peer >= 0 && conn_to_peer(c->peer) == NULL) {
+        set_peer_connected(c->peer, 0);
+        LOG_WARN_F("Federation: lost peer %s", fed_queue->peers[c->peer].name);
+    }
+}
+
+// Messages are small and infrequent, so a full socket buffer means the
+// peer is stuck; drop the connection rather than queue behind it
+static void send_line(Connection* c, const char* fmt, ...) {
+    if (c == NULL || c->dead) return;
+
+    char line[FED_LINE_MAX];
+    va_list args;
+    va_start(args, fmt);
+    int len = vsnprintf(line, sizeof(line) - 1, fmt, args);
+    va_end(args);
+    if (len < 0) return;
+    if (len > (int)sizeof(line) - 2) len = (int)sizeof(line) - 2;
+    line[len++] = '\n';
+
+    if (send(c->fd, line, len, MSG_NOSIGNAL | MSG_DONTWAIT) != len) {
+        c->dead = 1;
+    }
+}
+
+// The name ends the line, so one carrying a line break would smuggle a
+// second command to the peer. enqueue_task refuses those; this catches
+// any left in a segment from before it did. -1 if not sent.
+static int send_offer(Connection* c, const Task* task) {
+    if (strpbrk(task->name, "\r\n") != NULL) {
+        LOG_WARN_F("Federation: not offering task %d, its name has a line break", task->id);
+        return -1;
+    }
+    send_line(c, "OFFER %d %d %u %u %u %u %u %u %s", task->id, (int)task->priority,
+              task->execution_time_ms, task->timeout_ms, task->max_retries,
+              task->backoff_base_ms, task->backoff_cap_ms, task->backoff_jitter, task->name);
+    return 0;
+}
+
+// This node's load as its peers see it
+static void local_load(int* pending, int* running, int* capacity) {
+    lock_queue(fed_queue);
+    *pending = get_pending_task_count(fed_queue);
+    *running = get_running_task_count(fed_queue);
+    unlock_queue(fed_queue);
+
+    *capacity = 0;
+    for (int i = 0; i < MAX_WORKERS; i++) {
+        WorkerSlot slot;
+        worker_stats_read(&fed_queue->workers[i], &slot);
+        if (slot.pid != 0 && !slot.drain_requested) *capacity += slot.capacity;
+    }
+}
+
+static void handle_hello(Connection* c, const char* name, unsigned long long incarnation) {
+    if (strcmp(name, node_name) == 0) {
+        LOG_WARN_F("Federation: dropping a connection to ourselves");
+        c->dead = 1;
+        return;
+    }
+    int peer = find_or_add_peer(name);
+    if (peer < 0) {
+        LOG_WARN_F("Federation: no room for peer %s (MAX_PEERS %d)", name, MAX_PEERS);
+        c->dead = 1;
+        return;
+    }
+
+    int was_connected = conn_to_peer(peer) != NULL;
+    c->peer = peer;
+    set_peer_connected(peer, 1);
+    lock_queue(fed_queue);
+    fed_queue->peers[peer].incarnation = incarnation;
+    unlock_queue(fed_queue);
+    // A new incarnation numbers its tasks from 1 again, so what we said
+    // to its old ids must not answer its new ones
+    int forgotten = forget_handoffs(fed_queue, name, incarnation);
+    if (forgotten > 0) {
+        LOG_INFO_F("Federation: %s has a new queue, forgot %d of its old offers", name, forgotten);
+    }
+    if (was_connected) return;
+    LOG_INFO_F("Federation: connected to peer %s", name);
+
+    // Offers made before a disconnect may never have arrived, or their
+    // answer was lost. Resending is safe: the peer answers a task it has
+    // seen before (by our id) as it did the first time.
+    Task offers[FED_OFFER_BATCH];
+    int count = list_handoffs(fed_queue, name, FED_OFFER_BATCH, offers);
+    for (int i = 0; i < count; i++) {
+        send_offer(c, &offers[i]);
+    }
+}
+
+static void handle_steal(Connection* c, int wanted) {
+    const char* peer = fed_queue->peers[c->peer].name;
+    int pending, running, capacity;
+    local_load(&pending, &running, &capacity);
+
+    // Only give away what our own workers can't start right now
+    int spare = capacity > running ? capacity - running : 0;
+    int give = pending - spare;
+    if (give > wanted) give = wanted;
+    if (give > FEDERATION_STEAL_BATCH) give = FEDERATION_STEAL_BATCH;
+    if (give <= 0) return;
+
+    Task offers[FEDERATION_STEAL_BATCH];
+    int count = begin_handoff(fed_queue, peer, give, offers);
+    int sent = 0;
+    for (int i = 0; i < count; i++) {
+        if (send_offer(c, &offers[i]) == 0) {
+            sent++;
+        } else {
+            // Never sent, so the peer can't have it: safe to take back
+            abort_handoff(fed_queue, offers[i].id, peer);
+        }
+    }
+    if (sent > 0) {
+        LOG_INFO_F("Federation: offering %d tasks to %s", sent, peer);
+    }
+}
+
+static void handle_offer(Connection* c, const char* args) {
+    Task offered;
+    memset(&offered, 0, sizeof(offered));
+    int priority;
+    int name_at = 0;
+    if (sscanf(args, "%d %d %u %u %u %u %u %u %n", &offered.id, &priority,
+               &offered.execution_time_ms, &offered.timeout_ms, &offered.max_retries,
+               &offered.backoff_base_ms, &offered.backoff_cap_ms, &offered.backoff_jitter,
+               &name_at) < 8 || name_at == 0 || priority < PRIORITY_HIGH || priority > PRIORITY_LOW) {
+        LOG_WARN_F("Federation: malformed offer from %s", fed_queue->peers[c->peer].name);
+        return;
+    }
+    offered.priority = (Priority)priority;
+    strncpy(offered.name, args + name_at, MAX_TASK_NAME_LEN - 1);
+
+    const char* peer = fed_queue->peers[c->peer].name;
+    int fresh = 0;
+    int local_id = accept_handoff(fed_queue, peer, fed_queue->peers[c->peer].incarnation,
+                                  &offered, &fresh);
+    if (local_id < 0) {
+        send_line(c, "REJECT %d", offered.id);
+        return;
+    }
+    send_line(c, "ACCEPT %d %d", offered.id, local_id);
+    if (!fresh) return;
+
+    lock_queue(fed_queue);
+    fed_queue->peers[c->peer].tasks_received++;
+    unlock_queue(fed_queue);
+    LOG_INFO_F("Federation: took task %d from %s as task %d", offered.id, peer, local_id);
+}
+
+static void handle_accept(Connection* c, int task_id, int peer_task_id) {
+    const char* peer = fed_queue->peers[c->peer].name;
+    // A second ACCEPT (for a resent offer or a RECLAIM) finds it FORWARDED
+    if (complete_handoff(fed_queue, task_id, peer, peer_task_id) != 0) return;
+
+    lock_queue(fed_queue);
+    fed_queue->peers[c->peer].tasks_sent++;
+    unlock_queue(fed_queue);
+    LOG_INFO_F("Federation: task %d forwarded to %s as task %d", task_id, peer, peer_task_id);
+}
+
+// The peer never took the task and now never will, so it is ours to run
+static void handle_refusal(Connection* c, int task_id) {
+    const char* peer = fed_queue->peers[c->peer].name;
+    if (abort_handoff(fed_queue, task_id, peer) == 0) {
+        LOG_INFO_F("Federation: %s refused task %d, running it here", peer, task_id);
+    }
+}
+
+static void handle_reclaim(Connection* c, int peer_task_id) {
+    const char* peer = fed_queue->peers[c->peer].name;
+    int local_id = reclaim_handoff(fed_queue, peer, fed_queue->peers[c->peer].incarnation,
+                                   peer_task_id);
+    if (local_id > 0) {
+        send_line(c, "ACCEPT %d %d", peer_task_id, local_id);
+    } else {
+        send_line(c, "RECLAIMED %d", peer_task_id);
+    }
+}
+
+static void handle_line(Connection* c, char* line) {
+    char verb[16];
+    int consumed = 0;
+    if (sscanf(line, "%15s %n", verb, &consumed) != 1) return;
+    const char* args = line + consumed;
+
+    if (strcmp(verb, "HELLO") == 0) {
+        char name[MAX_PEER_NAME_LEN];
+        unsigned long long incarnation;
+        if (sscanf(args, "%63s %llu", name, &incarnation) == 2) {
+            handle_hello(c, name, incarnation);
+        } else {
+            LOG_WARN_F("Federation: malformed HELLO, dropping connection");
+            c->dead = 1;
+        }
+        return;
+    }
+    if (c->peer < 0) {
+        LOG_WARN_F("Federation: %s before HELLO, dropping connection", verb);
+        c->dead = 1;
+        return;
+    }
+
+    int a, b, d;
+    lock_queue(fed_queue);
+    fed_queue->peers[c->peer].last_seen = time(NULL);
+    unlock_queue(fed_queue);
+
+    if (strcmp(verb, "LOAD") == 0 && sscanf(args, "%d %d %d", &a, &b, &d) == 3) {
+        lock_queue(fed_queue);
+        PeerSlot* slot = &fed_queue->peers[c->peer];
+        slot->pending = a;
+        slot->running = b;
+        slot->capacity = d;
+        unlock_queue(fed_queue);
+        steal_sent_at[c->peer] = 0;  // Fresh numbers: free to ask again
+    } else if (strcmp(verb, "STEAL") == 0 && sscanf(args, "%d", &a) == 1) {
+        handle_steal(c, a);
+    } else if (strcmp(verb, "OFFER") == 0) {
+        handle_offer(c, args);
+    } else if (strcmp(verb, "ACCEPT") == 0 && sscanf(args, "%d %d", &a, &b) == 2) {
+        handle_accept(c, a, b);
+    } else if ((strcmp(verb, "REJECT") == 0 || strcmp(verb, "RECLAIMED") == 0) &&
+               sscanf(args, "%d", &a) == 1) {
+        handle_refusal(c, a);
+    } else if (strcmp(verb, "RECLAIM") == 0 && sscanf(args, "%d", &a) == 1) {
+        handle_reclaim(c, a);
+    } else {
+        LOG_WARN_F("Federation: unknown message '%s' from %s", verb,
+                   fed_queue->peers[c->peer].name);
+    }
+}
+
+static void read_conn(Connection* c) {
+    for (;;) {
+        ssize_t n = recv(c->fd, c->in + c->in_len, sizeof(c->in) - c->in_len, 0);
+        if (n == 0 || (n < 0 && errno != EAGAIN && errno != EINTR)) {
+            c->dead = 1;
+            return;
+        }
+        if (n < 0) return;
+        c->in_len += (size_t)n;
+
+        size_t start = 0;
+        for (size_t i = 0; i < c->in_len && !c->dead; i++) {
+            if (c->in[i] != '\n') continue;
+            c->in[i] = '\0';
+            if (i > start && c->in[i - 1] == '\r') c->in[i - 1] = '\0';
+            handle_line(c, c->in + start);
+            start = i + 1;
+        }
+        if (c->dead) return;
+        memmove(c->in, c->in + start, c->in_len - start);
+        c->in_len -= start;
+        if (c->in_len == sizeof(c->in)) {
+            LOG_WARN_F("Federation: line too long, dropping connection");
+            c->dead = 1;
+            return;
+        }
+    }
+}
+
+static void watch_conn(Connection* c, uint32_t events) {
+    struct epoll_event ev;
+    ev.events = events;
+    ev.data.ptr = c;
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, c->fd, &ev) != 0) {
+        epoll_ctl(epoll_fd, EPOLL_CTL_MOD, c->fd, &ev);
+    }
+}
+
+static void dial_peer(int index) {
+    PeerAddr* addr = &peer_addrs[index];
+    addr->next_attempt = time(NULL) + FEDERATION_RECONNECT_INTERVAL;
+
+    struct addrinfo hints, *res;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    if (getaddrinfo(addr->host, addr->port, &hints, &res) != 0) return;
+
+    int fd = socket(res->ai_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    Connection* c = fd >= 0 ? alloc_conn(fd) : NULL;
+    if (c == NULL) {
+        if (fd >= 0) close(fd);
+        freeaddrinfo(res);
+        return;
+    }
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+    int rc = connect(fd, res->ai_addr, res->ai_addrlen);
+    freeaddrinfo(res);
+    if (rc != 0 && errno != EINPROGRESS) {
+        close(fd);
+        c->fd = -1;
+        return;
+    }
+    c->outbound = index;
+    c->connecting = 1;
+    addr->conn = c;
+    watch_conn(c, EPOLLOUT);
+}
+
+static void finish_connect(Connection* c) {
+    int err = 0;
+    socklen_t len = sizeof(err);
+    getsockopt(c->fd, SOL_SOCKET, SO_ERROR, &err, &len);
+    if (err != 0) {
+        c->dead = 1;
+        return;
+    }
+    c->connecting = 0;
+    watch_conn(c, EPOLLIN);
+    send_line(c, "HELLO %s %llu", node_name, fed_queue->incarnation);
+}
+
+static void accept_peers(void) {
+    for (;;) {
+        int fd = accept4(listen_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) return;
+
+        Connection* c = alloc_conn(fd);
+        if (c == NULL) {
+            LOG_WARN_F("Federation: too many connections, refusing one");
+            close(fd);
+            continue;
+        }
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        watch_conn(c, EPOLLIN);
+        send_line(c, "HELLO %s %llu", node_name, fed_queue->incarnation);
+    }
+}
+
+// Ask the busiest live peer for work when we have idle capacity and an
+// empty queue. One request per peer is outstanding until it gossips again.
+static void maybe_steal(int pending, int running, int capacity) {
+    int spare = capacity - running;
+    if (pending > 0 || spare <= 0) return;
+
+    time_t now = time(NULL);
+    int victim = -1;
+    int victim_pending = 0;
+    lock_queue(fed_queue);
+    for (int i = 0; i < fed_queue->peer_count; i++) {
+        PeerSlot* slot = &fed_queue->peers[i];
+        if (!slot->connected || now - slot->last_seen > FEDERATION_PEER_TIMEOUT) continue;
+        if (steal_sent_at[i] != 0 && now - steal_sent_at[i] <= FEDERATION_PEER_TIMEOUT) continue;
+        if (slot->pending >= FEDERATION_STEAL_MIN_PENDING && slot->pending > victim_pending) {
+            victim = i;
+            victim_pending = slot->pending;
+        }
+    }
+    unlock_queue(fed_queue);
+    if (victim < 0) return;
+
+    Connection* c = conn_to_peer(victim);
+    if (c == NULL) return;
+
+    int wanted = (victim_pending + 1) / 2;
+    if (wanted > spare) wanted = spare;
+    if (wanted > FEDERATION_STEAL_BATCH) wanted = FEDERATION_STEAL_BATCH;
+    send_line(c, "STEAL %d", wanted);
+    steal_sent_at[victim] = now;
+    LOG_INFO_F("Federation: asking %s for %d tasks (%d pending there)",
+               fed_queue->peers[victim].name, wanted, victim_pending);
+}
+
+// A peer away for peer_gone_timeout is taken to be gone for good, along
+// with anything it took, so its unanswered offers run here. Should it
+// come back after all having taken one, that task runs twice.
+static void abandon_if_gone(const Task* task, int peer, time_t now) {
+    if (peer_gone_timeout <= 0) return;
+
+    time_t seen = fed_started_at;
+    if (peer >= 0) {
+        lock_queue(fed_queue);
+        if (fed_queue->peers[peer].last_seen > seen) seen = fed_queue->peers[peer].last_seen;
+        unlock_queue(fed_queue);
+    }
+    if (now - seen < peer_gone_timeout) return;
+    if (abort_handoff(fed_queue, task->id, task->peer) == 0) {
+        LOG_WARN_F("Federation: %s gone for %ld s, running task %d here", task->peer,
+                   (long)(now - seen), task->id);
+    }
+}
+
+static void gossip_tick(void) {
+    uint64_t expirations;
+    if (read(timer_fd, &expirations, sizeof(expirations)) < 0 && errno != EAGAIN) return;
+
+    time_t now = time(NULL);
+    for (int i = 0; i < peer_addr_count; i++) {
+        if (peer_addrs[i].conn == NULL && now >= peer_addrs[i].next_attempt) {
+            dial_peer(i);
+        }
+    }
+
+    int pending, running, capacity;
+    local_load(&pending, &running, &capacity);
+    for (int i = 0; i < FED_MAX_CONNS; i++) {
+        if (conns[i].fd >= 0 && conns[i].peer >= 0 && !conns[i].connecting) {
+            send_line(&conns[i], "LOAD %d %d %d", pending, running, capacity);
+        }
+    }
+
+    maybe_steal(pending, running, capacity);
+
+    // An unanswered offer may never have arrived, or the peer took it and
+    // the answer was lost; only the peer knows which. Ask it, and keep the
+    // task HANDOFF until it answers (again after each timeout).
+    Task overdue[FED_OFFER_BATCH];
+    int count = overdue_handoffs(fed_queue, now - FEDERATION_HANDOFF_TIMEOUT,
+                                 FED_OFFER_BATCH, overdue);
+    for (int i = 0; i < count; i++) {
+        int peer = find_peer(overdue[i].peer);
+        Connection* c = peer >= 0 ? conn_to_peer(peer) : NULL;
+        if (c == NULL) {
+            abandon_if_gone(&overdue[i], peer, now);
+            continue;  // Else resent as an OFFER when it reconnects
+        }
+        LOG_WARN_F("Federation: %s has not answered the offer of task %d for %d s, asking",
+                   overdue[i].peer, overdue[i].id, FEDERATION_HANDOFF_TIMEOUT);
+        send_line(c, "RECLAIM %d", overdue[i].id);
+    }
+}
+
+static void* federation_thread(void* arg) {
+    (void)arg;
+
+    while (fed_running) {
+        struct epoll_event events[FED_MAX_CONNS + 3];
+        int n = epoll_wait(epoll_fd, events, FED_MAX_CONNS + 3, -1);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            LOG_ERROR_F("Federation: epoll_wait failed: %s", strerror(errno));
+            break;
+        }
+
+        for (int i = 0; i < n; i++) {
+            void* tag = events[i].data.ptr;
+            if (tag == &wake_tag) {
+                fed_running = 0;
+            } else if (tag == &listen_tag) {
+                accept_peers();
+            } else if (tag == &timer_tag) {
+                gossip_tick();
+            } else {
+                Connection* c = (Connection*)tag;
+                if (c->fd < 0) continue;
+                if (c->connecting) {
+                    finish_connect(c);
+                } else if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) {
+                    read_conn(c);
+                }
+            }
+        }
+
+        // Close outside the event walk so no handler sees a reused slot
+        for (int i = 0; i < FED_MAX_CONNS; i++) {
+            if (conns[i].fd >= 0 && conns[i].dead) close_conn(&conns[i]);
+        }
+    }
+
+    return NULL;
+}
+
+static int add_fd(int fd, void* tag) {
+    struct epoll_event ev;
+    ev.events = EPOLLIN;
+    ev.data.ptr = tag;
+    return epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev);
+}
+
+// Peers are not authenticated: whoever reaches the port can take tasks,
+// so bind where only trusted hosts can. "::" also takes IPv4.
+static int open_listener(const char* address, int port) {
+    char port_str[8];
+    snprintf(port_str, sizeof(port_str), "%d", port);
+    struct addrinfo hints, *res;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = AI_PASSIVE;
+    if (getaddrinfo(address, port_str, &hints, &res) != 0) {
+        errno = EADDRNOTAVAIL;
+        return -1;
+    }
+
+    int fd = socket(res->ai_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    int one = 1;
+    int zero = 0;
+    if (fd < 0) {
+        freeaddrinfo(res);
+        return -1;
+    }
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    if (res->ai_family == AF_INET6) {
+        setsockopt(fd, IPPROTO_IPV6, IPV6_V6ONLY, &zero, sizeof(zero));
+    }
+
+    int rc = bind(fd, res->ai_addr, res->ai_addrlen);
+    freeaddrinfo(res);
+    if (rc != 0 || listen(fd, 16) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+int federation_start(TaskQueue* queue, const char* name, const char* address, int port,
+                     const char* const* peers, int peer_count, int gone_timeout) {
+    if (queue == NULL || name == NULL || address == NULL || peer_count > MAX_PEERS) return -1;
+
+    fed_queue = queue;
+    peer_gone_timeout = gone_timeout;
+    fed_started_at = time(NULL);
+    strncpy(node_name, name, sizeof(node_name) - 1);
+    for (int i = 0; i < FED_MAX_CONNS; i++) {
+        conns[i].fd = -1;
+    }
+
+    peer_addr_count = 0;
+    for (int i = 0; i < peer_count; i++) {
+        const char* colon = strrchr(peers[i], ':');
+        PeerAddr* addr = &peer_addrs[peer_addr_count];
+        size_t host_len = colon != NULL ? (size_t)(colon - peers[i]) : 0;
+        if (host_len == 0 || host_len >= sizeof(addr->host) || colon[1] == '\0') {
+            LOG_ERROR_F("Federation: peer must be host:port, not '%s'", peers[i]);
+            return -1;
+        }
+        memcpy(addr->host, peers[i], host_len);
+        addr->host[host_len] = '\0';
+        snprintf(addr->port, sizeof(addr->port), "%s", colon + 1);
+        addr->conn = NULL;
+        addr->next_attempt = 0;
+        peer_addr_count++;
+    }
+
+    epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (epoll_fd < 0 || timer_fd < 0 || wake_fd < 0) return -1;
+
+    if (port > 0) {
+        listen_fd = open_listener(address, port);
+        if (listen_fd < 0) {
+            LOG_ERROR_F("Federation: cannot listen on %s port %d: %s", address, port,
+                        strerror(errno));
+            return -1;
+        }
+        if (add_fd(listen_fd, &listen_tag) != 0) return -1;
+    }
+
+    struct itimerspec spec;
+    memset(&spec, 0, sizeof(spec));
+    spec.it_value.tv_nsec = 1000000L;  // First tick (and dial) right away
+    spec.it_interval.tv_sec = FEDERATION_GOSSIP_INTERVAL_MS / 1000;
+    spec.it_interval.tv_nsec = (long)(FEDERATION_GOSSIP_INTERVAL_MS % 1000) * 1000000L;
+    if (timerfd_settime(timer_fd, 0, &spec, NULL) != 0) return -1;
+    if (add_fd(timer_fd, &timer_tag) != 0 || add_fd(wake_fd, &wake_tag) != 0) return -1;
+
+    lock_queue(queue);
+    strncpy(queue->node_name, node_name, MAX_PEER_NAME_LEN - 1);
+    queue->federation_port = port;
+    queue->peer_count = 0;
+    unlock_queue(queue);
+
+    fed_running = 1;
+    if (pthread_create(&fed_thread, NULL, federation_thread, NULL) != 0) {
+        fed_running = 0;
+        return -1;
+    }
+
+    if (port > 0) {
+        LOG_INFO_F("Federation: node %s listening on %s port %d, %d configured peers",
+                   node_name, address, port, peer_addr_count);
+    } else {
+        LOG_INFO_F("Federation: node %s (dial-out only), %d configured peers",
+                   node_name, peer_addr_count);
+    }
+    return 0;
+}
+
+void federation_stop(void) {
+    if (!fed_running) return;
+
+    uint64_t one = 1;
+    if (write(wake_fd, &one, sizeof(one)) < 0) {
+        LOG_WARN_F("Federation: failed to wake thread: %s", strerror(errno));
+    }
+    pthread_join(fed_thread, NULL);
+
+    for (int i = 0; i < FED_MAX_CONNS; i++) {
+        if (conns[i].fd >= 0) {
+            close(conns[i].fd);
+            conns[i].fd = -1;
+        }
+    }
+    if (listen_fd >= 0) close(listen_fd);
+    close(timer_fd);
+    close(wake_fd);
+    close(epoll_fd);
+    listen_fd = timer_fd = wake_fd = epoll_fd = -1;
+
+    // Offers still out stay HANDOFF: the peer may have taken them, so
+    // running them here could run them twice. A restart resends them.
+
+    lock_queue(fed_queue);
+    for (int i = 0; i < fed_queue->peer_count; i++) {
+        fed_queue->peers[i].connected = 0;
+    }
+    fed_queue->node_name[0] = '\0';
+    unlock_queue(fed_queue);
+}
@@ -0,0 +1,37 @@
+#ifndef FEDERATION_H
+#define FEDERATION_H
+
+#include "common.h"
+#include "task_queue.h"
+
+// Federation: schedulers on several hosts, each with its own queue, share
+// load over TCP. Every node gossips its queue depth to its peers once per
+// FEDERATION_GOSSIP_INTERVAL_MS. A node with idle capacity and nothing
+// pending asks the busiest peer for work; that peer offers its least
+// urgent pending tasks, and each offer is a handoff (see task_queue.h):
+// the task is only marked FORWARDED once the thief has enqueued it, and
+// only runs here again once the thief has refused it. An offer left
+// unanswered for FEDERATION_HANDOFF_TIMEOUT is followed by a RECLAIM,
+// which the thief answers with ACCEPT if it took the task, else with
+// RECLAIMED, after which it refuses that task for good.
+//
+// Wire protocol, one text line per message:
+//   HELLO <node> <incarnation>   first line on every connection; the
+//                                incarnation changes when task ids restart
+//   LOAD <pending> <running> <capacity>
+//   STEAL <count>
+//   OFFER <id> <priority> <ms> <timeout_ms> <max_retries> <base_ms> <cap_ms> <jitter> <name>
+//   ACCEPT <id> <local id>       REJECT <id>
+//   RECLAIM <id>                 RECLAIMED <id>
+
+// Start the federation thread, listening on address:port (port 0 only
+// dials out; peers are not authenticated). peers are "host:port" strings. node_name must be unique in the federation and
+// stay the same across restarts. Offers to a peer away for gone_timeout
+// seconds are run here instead (0 = wait for it forever).
+int federation_start(TaskQueue* queue, const char* node_name, const char* address, int port,
+                     const char* const* peers, int peer_count, int gone_timeout);
+
+// Stop the thread. Offers still waiting for an answer stay HANDOFF.
+void federation_stop(void);
+
+#endif // FEDERATION_H
@@ -0,0 +1,593 @@
+#include "common.h"
+#include "task_queue.h"
+#include "submit_client.h"
+#include <getopt.h>
+#include <math.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <strings.h>
+#include <sys/socket.h>
+
+// loadgen: open-loop load against a running scheduler. Arrival times are
+// drawn in advance (Poisson or evenly spaced at the target rate) and each
+// task is submitted when it is due, through the shared segment, the
+// submission socket or the web API. Starts and finishes are read from the
+// tasks' CLOCK_MONOTONIC stamps in the queue.
+//
+// Latencies are measured from when a task was due, not from when it was
+// sent. If submission stalls, the tasks that should have gone out during
+// the stall still count their full wait, instead of the stall hiding them
+// (coordinated omission). The same latencies measured from the actual send
+// are printed alongside for comparison.
+
+#define POLL_INTERVAL_NS 1000000ULL     // How often the queue is checked
+#define HDR_SUB_BITS 11                 // Values kept to 1 part in 1024
+#define HDR_SUB_COUNT (1 << HDR_SUB_BITS)
+#define HDR_HALF (HDR_SUB_COUNT / 2)
+#define HDR_MAX_SHIFT 26                // Longest value about 2^37 us (38 hours)
+#define HDR_SLOTS (HDR_SUB_COUNT + HDR_MAX_SHIFT * HDR_HALF)
+
+typedef enum {
+    VIA_SHM,
+    VIA_SOCKET,
+    VIA_HTTP
+} SubmitPath;
+
+enum { LATENCY_START, LATENCY_FINISH, LATENCY_KINDS };
+
+// HDR-style histogram of microseconds: exact below HDR_SUB_COUNT, then
+// HDR_HALF linear sub-buckets for every further power of two
+typedef struct {
+    unsigned long long counts[HDR_SLOTS];
+    unsigned long long total;
+    unsigned long long max;
+} Histogram;
+
+typedef struct {
+    int id;                     // 0 until submitted, -1 if rejected
+    Priority priority;
+    int started;
+    int finished;
+    unsigned long long due_ns;  // When the schedule said it arrives
+    unsigned long long sent_ns; // When we got round to submitting it
+} Arrival;
+
+static SubmitPath via = VIA_SHM;
+static double rate = 50.0;
+static int poisson = 1;
+static double duration_s = 10.0;
+static double drain_s = 30.0;
+static unsigned int mix[PRIORITY_COUNT] = { 1, 1, 1 };
+static unsigned int task_ms_min = 10, task_ms_max = 10;
+static char http_host[256] = "localhost";
+static char http_port[16] = "8080";
+static char http_prefix[64] = "";
+static unsigned long long rng_state;
+
+static Arrival* arrivals;
+static size_t arrival_count, arrival_capacity;
+static int* by_id;              // Indexes into arrivals of submitted tasks, by id
+static size_t known, checked;   // by_id entries, and how many were looked at once
+static unsigned long long seen_seq;
+static unsigned long long last_end_ns;
+static unsigned long completed, failed, lost, rejected;
+
+// [PRIORITY_COUNT] is every priority together
+static Histogram* corrected[PRIORITY_COUNT + 1][LATENCY_KINDS];
+static Histogram* uncorrected[LATENCY_KINDS];
+
+static SubmitClient submit_client;
+static int submit_result;
+static int http_fd = -1;
+static volatile sig_atomic_t stop_requested = 0;
+
+static void print_usage(const char* prog) {
+    fprintf(stderr, "Usage: %s [options]\n", prog);
+    fprintf(stderr, "  -q QUEUE       Named queue (default $%s, else %s)\n", QUEUE_NAME_ENV, DEFAULT_QUEUE_NAME);
+    fprintf(stderr, "  -p PATH        shm, socket or http (default shm)\n");
+    fprintf(stderr, "  -H HOST:PORT   Web server for -p http (default localhost:8080)\n");
+    fprintf(stderr, "  -r RATE        Arrivals per second (default 50)\n");
+    fprintf(stderr, "  -a ARRIVALS    poisson or constant (default poisson)\n");
+    fprintf(stderr, "  -d SECONDS     How long arrivals go on (default 10)\n");
+    fprintf(stderr, "  -w SECONDS     How long to wait for the last tasks to finish (default 30)\n");
+    fprintf(stderr, "  -m H:M:L       Priority mix as weights (default 1:1:1)\n");
+    fprintf(stderr, "  -t MS[-MS]     Task duration, fixed or uniform in a range (default 10)\n");
+    fprintf(stderr, "  -s SEED        Random seed (default from the clock)\n");
+    fprintf(stderr, "The queue must be on this host: starts and finishes are read from shared memory.\n");
+}
+
+static unsigned long long now_ns(void) {
+    return queue_clock_ns();
+}
+
+static void sleep_until(unsigned long long deadline_ns) {
+    struct timespec ts = { (time_t)(deadline_ns / 1000000000ULL), (long)(deadline_ns % 1000000000ULL) };
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR && !stop_requested) {
+    }
+}
+
+static void on_signal(int sig) {
+    (void)sig;
+    stop_requested = 1;
+}
+
+// xorshift64*: cheap, and reproducible with -s
+static unsigned long long next_random(void) {
+    rng_state ^= rng_state >> 12;
+    rng_state ^= rng_state << 25;
+    rng_state ^= rng_state >> 27;
+    return rng_state * 2685821657736338717ULL;
+}
+
+static double random_unit(void) {
+    return (double)(next_random() >> 11) / 9007199254740992.0;  // [0, 1)
+}
+
+static unsigned long long next_gap_ns(void) {
+    double mean = 1e9 / rate;
+    return (unsigned long long)(poisson ? -log(1.0 - random_unit()) * mean : mean);
+}
+
+static Priority random_priority(void) {
+    unsigned int total = mix[0] + mix[1] + mix[2];
+    unsigned int pick = (unsigned int)(next_random() % total);
+    for (int p = 0; p < PRIORITY_COUNT; p++) {
+        if (pick < mix[p]) return (Priority)p;
+        pick -= mix[p];
+    }
+    return PRIORITY_LOW;
+}
+
+// ---- histograms ----
+
+static int hdr_index(unsigned long long value) {
+    if (value < HDR_SUB_COUNT) return (int)value;
+    int shift = 63 - __builtin_clzll(value) - (HDR_SUB_BITS - 1);
+    if (shift > HDR_MAX_SHIFT) return HDR_SLOTS - 1;
+    return HDR_SUB_COUNT + (shift - 1) * HDR_HALF + (int)((value >> shift) - HDR_HALF);
+}
+
+// Largest value that lands in slot
+static unsigned long long hdr_value(int slot) {
+    if (slot < HDR_SUB_COUNT) return (unsigned long long)slot;
+    int shift = (slot - HDR_SUB_COUNT) / HDR_HALF + 1;
+    unsigned long long sub = (unsigned long long)((slot - HDR_SUB_COUNT) % HDR_HALF + HDR_HALF);
+    return ((sub + 1) << shift) - 1;
+}
+
+static void hdr_record(Histogram* h, unsigned long long us) {
+    h->counts[hdr_index(us)]++;
+    h->total++;
+    if (us > h->max) h->max = us;
+}
+
+static unsigned long long hdr_percentile(const Histogram* h, double percentile) {
+    if (h->total == 0) return 0;
+    unsigned long long rank = (unsigned long long)ceil(percentile / 100.0 * (double)h->total);
+    if (rank == 0) rank = 1;
+    unsigned long long seen = 0;
+    for (int slot = 0; slot < HDR_SLOTS; slot++) {
+        seen += h->counts[slot];
+        if (seen >= rank) {
+            unsigned long long value = hdr_value(slot);
+            return value < h->max ? value : h->max;
+        }
+    }
+    return h->max;
+}
+
+static void record_latency(int kind, const Arrival* a, unsigned long long at_ns) {
+    unsigned long long from_due = at_ns > a->due_ns ? (at_ns - a->due_ns) / 1000ULL : 0;
+    unsigned long long from_sent = at_ns > a->sent_ns ? (at_ns - a->sent_ns) / 1000ULL : 0;
+    hdr_record(corrected[a->priority][kind], from_due);
+    hdr_record(corrected[PRIORITY_COUNT][kind], from_due);
+    hdr_record(uncorrected[kind], from_sent);
+}
+
+// ---- submission ----
+
+static void on_submit_ack(void* arg, uint32_t seq, const int32_t* results, int count) {
+    (void)arg;
+    (void)seq;
+    if (count > 0) submit_result = results[0];
+}
+
+static int http_connect(void) {
+    struct addrinfo hints, *res;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    if (getaddrinfo(http_host, http_port, &hints, &res) != 0) return -1;
+    int fd = -1;
+    for (struct addrinfo* ai = res; ai != NULL && fd < 0; ai = ai->ai_next) {
+        fd = socket(ai->ai_family, ai->ai_socktype | SOCK_CLOEXEC, ai->ai_protocol);
+        if (fd < 0) continue;
+        if (connect(fd, ai->ai_addr, ai->ai_addrlen) != 0) {
+            close(fd);
+            fd = -1;
+        }
+    }
+    freeaddrinfo(res);
+    if (fd >= 0) {
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    }
+    return fd;
+}
+
+// One POST /api/add_task on the kept-alive connection. Returns the task
+// id, 0 if the server refused it, -1 if the connection failed.
+static int http_exchange(const char* request, size_t len) {
+    if (send(http_fd, request, len, MSG_NOSIGNAL) != (ssize_t)len) return -1;
+
+    char buf[4096];
+    size_t have = 0;
+    char* body = NULL;
+    long content_length = -1;
+    int keep_alive = 1;
+    while (body == NULL || (long)(buf + have - body) < content_length) {
+        if (have == sizeof(buf) - 1) return -1;
+        ssize_t n = recv(http_fd, buf + have, sizeof(buf) - 1 - have, 0);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return -1;
+        have += (size_t)n;
+        buf[have] = '\0';
+        if (body != NULL) continue;
+        body = strstr(buf, "\r\n\r\n");
+        if (body == NULL) continue;
+        body += 4;
+        for (char* line = strstr(buf, "\r\n"); line != NULL && line + 2 < body;
+             line = strstr(line + 2, "\r\n")) {
+            if (strncasecmp(line + 2, "Content-Length:", 15) == 0) {
+                content_length = atol(line + 17);
+            } else if (strncasecmp(line + 2, "Connection: close", 17) == 0) {
+                keep_alive = 0;
+            }
+        }
+        if (content_length < 0) return -1;
+    }
+    if (!keep_alive) {
+        close(http_fd);
+        http_fd = -1;
+    }
+    const char* id = strstr(body, "\"task_id\":");
+    return id != NULL ? atoi(id + 10) : 0;
+}
+
+static int http_submit(const char* name, Priority priority, unsigned int ms) {
+    char body[512];
+    int body_len = snprintf(body, sizeof(body), "{\"name\":\"%s\",\"priority\":\"%s\",\"duration\":%u}",
+                            name, priority_to_string(priority), ms);
+    char request[1024];
+    int len = snprintf(request, sizeof(request),
+                       "POST %s/api/add_task HTTP/1.1\r\n"
+                       "Host: %s:%s\r\n"
+                       "Content-Type: application/json\r\n"
+                       "Content-Length: %d\r\n"
+                       "\r\n"
+                       "%s",
+                       http_prefix, http_host, http_port, body_len, body);
+    // A kept-alive connection may have been closed under us: one retry
+    for (int attempt = 0; attempt < 2; attempt++) {
+        if (http_fd < 0) http_fd = http_connect();
+        if (http_fd < 0) return -1;
+        int id = http_exchange(request, (size_t)len);
+        if (id >= 0) return id > 0 ? id : -1;
+        close(http_fd);
+        http_fd = -1;
+    }
+    return -1;
+}
+
+// Returns the task id, or -1 if it was not added
+static int submit_task(TaskQueue* queue, const char* name, Priority priority, unsigned int ms) {
+    switch (via) {
+        case VIA_SOCKET:
+            submit_result = -1;
+            if (submit_client_add(&submit_client, name, priority, ms, NULL) != 0 ||
+                submit_client_wait(&submit_client) != 0) {
+                return -1;
+            }
+            return submit_result > 0 ? submit_result : -1;
+        case VIA_HTTP:
+            return http_submit(name, priority, ms);
+        default: {
+            int id = enqueue_task_ex(queue, name, priority, ms, NULL);
+            return id > 0 ? id : -1;
+        }
+    }
+}
+
+static int add_arrival(TaskQueue* queue, unsigned long long due_ns) {
+    if (arrival_count == arrival_capacity) {
+        size_t capacity = arrival_capacity ? arrival_capacity * 2 : 4096;
+        Arrival* grown = realloc(arrivals, capacity * sizeof(Arrival));
+        int* grown_ids = realloc(by_id, capacity * sizeof(int));
+        if (grown != NULL) arrivals = grown;
+        if (grown_ids != NULL) by_id = grown_ids;
+        if (grown == NULL || grown_ids == NULL) return -1;
+        arrival_capacity = capacity;
+    }
+    Arrival* a = &arrivals[arrival_count];
+    memset(a, 0, sizeof(*a));
+    a->due_ns = due_ns;
+    a->priority = random_priority();
+    unsigned int ms = task_ms_min + (unsigned int)(next_random() % (task_ms_max - task_ms_min + 1));
+
+    char name[MAX_TASK_NAME_LEN];
+    snprintf(name, sizeof(name), "loadgen-%zu", arrival_count);
+    a->sent_ns = now_ns();
+    a->id = submit_task(queue, name, a->priority, ms);
+    return 0;
+}
+
+// ---- observation ----
+
+static int find_arrival(int id) {
+    size_t left = 0, right = known;
+    while (left < right) {
+        size_t mid = left + (right - left) / 2;
+        int mid_id = arrivals[by_id[mid]].id;
+        if (mid_id == id) return by_id[mid];
+        if (mid_id < id) left = mid + 1;
+        else right = mid;
+    }
+    return -1;
+}
+
+// Take whatever happened to the task since we last looked (mutex held)
+static void check_arrival(TaskQueue* queue, Arrival* a) {
+    if (a->finished) return;
+    Task* task = find_task_by_id(queue, a->id);
+    if (task == NULL) {
+        a->finished = 1;            // Cleaned up before we saw it end
+        lost++;
+        return;
+    }
+    if (!a->started && task->started_ns != 0) {
+        a->started = 1;
+        record_latency(LATENCY_START, a, task->started_ns);
+    }
+    if (task->ended_ns != 0 && (task->status == STATUS_COMPLETED || task->status == STATUS_FAILED ||
+                                task->status == STATUS_FORWARDED)) {
+        a->finished = 1;
+        record_latency(LATENCY_FINISH, a, task->ended_ns);
+        if (task->status == STATUS_COMPLETED) completed++;
+        else failed++;
+        if (task->ended_ns > last_end_ns) last_end_ns = task->ended_ns;
+    }
+}
+
+// Follow the queue's change log since the last poll, and look once at
+// every task submitted since; fall back to checking every unfinished
+// task when the log has wrapped
+static void poll_queue(TaskQueue* queue) {
+    lock_queue(queue);
+    unsigned long long seq = queue->change_seq;
+    if (seq - seen_seq > CHANGE_LOG_SIZE) {
+        for (size_t i = 0; i < checked; i++) {
+            check_arrival(queue, &arrivals[by_id[i]]);
+        }
+    } else {
+        for (unsigned long long s = seen_seq; s < seq; s++) {
+            int index = find_arrival(queue->change_log[s % CHANGE_LOG_SIZE].task_id);
+            if (index >= 0 && (size_t)index < arrival_count) {
+                check_arrival(queue, &arrivals[index]);
+            }
+        }
+    }
+    for (; checked < known; checked++) {
+        check_arrival(queue, &arrivals[by_id[checked]]);
+    }
+    seen_seq = seq;
+    unlock_queue(queue);
+}
+
+// ---- report ----
+
+static void print_latency_row(const char* label, const Histogram* h) {
+    if (h->total == 0) {
+        printf("  %-28s %8d %10s %10s %10s %10s\n", label, 0, "-", "-", "-", "-");
+        return;
+    }
+    printf("  %-28s %8llu %10.3f %10.3f %10.3f %10.3f\n", label, h->total,
+           hdr_percentile(h, 50.0) / 1e3, hdr_percentile(h, 99.0) / 1e3,
+           hdr_percentile(h, 99.9) / 1e3, h->max / 1e3);
+}
+
+static void print_report(unsigned long long start_ns, unsigned long long stop_ns) {
+    unsigned long long max_lag_ns = 0;
+    unsigned long submitted = 0;
+    for (size_t i = 0; i < arrival_count; i++) {
+        if (arrivals[i].id > 0) submitted++;
+        unsigned long long lag = arrivals[i].sent_ns - arrivals[i].due_ns;
+        if (arrivals[i].sent_ns > arrivals[i].due_ns && lag > max_lag_ns) max_lag_ns = lag;
+    }
+    double send_s = (double)(stop_ns - start_ns) / 1e9;
+    double finish_s = last_end_ns > start_ns ? (double)(last_end_ns - start_ns) / 1e9 : 0.0;
+    unsigned long finished = completed + failed;
+
+    printf("submitted  %lu of %zu arrivals in %.2f s (%.1f/s), %lu rejected; sends ran up to %.3f ms late\n",
+           submitted, arrival_count, send_s, send_s > 0 ? submitted / send_s : 0.0, rejected,
+           max_lag_ns / 1e6);
+    printf("finished   %lu (%lu completed, %lu failed) by %.2f s (%.1f/s); %lu unfinished, %lu lost\n",
+           finished, completed, failed, finish_s, finish_s > 0 ? finished / finish_s : 0.0,
+           submitted - finished - lost, lost);
+    printf("\n  %-28s %8s %10s %10s %10s %10s\n", "latency from due time (ms)", "count", "p50", "p99",
+           "p99.9", "max");
+    print_latency_row("submit->start", corrected[PRIORITY_COUNT][LATENCY_START]);
+    print_latency_row("submit->finish", corrected[PRIORITY_COUNT][LATENCY_FINISH]);
+    for (int p = 0; p < PRIORITY_COUNT; p++) {
+        if (mix[p] == 0) continue;
+        char label[64];
+        snprintf(label, sizeof(label), "submit->start %s", priority_to_string((Priority)p));
+        print_latency_row(label, corrected[p][LATENCY_START]);
+        snprintf(label, sizeof(label), "submit->finish %s", priority_to_string((Priority)p));
+        print_latency_row(label, corrected[p][LATENCY_FINISH]);
+    }
+    printf("\n  %-28s\n", "from actual send (uncorrected)");
+    print_latency_row("submit->start", uncorrected[LATENCY_START]);
+    print_latency_row("submit->finish", uncorrected[LATENCY_FINISH]);
+}
+
+// ---- options ----
+
+static int parse_options(int argc, char* argv[]) {
+    int opt;
+    while ((opt = getopt(argc, argv, "q:p:H:r:a:d:w:m:t:s:h")) != -1) {
+        char* end;
+        switch (opt) {
+            case 'q':
+                if (!queue_name_valid(optarg)) return -1;
+                // Where queue_shm_key() and the submission client look
+                setenv(QUEUE_NAME_ENV, optarg, 1);
+                snprintf(http_prefix, sizeof(http_prefix), "/q/%s", optarg);
+                break;
+            case 'p':
+                if (strcmp(optarg, "shm") == 0) via = VIA_SHM;
+                else if (strcmp(optarg, "socket") == 0) via = VIA_SOCKET;
+                else if (strcmp(optarg, "http") == 0) via = VIA_HTTP;
+                else return -1;
+                break;
+            case 'H': {
+                const char* colon = strrchr(optarg, ':');
+                if (colon == NULL || colon == optarg || (size_t)(colon - optarg) >= sizeof(http_host) ||
+                    strlen(colon + 1) >= sizeof(http_port)) {
+                    return -1;
+                }
+                snprintf(http_host, sizeof(http_host), "%.*s", (int)(colon - optarg), optarg);
+                snprintf(http_port, sizeof(http_port), "%s", colon + 1);
+                break;
+            }
+            case 'r':
+                rate = strtod(optarg, &end);
+                if (*end != '\0' || !(rate > 0)) return -1;
+                break;
+            case 'a':
+                if (strcmp(optarg, "poisson") == 0) poisson = 1;
+                else if (strcmp(optarg, "constant") == 0) poisson = 0;
+                else return -1;
+                break;
+            case 'd':
+                duration_s = strtod(optarg, &end);
+                if (*end != '\0' || !(duration_s > 0)) return -1;
+                break;
+            case 'w':
+                drain_s = strtod(optarg, &end);
+                if (*end != '\0' || !(drain_s >= 0)) return -1;
+                break;
+            case 'm':
+                if (sscanf(optarg, "%u:%u:%u", &mix[0], &mix[1], &mix[2]) != 3 ||
+                    mix[0] + mix[1] + mix[2] == 0) {
+                    return -1;
+                }
+                break;
+            case 't': {
+                int n = sscanf(optarg, "%u-%u", &task_ms_min, &task_ms_max);
+                if (n == 1) task_ms_max = task_ms_min;
+                if (n < 1 || task_ms_min == 0 || task_ms_max < task_ms_min) return -1;
+                break;
+            }
+            case 's':
+                rng_state = strtoull(optarg, &end, 0);
+                if (*end != '\0') return -1;
+                break;
+            default:
+                return -1;
+        }
+    }
+    return optind == argc ? 0 : -1;
+}
+
+int main(int argc, char* argv[]) {
+    if (parse_options(argc, argv) != 0) {
+        print_usage(argv[0]);
+        return 2;
+    }
+    if (rng_state == 0) rng_state = now_ns() ^ ((unsigned long long)getpid() << 32);
+    if (rng_state == 0) rng_state = 1;
+
+    TaskQueue* queue = attach_shared_memory(-1);
+    if (queue == NULL) {
+        fprintf(stderr, "loadgen: no queue %s at key 0x%x (is the scheduler running?)\n",
+                queue_name(), (unsigned)queue_shm_key());
+        return 1;
+    }
+    if (via == VIA_SOCKET && submit_client_open(&submit_client, NULL, on_submit_ack, NULL) != 0) {
+        perror("loadgen: cannot connect to the submission socket");
+        return 1;
+    }
+    for (int p = 0; p <= PRIORITY_COUNT; p++) {
+        for (int k = 0; k < LATENCY_KINDS; k++) {
+            corrected[p][k] = calloc(1, sizeof(Histogram));
+            if (corrected[p][k] == NULL) return 1;
+        }
+    }
+    for (int k = 0; k < LATENCY_KINDS; k++) {
+        uncorrected[k] = calloc(1, sizeof(Histogram));
+        if (uncorrected[k] == NULL) return 1;
+    }
+    signal(SIGINT, on_signal);
+    signal(SIGTERM, on_signal);
+
+    static const char* const path_names[] = { "shm", "socket", "http" };
+    printf("loadgen: %.1f tasks/s (%s) for %.1f s via %s, mix %u:%u:%u, tasks %u-%u ms\n",
+           rate, poisson ? "poisson" : "constant", duration_s, path_names[via],
+           mix[0], mix[1], mix[2], task_ms_min, task_ms_max);
+    fflush(stdout);
+
+    lock_queue(queue);
+    seen_seq = queue->change_seq;
+    unlock_queue(queue);
+
+    unsigned long long start_ns = now_ns();
+    unsigned long long end_ns = start_ns + (unsigned long long)(duration_s * 1e9);
+    unsigned long long drain_end_ns = end_ns + (unsigned long long)(drain_s * 1e9);
+    unsigned long long next_due = start_ns + next_gap_ns();
+    unsigned long long stop_ns = end_ns;
+    unsigned long long last_poll = 0;
+    int sending = 1;
+
+    while (!stop_requested) {
+        unsigned long long now = now_ns();
+        if (sending && next_due >= end_ns) {
+            sending = 0;
+            stop_ns = now;
+        }
+        // Late arrivals go out back to back, still on their own due times
+        if (sending && now >= next_due) {
+            if (add_arrival(queue, next_due) != 0) {
+                fprintf(stderr, "loadgen: out of memory\n");
+                break;
+            }
+            Arrival* a = &arrivals[arrival_count++];
+            if (a->id > 0) {
+                by_id[known++] = (int)(a - arrivals);
+            } else {
+                a->finished = 1;
+                rejected++;
+            }
+            next_due += next_gap_ns();
+            now = now_ns();
+        }
+        if (now - last_poll >= POLL_INTERVAL_NS) {
+            poll_queue(queue);
+            last_poll = now;
+        }
+        if (!sending && (completed + failed + lost == known || now >= drain_end_ns)) break;
+
+        unsigned long long wake = last_poll + POLL_INTERVAL_NS;
+        if (sending && next_due < wake) wake = next_due;
+        if (wake > now) sleep_until(wake);
+    }
+    if (sending) stop_ns = now_ns();
+    poll_queue(queue);
+
+    print_report(start_ns, stop_ns);
+
+    if (via == VIA_SOCKET) submit_client_close(&submit_client);
+    if (http_fd >= 0) close(http_fd);
+    detach_shared_memory(queue);
+    return 0;
+}
@@ -1,71 +1,322 @@
 #include "common.h"
 #include "logger.h"
 #include <stdarg.h>
+#include <signal.h>
 #include <sys/stat.h>
-#include <sys/file.h>
+#include <sys/uio.h>
 
-static FILE* log_file = NULL;
+#define LOG_BATCH 64            // Lines per writev
+#define LOG_PREFIX_MAX 64       // "[timestamp] [pid] [LEVEL] "
+
+// One queued line. seq is the slot's turn (bounded MPMC ring, used here
+// with a single consumer): pos when free for the producer reserving pos,
+// pos + 1 once that line is published, pos + LOG_RING_SLOTS when written.
+typedef struct {
+    unsigned long seq;
+    time_t time;
+    LogLevel level;
+    unsigned int len;
+    char message[LOG_MESSAGE_MAX];
+} LogRecord;
+
+static LogRecord ring[LOG_RING_SLOTS];
+static unsigned long ring_tail;         // Next position a producer reserves
+static unsigned long ring_head;         // Next position the flusher writes
+
+static int log_fd = -1;
 static char log_file_path[512];
+static pid_t logger_pid;
+static LogOverflowPolicy overflow_policy = LOG_OVERFLOW_DEFAULT;
+static unsigned long dropped_lines;
+
+static pthread_t flusher_thread;
+static int flusher_running;             // Lines go through the ring only while set
+static int flusher_stop;
+static pthread_mutex_t flush_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t flush_cond;
+
+static const char* level_string(LogLevel level) {
+    switch (level) {
+        case LOG_DEBUG: return "DEBUG";
+        case LOG_INFO:  return "INFO";
+        case LOG_WARN:  return "WARN";
+        case LOG_ERROR: return "ERROR";
+        default:        return "INFO";
+    }
+}
+
+// Format: [TIMESTAMP] [PID] [LEVEL] (flusher only). Consecutive lines
+// mostly share a second, so its string is kept until the second changes.
+static int format_prefix(time_t t, LogLevel level, char* buffer, size_t size) {
+    static time_t cached_second = -1;
+    static char cached_timestamp[64];
+
+    if (t != cached_second) {
+        format_timestamp(t, cached_timestamp, sizeof(cached_timestamp));
+        cached_second = t;
+    }
+    int len = snprintf(buffer, size, "[%s] [%d] [%s] ", cached_timestamp, logger_pid, level_string(level));
+    return len < (int)size ? len : (int)size - 1;
+}
+
+static void writev_full(int fd, struct iovec* iov, int count) {
+    while (count > 0) {
+        ssize_t n = writev(fd, iov, count);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return;
+        }
+        while (count > 0 && (size_t)n >= iov->iov_len) {
+            n -= (ssize_t)iov->iov_len;
+            iov++;
+            count--;
+        }
+        if (count > 0) {
+            iov->iov_base = (char*)iov->iov_base + n;
+            iov->iov_len -= (size_t)n;
+        }
+    }
+}
+
+// Write up to LOG_BATCH published lines (plus a note about drops) in one
+// writev. Returns the number of lines written. When final, lines that are
+// reserved but not yet published are waited for, so none is left behind.
+static int flush_batch(int final) {
+    static unsigned long reported_drops;
+    static char drop_line[128];
+    struct iovec iov[LOG_BATCH * 3 + 1];
+    char prefixes[LOG_BATCH][LOG_PREFIX_MAX];
+    int n_iov = 0;
+    int count = 0;
+
+    unsigned long dropped = __atomic_load_n(&dropped_lines, __ATOMIC_RELAXED);
+    if (dropped != reported_drops) {
+        char prefix[LOG_PREFIX_MAX];
+        format_prefix(time(NULL), LOG_WARN, prefix, sizeof(prefix));
+        int len = snprintf(drop_line, sizeof(drop_line), "%sLogger: %lu lines dropped (ring full)\n",
+                           prefix, dropped - reported_drops);
+        iov[n_iov].iov_base = drop_line;
+        iov[n_iov].iov_len = len < (int)sizeof(drop_line) ? (size_t)len : sizeof(drop_line) - 1;
+        n_iov++;
+        reported_drops = dropped;
+    }
+
+    unsigned long head = ring_head;
+    while (count < LOG_BATCH) {
+        unsigned long pos = head + (unsigned long)count;
+        LogRecord* r = &ring[pos & (LOG_RING_SLOTS - 1)];
+        if (__atomic_load_n(&r->seq, __ATOMIC_ACQUIRE) != pos + 1) {
+            if (final && pos != __atomic_load_n(&ring_tail, __ATOMIC_ACQUIRE)) {
+                sched_yield();
+                continue;
+            }
+            break;
+        }
+        int len = format_prefix(r->time, r->level, prefixes[count], LOG_PREFIX_MAX);
+        iov[n_iov].iov_base = prefixes[count];
+        iov[n_iov++].iov_len = (size_t)len;
+        iov[n_iov].iov_base = r->message;
+        iov[n_iov++].iov_len = r->len;
+        iov[n_iov].iov_base = "\n";
+        iov[n_iov++].iov_len = 1;
+        count++;
+    }
+
+    if (n_iov > 0) writev_full(log_fd >= 0 ? log_fd : STDERR_FILENO, iov, n_iov);
+
+    // Hand the slots back to producers
+    for (int i = 0; i < count; i++) {
+        unsigned long pos = head + (unsigned long)i;
+        __atomic_store_n(&ring[pos & (LOG_RING_SLOTS - 1)].seq, pos + LOG_RING_SLOTS, __ATOMIC_RELEASE);
+    }
+    __atomic_store_n(&ring_head, head + (unsigned long)count, __ATOMIC_RELEASE);
+    return count;
+}
+
+static void* flusher_main(void* arg) {
+    (void)arg;
+    while (1) {
+        int stopping = __atomic_load_n(&flusher_stop, __ATOMIC_ACQUIRE);
+        while (flush_batch(stopping) == LOG_BATCH) {
+        }
+        if (stopping) break;
+
+        // Producers only wake us when the ring fills up or for errors;
+        // everything else waits for the next interval
+        pthread_mutex_lock(&flush_mutex);
+        if (!__atomic_load_n(&flusher_stop, __ATOMIC_ACQUIRE)) {
+            struct timespec deadline;
+            clock_gettime(CLOCK_MONOTONIC, &deadline);
+            deadline.tv_nsec += LOG_FLUSH_INTERVAL_MS * 1000000L;
+            if (deadline.tv_nsec >= 1000000000L) {
+                deadline.tv_sec += deadline.tv_nsec / 1000000000L;
+                deadline.tv_nsec %= 1000000000L;
+            }
+            pthread_cond_timedwait(&flush_cond, &flush_mutex, &deadline);
+        }
+        pthread_mutex_unlock(&flush_mutex);
+    }
+    return NULL;
+}
+
+static void wake_flusher(void) {
+    pthread_mutex_lock(&flush_mutex);
+    pthread_cond_signal(&flush_cond);
+    pthread_mutex_unlock(&flush_mutex);
+}
+
+// A forked child has no flusher; it writes directly until it execs
+static void logger_atfork_child(void) {
+    flusher_running = 0;
+    logger_pid = getpid();
+}
+
+// Used when there is no flusher: one write per line
+static void write_direct(LogLevel level, const char* format, va_list args) {
+    char timestamp[64];
+    char line[LOG_PREFIX_MAX + LOG_MESSAGE_MAX + 1];
+    format_timestamp(time(NULL), timestamp, sizeof(timestamp));
+    int len = snprintf(line, LOG_PREFIX_MAX, "[%s] [%d] [%s] ", timestamp, getpid(), level_string(level));
+    if (len >= LOG_PREFIX_MAX) len = LOG_PREFIX_MAX - 1;
+    int n = vsnprintf(line + len, LOG_MESSAGE_MAX, format, args);
+    if (n < 0) n = 0;
+    if (n >= LOG_MESSAGE_MAX) n = LOG_MESSAGE_MAX - 1;
+    len += n;
+    line[len++] = '\n';
+
+    int fd = log_fd >= 0 ? log_fd : STDERR_FILENO;
+    ssize_t written;
+    do {
+        written = write(fd, line, (size_t)len);
+    } while (written < 0 && errno == EINTR);
+}
 
 void init_logger(const char* process_name) {
+    static int registered = 0;
+
     // Create logs directory if it doesn't exist
     struct stat st = {0};
     if (stat(LOG_DIR, &st) == -1) {
         mkdir(LOG_DIR, 0700);
     }
-    
+
     // Create log file path
-    snprintf(log_file_path, sizeof(log_file_path), "%s/%s_%d.log", 
+    snprintf(log_file_path, sizeof(log_file_path), "%s/%s_%d.log",
              LOG_DIR, process_name, getpid());
-    
-    log_file = fopen(log_file_path, "a");
-    if (log_file == NULL) {
+
+    log_fd = open(log_file_path, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (log_fd < 0) {
         perror("Failed to open log file");
-        log_file = stderr;
     }
-    
-    // Set line buffering
-    setvbuf(log_file, NULL, _IOLBF, 0);
+    logger_pid = getpid();
+
+    const char* policy = getenv(LOG_OVERFLOW_ENV);
+    if (policy != NULL && strcmp(policy, "block") == 0) {
+        overflow_policy = LOG_OVERFLOW_BLOCK;
+    } else if (policy != NULL && strcmp(policy, "drop") == 0) {
+        overflow_policy = LOG_OVERFLOW_DROP;
+    }
+
+    if (!registered) {
+        pthread_condattr_t attr;
+        pthread_condattr_init(&attr);
+        pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+        pthread_cond_init(&flush_cond, &attr);
+        pthread_condattr_destroy(&attr);
+
+        for (unsigned long i = 0; i < LOG_RING_SLOTS; i++) {
+            ring[i].seq = i;
+        }
+        pthread_atfork(NULL, NULL, logger_atfork_child);
+        atexit(close_logger);
+        registered = 1;
+    }
+
+    // The flusher takes no signals, so handlers that log never run on it
+    sigset_t all, old;
+    sigfillset(&all);
+    pthread_sigmask(SIG_SETMASK, &all, &old);
+    __atomic_store_n(&flusher_stop, 0, __ATOMIC_RELEASE);
+    if (pthread_create(&flusher_thread, NULL, flusher_main, NULL) == 0) {
+        __atomic_store_n(&flusher_running, 1, __ATOMIC_RELEASE);
+    } else {
+        perror("Failed to start log flusher");
+    }
+    pthread_sigmask(SIG_SETMASK, &old, NULL);
 }
 
 void close_logger(void) {
-    if (log_file && log_file != stderr && log_file != stdout) {
-        fclose(log_file);
-        log_file = NULL;
+    if (__atomic_exchange_n(&flusher_running, 0, __ATOMIC_ACQ_REL)) {
+        __atomic_store_n(&flusher_stop, 1, __ATOMIC_RELEASE);
+        wake_flusher();
+        pthread_join(flusher_thread, NULL);
+    }
+    if (log_fd >= 0) {
+        close(log_fd);
+        log_fd = -1;
     }
 }
 
 void log_message(LogLevel level, const char* format, ...) {
-    if (log_file == NULL) {
-        log_file = stderr;
-    }
-    
-    time_t now = time(NULL);
-    char timestamp[64];
-    format_timestamp(now, timestamp, sizeof(timestamp));
-    
-    const char* level_str;
-    switch (level) {
-        case LOG_DEBUG: level_str = "DEBUG"; break;
-        case LOG_INFO:  level_str = "INFO";  break;
-        case LOG_WARN:  level_str = "WARN";  break;
-        case LOG_ERROR: level_str = "ERROR"; break;
-        default:        level_str = "INFO";  break;
-    }
-    
-    // Format: [TIMESTAMP] [PID] [LEVEL] message
-    fprintf(log_file, "[%s] [%d] [%s] ", timestamp, getpid(), level_str);
-    
     va_list args;
     va_start(args, format);
-    vfprintf(log_file, format, args);
+
+    if (!__atomic_load_n(&flusher_running, __ATOMIC_ACQUIRE)) {
+        write_direct(level, format, args);
+        va_end(args);
+        return;
+    }
+
+    // Reserve a slot: the one at the tail is free once its seq equals the
+    // position; a seq behind it means the ring is full
+    LogRecord* r;
+    unsigned long pos = __atomic_load_n(&ring_tail, __ATOMIC_RELAXED);
+    while (1) {
+        r = &ring[pos & (LOG_RING_SLOTS - 1)];
+        long diff = (long)(__atomic_load_n(&r->seq, __ATOMIC_ACQUIRE) - pos);
+        if (diff == 0) {
+            if (__atomic_compare_exchange_n(&ring_tail, &pos, pos + 1, 1,
+                                            __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+                break;
+            }
+        } else if (diff < 0) {
+            if (overflow_policy == LOG_OVERFLOW_DROP) {
+                __atomic_add_fetch(&dropped_lines, 1, __ATOMIC_RELAXED);
+                va_end(args);
+                return;
+            }
+            wake_flusher();
+            struct timespec pause = {0, 100000};
+            nanosleep(&pause, NULL);
+            pos = __atomic_load_n(&ring_tail, __ATOMIC_RELAXED);
+        } else {
+            pos = __atomic_load_n(&ring_tail, __ATOMIC_RELAXED);
+        }
+    }
+
+    int n = vsnprintf(r->message, sizeof(r->message), format, args);
     va_end(args);
-    
-    fprintf(log_file, "\n");
-    fflush(log_file);
+    if (n < 0) n = 0;
+    r->len = n < (int)sizeof(r->message) ? (unsigned int)n : sizeof(r->message) - 1;
+    r->time = time(NULL);
+    r->level = level;
+    __atomic_store_n(&r->seq, pos + 1, __ATOMIC_RELEASE);
+
+    // Errors go out at once; so does a ring that is filling up
+    unsigned long used = pos + 1 - __atomic_load_n(&ring_head, __ATOMIC_ACQUIRE);
+    if (level >= LOG_ERROR || used >= LOG_RING_SLOTS / 2) {
+        wake_flusher();
+    }
 }
 
 const char* get_log_file_path(void) {
     return log_file_path;
 }
 
+void set_log_overflow_policy(LogOverflowPolicy policy) {
+    overflow_policy = policy;
+}
+
+unsigned long log_dropped_count(void) {
+    return __atomic_load_n(&dropped_lines, __ATOMIC_RELAXED);
+}
@@ -10,11 +10,29 @@ typedef enum {
     LOG_ERROR = 3
 } LogLevel;
 
+// What log_message does when the ring is full
+typedef enum {
+    LOG_OVERFLOW_DROP = 0,      // Discard the line and count it
+    LOG_OVERFLOW_BLOCK = 1      // Wait for the flusher to make room
+} LogOverflowPolicy;
+
+// Open the log file and start the flusher thread. log_message formats
+// only the message into a ring slot; the thread adds the timestamp and
+// prefix and writes batches of lines with writev. Lines logged before
+// init_logger, after close_logger or in a forked child are written directly.
 void init_logger(const char* process_name);
+
+// Write every queued line, stop the flusher and close the file (also run at exit)
 void close_logger(void);
+
 void log_message(LogLevel level, const char* format, ...);
 const char* get_log_file_path(void);
 
+void set_log_overflow_policy(LogOverflowPolicy policy);
+
+// Lines discarded because the ring was full
+unsigned long log_dropped_count(void);
+
 // Convenience macros
 #define LOG_DEBUG_F(...) log_message(LOG_DEBUG, __VA_ARGS__)
 #define LOG_INFO_F(...)  log_message(LOG_INFO, __VA_ARGS__)
@@ -22,4 +40,3 @@ const char* get_log_file_path(void);
 #define LOG_ERROR_F(...) log_message(LOG_ERROR, __VA_ARGS__)
 
 #endif // LOGGER_H
-
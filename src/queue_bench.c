@@ -0,0 +1,580 @@
+#include "common.h"
+#include "task_queue.h"
+#include <getopt.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+
+// queue_bench: micro-benchmarks for the task queue operations. Each
+// scenario gets a private segment holding queue_size PENDING tasks, then
+// several processes with several threads each call one operation on it at
+// once, timing every call. The calls run in rounds: between rounds, with
+// everyone stopped, the tasks a round needs are set up and the ones it
+// left behind removed, so the queue stays within a tenth of its size (a
+// few tasks per participant for small ones) and only the timed calls
+// count towards throughput. Results go out as JSON,
+// one scenario per line, so two runs can be compared with -b or a plain
+// diff. `make bench` builds this with a larger MAX_TASKS.
+
+#define BENCH_DEFAULT_OPS 10000         // Timed calls per scenario
+#define BENCH_ROUND_DIVISOR 10          // A round adds at most queue_size / this tasks...
+#define BENCH_ROUND_MIN_PER_THREAD 4    // ...or this many per participant, if more
+#define BENCH_FILL_CHUNK 256            // Tasks per enqueue_task_batch while filling
+#define BENCH_MAX_SIZES 16
+#define BENCH_MAX_LEVELS 16
+#define BENCH_MAX_PARTICIPANTS 256
+#define BENCH_DEFAULT_THRESHOLD 20.0    // Percent change worth flagging; runs vary by ~10%
+
+typedef enum {
+    OP_ENQUEUE,
+    OP_CLAIM,
+    OP_COMPLETE,
+    OP_CANCEL,
+    OP_CLEANUP,
+    OP_COUNT
+} BenchOp;
+
+static const char* const op_names[OP_COUNT] = { "enqueue", "claim", "complete", "cancel", "cleanup" };
+
+typedef struct {
+    int procs;
+    int threads;
+} Contention;
+
+// Mapped shared before the participants fork, so everyone sees it. The
+// coordinator publishes round n by storing n in round; each participant
+// does calls first + participant, first + participant + participants, ...
+// below first + count, then bumps finished.
+typedef struct {
+    int participants;
+    int round;
+    int stop;
+    int first;
+    int count;
+    int finished;
+    int failures;               // Calls that returned an error
+    int cleanup_ticket;         // Cleanup calls taken this round, in arrival order
+    unsigned long long start_ns[BENCH_MAX_PARTICIPANTS];
+    unsigned long long end_ns[BENCH_MAX_PARTICIPANTS];
+    int* ids;                   // [ops] the task each call used
+    unsigned long long* samples; // [ops] nanoseconds per call
+} BenchRun;
+
+typedef struct {
+    BenchOp op;
+    int queue_size;
+    Contention level;
+    int ops;
+    double seconds;
+    double ops_per_sec;
+    unsigned long long mean_ns, p50_ns, p90_ns, p99_ns, p999_ns, max_ns;
+    int failures;
+} BenchResult;
+
+typedef struct {
+    TaskQueue* queue;
+    BenchRun* run;
+    BenchOp op;
+    int participant;
+} ParticipantArgs;
+
+static int sizes[BENCH_MAX_SIZES] = { 100, 1000, 10000 };
+static int size_count = 3;
+static Contention levels[BENCH_MAX_LEVELS] = { { 1, 1 }, { 1, 4 }, { 4, 1 }, { 4, 4 } };
+static int level_count = 4;
+static int selected_ops[OP_COUNT] = { 1, 1, 1, 1, 1 };
+static int ops_per_scenario = BENCH_DEFAULT_OPS;
+static double threshold = BENCH_DEFAULT_THRESHOLD;
+
+static void print_usage(const char* prog) {
+    fprintf(stderr, "Usage: %s [options]\n", prog);
+    fprintf(stderr, "  -n OPS         Timed calls per scenario (default %d)\n", BENCH_DEFAULT_OPS);
+    fprintf(stderr, "  -s N[,N...]    Queue sizes (default 100,1000,10000; MAX_TASKS is %d)\n", MAX_TASKS);
+    fprintf(stderr, "  -c PxT[,PxT]   Contention: processes x threads (default 1x1,1x4,4x1,4x4)\n");
+    fprintf(stderr, "  -O OP[,OP...]  Only these of enqueue, claim, complete, cancel, cleanup\n");
+    fprintf(stderr, "  -o FILE        Write the JSON here instead of stdout\n");
+    fprintf(stderr, "  -b FILE        Compare with an earlier run's JSON\n");
+    fprintf(stderr, "  -T PERCENT     Flag changes beyond this against -b (default %.0f)\n", BENCH_DEFAULT_THRESHOLD);
+}
+
+// ---- rounds ----
+
+// Add count PENDING tasks of mixed priority; ids (if not NULL) gets their ids
+static int fill_queue(TaskQueue* queue, int count, int* ids) {
+    TaskSpec specs[BENCH_FILL_CHUNK];
+    int chunk_ids[BENCH_FILL_CHUNK];
+    memset(specs, 0, sizeof(specs));
+    for (int done = 0; done < count;) {
+        int n = count - done < BENCH_FILL_CHUNK ? count - done : BENCH_FILL_CHUNK;
+        for (int i = 0; i < n; i++) {
+            snprintf(specs[i].name, sizeof(specs[i].name), "bench-%d", done + i);
+            specs[i].priority = (Priority)((done + i) % PRIORITY_COUNT);
+            specs[i].execution_time_ms = 1000;
+        }
+        if (enqueue_task_batch(queue, specs, n, chunk_ids) != n) return -1;
+        if (ids != NULL) memcpy(ids + done, chunk_ids, (size_t)n * sizeof(int));
+        done += n;
+    }
+    return 0;
+}
+
+// Give the next round what its calls work on (nobody else running)
+static int prepare_round(TaskQueue* queue, BenchOp op, BenchRun* run) {
+    int* ids = run->ids + run->first;
+    int count = run->count;
+    switch (op) {
+        case OP_CLAIM:
+            return fill_queue(queue, count, NULL);
+        case OP_COMPLETE:
+            if (fill_queue(queue, count, NULL) != 0) return -1;
+            for (int k = 0; k < count; k++) {
+                Task task;
+                ids[k] = dequeue_task(queue, &task);
+                if (ids[k] <= 0) return -1;
+            }
+            return 0;
+        case OP_CANCEL:
+            return fill_queue(queue, count, ids);
+        case OP_CLEANUP: {
+            // Finished tasks aged so that the k-th call to arrive removes
+            // the k-th one
+            if (fill_queue(queue, count, ids) != 0) return -1;
+            time_t now = time(NULL);
+            lock_queue(queue);
+            for (int k = 0; k < count; k++) {
+                Task* task = find_task_by_id(queue, ids[k]);
+                if (task == NULL) break;
+                task->status = STATUS_FAILED;
+                task->end_time = now - (count - k) - 1;
+            }
+            unlock_queue(queue);
+            run->cleanup_ticket = 0;
+            return 0;
+        }
+        default:
+            return 0;
+    }
+}
+
+// Take away whatever the round added, leaving the PENDING background
+static void tidy_round(TaskQueue* queue, BenchOp op, BenchRun* run) {
+    const int* ids = run->ids + run->first;
+    for (int k = 0; k < run->count; k++) {
+        if (ids[k] <= 0) continue;
+        if (op == OP_ENQUEUE) cancel_task(queue, ids[k]);
+        else if (op == OP_CLAIM) finish_task(queue, ids[k], STATUS_COMPLETED, NULL);
+    }
+    remove_completed_tasks(queue, -1);
+}
+
+// ---- participants ----
+
+static int timed_call(TaskQueue* queue, BenchRun* run, BenchOp op, int i, const char* name) {
+    switch (op) {
+        case OP_ENQUEUE:
+            run->ids[i] = enqueue_task_ex(queue, name, (Priority)(i % PRIORITY_COUNT), 1000, NULL);
+            return run->ids[i] > 0 ? 0 : -1;
+        case OP_CLAIM: {
+            Task task;
+            run->ids[i] = dequeue_task(queue, &task);
+            return run->ids[i] > 0 ? 0 : -1;
+        }
+        case OP_COMPLETE:
+            return finish_task(queue, run->ids[i], STATUS_COMPLETED, NULL);
+        case OP_CANCEL:
+            return cancel_task(queue, run->ids[i]);
+        default: {
+            int k = __atomic_fetch_add(&run->cleanup_ticket, 1, __ATOMIC_RELAXED);
+            return remove_completed_tasks(queue, run->count - k) >= 0 ? 0 : -1;
+        }
+    }
+}
+
+static void* participant_main(void* arg) {
+    ParticipantArgs* args = arg;
+    BenchRun* run = args->run;
+    char name[MAX_TASK_NAME_LEN];
+    snprintf(name, sizeof(name), "bench-p%d", args->participant);
+
+    int failures = 0;
+    for (int round = 1;; round++) {
+        while (__atomic_load_n(&run->round, __ATOMIC_ACQUIRE) < round &&
+               !__atomic_load_n(&run->stop, __ATOMIC_ACQUIRE)) {
+            sched_yield();
+        }
+        if (__atomic_load_n(&run->round, __ATOMIC_ACQUIRE) < round) break;
+
+        run->start_ns[args->participant] = queue_clock_ns();
+        for (int i = run->first + args->participant; i < run->first + run->count; i += run->participants) {
+            unsigned long long begin = queue_clock_ns();
+            int rc = timed_call(args->queue, run, args->op, i, name);
+            run->samples[i] = queue_clock_ns() - begin;
+            if (rc < 0) failures++;
+        }
+        run->end_ns[args->participant] = queue_clock_ns();
+        __atomic_add_fetch(&run->finished, 1, __ATOMIC_ACQ_REL);
+    }
+    if (failures > 0) __atomic_add_fetch(&run->failures, failures, __ATOMIC_RELAXED);
+    return NULL;
+}
+
+static int start_threads(TaskQueue* queue, BenchRun* run, BenchOp op, int proc, int threads,
+                         pthread_t* tids, ParticipantArgs* args) {
+    for (int t = 0; t < threads; t++) {
+        args[t] = (ParticipantArgs){ queue, run, op, proc * threads + t };
+        if (pthread_create(&tids[t], NULL, participant_main, &args[t]) != 0) return t;
+    }
+    return threads;
+}
+
+static void join_threads(pthread_t* tids, int count) {
+    for (int t = 0; t < count; t++) {
+        pthread_join(tids[t], NULL);
+    }
+}
+
+// A forked process: its share of the participants, as threads
+static int run_process(TaskQueue* queue, BenchRun* run, BenchOp op, int proc, int threads) {
+    pthread_t tids[BENCH_MAX_PARTICIPANTS];
+    ParticipantArgs args[BENCH_MAX_PARTICIPANTS];
+    int started = start_threads(queue, run, op, proc, threads, tids, args);
+    if (started < threads) __atomic_store_n(&run->stop, 1, __ATOMIC_RELEASE);
+    join_threads(tids, started);
+    return started == threads ? 0 : -1;
+}
+
+static int compare_ull(const void* a, const void* b) {
+    unsigned long long x = *(const unsigned long long*)a, y = *(const unsigned long long*)b;
+    return (x > y) - (x < y);
+}
+
+static unsigned long long percentile(const unsigned long long* sorted, int count, double p) {
+    int rank = (int)(p / 100.0 * count + 0.999999);
+    if (rank < 1) rank = 1;
+    if (rank > count) rank = count;
+    return sorted[rank - 1];
+}
+
+// Run the rounds from this process while the participants work; returns
+// the time spent inside rounds, or 0 if they could not all be run
+static unsigned long long coordinate(TaskQueue* queue, BenchOp op, BenchRun* run, int ops, int round_size) {
+    unsigned long long busy_ns = 0;
+    for (int round = 1; run->first + run->count < ops; round++) {
+        run->first += run->count;
+        run->count = ops - run->first < round_size ? ops - run->first : round_size;
+        if (__atomic_load_n(&run->stop, __ATOMIC_ACQUIRE) || prepare_round(queue, op, run) != 0) {
+            return 0;
+        }
+        __atomic_store_n(&run->finished, 0, __ATOMIC_RELAXED);
+        __atomic_store_n(&run->round, round, __ATOMIC_RELEASE);
+        while (__atomic_load_n(&run->finished, __ATOMIC_ACQUIRE) < run->participants) {
+            if (__atomic_load_n(&run->stop, __ATOMIC_ACQUIRE)) return 0;
+            sched_yield();
+        }
+        unsigned long long first = run->start_ns[0], last = run->end_ns[0];
+        for (int p = 1; p < run->participants; p++) {
+            if (run->start_ns[p] < first) first = run->start_ns[p];
+            if (run->end_ns[p] > last) last = run->end_ns[p];
+        }
+        busy_ns += last - first;
+        tidy_round(queue, op, run);
+    }
+    return busy_ns;
+}
+
+static int run_scenario(BenchOp op, int queue_size, Contention level, BenchResult* result) {
+    int participants = level.procs * level.threads;
+    int ops = ops_per_scenario < participants ? participants : ops_per_scenario;
+    int round_size = queue_size / BENCH_ROUND_DIVISOR;
+    if (round_size < participants * BENCH_ROUND_MIN_PER_THREAD) {
+        round_size = participants * BENCH_ROUND_MIN_PER_THREAD;
+    }
+    if (queue_size + round_size > MAX_TASKS) {
+        fprintf(stderr, "skipping %s at %d: %d tasks don't fit in MAX_TASKS %d\n",
+                op_names[op], queue_size, queue_size + round_size, MAX_TASKS);
+        return -1;
+    }
+
+    size_t run_len = sizeof(BenchRun) + (size_t)ops * (sizeof(unsigned long long) + sizeof(int));
+    BenchRun* run = mmap(NULL, run_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (run == MAP_FAILED) return -1;
+    run->participants = participants;
+    run->samples = (unsigned long long*)(run + 1);
+    run->ids = (int*)(run->samples + ops);
+
+    // Marked for removal at once: the segment goes away with the last
+    // process attached, however we exit
+    int shm_id = init_shared_memory(IPC_PRIVATE);
+    TaskQueue* queue = shm_id != -1 ? attach_shared_memory(shm_id) : NULL;
+    destroy_shared_memory(shm_id);
+    if (queue == NULL || fill_queue(queue, queue_size, NULL) != 0) {
+        fprintf(stderr, "cannot set up a queue of %d\n", queue_size);
+        detach_shared_memory(queue);
+        munmap(run, run_len);
+        return -1;
+    }
+
+    // Process 0 is this one; the rest are forked with the segment attached
+    int forked = 0;
+    pid_t pids[BENCH_MAX_PARTICIPANTS];
+    for (int p = 1; p < level.procs; p++) {
+        pid_t pid = fork();
+        if (pid == 0) {
+            _exit(run_process(queue, run, op, p, level.threads) == 0 ? 0 : 1);
+        }
+        if (pid < 0) {
+            run->stop = 1;
+            break;
+        }
+        pids[forked++] = pid;
+    }
+    pthread_t tids[BENCH_MAX_PARTICIPANTS];
+    ParticipantArgs args[BENCH_MAX_PARTICIPANTS];
+    int started = run->stop ? 0 : start_threads(queue, run, op, 0, level.threads, tids, args);
+    unsigned long long busy_ns = started == level.threads ? coordinate(queue, op, run, ops, round_size) : 0;
+    __atomic_store_n(&run->stop, 1, __ATOMIC_RELEASE);
+    join_threads(tids, started);
+    int ok = busy_ns > 0;
+    for (int i = 0; i < forked; i++) {
+        int status;
+        if (waitpid(pids[i], &status, 0) != pids[i] || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+            ok = 0;
+        }
+    }
+
+    if (ok) {
+        unsigned long long total = 0;
+        for (int i = 0; i < ops; i++) {
+            total += run->samples[i];
+        }
+        qsort(run->samples, (size_t)ops, sizeof(unsigned long long), compare_ull);
+
+        memset(result, 0, sizeof(*result));
+        result->op = op;
+        result->queue_size = queue_size;
+        result->level = level;
+        result->ops = ops;
+        result->seconds = (double)busy_ns / 1e9;
+        result->ops_per_sec = ops / result->seconds;
+        result->mean_ns = total / (unsigned long long)ops;
+        result->p50_ns = percentile(run->samples, ops, 50.0);
+        result->p90_ns = percentile(run->samples, ops, 90.0);
+        result->p99_ns = percentile(run->samples, ops, 99.0);
+        result->p999_ns = percentile(run->samples, ops, 99.9);
+        result->max_ns = run->samples[ops - 1];
+        result->failures = run->failures;
+    } else {
+        fprintf(stderr, "%s at %d with %dx%d failed to run\n", op_names[op], queue_size,
+                level.procs, level.threads);
+    }
+    detach_shared_memory(queue);
+    munmap(run, run_len);
+    return ok ? 0 : -1;
+}
+
+// ---- output ----
+
+static void write_result(FILE* out, const BenchResult* r, int last) {
+    fprintf(out,
+            "    {\"op\": \"%s\", \"queue_size\": %d, \"procs\": %d, \"threads\": %d, \"ops\": %d, "
+            "\"seconds\": %.6f, \"ops_per_sec\": %.1f, \"mean_ns\": %llu, \"p50_ns\": %llu, "
+            "\"p90_ns\": %llu, \"p99_ns\": %llu, \"p999_ns\": %llu, \"max_ns\": %llu, \"failures\": %d}%s\n",
+            op_names[r->op], r->queue_size, r->level.procs, r->level.threads, r->ops, r->seconds,
+            r->ops_per_sec, r->mean_ns, r->p50_ns, r->p90_ns, r->p99_ns, r->p999_ns, r->max_ns,
+            r->failures, last ? "" : ",");
+}
+
+// Value of "key": in a result line, or -1
+static double json_number(const char* line, const char* key) {
+    char pattern[64];
+    snprintf(pattern, sizeof(pattern), "\"%s\":", key);
+    const char* at = strstr(line, pattern);
+    return at != NULL ? strtod(at + strlen(pattern), NULL) : -1.0;
+}
+
+// The baseline's result for the same scenario, from a file this program
+// wrote: one result object per line
+static int find_baseline(FILE* baseline, const BenchResult* r, double* ops_per_sec, double* p99_ns) {
+    char line[1024];
+    char op_field[64];
+    snprintf(op_field, sizeof(op_field), "\"op\": \"%s\"", op_names[r->op]);
+    rewind(baseline);
+    while (fgets(line, sizeof(line), baseline) != NULL) {
+        if (strstr(line, op_field) == NULL) continue;
+        if ((int)json_number(line, "queue_size") != r->queue_size ||
+            (int)json_number(line, "procs") != r->level.procs ||
+            (int)json_number(line, "threads") != r->level.threads) {
+            continue;
+        }
+        *ops_per_sec = json_number(line, "ops_per_sec");
+        *p99_ns = json_number(line, "p99_ns");
+        return *ops_per_sec > 0 && *p99_ns > 0 ? 0 : -1;
+    }
+    return -1;
+}
+
+static double percent_change(double now, double before) {
+    return (now - before) / before * 100.0;
+}
+
+// Human-readable line on stderr, with the change from the baseline if any
+static int print_summary(const BenchResult* r, FILE* baseline) {
+    char scenario[64];
+    snprintf(scenario, sizeof(scenario), "%s %d %dx%d", op_names[r->op], r->queue_size,
+             r->level.procs, r->level.threads);
+    fprintf(stderr, "%-24s %12.0f ops/s  p50 %9.2f us  p99 %9.2f us  max %10.2f us",
+            scenario, r->ops_per_sec, r->p50_ns / 1e3, r->p99_ns / 1e3, r->max_ns / 1e3);
+    int flagged = 0;
+    double base_ops, base_p99;
+    if (baseline != NULL && find_baseline(baseline, r, &base_ops, &base_p99) == 0) {
+        double ops_change = percent_change(r->ops_per_sec, base_ops);
+        double p99_change = percent_change((double)r->p99_ns, base_p99);
+        flagged = ops_change < -threshold || p99_change > threshold;
+        fprintf(stderr, "  [%+6.1f%% ops/s, %+6.1f%% p99]%s", ops_change, p99_change,
+                flagged ? " slower" : "");
+    } else if (baseline != NULL) {
+        fprintf(stderr, "  [not in baseline]");
+    }
+    if (r->failures > 0) fprintf(stderr, "  (%d calls failed)", r->failures);
+    fprintf(stderr, "\n");
+    return flagged;
+}
+
+// ---- options ----
+
+static int parse_sizes(const char* arg) {
+    char copy[256];
+    snprintf(copy, sizeof(copy), "%s", arg);
+    size_count = 0;
+    for (char* tok = strtok(copy, ","); tok != NULL; tok = strtok(NULL, ",")) {
+        char* end;
+        long n = strtol(tok, &end, 10);
+        if (*end != '\0' || n < 0 || n > MAX_TASKS || size_count == BENCH_MAX_SIZES) return -1;
+        sizes[size_count++] = (int)n;
+    }
+    return size_count > 0 ? 0 : -1;
+}
+
+static int parse_levels(const char* arg) {
+    char copy[256];
+    snprintf(copy, sizeof(copy), "%s", arg);
+    level_count = 0;
+    for (char* tok = strtok(copy, ","); tok != NULL; tok = strtok(NULL, ",")) {
+        Contention level;
+        char extra;
+        if (sscanf(tok, "%dx%d%c", &level.procs, &level.threads, &extra) != 2 ||
+            level.procs < 1 || level.threads < 1 ||
+            level.procs * level.threads > BENCH_MAX_PARTICIPANTS || level_count == BENCH_MAX_LEVELS) {
+            return -1;
+        }
+        levels[level_count++] = level;
+    }
+    return level_count > 0 ? 0 : -1;
+}
+
+static int parse_ops(const char* arg) {
+    char copy[256];
+    snprintf(copy, sizeof(copy), "%s", arg);
+    memset(selected_ops, 0, sizeof(selected_ops));
+    for (char* tok = strtok(copy, ","); tok != NULL; tok = strtok(NULL, ",")) {
+        int found = 0;
+        for (int op = 0; op < OP_COUNT; op++) {
+            if (strcmp(tok, op_names[op]) == 0) selected_ops[op] = found = 1;
+        }
+        if (!found) return -1;
+    }
+    return 0;
+}
+
+int main(int argc, char* argv[]) {
+    const char* output_path = NULL;
+    const char* baseline_path = NULL;
+    int opt;
+    while ((opt = getopt(argc, argv, "n:s:c:O:o:b:T:h")) != -1) {
+        int bad = 0;
+        switch (opt) {
+            case 'n':
+                ops_per_scenario = atoi(optarg);
+                bad = ops_per_scenario < 1;
+                break;
+            case 's':
+                bad = parse_sizes(optarg) != 0;
+                break;
+            case 'c':
+                bad = parse_levels(optarg) != 0;
+                break;
+            case 'O':
+                bad = parse_ops(optarg) != 0;
+                break;
+            case 'o':
+                output_path = optarg;
+                break;
+            case 'b':
+                baseline_path = optarg;
+                break;
+            case 'T':
+                threshold = atof(optarg);
+                bad = threshold <= 0;
+                break;
+            default:
+                bad = 1;
+                break;
+        }
+        if (bad) {
+            print_usage(argv[0]);
+            return 2;
+        }
+    }
+    if (optind != argc) {
+        print_usage(argv[0]);
+        return 2;
+    }
+
+    FILE* baseline = NULL;
+    if (baseline_path != NULL && (baseline = fopen(baseline_path, "r")) == NULL) {
+        fprintf(stderr, "cannot read baseline %s: %s\n", baseline_path, strerror(errno));
+        return 1;
+    }
+
+    int scenario_count = 0;
+    for (int op = 0; op < OP_COUNT; op++) {
+        scenario_count += selected_ops[op] * size_count * level_count;
+    }
+    BenchResult* results = calloc((size_t)scenario_count, sizeof(BenchResult));
+    if (results == NULL) return 1;
+
+    int done = 0, flagged = 0, failed = 0;
+    for (int op = 0; op < OP_COUNT; op++) {
+        if (!selected_ops[op]) continue;
+        for (int s = 0; s < size_count; s++) {
+            for (int l = 0; l < level_count; l++) {
+                if (run_scenario((BenchOp)op, sizes[s], levels[l], &results[done]) != 0) {
+                    failed++;
+                    continue;
+                }
+                flagged += print_summary(&results[done], baseline);
+                done++;
+            }
+        }
+    }
+
+    FILE* out = output_path != NULL ? fopen(output_path, "w") : stdout;
+    if (out == NULL) {
+        fprintf(stderr, "cannot write %s: %s\n", output_path, strerror(errno));
+        return 1;
+    }
+    fprintf(out, "{\n  \"max_tasks\": %d,\n  \"cpus\": %ld,\n  \"results\": [\n",
+            MAX_TASKS, sysconf(_SC_NPROCESSORS_ONLN));
+    for (int i = 0; i < done; i++) {
+        write_result(out, &results[i], i == done - 1);
+    }
+    fprintf(out, "  ]\n}\n");
+    if (out != stdout) fclose(out);
+
+    if (baseline != NULL) {
+        fprintf(stderr, "%d of %d scenarios beyond %.0f%% slower than %s\n", flagged, done, threshold,
+                baseline_path);
+        fclose(baseline);
+    }
+    free(results);
+    return failed > 0 ? 1 : 0;
+}
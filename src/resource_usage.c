@@ -0,0 +1,62 @@
+#include "resource_usage.h"
+
+static unsigned long long timeval_us(const struct timeval* tv) {
+    return (unsigned long long)tv->tv_sec * 1000000ULL + (unsigned long long)tv->tv_usec;
+}
+
+static unsigned long long timespec_us(const struct timespec* ts) {
+    return (unsigned long long)ts->tv_sec * 1000000ULL + (unsigned long long)ts->tv_nsec / 1000ULL;
+}
+
+// Per-thread I/O accounting; absent without CONFIG_TASK_IO_ACCOUNTING
+static int read_thread_io(unsigned long long* rchar, unsigned long long* wchar, size_t* self_read) {
+    int fd = open("/proc/thread-self/io", O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return -1;
+
+    char buffer[512];
+    size_t total = 0;
+    ssize_t n;
+    while (total < sizeof(buffer) - 1 &&
+           (n = read(fd, buffer + total, sizeof(buffer) - 1 - total)) > 0) {
+        total += (size_t)n;
+    }
+    close(fd);
+    buffer[total] = '\0';
+
+    char* r = strstr(buffer, "rchar:");
+    char* w = strstr(buffer, "wchar:");
+    if (r == NULL || w == NULL) return -1;
+
+    *rchar = strtoull(r + 6, NULL, 10);
+    *wchar = strtoull(w + 6, NULL, 10);
+    *self_read = total;
+    return 0;
+}
+
+void usage_sample_thread(UsageSample* sample, int with_io) {
+    memset(sample, 0, sizeof(*sample));
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &sample->cpu);
+    getrusage(RUSAGE_THREAD, &sample->ru);
+    if (with_io) {
+        sample->has_io = read_thread_io(&sample->rchar, &sample->wchar, &sample->self_read) == 0;
+    }
+}
+
+void usage_accumulate(TaskUsage* usage, const UsageSample* start, const UsageSample* end) {
+    usage->cpu_time_us += timespec_us(&end->cpu) - timespec_us(&start->cpu);
+    usage->cpu_user_us += timeval_us(&end->ru.ru_utime) - timeval_us(&start->ru.ru_utime);
+    usage->cpu_system_us += timeval_us(&end->ru.ru_stime) - timeval_us(&start->ru.ru_stime);
+    usage->voluntary_ctx_switches += end->ru.ru_nvcsw - start->ru.ru_nvcsw;
+    usage->involuntary_ctx_switches += end->ru.ru_nivcsw - start->ru.ru_nivcsw;
+
+    // Linux reports the process-wide high-water mark even for RUSAGE_THREAD
+    if (end->ru.ru_maxrss > usage->max_rss_kb) {
+        usage->max_rss_kb = end->ru.ru_maxrss;
+    }
+
+    if (start->has_io && end->has_io) {
+        // The start sample's own read of the io file lands in the delta
+        usage->io_read_bytes += end->rchar - start->rchar - start->self_read;
+        usage->io_write_bytes += end->wchar - start->wchar;
+    }
+}
@@ -0,0 +1,25 @@
+#ifndef RESOURCE_USAGE_H
+#define RESOURCE_USAGE_H
+
+#include "common.h"
+#include "task_queue.h"
+#include <sys/resource.h>
+
+// Point-in-time view of the calling thread's resource counters. A task's
+// usage is the difference between a sample taken before and after it ran.
+typedef struct {
+    struct timespec cpu;            // CLOCK_THREAD_CPUTIME_ID
+    struct rusage ru;               // RUSAGE_THREAD
+    unsigned long long rchar;
+    unsigned long long wchar;
+    size_t self_read;               // Bytes this sample read from /proc
+    int has_io;
+} UsageSample;
+
+// with_io also reads /proc/thread-self/io (one open/read/close)
+void usage_sample_thread(UsageSample* sample, int with_io);
+
+// Add the end - start delta to a task's running totals
+void usage_accumulate(TaskUsage* usage, const UsageSample* start, const UsageSample* end);
+
+#endif // RESOURCE_USAGE_H
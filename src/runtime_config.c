@@ -0,0 +1,179 @@
+#include "runtime_config.h"
+#include "task_queue.h"
+#include <ctype.h>
+#include <stddef.h>
+
+// Integer options, by config file name
+typedef struct {
+    const char* key;
+    size_t offset;
+} IntOption;
+
+static const IntOption int_options[] = {
+    {"workers",                offsetof(RuntimeConfig, workers)},
+    {"min_workers",            offsetof(RuntimeConfig, min_workers)},
+    {"max_workers",            offsetof(RuntimeConfig, max_workers)},
+    {"threads_per_worker",     offsetof(RuntimeConfig, threads_per_worker)},
+    {"cleanup_interval",       offsetof(RuntimeConfig, cleanup_interval)},
+    {"completed_task_max_age", offsetof(RuntimeConfig, completed_task_max_age)},
+};
+
+void runtime_config_defaults(RuntimeConfig* cfg, const char* queue) {
+    cfg->workers = NUM_WORKERS;
+    cfg->min_workers = 0;
+    cfg->max_workers = 0;
+    cfg->threads_per_worker = MAX_THREADS_PER_WORKER;
+    cfg->sched_policy = DEFAULT_SCHED_POLICY;
+    cfg->cleanup_interval = CLEANUP_INTERVAL;
+    cfg->completed_task_max_age = COMPLETED_TASK_MAX_AGE;
+    cfg->shm_key = queue_shm_key_for(queue);
+    if (strcmp(queue, DEFAULT_QUEUE_NAME) == 0 && getenv(SHM_KEY_ENV) != NULL) {
+        cfg->shm_key = queue_shm_key();  // Exported override, as workers see it
+    }
+}
+
+int runtime_config_set(RuntimeConfig* cfg, const char* key, const char* value,
+                       char* err, size_t err_size) {
+    if (strcmp(key, "sched_policy") == 0) {
+        if (parse_sched_policy(value, &cfg->sched_policy) != 0) {
+            snprintf(err, err_size, "sched_policy must be priority or fifo, not '%s'", value);
+            return -1;
+        }
+        return 0;
+    }
+
+    if (strcmp(key, "shm_key") == 0) {
+        char* end;
+        errno = 0;
+        unsigned long key_value = strtoul(value, &end, 0);
+        if (errno != 0 || end == value || *end != '\0' || key_value == 0) {
+            snprintf(err, err_size, "shm_key must be a non-zero number, not '%s'", value);
+            return -1;
+        }
+        cfg->shm_key = (key_t)key_value;
+        return 0;
+    }
+
+    for (size_t i = 0; i < sizeof(int_options) / sizeof(int_options[0]); i++) {
+        if (strcmp(key, int_options[i].key) != 0) continue;
+
+        char* end;
+        errno = 0;
+        long number = strtol(value, &end, 10);
+        if (errno != 0 || end == value || *end != '\0' || number < 0 || number > 1000000) {
+            snprintf(err, err_size, "%s must be a number from 0 to 1000000, not '%s'", key, value);
+            return -1;
+        }
+        *(int*)((char*)cfg + int_options[i].offset) = (int)number;
+        return 0;
+    }
+
+    snprintf(err, err_size, "unknown option '%s'", key);
+    return -1;
+}
+
+static char* trim(char* s) {
+    while (isspace((unsigned char)*s)) s++;
+    char* end = s + strlen(s);
+    while (end > s && isspace((unsigned char)end[-1])) end--;
+    *end = '\0';
+    return s;
+}
+
+// "[queue NAME]" -> NAME, or NULL if text isn't a valid section header
+static const char* parse_section(char* text) {
+    size_t len = strlen(text);
+    if (len < 2 || text[0] != '[' || text[len - 1] != ']') return NULL;
+    text[len - 1] = '\0';
+    char* inner = trim(text + 1);
+    if (strncmp(inner, "queue", 5) != 0 || !isspace((unsigned char)inner[5])) return NULL;
+    char* name = trim(inner + 5);
+    return queue_name_valid(name) ? name : NULL;
+}
+
+int runtime_config_load(RuntimeConfig* cfg, const char* path, int required,
+                        const char* queue, char* err, size_t err_size) {
+    FILE* file = fopen(path, "r");
+    if (file == NULL) {
+        if (errno == ENOENT && !required) return 0;
+        snprintf(err, err_size, "%s: %s", path, strerror(errno));
+        return -1;
+    }
+
+    // Another queue's settings land here, so they are still validated
+    RuntimeConfig other = *cfg;
+    RuntimeConfig* target = cfg;
+
+    char line[512];
+    int line_no = 0;
+    while (fgets(line, sizeof(line), file) != NULL) {
+        line_no++;
+        char* comment = strchr(line, '#');
+        if (comment != NULL) *comment = '\0';
+
+        char* text = trim(line);
+        if (*text == '\0') continue;
+
+        if (*text == '[') {
+            const char* section = parse_section(text);
+            if (section == NULL) {
+                snprintf(err, err_size, "%s:%d: expected [queue NAME]", path, line_no);
+                fclose(file);
+                return -1;
+            }
+            target = strcmp(section, queue) == 0 ? cfg : &other;
+            continue;
+        }
+
+        char* eq = strchr(text, '=');
+        if (eq == NULL) {
+            snprintf(err, err_size, "%s:%d: expected key = value", path, line_no);
+            fclose(file);
+            return -1;
+        }
+        *eq = '\0';
+
+        char reason[256];
+        if (runtime_config_set(target, trim(text), trim(eq + 1), reason, sizeof(reason)) != 0) {
+            snprintf(err, err_size, "%s:%d: %s", path, line_no, reason);
+            fclose(file);
+            return -1;
+        }
+    }
+
+    fclose(file);
+    return 0;
+}
+
+int runtime_config_resolve(RuntimeConfig* cfg, char* err, size_t err_size) {
+    if (cfg->workers < 1) {
+        snprintf(err, err_size, "workers must be at least 1");
+        return -1;
+    }
+
+    if (cfg->min_workers == 0 && cfg->max_workers == 0) {
+        cfg->min_workers = cfg->max_workers = cfg->workers;
+    } else if (cfg->max_workers == 0) {
+        cfg->max_workers = cfg->workers > cfg->min_workers ? cfg->workers : cfg->min_workers;
+    } else if (cfg->min_workers == 0) {
+        cfg->min_workers = cfg->workers < cfg->max_workers ? cfg->workers : cfg->max_workers;
+    }
+    // One worker id stays spare for the replacement during a rolling restart
+    if (cfg->min_workers < 1 || cfg->min_workers > cfg->max_workers ||
+        cfg->max_workers > MAX_WORKERS - 1) {
+        snprintf(err, err_size, "need 1 <= min_workers <= max_workers <= %d", MAX_WORKERS - 1);
+        return -1;
+    }
+    if (cfg->workers < cfg->min_workers) cfg->workers = cfg->min_workers;
+    if (cfg->workers > cfg->max_workers) cfg->workers = cfg->max_workers;
+
+    if (cfg->threads_per_worker < 1) {
+        snprintf(err, err_size, "threads_per_worker must be at least 1");
+        return -1;
+    }
+    if (cfg->cleanup_interval < 1) {
+        snprintf(err, err_size, "cleanup_interval must be at least 1 second");
+        return -1;
+    }
+    return 0;
+}
@@ -0,0 +1,40 @@
+#ifndef RUNTIME_CONFIG_H
+#define RUNTIME_CONFIG_H
+
+#include "common.h"
+
+// Scheduler settings that can change without a rebuild. Built from the
+// config.h defaults, then the config file, then command-line overrides;
+// SIGHUP rebuilds it the same way and the scheduler applies the difference.
+typedef struct {
+    int workers;                // Initial pool size
+    int min_workers;            // 0 = derived from workers by runtime_config_resolve
+    int max_workers;
+    int threads_per_worker;
+    SchedPolicy sched_policy;
+    int cleanup_interval;
+    int completed_task_max_age;
+    key_t shm_key;              // Read at startup only
+} RuntimeConfig;
+
+// Defaults for the named queue (its shm_key is derived from the name)
+void runtime_config_defaults(RuntimeConfig* cfg, const char* queue);
+
+// Set one option by its config file name (e.g. "threads_per_worker").
+// Returns 0, or -1 with the reason in err.
+int runtime_config_set(RuntimeConfig* cfg, const char* key, const char* value,
+                       char* err, size_t err_size);
+
+// Apply a file of "key = value" lines; '#' starts a comment. Lines after a
+// "[queue NAME]" header only apply to that queue (the others are still
+// checked); lines before the first header apply to every queue. A missing
+// file is only an error when required is set. Returns 0, or -1 with
+// "path:line: reason" in err (cfg may be partly updated then).
+int runtime_config_load(RuntimeConfig* cfg, const char* path, int required,
+                        const char* queue, char* err, size_t err_size);
+
+// Derive unset pool bounds and range-check everything. Giving only one
+// bound stretches the other to fit it. Returns 0, or -1 with err set.
+int runtime_config_resolve(RuntimeConfig* cfg, char* err, size_t err_size);
+
+#endif // RUNTIME_CONFIG_H
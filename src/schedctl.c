@@ -0,0 +1,557 @@
+#include "common.h"
+#include "task_queue.h"
+#include "worker_stats.h"
+#include "submit_client.h"
+#include <getopt.h>
+#include <sys/ioctl.h>
+
+// schedctl: submit, cancel and inspect tasks without the shell helpers.
+// Submissions go over the scheduler's socket; everything else reads the
+// shared segment through lock-free snapshots.
+
+// Tasks submitted but not yet acknowledged, as input line numbers
+#define INFLIGHT_RING ((SUBMIT_WINDOW + 2) * SUBMIT_MAX_BATCH)
+
+static QueueSnapshot snapshot;
+
+static void print_usage(const char* prog) {
+    fprintf(stderr, "Usage: %s [-q QUEUE] <command> [options]\n", prog);
+    fprintf(stderr, "  -q QUEUE                  Named queue to act on (default $%s, else %s)\n",
+            QUEUE_NAME_ENV, DEFAULT_QUEUE_NAME);
+    fprintf(stderr, "Commands:\n");
+    fprintf(stderr, "  submit NAME PRIORITY DURATION_MS [TIMEOUT_MS [MAX_RETRIES]]\n");
+    fprintf(stderr, "  submit -f FILE            One task per line (- = stdin):\n");
+    fprintf(stderr, "                            name,priority,duration_ms[,timeout_ms[,max_retries]]\n");
+    fprintf(stderr, "  cancel ID...              Cancel tasks (running ones are stopped)\n");
+    fprintf(stderr, "  status [-t]               Queue and worker summary; -t lists every task\n");
+    fprintf(stderr, "  watch [-n SECONDS]        Full-screen view, refreshed every %d s by default\n",
+            MONITOR_REFRESH_INTERVAL);
+    fprintf(stderr, "  report [-o FILE]          CSV of every task (default stdout)\n");
+    fprintf(stderr, "  info                      The queue's shared memory key and socket path\n");
+    fprintf(stderr, "Environment: %s and %s override the queue's key and socket.\n",
+            SHM_KEY_ENV, SUBMIT_SOCKET_ENV);
+}
+
+static TaskQueue* attach_queue(void) {
+    TaskQueue* queue = attach_shared_memory(-1);
+    if (queue == NULL) {
+        fprintf(stderr, "schedctl: no queue %s at key 0x%x (is the scheduler running?)\n",
+                queue_name(), (unsigned)queue_shm_key());
+    }
+    return queue;
+}
+
+static int parse_uint(const char* str, unsigned int* value) {
+    char* end;
+    errno = 0;
+    unsigned long number = strtoul(str, &end, 10);
+    if (errno != 0 || end == str || *end != '\0' || number > 0xffffffffUL || *str == '-') {
+        return -1;
+    }
+    *value = (unsigned int)number;
+    return 0;
+}
+
+// ---- submit ----
+
+typedef struct {
+    int ring[INFLIGHT_RING];    // Line number of each in-flight task
+    unsigned long queued;       // Tasks handed to the client
+    unsigned long acked;
+    unsigned long added;
+    unsigned long full;
+    unsigned long invalid;
+    int first_id;
+    int last_id;
+    int single;                 // One task from the command line: print its id
+} SubmitState;
+
+static void on_submit_ack(void* arg, uint32_t seq, const int32_t* results, int count) {
+    SubmitState* state = arg;
+    (void)seq;
+
+    for (int i = 0; i < count; i++) {
+        int line = state->ring[state->acked++ % INFLIGHT_RING];
+        if (results[i] > 0) {
+            state->added++;
+            if (state->first_id == 0) state->first_id = results[i];
+            state->last_id = results[i];
+            if (state->single) printf("Task added successfully. ID: %d\n", results[i]);
+        } else if (results[i] == SUBMIT_ERR_FULL) {
+            state->full++;
+            if (state->single) fprintf(stderr, "Error: Failed to add task (queue is full)\n");
+        } else {
+            state->invalid++;
+            fprintf(stderr, "line %d: rejected by the scheduler\n", line);
+        }
+    }
+}
+
+// Split "name,priority,duration_ms[,timeout_ms[,max_retries]]" in place
+static int parse_task_line(char* line, char** name, Priority* priority,
+                           unsigned int* duration, TaskOptions* options) {
+    char* fields[5];
+    int count = 0;
+    char* save = NULL;
+    for (char* field = strtok_r(line, ",", &save); field != NULL && count < 5;
+         field = strtok_r(NULL, ",", &save)) {
+        fields[count++] = field;
+    }
+    if (count < 3 || strtok_r(NULL, ",", &save) != NULL) return -1;
+
+    memset(options, 0, sizeof(*options));
+    *name = fields[0];
+    if (parse_priority(fields[1], priority) != 0) return -1;
+    if (parse_uint(fields[2], duration) != 0 || *duration == 0) return -1;
+    if (count > 3 && parse_uint(fields[3], &options->timeout_ms) != 0) return -1;
+    if (count > 4 && parse_uint(fields[4], &options->max_retries) != 0) return -1;
+    return 0;
+}
+
+static int add_task(SubmitClient* client, SubmitState* state, int line, const char* name,
+                    Priority priority, unsigned int duration, const TaskOptions* options) {
+    // Record the line first: the add may flush and read ACKs
+    state->ring[state->queued % INFLIGHT_RING] = line;
+    if (submit_client_add(client, name, priority, duration, options) == 0) {
+        state->queued++;
+        return 0;
+    }
+    if (errno == EINVAL) {
+        state->invalid++;
+        fprintf(stderr, "line %d: invalid task name\n", line);
+        return 0;
+    }
+    perror("schedctl: submit failed");
+    return -1;
+}
+
+static int submit_file(SubmitClient* client, SubmitState* state, const char* path) {
+    FILE* in = strcmp(path, "-") == 0 ? stdin : fopen(path, "r");
+    if (in == NULL) {
+        fprintf(stderr, "schedctl: %s: %s\n", path, strerror(errno));
+        return -1;
+    }
+
+    char* line = NULL;
+    size_t cap = 0;
+    ssize_t len;
+    int line_no = 0;
+    int rc = 0;
+    while ((len = getline(&line, &cap, in)) >= 0) {
+        line_no++;
+        while (len > 0 && (line[len - 1] == '\n' || line[len - 1] == '\r')) line[--len] = '\0';
+        if (len == 0 || line[0] == '#') continue;
+
+        char* name;
+        Priority priority;
+        unsigned int duration;
+        TaskOptions options;
+        if (parse_task_line(line, &name, &priority, &duration, &options) != 0) {
+            state->invalid++;
+            fprintf(stderr, "line %d: expected name,priority,duration_ms[,timeout_ms[,max_retries]]\n",
+                    line_no);
+            continue;
+        }
+        if (add_task(client, state, line_no, name, priority, duration, &options) != 0) {
+            rc = -1;
+            break;
+        }
+    }
+
+    free(line);
+    if (in != stdin) fclose(in);
+    return rc;
+}
+
+static int cmd_submit(int argc, char* argv[]) {
+    const char* file = NULL;
+    int opt;
+    optind = 1;
+    while ((opt = getopt(argc, argv, "+f:")) != -1) {
+        if (opt != 'f') return 2;
+        file = optarg;
+    }
+
+    int positional = argc - optind;
+    if ((file == NULL && (positional < 3 || positional > 5)) || (file != NULL && positional != 0)) {
+        return 2;
+    }
+
+    SubmitState* state = calloc(1, sizeof(SubmitState));
+    if (state == NULL) return 1;
+
+    SubmitClient client;
+    if (submit_client_open(&client, NULL, on_submit_ack, state) != 0) {
+        perror("schedctl: cannot connect to the submission socket");
+        free(state);
+        return 1;
+    }
+
+    int rc = 0;
+    if (file != NULL) {
+        rc = submit_file(&client, state, file);
+    } else {
+        char** args = argv + optind;
+        Priority priority;
+        unsigned int duration;
+        TaskOptions options;
+        memset(&options, 0, sizeof(options));
+        if (parse_priority(args[1], &priority) != 0) {
+            fprintf(stderr, "Error: Priority must be HIGH, MEDIUM, or LOW\n");
+            rc = -1;
+        } else if (parse_uint(args[2], &duration) != 0 || duration == 0) {
+            fprintf(stderr, "Error: Duration must be a positive integer\n");
+            rc = -1;
+        } else if ((positional > 3 && parse_uint(args[3], &options.timeout_ms) != 0) ||
+                   (positional > 4 && parse_uint(args[4], &options.max_retries) != 0)) {
+            fprintf(stderr, "Error: Timeout and max retries must be non-negative integers\n");
+            rc = -1;
+        } else {
+            state->single = 1;
+            rc = add_task(&client, state, 1, args[0], priority, duration, &options);
+        }
+    }
+
+    if (rc == 0 && submit_client_wait(&client) != 0) {
+        perror("schedctl: submit failed");
+        rc = -1;
+    }
+    submit_client_close(&client);
+
+    if (file != NULL) {
+        printf("%lu added", state->added);
+        if (state->added > 0) printf(" (ids %d-%d)", state->first_id, state->last_id);
+        printf(", %lu rejected (queue full), %lu invalid\n", state->full, state->invalid);
+    }
+    int failed = rc != 0 || state->full > 0 || state->invalid > 0;
+    free(state);
+    return failed ? 1 : 0;
+}
+
+// ---- cancel ----
+
+static int cmd_cancel(int argc, char* argv[]) {
+    if (argc < 2) return 2;
+
+    TaskQueue* queue = attach_queue();
+    if (queue == NULL) return 1;
+
+    int failed = 0;
+    for (int i = 1; i < argc; i++) {
+        unsigned int id;
+        if (parse_uint(argv[i], &id) != 0 || id == 0) {
+            fprintf(stderr, "Invalid task id: %s\n", argv[i]);
+            failed = 1;
+            continue;
+        }
+        switch (cancel_task(queue, (int)id)) {
+            case 0:  printf("Task %u cancelled\n", id); break;
+            case 1:  printf("Task %u is running; its worker will stop it\n", id); break;
+            case -2: fprintf(stderr, "Task %u already finished\n", id); failed = 1; break;
+            default: fprintf(stderr, "Task %u not found\n", id); failed = 1; break;
+        }
+    }
+
+    detach_shared_memory(queue);
+    return failed;
+}
+
+// ---- status / watch ----
+
+typedef struct {
+    int by_status[STATUS_FORWARDED + 1];
+} StatusCounts;
+
+static void count_statuses(const QueueSnapshot* snap, StatusCounts* counts) {
+    memset(counts, 0, sizeof(*counts));
+    for (int i = 0; i < snap->size; i++) {
+        TaskStatus status = snap->tasks[i].status;
+        if (status >= 0 && status <= STATUS_FORWARDED) counts->by_status[status]++;
+    }
+}
+
+static void print_summary(FILE* out, TaskQueue* queue, const QueueSnapshot* snap) {
+    StatusCounts counts;
+    count_statuses(snap, &counts);
+
+    pid_t scheduler_pid = queue->scheduler_pid;
+    int alive = scheduler_pid > 0 && kill(scheduler_pid, 0) == 0;
+    fprintf(out, "Scheduler: PID %d (%s), pool %d-%d, %d threads per worker, policy %s\n",
+            (int)scheduler_pid, alive ? "running" : "not running",
+            snap->min_workers, snap->max_workers, snap->config.threads_per_worker,
+            sched_policy_to_string(snap->config.sched_policy));
+    fprintf(out, "Queue:     %s, %d/%d tasks | total %d, completed %d, failed %d\n",
+            queue->name[0] != '\0' ? queue->name : queue_name(),
+            snap->size, snap->capacity, snap->total_tasks,
+            snap->completed_tasks, snap->failed_tasks);
+    fprintf(out, "Now:       %d pending, %d running, %d retry wait, %d handoff, %d forwarded\n",
+            counts.by_status[STATUS_PENDING], counts.by_status[STATUS_RUNNING],
+            counts.by_status[STATUS_RETRY_WAIT], counts.by_status[STATUS_HANDOFF],
+            counts.by_status[STATUS_FORWARDED]);
+}
+
+// Returns how many workers it listed
+static int print_workers(FILE* out, TaskQueue* queue) {
+    time_t now = time(NULL);
+    int listed = 0;
+    fprintf(out, "\n  Worker    PID  State   Busy  Idle  Running  Completed  Failed\n");
+    for (int i = 0; i < MAX_WORKERS; i++) {
+        WorkerSlot slot;
+        worker_stats_read(&queue->workers[i], &slot);
+        if (slot.pid == 0) continue;
+        const char* state = !worker_stats_alive(&slot, now) ? "stale"
+                          : slot.drain_requested ? "drain" : "active";
+        fprintf(out, "  %6d %6d  %-6s %5d %5d %8d %10llu %7llu\n",
+                i, (int)slot.pid, state, slot.busy_threads, slot.idle_threads,
+                slot.inflight_tasks, slot.tasks_completed, slot.tasks_failed);
+        listed++;
+    }
+    return listed;
+}
+
+static void print_task_header(FILE* out) {
+    fprintf(out, "\n  %6s  %-24s %-6s  %-10s %6s %9s %8s\n",
+             "ID", "Name", "Prio", "Status", "Worker", "Duration", "Elapsed");
+}
+
+static void print_task_row(FILE* out, const Task* task, time_t now) {
+    char elapsed[16] = "-";
+    if (task->start_time > 0) {
+        time_t end = task->end_time > 0 ? task->end_time : now;
+        snprintf(elapsed, sizeof(elapsed), "%lds", (long)(end - task->start_time));
+    }
+    fprintf(out, "  %6d  %-24.24s %-6s  %-10s %6d %7ums %8s\n",
+            task->id, task->name, priority_to_string(task->priority),
+            status_to_string(task->status), task->worker_id, task->execution_time_ms, elapsed);
+}
+
+static int cmd_status(int argc, char* argv[]) {
+    int list_tasks = 0;
+    int opt;
+    optind = 1;
+    while ((opt = getopt(argc, argv, "t")) != -1) {
+        if (opt != 't') return 2;
+        list_tasks = 1;
+    }
+
+    TaskQueue* queue = attach_queue();
+    if (queue == NULL) return 1;
+    snapshot_queue(queue, &snapshot);
+
+    print_summary(stdout, queue, &snapshot);
+    print_workers(stdout, queue);
+    if (list_tasks && snapshot.size > 0) {
+        time_t now = time(NULL);
+        print_task_header(stdout);
+        for (int i = 0; i < snapshot.size; i++) {
+            print_task_row(stdout, &snapshot.tasks[i], now);
+        }
+    }
+
+    detach_shared_memory(queue);
+    return 0;
+}
+
+static int terminal_rows(void) {
+    struct winsize ws;
+    if (ioctl(STDOUT_FILENO, TIOCGWINSZ, &ws) == 0 && ws.ws_row > 0) return ws.ws_row;
+    return 24;
+}
+
+static int cmd_watch(int argc, char* argv[]) {
+    unsigned int interval = MONITOR_REFRESH_INTERVAL;
+    int opt;
+    optind = 1;
+    while ((opt = getopt(argc, argv, "n:")) != -1) {
+        if (opt != 'n' || parse_uint(optarg, &interval) != 0 || interval == 0) return 2;
+    }
+
+    TaskQueue* queue = attach_queue();
+    if (queue == NULL) return 1;
+
+    // Build each frame in memory and write it at once, so it doesn't flicker
+    char* screen = NULL;
+    size_t screen_size = 0;
+    for (;;) {
+        snapshot_queue(queue, &snapshot);
+        time_t now = time(NULL);
+
+        FILE* out = open_memstream(&screen, &screen_size);
+        if (out == NULL) break;
+        char clock[64];
+        format_timestamp(now, clock, sizeof(clock));
+        fprintf(out, "\033[H\033[2J%s   (every %us, Ctrl+C to quit)\n\n", clock, interval);
+        print_summary(out, queue, &snapshot);
+        int workers = print_workers(out, queue);
+
+        // Running tasks first, then the rest in queue order, as rows allow
+        int rows = terminal_rows() - 10 - workers;
+        if (rows > 0 && snapshot.size > 0) {
+            print_task_header(out);
+            for (int pass = 0; pass < 2 && rows > 0; pass++) {
+                for (int i = 0; i < snapshot.size && rows > 0; i++) {
+                    int running = snapshot.tasks[i].status == STATUS_RUNNING;
+                    if (running != (pass == 0)) continue;
+                    print_task_row(out, &snapshot.tasks[i], now);
+                    rows--;
+                }
+            }
+        }
+        fclose(out);
+
+        if (fwrite(screen, 1, screen_size, stdout) != screen_size || fflush(stdout) != 0) break;
+        sleep(interval);
+    }
+
+    free(screen);
+    detach_shared_memory(queue);
+    return 0;
+}
+
+// ---- report ----
+
+// Quoted CSV field, embedded quotes doubled
+static void write_csv_field(FILE* out, const char* s) {
+    fputc('"', out);
+    for (; *s != '\0'; s++) {
+        if (*s == '"') fputc('"', out);
+        fputc(*s, out);
+    }
+    fputc('"', out);
+}
+
+static int cmd_report(int argc, char* argv[]) {
+    const char* path = NULL;
+    int opt;
+    optind = 1;
+    while ((opt = getopt(argc, argv, "o:")) != -1) {
+        if (opt != 'o') return 2;
+        path = optarg;
+    }
+
+    TaskQueue* queue = attach_queue();
+    if (queue == NULL) return 1;
+    snapshot_queue(queue, &snapshot);
+    detach_shared_memory(queue);
+
+    FILE* out = path != NULL ? fopen(path, "w") : stdout;
+    if (out == NULL) {
+        fprintf(stderr, "schedctl: %s: %s\n", path, strerror(errno));
+        return 1;
+    }
+    setvbuf(out, NULL, _IOFBF, 1 << 20);
+
+    fprintf(out, "task_id,name,priority,status,creation_time,start_time,end_time,duration_ms,timeout_ms,"
+                 "attempts,max_retries,last_error,worker_id,"
+                 "cpu_us,cpu_user_us,cpu_system_us,max_rss_kb,voluntary_cs,involuntary_cs,"
+                 "io_read_bytes,io_write_bytes\n");
+
+    time_t now = time(NULL);
+    for (int i = 0; i < snapshot.size; i++) {
+        const Task* task = &snapshot.tasks[i];
+        char creation_time[64], start_time[64] = "", end_time[64] = "";
+        format_timestamp(task->creation_time, creation_time, sizeof(creation_time));
+        if (task->start_time > 0) format_timestamp(task->start_time, start_time, sizeof(start_time));
+        if (task->end_time > 0) format_timestamp(task->end_time, end_time, sizeof(end_time));
+
+        unsigned int duration = 0;
+        if (task->start_time > 0) {
+            time_t end = task->end_time > 0 ? task->end_time : now;
+            duration = (unsigned int)(end - task->start_time) * 1000;
+        }
+
+        fprintf(out, "%d,", task->id);
+        write_csv_field(out, task->name);
+        fprintf(out, ",%s,%s,%s,%s,%s,%u,%u,%u,%u,",
+                priority_to_string(task->priority), status_to_string(task->status),
+                creation_time, start_time, end_time,
+                duration, task->timeout_ms, task->attempts, task->max_retries);
+        write_csv_field(out, task->last_error);
+        fprintf(out, ",%d,%llu,%llu,%llu,%ld,%ld,%ld,%llu,%llu\n",
+                task->worker_id,
+                task->usage.cpu_time_us, task->usage.cpu_user_us, task->usage.cpu_system_us,
+                task->usage.max_rss_kb,
+                task->usage.voluntary_ctx_switches, task->usage.involuntary_ctx_switches,
+                task->usage.io_read_bytes, task->usage.io_write_bytes);
+    }
+
+    int failed = fflush(out) != 0;
+    if (out != stdout) failed |= fclose(out) != 0;
+    if (failed) {
+        perror("schedctl: writing report");
+        return 1;
+    }
+
+    StatusCounts counts;
+    count_statuses(&snapshot, &counts);
+    fprintf(stderr, "%d tasks: %d completed, %d failed, %d pending, %d running, %d waiting to retry "
+                    "(lifetime: %d total, %d completed, %d failed)\n",
+            snapshot.size, counts.by_status[STATUS_COMPLETED], counts.by_status[STATUS_FAILED],
+            counts.by_status[STATUS_PENDING], counts.by_status[STATUS_RUNNING],
+            counts.by_status[STATUS_RETRY_WAIT],
+            snapshot.total_tasks, snapshot.completed_tasks, snapshot.failed_tasks);
+    return 0;
+}
+
+// ---- info ----
+
+// Where this queue lives; works without a scheduler (cleanup.sh uses it)
+static int cmd_info(int argc, char* argv[]) {
+    (void)argv;
+    if (argc != 1) return 2;
+
+    char socket_path[108];
+    const char* env = getenv(SUBMIT_SOCKET_ENV);
+    if (env != NULL && *env != '\0') {
+        snprintf(socket_path, sizeof(socket_path), "%s", env);
+    } else {
+        submit_socket_path_for(queue_name(), socket_path, sizeof(socket_path));
+    }
+    printf("queue %s\nshm_key 0x%x\nsocket %s\n",
+           queue_name(), (unsigned)queue_shm_key(), socket_path);
+    return 0;
+}
+
+int main(int argc, char* argv[]) {
+    static const struct {
+        const char* name;
+        int (*run)(int argc, char* argv[]);
+    } commands[] = {
+        {"submit", cmd_submit},
+        {"cancel", cmd_cancel},
+        {"status", cmd_status},
+        {"watch",  cmd_watch},
+        {"report", cmd_report},
+        {"info",   cmd_info},
+    };
+    const char* prog = argv[0];
+
+    // The queue is passed on through the environment, which is where
+    // queue_shm_key() and the submission client look for it
+    if (argc >= 3 && strcmp(argv[1], "-q") == 0) {
+        if (!queue_name_valid(argv[2])) {
+            fprintf(stderr, "Invalid queue name: %s\n", argv[2]);
+            return 2;
+        }
+        setenv(QUEUE_NAME_ENV, argv[2], 1);
+        argc -= 2;
+        argv += 2;
+    }
+
+    if (argc < 2 || strcmp(argv[1], "-h") == 0 || strcmp(argv[1], "--help") == 0) {
+        print_usage(prog);
+        return argc < 2 ? 2 : 0;
+    }
+
+    for (size_t i = 0; i < sizeof(commands) / sizeof(commands[0]); i++) {
+        if (strcmp(argv[1], commands[i].name) == 0) {
+            int rc = commands[i].run(argc - 1, argv + 1);
+            if (rc == 2) print_usage(prog);
+            return rc;
+        }
+    }
+
+    fprintf(stderr, "Unknown command: %s\n", argv[1]);
+    print_usage(prog);
+    return 2;
+}
@@ -1,188 +1,1218 @@
 #include "common.h"
 #include "task_queue.h"
 #include "logger.h"
+#include "affinity.h"
+#include "worker_stats.h"
+#include "runtime_config.h"
+#include "federation.h"
+#include "submit_server.h"
+#include "submit_proto.h"
+#include "trace.h"
 #include <sys/wait.h>
+#include <sys/epoll.h>
+#include <sys/signalfd.h>
+#include <sys/timerfd.h>
+#include <sys/syscall.h>
+#include <getopt.h>
 
-static TaskQueue* queue = NULL;
-static int shm_id = -1;
-static pid_t worker_pids[NUM_WORKERS];
-static int num_workers_running = 0;
+// Worker ids are slots in queue->workers; a drained id is free for reuse
+typedef enum {
+    WORKER_FREE = 0,
+    WORKER_RUNNING,
+    WORKER_DRAINING        // Asked to finish its tasks and exit; not respawned
+} WorkerState;
+
+// One supervised queue: its segment, live settings, worker pool and the
+// threads serving it. Queues share nothing but the supervisor loop, so
+// traffic on one never contends with another's queue_mutex.
+typedef struct {
+    char name[MAX_QUEUE_NAME_LEN];
+    TaskQueue* queue;
+    int shm_id;
+    RuntimeConfig config;
+    char shm_key_str[16];           // Its workers' SHM_KEY_ENV
+    
+    pid_t worker_pids[MAX_WORKERS];
+    WorkerState worker_states[MAX_WORKERS];
+    int worker_pidfds[MAX_WORKERS];
+    
+    // Rolling restart (SIGUSR2): every worker started before the request is
+    // replaced by a fresh exec of ./worker, one at a time. The replacement is
+    // started and attached before the old worker drains, so capacity never dips.
+    int restart_requested;
+    int worker_generation[MAX_WORKERS];
+    int current_generation;
+    int restart_active;
+    int restart_old_id;             // Worker being replaced
+    int restart_new_id;             // Its replacement, until it attaches
+    time_t restart_spawned_at;
+    
+    // Autoscaling streaks and the last pool change (see autoscale)
+    int up_ticks;
+    int down_ticks;
+    time_t last_change;
+    time_t last_cleanup;
+    
+    char socket_path[108];          // sizeof(sun_path)
+    SubmitServer* submit;
+    pthread_t retry_thread;
+    int retry_thread_started;
+} QueueInstance;
+
+static QueueInstance instances[MAX_QUEUES];
+static int instance_count = 0;
 static volatile int shutdown_requested = 0;
 
-void signal_handler(int sig) {
-    if (sig == SIGINT || sig == SIGTERM) {
-        shutdown_requested = 1;
-        LOG_INFO_F("Shutdown signal received");
-        
-        if (queue != NULL) {
-            queue->shutdown_flag = 1;
-            pthread_cond_broadcast(&queue->queue_cond);
-        }
+// Live configuration. Command-line settings are kept as overrides so a
+// SIGHUP reload applies them again on top of the re-read file.
+#define MAX_CONFIG_OVERRIDES 16
+static const char* config_path = CONFIG_FILE;
+static int config_path_required = 0;      // Given with --config, so it must exist
+static const char* config_overrides[MAX_CONFIG_OVERRIDES][2];
+static int config_override_count = 0;
+
+// Supervisor loop: one epoll set watching a pidfd per worker of every
+// queue, a signalfd for the signals we act on and a timerfd for periodic
+// maintenance. Worker exits are handled the moment they happen and an idle
+// pool costs nothing.
+#define SUPERVISOR_WORKER_TAG(q, id) ((uint32_t)((q) * MAX_WORKERS + (id)))
+#define SUPERVISOR_SIGNAL_TAG  (MAX_QUEUES * MAX_WORKERS + 1)
+#define SUPERVISOR_TIMER_TAG   (MAX_QUEUES * MAX_WORKERS + 2)
+static int epoll_fd = -1;
+static int signal_fd = -1;
+static int timer_fd = -1;
+static int pidfd_supported = 0;     // Otherwise SIGCHLD through the signalfd
+static sigset_t supervisor_signals;
+static int timer_interval = 0;
+
+static ExecMode worker_exec_mode = EXEC_MODE_THREAD;
+
+// Federation (all optional; without --listen or --peer the node stands alone)
+static int federation_port = 0;
+static const char* federation_listen_address = FEDERATION_LISTEN_ADDRESS;
+static const char* federation_peers[MAX_PEERS];
+static int federation_peer_count = 0;
+static char federation_node_name[MAX_PEER_NAME_LEN] = "";
+static int federation_gone_timeout = FEDERATION_PEER_GONE_TIMEOUT;
+static const char* pid_file_path = PID_FILE;
+
+// First queue's submission socket; NULL = $SUBMIT_SOCKET_ENV, else the
+// queue's default (every other queue always uses its default)
+static const char* submit_socket_path = NULL;
+
+// Worker placement (all optional; by default workers float freely)
+static int pin_workers = 0;
+static cpu_set_t worker_cpus;
+static int pin_worker_threads = 0;
+static char isolated_cpus_arg[256] = "";
+
+static int pidfd_open(pid_t pid) {
+#ifdef SYS_pidfd_open
+    return (int)syscall(SYS_pidfd_open, pid, 0);
+#else
+    (void)pid;
+    errno = ENOSYS;
+    return -1;
+#endif
+}
+
+// Tell every process attached to our queues that we are going down
+static void request_shutdown(void) {
+    shutdown_requested = 1;
+    for (int q = 0; q < instance_count; q++) {
+        TaskQueue* queue = instances[q].queue;
+        if (queue == NULL) continue;
+        lock_queue(queue);
+        queue->shutdown_flag = 1;
+        pthread_cond_broadcast(&queue->queue_cond);
+        pthread_cond_broadcast(&queue->retry_cond);
+        unlock_queue(queue);
     }
 }
 
 void cleanup_resources(void) {
     LOG_INFO_F("Cleaning up resources...");
     
-    // Wait for workers to finish
-    for (int i = 0; i < num_workers_running; i++) {
-        if (worker_pids[i] > 0) {
-            LOG_INFO_F("Waiting for worker %d (PID: %d)", i, worker_pids[i]);
-            kill(worker_pids[i], SIGTERM);
-            waitpid(worker_pids[i], NULL, 0);
+    // Workers drain on SIGTERM: they stop claiming, then finish or hand back
+    // what they hold. Only one that overruns its drain is killed.
+    for (int q = 0; q < instance_count; q++) {
+        for (int i = 0; i < MAX_WORKERS; i++) {
+            if (instances[q].worker_pids[i] > 0) {
+                kill(instances[q].worker_pids[i], SIGTERM);
+            }
+        }
+    }
+    time_t deadline = time(NULL) + WORKER_DRAIN_TIMEOUT + 5;
+    for (int q = 0; q < instance_count; q++) {
+        QueueInstance* inst = &instances[q];
+        for (int i = 0; i < MAX_WORKERS; i++) {
+            pid_t pid = inst->worker_pids[i];
+            if (pid <= 0) continue;
+            
+            LOG_INFO_F("Queue %s: Waiting for worker %d (PID: %d)", inst->name, i, pid);
+            while (waitpid(pid, NULL, WNOHANG) == 0 && time(NULL) < deadline) {
+                usleep(100000);
+            }
+            if (kill(pid, 0) == 0) {
+                LOG_WARN_F("Queue %s: Worker %d (PID: %d) did not drain in time, killing it",
+                           inst->name, i, pid);
+                kill(pid, SIGKILL);
+                waitpid(pid, NULL, 0);
+                if (inst->queue != NULL) {
+                    requeue_worker_tasks(inst->queue, i);
+                }
+            }
+            inst->worker_pids[i] = 0;
         }
     }
     
-    // Set shutdown flag
-    if (queue != NULL) {
+    for (int q = 0; q < instance_count; q++) {
+        TaskQueue* queue = instances[q].queue;
+        if (queue == NULL) continue;
+        
+        // Set shutdown flag
         queue->shutdown_flag = 1;
         pthread_cond_broadcast(&queue->queue_cond);
-    }
-    
-    // Detach shared memory
-    if (queue != NULL) {
+        
+        // Detach shared memory (kept, not destroyed, so it can still be inspected)
         detach_shared_memory(queue);
-        queue = NULL;
+        instances[q].queue = NULL;
     }
     
-    // Destroy shared memory (optional - might want to keep it for monitoring)
-    // destroy_shared_memory(shm_id);
-    
     close_logger();
 }
 
-int spawn_worker(int worker_id) {
+int spawn_worker(QueueInstance* inst, int worker_id) {
     pid_t pid = fork();
     
     if (pid < 0) {
-        LOG_ERROR_F("Failed to fork worker %d: %s", worker_id, strerror(errno));
+        LOG_ERROR_F("Queue %s: Failed to fork worker %d: %s", inst->name, worker_id, strerror(errno));
         return -1;
     } else if (pid == 0) {
-        // Child process - exec worker
+        // Child process - exec worker. The blocked mask survives exec, so
+        // undo what the supervisor blocked for its signalfd.
+        sigprocmask(SIG_UNBLOCK, &supervisor_signals, NULL);
         char worker_id_str[16];
         snprintf(worker_id_str, sizeof(worker_id_str), "%d", worker_id);
         
-        execl("./worker", "worker", worker_id_str, NULL);
-        // If execl fails
+        // The worker attaches to this queue's segment
+        setenv(SHM_KEY_ENV, inst->shm_key_str, 1);
+        setenv(QUEUE_NAME_ENV, inst->name, 1);
+        
+        // Affinity is inherited across exec; isolated CPUs must be part of
+        // the process mask so HIGH-priority threads can move onto them
+        if (pin_workers && sched_setaffinity(0, sizeof(worker_cpus), &worker_cpus) != 0) {
+            LOG_WARN_F("Failed to set CPU affinity for worker %d: %s", worker_id, strerror(errno));
+        }
+        
+        char* worker_argv[8];
+        int n = 0;
+        worker_argv[n++] = "worker";
+        worker_argv[n++] = worker_id_str;
+        worker_argv[n++] = (char*)exec_mode_to_string(worker_exec_mode);
+        if (pin_worker_threads) {
+            worker_argv[n++] = "--pin-threads";
+        }
+        if (isolated_cpus_arg[0] != '\0') {
+            worker_argv[n++] = "--isolated-cpus";
+            worker_argv[n++] = isolated_cpus_arg;
+        }
+        worker_argv[n] = NULL;
+        
+        execv("./worker", worker_argv);
+        // _exit, not exit: the supervisor's atexit cleanup must not run in
+        // this child, or a missing binary would shut down the whole pool
         LOG_ERROR_F("Failed to exec worker: %s", strerror(errno));
-        exit(1);
+        _exit(127);
     } else {
         // Parent process
-        worker_pids[worker_id] = pid;
-        LOG_INFO_F("Spawned worker %d with PID %d", worker_id, pid);
+        inst->worker_pids[worker_id] = pid;
+        inst->worker_states[worker_id] = WORKER_RUNNING;
+        inst->worker_generation[worker_id] = inst->current_generation;
+        
+        if (pidfd_supported) {
+            inst->worker_pidfds[worker_id] = pidfd_open(pid);
+            struct epoll_event ev;
+            ev.events = EPOLLIN;
+            ev.data.u32 = SUPERVISOR_WORKER_TAG(inst - instances, worker_id);
+            if (inst->worker_pidfds[worker_id] < 0 ||
+                epoll_ctl(epoll_fd, EPOLL_CTL_ADD, inst->worker_pidfds[worker_id], &ev) != 0) {
+                // Reaping would wait for the next maintenance tick; say so
+                LOG_WARN_F("Queue %s: Failed to watch worker %d through a pidfd: %s",
+                           inst->name, worker_id, strerror(errno));
+            }
+        }
+        
+        LOG_INFO_F("Queue %s: Spawned worker %d with PID %d", inst->name, worker_id, pid);
         return 0;
     }
 }
 
-void monitor_workers(void) {
-    time_t last_cleanup = time(NULL);
+// Workers that are running and not draining
+static int count_live_workers(const QueueInstance* inst) {
+    int live = 0;
+    for (int i = 0; i < MAX_WORKERS; i++) {
+        if (inst->worker_states[i] == WORKER_RUNNING) live++;
+    }
+    return live;
+}
+
+// Collect exited workers of every queue. A drained worker frees its id;
+// anything else died unexpectedly and is respawned under the same id.
+static void reap_workers(void) {
+    int status;
+    pid_t pid;
     
-    while (!shutdown_requested) {
-        sleep(WORKER_CHECK_INTERVAL);
-        
-        // Check if any workers have died
-        for (int i = 0; i < num_workers_running; i++) {
-            if (worker_pids[i] > 0) {
-                int status;
-                pid_t result = waitpid(worker_pids[i], &status, WNOHANG);
-                
-                if (result > 0) {
-                    LOG_WARN_F("Worker %d (PID: %d) exited with status %d", 
-                              i, worker_pids[i], WEXITSTATUS(status));
-                    // Try to respawn
-                    worker_pids[i] = 0;
-                    if (spawn_worker(i) == 0) {
-                        LOG_INFO_F("Respawned worker %d", i);
-                    }
+    while ((pid = waitpid(-1, &status, WNOHANG)) > 0) {
+        QueueInstance* inst = NULL;
+        int id = -1;
+        for (int q = 0; q < instance_count && id < 0; q++) {
+            for (int i = 0; i < MAX_WORKERS; i++) {
+                if (instances[q].worker_pids[i] == pid) {
+                    inst = &instances[q];
+                    id = i;
+                    break;
                 }
             }
         }
+        if (id < 0) continue;
         
-        // Update worker count in shared memory
-        if (queue != NULL) {
-            pthread_mutex_lock(&queue->queue_mutex);
-            int active = 0;
-            for (int i = 0; i < num_workers_running; i++) {
-                if (worker_pids[i] > 0 && kill(worker_pids[i], 0) == 0) {
-                    active++;
-                }
+        WorkerState state = inst->worker_states[id];
+        inst->worker_pids[id] = 0;
+        inst->worker_states[id] = WORKER_FREE;
+        if (inst->worker_pidfds[id] >= 0) {
+            close(inst->worker_pidfds[id]);  // Also drops it from the epoll set
+            inst->worker_pidfds[id] = -1;
+        }
+        
+        // A drained worker holds nothing; a crashed one may have left tasks RUNNING
+        int requeued = requeue_worker_tasks(inst->queue, id);
+        if (requeued > 0) {
+            LOG_WARN_F("Queue %s: Requeued %d tasks left running by worker %d",
+                       inst->name, requeued, id);
+        }
+        
+        if (state == WORKER_DRAINING) {
+            LOG_INFO_F("Queue %s: Worker %d (PID: %d) drained and exited", inst->name, id, pid);
+            continue;
+        }
+        
+        LOG_WARN_F("Queue %s: Worker %d (PID: %d) exited with status %d", inst->name, id, pid,
+                   WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status));
+        // A rolling restart's replacement that dies before attaching is not
+        // respawned: rolling_restart_step aborts the restart instead
+        if (inst->restart_active && id == inst->restart_new_id) continue;
+        if (!shutdown_requested && spawn_worker(inst, id) == 0) {
+            LOG_INFO_F("Queue %s: Respawned worker %d", inst->name, id);
+        }
+    }
+}
+
+// Ask a worker to stop claiming, finish what it holds and exit
+static void drain_worker(QueueInstance* inst, int id) {
+    worker_stats_request_drain(&inst->queue->workers[id]);
+    inst->worker_states[id] = WORKER_DRAINING;
+    
+    // Wake it if it is waiting for work
+    lock_queue(inst->queue);
+    pthread_cond_broadcast(&inst->queue->queue_cond);
+    unlock_queue(inst->queue);
+}
+
+// Drain the least loaded worker, preferring high ids so the pool stays compact
+static void drain_one_worker(QueueInstance* inst) {
+    int victim = -1;
+    int victim_inflight = 0;
+    
+    for (int i = MAX_WORKERS - 1; i >= 0; i--) {
+        if (inst->worker_states[i] != WORKER_RUNNING) continue;
+        
+        WorkerSlot slot;
+        worker_stats_read(&inst->queue->workers[i], &slot);
+        if (slot.pid != inst->worker_pids[i]) continue;  // Not attached yet
+        
+        if (victim < 0 || slot.inflight_tasks < victim_inflight) {
+            victim = i;
+            victim_inflight = slot.inflight_tasks;
+        }
+    }
+    if (victim < 0) return;
+    
+    drain_worker(inst, victim);
+    LOG_INFO_F("Queue %s: Autoscale: draining worker %d (PID: %d, %d in flight)",
+               inst->name, victim, inst->worker_pids[victim], victim_inflight);
+}
+
+// Grow or shrink the pool between the configured min and max workers. Growing needs
+// a backlog (deep queue or an old pending task) on an already busy pool;
+// shrinking needs an empty queue and a mostly idle pool. Either must hold
+// for several consecutive checks and respect a cooldown since the last
+// change, so short bursts and lulls don't make the pool flap.
+static void autoscale(QueueInstance* inst) {
+    TaskQueue* queue = inst->queue;
+    const RuntimeConfig* config = &inst->config;
+    time_t now = time(NULL);
+    
+    int pending = 0;
+    time_t oldest = 0;
+    lock_queue(queue);
+    for (int i = 0; i < queue->size; i++) {
+        const Task* task = &queue->tasks[i];
+        if (task->status != STATUS_PENDING) continue;
+        pending++;
+        if (oldest == 0 || task->creation_time < oldest) {
+            oldest = task->creation_time;
+        }
+    }
+    unlock_queue(queue);
+    int oldest_age = pending > 0 ? (int)(now - oldest) : 0;
+    
+    // Utilization over workers that have attached and reported a capacity
+    int live = count_live_workers(inst);
+    long inflight = 0;
+    long capacity = 0;
+    for (int i = 0; i < MAX_WORKERS; i++) {
+        if (inst->worker_states[i] != WORKER_RUNNING) continue;
+        WorkerSlot slot;
+        worker_stats_read(&queue->workers[i], &slot);
+        if (slot.pid != inst->worker_pids[i] || slot.capacity <= 0) continue;
+        inflight += slot.inflight_tasks;
+        capacity += slot.capacity;
+    }
+    if (capacity == 0) {
+        // Nothing has attached yet (startup or respawn); judge next round
+        inst->up_ticks = inst->down_ticks = 0;
+        return;
+    }
+    int utilization = (int)(inflight * 100 / capacity);
+    
+    int want_up = live < config->max_workers &&
+                  (pending > AUTOSCALE_UP_PENDING_PER_WORKER * live ||
+                   oldest_age >= AUTOSCALE_UP_MAX_WAIT) &&
+                  utilization >= AUTOSCALE_UP_UTILIZATION;
+    int want_down = live > config->min_workers && pending == 0 &&
+                    utilization <= AUTOSCALE_DOWN_UTILIZATION;
+    
+    inst->up_ticks = want_up ? inst->up_ticks + 1 : 0;
+    inst->down_ticks = want_down ? inst->down_ticks + 1 : 0;
+    
+    if (inst->up_ticks >= AUTOSCALE_UP_TICKS && now - inst->last_change >= AUTOSCALE_UP_COOLDOWN) {
+        // Enough workers to take the backlog at the current per-worker capacity
+        long per_worker = capacity / live > 0 ? capacity / live : 1;
+        int add = (int)((pending + per_worker - 1) / per_worker);
+        if (add < 1) add = 1;
+        if (add > config->max_workers - live) add = config->max_workers - live;
+        
+        LOG_INFO_F("Queue %s: Autoscale: adding %d worker(s) (pending %d, oldest %d s, utilization %d%%)",
+                   inst->name, add, pending, oldest_age, utilization);
+        for (int i = 0; i < MAX_WORKERS && add > 0; i++) {
+            if (inst->worker_states[i] != WORKER_FREE) continue;
+            if (spawn_worker(inst, i) == 0) add--;
+        }
+        inst->last_change = now;
+        inst->up_ticks = 0;
+    } else if (inst->down_ticks >= AUTOSCALE_DOWN_TICKS &&
+               now - inst->last_change >= AUTOSCALE_DOWN_COOLDOWN) {
+        LOG_INFO_F("Queue %s: Autoscale: shrinking pool of %d (utilization %d%%)",
+                   inst->name, live, utilization);
+        drain_one_worker(inst);
+        inst->last_change = now;
+        inst->down_ticks = 0;
+    }
+}
+
+// Moves failed tasks back to PENDING as their backoff expires. Sleeps on
+// the retry heap's earliest deadline, so an idle queue costs nothing.
+static void* retry_timer_thread(void* arg) {
+    QueueInstance* inst = arg;
+    int released;
+    while ((released = retry_timer_wait(inst->queue)) >= 0) {
+        if (released > 0) {
+            LOG_INFO_F("Queue %s: Released %d task(s) for retry", inst->name, released);
+        }
+    }
+    return NULL;
+}
+
+// Autoscaling and rolling restarts need a look every WORKER_CHECK_INTERVAL;
+// fixed pools only need the periodic task cleanup of the most eager queue
+static void arm_maintenance_timer(void) {
+    int interval = 0;
+    for (int q = 0; q < instance_count; q++) {
+        const QueueInstance* inst = &instances[q];
+        int wanted = (inst->config.min_workers < inst->config.max_workers || inst->restart_active)
+                         ? WORKER_CHECK_INTERVAL : inst->config.cleanup_interval;
+        if (interval == 0 || wanted < interval) interval = wanted;
+    }
+    if (interval == timer_interval) return;
+    
+    struct itimerspec spec;
+    memset(&spec, 0, sizeof(spec));
+    spec.it_value.tv_sec = interval;
+    spec.it_interval.tv_sec = interval;
+    if (timerfd_settime(timer_fd, 0, &spec, NULL) != 0) {
+        LOG_ERROR_F("Failed to arm maintenance timer: %s", strerror(errno));
+        return;
+    }
+    timer_interval = interval;
+}
+
+static int find_free_worker_id(const QueueInstance* inst) {
+    for (int i = 0; i < MAX_WORKERS; i++) {
+        if (inst->worker_states[i] == WORKER_FREE) return i;
+    }
+    return -1;
+}
+
+// Advance the rolling restart by at most one step per check: start a
+// replacement, wait for it to attach, drain the old worker, wait for it to
+// exit, move on to the next one. Queues restart side by side.
+static void rolling_restart_step(QueueInstance* inst) {
+    if (inst->restart_requested) {
+        inst->restart_requested = 0;
+        if (inst->restart_active) {
+            LOG_INFO_F("Queue %s: Rolling restart already in progress", inst->name);
+        } else if (access("./worker", X_OK) != 0) {
+            LOG_ERROR_F("Queue %s: Rolling restart: ./worker is not executable: %s",
+                        inst->name, strerror(errno));
+        } else {
+            inst->current_generation++;
+            inst->restart_active = 1;
+            arm_maintenance_timer();
+            LOG_INFO_F("Queue %s: Rolling restart: replacing %d workers",
+                       inst->name, count_live_workers(inst));
+        }
+    }
+    if (!inst->restart_active) return;
+    
+    if (inst->restart_new_id >= 0) {
+        int new_id = inst->restart_new_id;
+        int old_id = inst->restart_old_id;
+        WorkerSlot slot;
+        worker_stats_read(&inst->queue->workers[new_id], &slot);
+        if (inst->worker_pids[new_id] == 0) {
+            // Exited before attaching (a missing or broken binary); the old
+            // worker was never drained and keeps running
+            LOG_ERROR_F("Queue %s: Rolling restart: worker %d exited before attaching, aborting; "
+                        "worker %d keeps running", inst->name, new_id, old_id);
+            inst->restart_active = 0;
+            inst->restart_new_id = -1;
+            inst->restart_old_id = -1;
+            arm_maintenance_timer();
+        } else if (slot.pid != 0 && slot.pid == inst->worker_pids[new_id]) {
+            // A worker that crashed meanwhile was respawned on the new binary already
+            if (inst->worker_states[old_id] == WORKER_RUNNING &&
+                inst->worker_generation[old_id] < inst->current_generation) {
+                drain_worker(inst, old_id);
+                LOG_INFO_F("Queue %s: Rolling restart: worker %d is up, draining worker %d (PID: %d)",
+                           inst->name, new_id, old_id, inst->worker_pids[old_id]);
             }
-            queue->num_active_workers = active;
-            pthread_mutex_unlock(&queue->queue_mutex);
+            inst->restart_new_id = -1;
+        } else if (time(NULL) - inst->restart_spawned_at >= WORKER_ATTACH_TIMEOUT) {
+            LOG_ERROR_F("Queue %s: Rolling restart: worker %d did not start within %d s, aborting",
+                        inst->name, new_id, WORKER_ATTACH_TIMEOUT);
+            if (inst->worker_pids[new_id] > 0) {
+                inst->worker_states[new_id] = WORKER_DRAINING;  // Don't respawn it
+                kill(inst->worker_pids[new_id], SIGTERM);
+            }
+            inst->restart_active = 0;
+            inst->restart_new_id = -1;
+            inst->restart_old_id = -1;
+            arm_maintenance_timer();
+        }
+        return;
+    }
+    
+    if (inst->restart_old_id >= 0) {
+        if (inst->worker_states[inst->restart_old_id] == WORKER_DRAINING) return;
+        inst->restart_old_id = -1;
+    }
+    
+    int old_id = -1;
+    for (int i = 0; i < MAX_WORKERS; i++) {
+        if (inst->worker_states[i] == WORKER_RUNNING &&
+            inst->worker_generation[i] < inst->current_generation) {
+            old_id = i;
+            break;
+        }
+    }
+    if (old_id < 0) {
+        LOG_INFO_F("Queue %s: Rolling restart complete (%d workers)",
+                   inst->name, count_live_workers(inst));
+        inst->restart_active = 0;
+        arm_maintenance_timer();
+        return;
+    }
+    
+    int new_id = find_free_worker_id(inst);
+    if (new_id < 0 || spawn_worker(inst, new_id) != 0) {
+        return;  // Try again next check
+    }
+    LOG_INFO_F("Queue %s: Rolling restart: started worker %d to replace worker %d",
+               inst->name, new_id, old_id);
+    inst->restart_old_id = old_id;
+    inst->restart_new_id = new_id;
+    inst->restart_spawned_at = time(NULL);
+}
+
+// Defaults, then the config file, then the command line
+static int build_config(const char* queue_name, RuntimeConfig* cfg, char* err, size_t err_size) {
+    runtime_config_defaults(cfg, queue_name);
+    if (runtime_config_load(cfg, config_path, config_path_required, queue_name,
+                            err, err_size) != 0) {
+        return -1;
+    }
+    for (int i = 0; i < config_override_count; i++) {
+        if (runtime_config_set(cfg, config_overrides[i][0], config_overrides[i][1],
+                               err, err_size) != 0) {
+            return -1;
+        }
+    }
+    return runtime_config_resolve(cfg, err, err_size);
+}
+
+// Copy the live settings into shared memory and bump the generation;
+// idle workers are woken so they pick it up right away
+static void publish_config(QueueInstance* inst) {
+    TaskQueue* queue = inst->queue;
+    lock_queue(queue);
+    queue->min_workers = inst->config.min_workers;
+    queue->max_workers = inst->config.max_workers;
+    queue->config.threads_per_worker = inst->config.threads_per_worker;
+    queue->config.sched_policy = inst->config.sched_policy;
+    queue->config.cleanup_interval = inst->config.cleanup_interval;
+    queue->config.completed_task_max_age = inst->config.completed_task_max_age;
+    __atomic_add_fetch(&queue->config_generation, 1, __ATOMIC_RELEASE);
+    queue_modified(queue);
+    pthread_cond_broadcast(&queue->queue_cond);
+    unlock_queue(queue);
+}
+
+// Bring the pool inside new bounds at once instead of waiting for autoscaling
+static void apply_pool_bounds(QueueInstance* inst) {
+    int live = count_live_workers(inst);
+    for (int i = 0; i < MAX_WORKERS && live < inst->config.min_workers; i++) {
+        if (inst->worker_states[i] == WORKER_FREE && spawn_worker(inst, i) == 0) live++;
+    }
+    for (; live > inst->config.max_workers; live--) {
+        drain_one_worker(inst);
+    }
+}
+
+// SIGHUP: rebuild every queue's configuration and apply what changed. A
+// file that fails to parse leaves all of them as they were.
+static void reload_config(void) {
+    RuntimeConfig next[MAX_QUEUES];
+    char err[512];
+    for (int q = 0; q < instance_count; q++) {
+        if (build_config(instances[q].name, &next[q], err, sizeof(err)) != 0) {
+            LOG_ERROR_F("Config reload failed, keeping the current settings: %s", err);
+            return;
+        }
+    }
+    
+    for (int q = 0; q < instance_count; q++) {
+        QueueInstance* inst = &instances[q];
+        if (next[q].shm_key != inst->config.shm_key) {
+            LOG_WARN_F("Queue %s: Config reload: shm_key change to 0x%x needs a restart, keeping 0x%x",
+                       inst->name, (unsigned)next[q].shm_key, (unsigned)inst->config.shm_key);
+            next[q].shm_key = inst->config.shm_key;
         }
         
-        // Periodic cleanup of completed tasks
-        time_t current_time = time(NULL);
-        if ((current_time - last_cleanup) >= CLEANUP_INTERVAL) {
-            if (queue != NULL) {
-                int removed = remove_completed_tasks(queue, COMPLETED_TASK_MAX_AGE);
-                if (removed > 0) {
-                    LOG_INFO_F("Cleaned up %d completed tasks older than %d seconds", 
-                              removed, COMPLETED_TASK_MAX_AGE);
+        RuntimeConfig prev = inst->config;
+        inst->config = next[q];
+        publish_config(inst);
+        if (inst->config.min_workers != prev.min_workers ||
+            inst->config.max_workers != prev.max_workers) {
+            apply_pool_bounds(inst);
+        }
+        
+        LOG_INFO_F("Queue %s: Config generation %d: pool %d-%d, %d threads per worker, policy %s, "
+                   "cleanup every %d s after %d s", inst->name, inst->queue->config_generation,
+                   inst->config.min_workers, inst->config.max_workers,
+                   inst->config.threads_per_worker,
+                   sched_policy_to_string(inst->config.sched_policy),
+                   inst->config.cleanup_interval, inst->config.completed_task_max_age);
+    }
+    arm_maintenance_timer();
+}
+
+// Block the signals we handle and route them, worker exits and the
+// maintenance timer into one epoll set
+static int init_supervisor(void) {
+    int probe = pidfd_open(getpid());
+    if (probe >= 0) {
+        close(probe);
+        pidfd_supported = 1;
+    }
+    
+    sigemptyset(&supervisor_signals);
+    sigaddset(&supervisor_signals, SIGINT);
+    sigaddset(&supervisor_signals, SIGTERM);
+    sigaddset(&supervisor_signals, SIGHUP);
+    sigaddset(&supervisor_signals, SIGUSR2);
+    if (!pidfd_supported) {
+        sigaddset(&supervisor_signals, SIGCHLD);
+    }
+    // Before any thread exists, so they all inherit the mask
+    if (sigprocmask(SIG_BLOCK, &supervisor_signals, NULL) != 0) return -1;
+    
+    epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    signal_fd = signalfd(-1, &supervisor_signals, SFD_NONBLOCK | SFD_CLOEXEC);
+    timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (epoll_fd < 0 || signal_fd < 0 || timer_fd < 0) return -1;
+    
+    struct epoll_event ev;
+    ev.events = EPOLLIN;
+    ev.data.u32 = SUPERVISOR_SIGNAL_TAG;
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, signal_fd, &ev) != 0) return -1;
+    ev.data.u32 = SUPERVISOR_TIMER_TAG;
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, timer_fd, &ev) != 0) return -1;
+    
+    if (!pidfd_supported) {
+        LOG_WARN_F("pidfd_open unavailable, watching worker exits through SIGCHLD");
+    }
+    return 0;
+}
+
+static void handle_signals(void) {
+    struct signalfd_siginfo info;
+    while (read(signal_fd, &info, sizeof(info)) == sizeof(info)) {
+        switch (info.ssi_signo) {
+            case SIGINT:
+            case SIGTERM:
+                LOG_INFO_F("Shutdown signal received");
+                request_shutdown();
+                break;
+            case SIGHUP:
+                LOG_INFO_F("SIGHUP received, reloading %s", config_path);
+                reload_config();
+                break;
+            case SIGUSR2:
+                for (int q = 0; q < instance_count; q++) {
+                    instances[q].restart_requested = 1;
                 }
+                break;
+            case SIGCHLD:
+                reap_workers();
+                break;
+        }
+    }
+}
+
+static void run_maintenance(void) {
+    uint64_t expirations;
+    if (read(timer_fd, &expirations, sizeof(expirations)) < 0 && errno != EAGAIN) {
+        LOG_WARN_F("Maintenance timer read failed: %s", strerror(errno));
+    }
+    
+    // Catches exits a missing pidfd would have reported
+    reap_workers();
+    
+    time_t current_time = time(NULL);
+    for (int q = 0; q < instance_count; q++) {
+        QueueInstance* inst = &instances[q];
+        
+        // The pool size is left alone while workers are being replaced
+        rolling_restart_step(inst);
+        if (!inst->restart_active) {
+            autoscale(inst);
+        }
+        
+        // Periodic cleanup of completed tasks
+        if ((current_time - inst->last_cleanup) >= inst->config.cleanup_interval) {
+            int removed = remove_completed_tasks(inst->queue, inst->config.completed_task_max_age);
+            if (removed > 0) {
+                LOG_INFO_F("Queue %s: Cleaned up %d completed tasks older than %d seconds",
+                          inst->name, removed, inst->config.completed_task_max_age);
             }
-            last_cleanup = current_time;
+            inst->last_cleanup = current_time;
         }
     }
 }
 
+void monitor_workers(void) {
+    for (int q = 0; q < instance_count; q++) {
+        instances[q].last_cleanup = time(NULL);
+    }
+    arm_maintenance_timer();
+    
+    while (!shutdown_requested) {
+        struct epoll_event events[MAX_QUEUES * MAX_WORKERS + 2];
+        int n = epoll_wait(epoll_fd, events, MAX_QUEUES * MAX_WORKERS + 2, -1);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            LOG_ERROR_F("Supervisor epoll_wait failed: %s", strerror(errno));
+            request_shutdown();
+            break;
+        }
+        
+        for (int i = 0; i < n && !shutdown_requested; i++) {
+            uint32_t tag = events[i].data.u32;
+            if (tag == SUPERVISOR_SIGNAL_TAG) {
+                handle_signals();
+            } else if (tag == SUPERVISOR_TIMER_TAG) {
+                run_maintenance();
+            } else {
+                reap_workers();  // A worker's pidfd became readable: it exited
+            }
+        }
+        
+        for (int q = 0; q < instance_count; q++) {
+            QueueInstance* inst = &instances[q];
+            
+            // A SIGUSR2 starts the restart now rather than at the next tick
+            if (inst->restart_requested && !shutdown_requested) {
+                rolling_restart_step(inst);
+            }
+            
+            // Update worker count in shared memory
+            int live = count_live_workers(inst);
+            lock_queue(inst->queue);
+            if (inst->queue->num_active_workers != live) {
+                inst->queue->num_active_workers = live;
+                queue_modified(inst->queue);
+            }
+            unlock_queue(inst->queue);
+        }
+    }
+}
+
+static void print_usage(const char* prog) {
+    fprintf(stderr, "Usage: %s [options]\n", prog);
+    fprintf(stderr, "  --exec-mode thread|async  How workers run tasks: one thread per task (default)\n");
+    fprintf(stderr, "                            or multiplexed on epoll event loops\n");
+    fprintf(stderr, "  --cpus LIST               Pin worker processes to these CPUs (e.g. 0-3,8)\n");
+    fprintf(stderr, "  --numa-node N             Pin worker processes to NUMA node N's CPUs\n");
+    fprintf(stderr, "  --pin-threads             Also pin each pool thread to a single CPU\n");
+    fprintf(stderr, "  --isolated-cpus LIST      Reserve these CPUs for HIGH-priority tasks\n");
+    fprintf(stderr, "  --config FILE             Settings file (default %s, if present)\n", CONFIG_FILE);
+    fprintf(stderr, "  --workers N               Initial pool size (default %d)\n", NUM_WORKERS);
+    fprintf(stderr, "  --min-workers N           Smallest worker pool autoscaling shrinks to\n");
+    fprintf(stderr, "  --max-workers N           Largest worker pool autoscaling grows to (max %d)\n",
+            MAX_WORKERS - 1);
+    fprintf(stderr, "                            Both default to --workers, a fixed pool\n");
+    fprintf(stderr, "  --threads-per-worker N    Tasks a thread-mode worker runs at once (default %d)\n",
+            MAX_THREADS_PER_WORKER);
+    fprintf(stderr, "  --sched-policy P          priority (default) or fifo\n");
+    fprintf(stderr, "  --cleanup-interval S      Seconds between completed-task cleanups (default %d)\n",
+            CLEANUP_INTERVAL);
+    fprintf(stderr, "  --completed-max-age S     Age at which finished tasks are removed (default %d)\n",
+            COMPLETED_TASK_MAX_AGE);
+    fprintf(stderr, "  --shm-key KEY             Shared memory key (default 0x%x)\n", (unsigned)SHM_KEY);
+    fprintf(stderr, "  --listen PORT             Accept federation peers on this TCP port\n");
+    fprintf(stderr, "  --listen-address ADDR     Address --listen binds (default %s; peers are\n",
+            FEDERATION_LISTEN_ADDRESS);
+    fprintf(stderr, "                            not authenticated, so '::' opens it to anyone)\n");
+    fprintf(stderr, "  --peer HOST:PORT          Share load with this scheduler (repeatable, max %d)\n",
+            MAX_PEERS);
+    fprintf(stderr, "  --node-name NAME          This node's federation name (default host:port, or\n");
+    fprintf(stderr, "                            host/SHM_KEY without --listen)\n");
+    fprintf(stderr, "  --peer-gone-timeout S     Run offers to a peer away this long here instead\n");
+    fprintf(stderr, "                            (default %d, 0 = never)\n", FEDERATION_PEER_GONE_TIMEOUT);
+    fprintf(stderr, "  --pid-file PATH           Where to write our PID (default %s)\n", PID_FILE);
+    fprintf(stderr, "  --queue NAME              Supervise this named queue, with its own shared memory,\n");
+    fprintf(stderr, "                            workers and submission socket (repeatable, max %d;\n",
+            MAX_QUEUES);
+    fprintf(stderr, "                            default: one queue named %s)\n", DEFAULT_QUEUE_NAME);
+    fprintf(stderr, "  --submit-socket PATH      First queue's submission socket (default %s,\n",
+            SUBMIT_SOCKET_PATH);
+    fprintf(stderr, "                            or " SUBMIT_QUEUE_SOCKET_FMT " for a named queue)\n",
+            "NAME");
+    fprintf(stderr, "  --trace                   Record task events in logs/*.trace for tracedump\n");
+    fprintf(stderr, "Settings apply to every queue; a [queue NAME] section of the config file\n");
+    fprintf(stderr, "sets them for one. Send SIGHUP to reload the config file; command-line\n");
+    fprintf(stderr, "settings still win.\n");
+    fprintf(stderr, "Send SIGUSR2 to replace all workers with the current ./worker binary.\n");
+}
+
+static int add_config_override(const char* key, const char* value) {
+    if (config_override_count == MAX_CONFIG_OVERRIDES) return -1;
+    config_overrides[config_override_count][0] = key;
+    config_overrides[config_override_count][1] = value;
+    config_override_count++;
+    return 0;
+}
+
+// Resolve --cpus/--numa-node/--isolated-cpus into the worker process mask
+static int resolve_worker_cpus(const char* cpus_arg, int numa_node) {
+    cpu_set_t isolated;
+    CPU_ZERO(&isolated);
+    if (isolated_cpus_arg[0] != '\0' && parse_cpu_list(isolated_cpus_arg, &isolated) != 0) {
+        fprintf(stderr, "Invalid --isolated-cpus list: %s\n", isolated_cpus_arg);
+        return -1;
+    }
+    
+    if (sched_getaffinity(0, sizeof(worker_cpus), &worker_cpus) != 0) {
+        return -1;
+    }
+    if (cpus_arg != NULL) {
+        cpu_set_t requested;
+        if (parse_cpu_list(cpus_arg, &requested) != 0) {
+            fprintf(stderr, "Invalid --cpus list: %s\n", cpus_arg);
+            return -1;
+        }
+        CPU_AND(&worker_cpus, &worker_cpus, &requested);
+    }
+    if (numa_node >= 0) {
+        cpu_set_t node_cpus;
+        if (cpus_of_numa_node(numa_node, &node_cpus) != 0) {
+            fprintf(stderr, "Unknown NUMA node: %d\n", numa_node);
+            return -1;
+        }
+        CPU_AND(&worker_cpus, &worker_cpus, &node_cpus);
+    }
+    
+    // Non-HIGH work needs somewhere to run besides the isolated cores
+    cpu_set_t general;
+    CPU_XOR(&general, &worker_cpus, &isolated);
+    CPU_AND(&general, &general, &worker_cpus);
+    if (CPU_COUNT(&general) == 0) {
+        fprintf(stderr, "No usable CPUs left for workers\n");
+        return -1;
+    }
+    
+    // Isolated CPUs alone just split the inherited mask inside each worker
+    CPU_OR(&worker_cpus, &worker_cpus, &isolated);
+    pin_workers = (cpus_arg != NULL || numa_node >= 0);
+    return 0;
+}
+
 int main(int argc, char* argv[]) {
-    (void)argc;  // Suppress unused parameter warning
-    (void)argv;
+    static struct option long_options[] = {
+        {"exec-mode",          required_argument, NULL, 'm'},
+        {"cpus",               required_argument, NULL, 'c'},
+        {"numa-node",          required_argument, NULL, 'n'},
+        {"pin-threads",        no_argument,       NULL, 'p'},
+        {"isolated-cpus",      required_argument, NULL, 'i'},
+        {"config",             required_argument, NULL, 'f'},
+        {"workers",            required_argument, NULL, 'N'},
+        {"min-workers",        required_argument, NULL, 'w'},
+        {"max-workers",        required_argument, NULL, 'W'},
+        {"threads-per-worker", required_argument, NULL, 't'},
+        {"sched-policy",       required_argument, NULL, 's'},
+        {"cleanup-interval",   required_argument, NULL, 'C'},
+        {"completed-max-age",  required_argument, NULL, 'A'},
+        {"shm-key",            required_argument, NULL, 'k'},
+        {"listen",             required_argument, NULL, 'l'},
+        {"listen-address",     required_argument, NULL, 'L'},
+        {"peer",               required_argument, NULL, 'P'},
+        {"node-name",          required_argument, NULL, 'o'},
+        {"peer-gone-timeout",  required_argument, NULL, 'g'},
+        {"pid-file",           required_argument, NULL, 'F'},
+        {"submit-socket",      required_argument, NULL, 'S'},
+        {"queue",              required_argument, NULL, 'q'},
+        {"trace",              no_argument,       NULL, 'T'},
+        {"help",               no_argument,       NULL, 'h'},
+        {NULL, 0, NULL, 0}
+    };
+    
+    const char* cpus_arg = NULL;
+    int numa_node = -1;
+    int opt;
+    int bad_override = 0;
+    while ((opt = getopt_long(argc, argv, "m:c:n:pi:f:N:w:W:t:s:C:A:k:l:L:P:o:g:F:S:q:Th", long_options, NULL)) != -1) {
+        switch (opt) {
+            case 'm':
+                if (parse_exec_mode(optarg, &worker_exec_mode) != 0) {
+                    fprintf(stderr, "Unknown execution mode: %s\n", optarg);
+                    print_usage(argv[0]);
+                    return 1;
+                }
+                break;
+            case 'c':
+                cpus_arg = optarg;
+                break;
+            case 'n':
+                numa_node = atoi(optarg);
+                break;
+            case 'p':
+                pin_worker_threads = 1;
+                break;
+            case 'i':
+                strncpy(isolated_cpus_arg, optarg, sizeof(isolated_cpus_arg) - 1);
+                break;
+            case 'f':
+                config_path = optarg;
+                config_path_required = 1;
+                break;
+            case 'N': bad_override |= add_config_override("workers", optarg); break;
+            case 'w': bad_override |= add_config_override("min_workers", optarg); break;
+            case 'W': bad_override |= add_config_override("max_workers", optarg); break;
+            case 't': bad_override |= add_config_override("threads_per_worker", optarg); break;
+            case 's': bad_override |= add_config_override("sched_policy", optarg); break;
+            case 'C': bad_override |= add_config_override("cleanup_interval", optarg); break;
+            case 'A': bad_override |= add_config_override("completed_task_max_age", optarg); break;
+            case 'k': bad_override |= add_config_override("shm_key", optarg); break;
+            case 'l':
+                federation_port = atoi(optarg);
+                if (federation_port <= 0 || federation_port > 65535) {
+                    fprintf(stderr, "Invalid --listen port: %s\n", optarg);
+                    return 1;
+                }
+                break;
+            case 'L':
+                federation_listen_address = optarg;
+                break;
+            case 'P':
+                if (federation_peer_count == MAX_PEERS) {
+                    fprintf(stderr, "At most %d --peer options\n", MAX_PEERS);
+                    return 1;
+                }
+                federation_peers[federation_peer_count++] = optarg;
+                break;
+            case 'o':
+                if (strlen(optarg) >= sizeof(federation_node_name) || strpbrk(optarg, " \t") != NULL) {
+                    fprintf(stderr, "--node-name must be one word under %d characters\n",
+                            MAX_PEER_NAME_LEN);
+                    return 1;
+                }
+                strcpy(federation_node_name, optarg);
+                break;
+            case 'g':
+                federation_gone_timeout = atoi(optarg);
+                if (federation_gone_timeout < 0) {
+                    fprintf(stderr, "Invalid --peer-gone-timeout: %s\n", optarg);
+                    return 1;
+                }
+                break;
+            case 'F':
+                pid_file_path = optarg;
+                break;
+            case 'S':
+                submit_socket_path = optarg;
+                break;
+            case 'q':
+                if (!queue_name_valid(optarg)) {
+                    fprintf(stderr, "--queue names are 1-%d letters, digits, '-' or '_'\n",
+                            MAX_QUEUE_NAME_LEN - 1);
+                    return 1;
+                }
+                if (instance_count == MAX_QUEUES) {
+                    fprintf(stderr, "At most %d --queue options\n", MAX_QUEUES);
+                    return 1;
+                }
+                for (int q = 0; q < instance_count; q++) {
+                    if (strcmp(instances[q].name, optarg) == 0) {
+                        fprintf(stderr, "Queue %s given twice\n", optarg);
+                        return 1;
+                    }
+                }
+                strcpy(instances[instance_count++].name, optarg);
+                break;
+            case 'T':
+                // Workers inherit it and trace themselves
+                setenv(TRACE_ENV, "1", 1);
+                break;
+            case 'h':
+                print_usage(argv[0]);
+                return 0;
+            default:
+                print_usage(argv[0]);
+                return 1;
+        }
+    }
+    
+    char config_err[512];
+    if (bad_override) {
+        fprintf(stderr, "Too many configuration options\n");
+        return 1;
+    }
+    if (instance_count == 0) {
+        strcpy(instances[instance_count++].name, DEFAULT_QUEUE_NAME);
+    }
+    for (int q = 0; q < instance_count; q++) {
+        QueueInstance* inst = &instances[q];
+        if (build_config(inst->name, &inst->config, config_err, sizeof(config_err)) != 0) {
+            fprintf(stderr, "Invalid configuration for queue %s: %s\n", inst->name, config_err);
+            print_usage(argv[0]);
+            return 1;
+        }
+        // Two names can hash alike, and shm_key can be set by hand
+        for (int other = 0; other < q; other++) {
+            if (instances[other].config.shm_key == inst->config.shm_key) {
+                fprintf(stderr, "Queues %s and %s would share shm_key 0x%x; "
+                        "set shm_key in a [queue NAME] section of the config file\n",
+                        instances[other].name, inst->name, (unsigned)inst->config.shm_key);
+                return 1;
+            }
+        }
+        
+        snprintf(inst->shm_key_str, sizeof(inst->shm_key_str), "0x%x",
+                 (unsigned)inst->config.shm_key);
+        submit_socket_path_for(inst->name, inst->socket_path, sizeof(inst->socket_path));
+        inst->shm_id = -1;
+        inst->restart_old_id = inst->restart_new_id = -1;
+        for (int i = 0; i < MAX_WORKERS; i++) {
+            inst->worker_pidfds[i] = -1;
+        }
+    }
+    if (submit_socket_path == NULL) submit_socket_path = getenv(SUBMIT_SOCKET_ENV);
+    if (submit_socket_path != NULL && *submit_socket_path != '\0') {
+        snprintf(instances[0].socket_path, sizeof(instances[0].socket_path), "%s", submit_socket_path);
+    }
+    
+    if (resolve_worker_cpus(cpus_arg, numa_node) != 0) {
+        print_usage(argv[0]);
+        return 1;
+    }
     
     // Initialize logger
     init_logger("scheduler");
-    LOG_INFO_F("Starting scheduler...");
+    if (trace_open("scheduler", -1) != 0) {
+        LOG_WARN_F("Failed to open trace file: %s", strerror(errno));
+    }
+    LOG_INFO_F("Starting scheduler (worker execution mode: %s, %d queue(s))...",
+               exec_mode_to_string(worker_exec_mode), instance_count);
     
-    // Set up signal handlers
-    signal(SIGINT, signal_handler);
-    signal(SIGTERM, signal_handler);
-    signal(SIGCHLD, SIG_IGN); // Reap zombie processes
+    // Signals are read from a signalfd in the supervisor loop
+    if (init_supervisor() != 0) {
+        LOG_ERROR_F("Failed to set up supervisor loop: %s", strerror(errno));
+        return 1;
+    }
     
     // Register cleanup function
     atexit(cleanup_resources);
     
-    // Initialize shared memory
-    shm_id = init_shared_memory();
-    if (shm_id == -1) {
-        LOG_ERROR_F("Failed to initialize shared memory");
-        return 1;
+    unsigned long nodes = pin_workers ? numa_nodes_of_cpus(&worker_cpus) : 0;
+    for (int q = 0; q < instance_count; q++) {
+        QueueInstance* inst = &instances[q];
+        
+        // Initialize shared memory
+        inst->shm_id = init_shared_memory(inst->config.shm_key);
+        if (inst->shm_id == -1) {
+            LOG_ERROR_F("Queue %s: Failed to initialize shared memory", inst->name);
+            return 1;
+        }
+        
+        // Attach to shared memory
+        TaskQueue* queue = attach_shared_memory(inst->shm_id);
+        if (queue == NULL) {
+            LOG_ERROR_F("Queue %s: Failed to attach to shared memory", inst->name);
+            return 1;
+        }
+        if (queue->name[0] != '\0' && strcmp(queue->name, inst->name) != 0) {
+            LOG_ERROR_F("Queue %s: Segment 0x%x belongs to queue %s; set shm_key in a "
+                        "[queue %s] section of the config file", inst->name,
+                        (unsigned)inst->config.shm_key, queue->name, inst->name);
+            detach_shared_memory(queue);
+            return 1;
+        }
+        inst->queue = queue;
+        
+        // Set scheduler PID
+        strcpy(queue->name, inst->name);
+        queue->scheduler_pid = getpid();
+        queue->shutdown_flag = 0;  // Left set if a previous scheduler exited on this segment
+        publish_config(inst);
+        
+        // Keep the shared segment's pages on the nodes the workers run on
+        if (nodes != 0) {
+            if (bind_memory_to_nodes(queue, sizeof(TaskQueue), nodes) == 0) {
+                LOG_INFO_F("Queue %s: Shared memory policy set for NUMA node mask 0x%lx",
+                           inst->name, nodes);
+            } else {
+                LOG_WARN_F("Queue %s: Failed to set shared memory NUMA policy: %s",
+                           inst->name, strerror(errno));
+            }
+        }
+        
+        LOG_INFO_F("Queue %s: Shared memory initialized (key %s)", inst->name, inst->shm_key_str);
     }
-    
-    // Attach to shared memory
-    queue = attach_shared_memory(shm_id);
-    if (queue == NULL) {
-        LOG_ERROR_F("Failed to attach to shared memory");
-        return 1;
+    if (pin_workers) {
+        char cpus[256];
+        format_cpu_list(&worker_cpus, cpus, sizeof(cpus));
+        LOG_INFO_F("Worker processes pinned to CPUs %s", cpus);
     }
     
-    // Set scheduler PID
-    queue->scheduler_pid = getpid();
-    
     // Write PID to file
-    FILE* pid_file = fopen(PID_FILE, "w");
+    FILE* pid_file = fopen(pid_file_path, "w");
     if (pid_file) {
         fprintf(pid_file, "%d\n", getpid());
         fclose(pid_file);
     }
     
-    LOG_INFO_F("Shared memory initialized, scheduler PID: %d", getpid());
+    LOG_INFO_F("Scheduler PID: %d", getpid());
     
-    // Spawn worker processes
-    num_workers_running = NUM_WORKERS;
-    for (int i = 0; i < NUM_WORKERS; i++) {
-        if (spawn_worker(i) != 0) {
-            LOG_ERROR_F("Failed to spawn worker %d", i);
-            num_workers_running--;
+    for (int q = 0; q < instance_count; q++) {
+        QueueInstance* inst = &instances[q];
+        
+        // Spawn the initial pool; autoscaling moves it within [min, max]
+        for (int i = 0; i < inst->config.workers; i++) {
+            if (spawn_worker(inst, i) != 0) {
+                LOG_ERROR_F("Queue %s: Failed to spawn worker %d", inst->name, i);
+            }
+        }
+        
+        LOG_INFO_F("Queue %s: Started %d worker processes (pool %d-%d, %d threads per worker, "
+                   "policy %s, config generation %d)", inst->name, count_live_workers(inst),
+                   inst->config.min_workers, inst->config.max_workers,
+                   inst->config.threads_per_worker,
+                   sched_policy_to_string(inst->config.sched_policy),
+                   inst->queue->config_generation);
+        
+        inst->retry_thread_started =
+            pthread_create(&inst->retry_thread, NULL, retry_timer_thread, inst) == 0;
+        if (!inst->retry_thread_started) {
+            LOG_ERROR_F("Queue %s: Failed to start retry timer; failed tasks will not be retried",
+                        inst->name);
         }
     }
     
-    LOG_INFO_F("Started %d worker processes", num_workers_running);
+    // Federation shares the first queue; the others stay local
+    int federated = 0;
+    if (federation_port > 0 || federation_peer_count > 0) {
+        // Peers know our offers by this name, so it must survive restarts:
+        // the port if we listen, else the queue's key (one scheduler per key)
+        if (federation_node_name[0] == '\0') {
+            char host[MAX_PEER_NAME_LEN - 16] = "localhost";
+            gethostname(host, sizeof(host) - 1);
+            if (federation_port > 0) {
+                snprintf(federation_node_name, sizeof(federation_node_name), "%s:%d", host,
+                         federation_port);
+            } else {
+                snprintf(federation_node_name, sizeof(federation_node_name), "%s/%s", host,
+                         instances[0].shm_key_str);
+            }
+        }
+        federated = federation_start(instances[0].queue, federation_node_name,
+                                     federation_listen_address, federation_port,
+                                     federation_peers, federation_peer_count,
+                                     federation_gone_timeout) == 0;
+        if (!federated) {
+            LOG_ERROR_F("Failed to start federation; running stand-alone");
+        } else if (instance_count > 1) {
+            LOG_INFO_F("Federating queue %s only", instances[0].name);
+        }
+    }
+    
+    for (int q = 0; q < instance_count; q++) {
+        QueueInstance* inst = &instances[q];
+        inst->submit = submit_server_start(inst->queue, inst->socket_path);
+        if (inst->submit == NULL) {
+            LOG_ERROR_F("Queue %s: Failed to start the submission socket%s", inst->name,
+                        q == 0 ? "; use --submit-socket to pick another path" : "");
+        }
+    }
     
     // Main scheduler loop - monitor workers
     monitor_workers();
     
+    for (int q = 0; q < instance_count; q++) {
+        submit_server_stop(instances[q].submit);
+        instances[q].submit = NULL;
+    }
+    
+    if (federated) {
+        federation_stop();
+    }
+    
+    for (int q = 0; q < instance_count; q++) {
+        if (instances[q].retry_thread_started) {
+            pthread_join(instances[q].retry_thread, NULL);
+        }
+    }
+    
     LOG_INFO_F("Scheduler shutting down...");
     return 0;
 }
-
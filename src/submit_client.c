@@ -0,0 +1,167 @@
+#include "submit_client.h"
+#include <sys/socket.h>
+#include <sys/un.h>
+
+static int write_full(int fd, const void* data, size_t len) {
+    const unsigned char* p = data;
+    while (len > 0) {
+        ssize_t n = send(fd, p, len, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        p += n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+static int read_full(int fd, void* data, size_t len) {
+    unsigned char* p = data;
+    while (len > 0) {
+        ssize_t n = read(fd, p, len);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        if (n == 0) {
+            errno = ECONNRESET;
+            return -1;
+        }
+        p += n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+static int read_ack(SubmitClient* client) {
+    SubmitFrameHeader header;
+    int32_t results[SUBMIT_MAX_BATCH];
+
+    if (read_full(client->fd, &header, sizeof(header)) != 0) return -1;
+    if (header.type != SUBMIT_FRAME_ACK || header.count > SUBMIT_MAX_BATCH ||
+        header.length != header.count * sizeof(int32_t)) {
+        errno = EPROTO;
+        return -1;
+    }
+    if (read_full(client->fd, results, header.length) != 0) return -1;
+
+    client->unacked--;
+    if (client->on_ack != NULL) {
+        client->on_ack(client->ack_arg, header.seq, results, header.count);
+    }
+    return 0;
+}
+
+int submit_client_open(SubmitClient* client, const char* path, SubmitAckFn on_ack, void* arg) {
+    memset(client, 0, sizeof(*client));
+    client->fd = -1;
+
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+
+    if (path == NULL) path = getenv(SUBMIT_SOCKET_ENV);
+    if (path == NULL || *path == '\0') {
+        const char* queue = getenv(QUEUE_NAME_ENV);
+        submit_socket_path_for(queue != NULL && *queue != '\0' ? queue : DEFAULT_QUEUE_NAME,
+                               addr.sun_path, sizeof(addr.sun_path));
+        path = addr.sun_path;
+    }
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+    if (path != addr.sun_path) strcpy(addr.sun_path, path);
+
+    client->frame = malloc(SUBMIT_MAX_FRAME);
+    if (client->frame == NULL) return -1;
+
+    client->fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (client->fd < 0 || connect(client->fd, (struct sockaddr*)&addr, sizeof(addr)) != 0) {
+        int saved = errno;
+        submit_client_close(client);
+        errno = saved;
+        return -1;
+    }
+
+    client->frame_len = sizeof(SubmitFrameHeader);
+    client->next_seq = 1;
+    client->on_ack = on_ack;
+    client->ack_arg = arg;
+    return 0;
+}
+
+int submit_client_flush(SubmitClient* client) {
+    if (client->frame_count == 0) return 0;
+
+    // Keep at most SUBMIT_WINDOW frames in flight so neither side stalls
+    while (client->unacked >= SUBMIT_WINDOW) {
+        if (read_ack(client) != 0) return -1;
+    }
+
+    SubmitFrameHeader header;
+    header.length = (uint32_t)(client->frame_len - sizeof(header));
+    header.type = SUBMIT_FRAME_TASKS;
+    header.count = (uint16_t)client->frame_count;
+    header.seq = client->next_seq++;
+    memcpy(client->frame, &header, sizeof(header));
+
+    if (write_full(client->fd, client->frame, client->frame_len) != 0) return -1;
+
+    client->unacked++;
+    client->frame_len = sizeof(header);
+    client->frame_count = 0;
+    return 0;
+}
+
+int submit_client_add(SubmitClient* client, const char* name, Priority priority,
+                      unsigned int execution_time_ms, const TaskOptions* options) {
+    size_t name_len = strlen(name);
+    if (!submit_name_valid(name, name_len) || priority < PRIORITY_HIGH || priority > PRIORITY_LOW) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    size_t record_len = sizeof(SubmitTaskRecord) + name_len;
+    if (client->frame_count == SUBMIT_MAX_BATCH ||
+        client->frame_len + record_len > SUBMIT_MAX_FRAME) {
+        if (submit_client_flush(client) != 0) return -1;
+    }
+
+    SubmitTaskRecord record;
+    memset(&record, 0, sizeof(record));
+    record.priority = (uint8_t)priority;
+    record.name_len = (uint8_t)name_len;
+    record.execution_time_ms = execution_time_ms;
+    if (options != NULL) {
+        record.timeout_ms = options->timeout_ms;
+        record.max_retries = options->max_retries;
+        record.backoff_base_ms = options->backoff_base_ms;
+        record.backoff_cap_ms = options->backoff_cap_ms;
+        record.backoff_jitter = options->backoff_jitter;
+    }
+
+    memcpy(client->frame + client->frame_len, &record, sizeof(record));
+    memcpy(client->frame + client->frame_len + sizeof(record), name, name_len);
+    client->frame_len += record_len;
+    client->frame_count++;
+
+    if (client->frame_count == SUBMIT_MAX_BATCH) return submit_client_flush(client);
+    return 0;
+}
+
+int submit_client_wait(SubmitClient* client) {
+    if (submit_client_flush(client) != 0) return -1;
+    while (client->unacked > 0) {
+        if (read_ack(client) != 0) return -1;
+    }
+    return 0;
+}
+
+void submit_client_close(SubmitClient* client) {
+    if (client->fd >= 0) close(client->fd);
+    free(client->frame);
+    client->fd = -1;
+    client->frame = NULL;
+}
@@ -0,0 +1,45 @@
+#ifndef SUBMIT_CLIENT_H
+#define SUBMIT_CLIENT_H
+
+#include "common.h"
+#include "task_queue.h"
+#include "submit_proto.h"
+
+// Producer side of the submission socket. Tasks are packed into frames of
+// up to SUBMIT_MAX_BATCH; full frames are sent at once and up to
+// SUBMIT_WINDOW of them stay in flight before the client reads an ACK.
+
+// Called once per ACK with the result of every task in the frame, in the
+// order they were added: a task id or a SUBMIT_ERR_* code
+typedef void (*SubmitAckFn)(void* arg, uint32_t seq, const int32_t* results, int count);
+
+typedef struct {
+    int fd;
+    unsigned char* frame;       // Frame being filled (SUBMIT_MAX_FRAME bytes)
+    size_t frame_len;
+    int frame_count;
+    uint32_t next_seq;
+    int unacked;                // Frames sent whose ACK hasn't been read
+    SubmitAckFn on_ack;
+    void* ack_arg;
+} SubmitClient;
+
+// Connect to path or, when NULL, to $SUBMIT_SOCKET_ENV, else the socket of
+// the queue named by $QUEUE_NAME_ENV (SUBMIT_SOCKET_PATH for the default).
+// on_ack may be NULL. Returns 0, or -1 with errno set.
+int submit_client_open(SubmitClient* client, const char* path, SubmitAckFn on_ack, void* arg);
+
+// Add a task to the current frame, sending the frame when it fills.
+// Returns 0, or -1 (errno EINVAL for a bad task, else a socket error).
+int submit_client_add(SubmitClient* client, const char* name, Priority priority,
+                      unsigned int execution_time_ms, const TaskOptions* options);
+
+// Send the partly filled frame, if any
+int submit_client_flush(SubmitClient* client);
+
+// Flush, then read every outstanding ACK
+int submit_client_wait(SubmitClient* client);
+
+void submit_client_close(SubmitClient* client);
+
+#endif // SUBMIT_CLIENT_H
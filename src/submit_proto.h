@@ -0,0 +1,64 @@
+#ifndef SUBMIT_PROTO_H
+#define SUBMIT_PROTO_H
+
+#include "common.h"
+#include <stdint.h>
+
+// Wire format of the scheduler's submission socket. The socket is local
+// (AF_UNIX, SOCK_STREAM), so fields are in host byte order and the structs
+// are sent as-is.
+//
+// A producer writes TASKS frames back to back without waiting; the
+// scheduler answers every frame with one ACK frame, in order, carrying
+// the same seq. A malformed frame closes the connection.
+//
+//   TASKS: header, then count records. Each record is a SubmitTaskRecord
+//          followed by name_len bytes of name (no terminator).
+//   ACK:   header, then count int32_t results: the new task id, or a
+//          SUBMIT_ERR_* code, one per record of the acknowledged frame.
+
+#define SUBMIT_FRAME_TASKS 1
+#define SUBMIT_FRAME_ACK   2
+
+#define SUBMIT_ERR_FULL    -1   // Queue full; the task was not added
+#define SUBMIT_ERR_INVALID -2   // Bad priority, empty name or control characters
+
+typedef struct {
+    uint32_t length;            // Payload bytes after this header
+    uint16_t type;              // SUBMIT_FRAME_*
+    uint16_t count;             // Records (TASKS) or results (ACK), at most SUBMIT_MAX_BATCH
+    uint32_t seq;               // Chosen by the producer, echoed in the ACK
+} SubmitFrameHeader;
+
+typedef struct {
+    uint8_t priority;           // Priority enum value
+    uint8_t name_len;           // 1 to MAX_TASK_NAME_LEN - 1
+    uint16_t reserved;
+    uint32_t execution_time_ms;
+    uint32_t timeout_ms;        // The rest are TaskOptions; 0 = default
+    uint32_t max_retries;
+    uint32_t backoff_base_ms;
+    uint32_t backoff_cap_ms;
+    uint32_t backoff_jitter;
+} SubmitTaskRecord;
+
+// Names travel in federation OFFER lines and JSON too, so no control characters
+static inline int submit_name_valid(const char* name, size_t len) {
+    if (len == 0 || len >= MAX_TASK_NAME_LEN) return 0;
+    for (size_t i = 0; i < len; i++) {
+        if ((unsigned char)name[i] < 0x20 || name[i] == 0x7f) return 0;
+    }
+    return 1;
+}
+
+// Where a queue accepts submissions: SUBMIT_SOCKET_PATH for the default
+// queue, SUBMIT_QUEUE_SOCKET_FMT for a named one
+static inline void submit_socket_path_for(const char* queue, char* path, size_t size) {
+    if (strcmp(queue, DEFAULT_QUEUE_NAME) == 0) {
+        snprintf(path, size, "%s", SUBMIT_SOCKET_PATH);
+    } else {
+        snprintf(path, size, SUBMIT_QUEUE_SOCKET_FMT, queue);
+    }
+}
+
+#endif // SUBMIT_PROTO_H
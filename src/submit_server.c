@@ -0,0 +1,383 @@
+#include "submit_server.h"
+#include "submit_proto.h"
+#include "logger.h"
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+// Room for the backlog plus the one ACK that pushes it over
+#define SUBMIT_OUT_SIZE (SUBMIT_ACK_BACKLOG + sizeof(SubmitFrameHeader) + \
+                         SUBMIT_MAX_BATCH * sizeof(int32_t))
+
+typedef struct {
+    int fd;
+    int dead;                   // Close once the current event is handled
+    uint32_t events;            // Current epoll interest
+    unsigned char* in;          // SUBMIT_MAX_FRAME bytes
+    size_t in_len;
+    unsigned char* out;         // SUBMIT_OUT_SIZE bytes
+    size_t out_len;             // ACK bytes not yet sent
+} Producer;
+
+struct SubmitServer {
+    TaskQueue* queue;
+    pthread_t thread;
+    int running;
+
+    int epoll_fd;
+    int listen_fd;
+    int wake_fd;
+    int listen_tag, wake_tag;   // Their epoll data.ptr
+    char socket_path[sizeof(((struct sockaddr_un*)0)->sun_path)];
+
+    // Buffers are allocated on first use of a slot and kept for the next producer
+    Producer producers[SUBMIT_MAX_CLIENTS];
+
+    // Per-frame scratch; only the server's thread touches these
+    TaskSpec frame_specs[SUBMIT_MAX_BATCH];
+    int frame_spec_index[SUBMIT_MAX_BATCH];
+    int frame_ids[SUBMIT_MAX_BATCH];
+    int32_t frame_results[SUBMIT_MAX_BATCH];
+
+    unsigned long long frames_handled;
+    unsigned long long tasks_added;
+};
+
+static void set_interest(SubmitServer* s, Producer* p, uint32_t events) {
+    if (p->events == events) return;
+
+    struct epoll_event ev;
+    ev.events = events;
+    ev.data.ptr = p;
+    if (epoll_ctl(s->epoll_fd, EPOLL_CTL_MOD, p->fd, &ev) == 0) {
+        p->events = events;
+    } else {
+        p->dead = 1;
+    }
+}
+
+static void close_producer(SubmitServer* s, Producer* p) {
+    epoll_ctl(s->epoll_fd, EPOLL_CTL_DEL, p->fd, NULL);
+    close(p->fd);
+    p->fd = -1;
+}
+
+static void accept_producers(SubmitServer* s) {
+    for (;;) {
+        int fd = accept4(s->listen_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) {
+            if (errno != EAGAIN && errno != EINTR) {
+                LOG_WARN_F("Submit: accept failed: %s", strerror(errno));
+            }
+            return;
+        }
+
+        Producer* p = NULL;
+        for (int i = 0; i < SUBMIT_MAX_CLIENTS; i++) {
+            if (s->producers[i].fd < 0) {
+                p = &s->producers[i];
+                break;
+            }
+        }
+        if (p != NULL && p->in == NULL) {
+            p->in = malloc(SUBMIT_MAX_FRAME);
+            p->out = malloc(SUBMIT_OUT_SIZE);
+            if (p->in == NULL || p->out == NULL) {
+                free(p->in);
+                free(p->out);
+                p->in = p->out = NULL;
+                p = NULL;
+            }
+        }
+        if (p == NULL) {
+            LOG_WARN_F("Submit: refusing producer, %d already connected", SUBMIT_MAX_CLIENTS);
+            close(fd);
+            continue;
+        }
+
+        p->fd = fd;
+        p->dead = 0;
+        p->events = EPOLLIN;
+        p->in_len = 0;
+        p->out_len = 0;
+
+        struct epoll_event ev;
+        ev.events = EPOLLIN;
+        ev.data.ptr = p;
+        if (epoll_ctl(s->epoll_fd, EPOLL_CTL_ADD, fd, &ev) != 0) {
+            close(fd);
+            p->fd = -1;
+        }
+    }
+}
+
+// Decode and enqueue one TASKS frame, then queue its ACK. Returns -1 if
+// the payload doesn't hold exactly header->count well-formed records.
+static int handle_tasks(SubmitServer* s, Producer* p, const SubmitFrameHeader* header, const unsigned char* payload) {
+    size_t offset = 0;
+    int valid = 0;
+
+    for (int i = 0; i < header->count; i++) {
+        SubmitTaskRecord record;
+        if (header->length - offset < sizeof(record)) return -1;
+        memcpy(&record, payload + offset, sizeof(record));
+        offset += sizeof(record);
+        if (header->length - offset < record.name_len) return -1;
+        const char* name = (const char*)payload + offset;
+        offset += record.name_len;
+
+        if (record.priority > PRIORITY_LOW || !submit_name_valid(name, record.name_len)) {
+            s->frame_results[i] = SUBMIT_ERR_INVALID;
+            continue;
+        }
+
+        TaskSpec* spec = &s->frame_specs[valid];
+        memcpy(spec->name, name, record.name_len);
+        spec->name[record.name_len] = '\0';
+        spec->priority = (Priority)record.priority;
+        spec->execution_time_ms = record.execution_time_ms;
+        spec->options.timeout_ms = record.timeout_ms;
+        spec->options.max_retries = record.max_retries;
+        spec->options.backoff_base_ms = record.backoff_base_ms;
+        spec->options.backoff_cap_ms = record.backoff_cap_ms;
+        spec->options.backoff_jitter = record.backoff_jitter;
+        s->frame_spec_index[valid++] = i;
+    }
+    if (offset != header->length) return -1;
+
+    if (valid > 0) {
+        s->tasks_added += (unsigned long long)enqueue_task_batch(s->queue, s->frame_specs, valid, s->frame_ids);
+        for (int i = 0; i < valid; i++) {
+            s->frame_results[s->frame_spec_index[i]] = s->frame_ids[i] >= 0 ? s->frame_ids[i] : SUBMIT_ERR_FULL;
+        }
+    }
+    s->frames_handled++;
+
+    SubmitFrameHeader ack;
+    ack.length = header->count * sizeof(int32_t);
+    ack.type = SUBMIT_FRAME_ACK;
+    ack.count = header->count;
+    ack.seq = header->seq;
+    memcpy(p->out + p->out_len, &ack, sizeof(ack));
+    memcpy(p->out + p->out_len + sizeof(ack), s->frame_results, ack.length);
+    p->out_len += sizeof(ack) + ack.length;
+    return 0;
+}
+
+// Handle every complete frame buffered, unless the producer is too far
+// behind on reading its ACKs
+static void handle_frames(SubmitServer* s, Producer* p) {
+    size_t used = 0;
+
+    while (p->in_len - used >= sizeof(SubmitFrameHeader) &&
+           p->out_len <= SUBMIT_ACK_BACKLOG) {
+        SubmitFrameHeader header;
+        memcpy(&header, p->in + used, sizeof(header));
+        if (header.type != SUBMIT_FRAME_TASKS || header.count > SUBMIT_MAX_BATCH ||
+            header.length > SUBMIT_MAX_FRAME - sizeof(header)) {
+            LOG_WARN_F("Submit: malformed frame header (type %u, %u records, %u bytes), "
+                       "dropping producer", header.type, header.count, header.length);
+            p->dead = 1;
+            return;
+        }
+        if (p->in_len - used < sizeof(header) + header.length) break;
+
+        if (handle_tasks(s, p, &header, p->in + used + sizeof(header)) != 0) {
+            LOG_WARN_F("Submit: malformed frame %u, dropping producer", header.seq);
+            p->dead = 1;
+            return;
+        }
+        used += sizeof(header) + header.length;
+    }
+
+    if (used > 0) {
+        memmove(p->in, p->in + used, p->in_len - used);
+        p->in_len -= used;
+    }
+}
+
+static void flush_producer(Producer* p) {
+    size_t sent = 0;
+    while (sent < p->out_len) {
+        ssize_t n = send(p->fd, p->out + sent, p->out_len - sent, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            if (errno != EAGAIN) p->dead = 1;
+            break;
+        }
+        sent += (size_t)n;
+    }
+    if (sent > 0) {
+        memmove(p->out, p->out + sent, p->out_len - sent);
+        p->out_len -= sent;
+    }
+}
+
+static void service_producer(SubmitServer* s, Producer* p, uint32_t events) {
+    if ((events & EPOLLIN) && p->in_len < SUBMIT_MAX_FRAME) {
+        ssize_t n = read(p->fd, p->in + p->in_len, SUBMIT_MAX_FRAME - p->in_len);
+        if (n == 0 || (n < 0 && errno != EAGAIN && errno != EINTR)) {
+            p->dead = 1;
+            return;
+        }
+        if (n > 0) p->in_len += (size_t)n;
+    } else if (events & (EPOLLHUP | EPOLLERR)) {
+        p->dead = 1;
+        return;
+    }
+
+    handle_frames(s, p);
+    flush_producer(p);
+    if (!p->dead) {
+        // Frames held back by the backlog may fit now that ACKs went out
+        handle_frames(s, p);
+        flush_producer(p);
+    }
+    if (p->dead) return;
+
+    set_interest(s, p, (p->out_len <= SUBMIT_ACK_BACKLOG ? EPOLLIN : 0) |
+                    (p->out_len > 0 ? EPOLLOUT : 0));
+}
+
+static void* submit_server_thread(void* arg) {
+    SubmitServer* s = arg;
+
+    while (s->running) {
+        struct epoll_event events[SUBMIT_MAX_CLIENTS + 2];
+        int n = epoll_wait(s->epoll_fd, events, SUBMIT_MAX_CLIENTS + 2, -1);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            LOG_ERROR_F("Submit: epoll_wait failed: %s", strerror(errno));
+            break;
+        }
+
+        for (int i = 0; i < n; i++) {
+            void* tag = events[i].data.ptr;
+            if (tag == &s->wake_tag) {
+                s->running = 0;
+            } else if (tag == &s->listen_tag) {
+                accept_producers(s);
+            } else {
+                Producer* p = (Producer*)tag;
+                if (p->fd >= 0) service_producer(s, p, events[i].events);
+            }
+        }
+
+        // Close outside the event walk so no handler sees a reused slot
+        for (int i = 0; i < SUBMIT_MAX_CLIENTS; i++) {
+            if (s->producers[i].fd >= 0 && s->producers[i].dead) close_producer(s, &s->producers[i]);
+        }
+    }
+
+    return NULL;
+}
+
+static int open_listener(const char* path) {
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+    strcpy(addr.sun_path, path);
+
+    // Replace a socket file left behind by a scheduler that died, but
+    // never one that is still being served
+    int probe = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (probe >= 0) {
+        int live = connect(probe, (struct sockaddr*)&addr, sizeof(addr)) == 0;
+        close(probe);
+        if (live) {
+            errno = EADDRINUSE;
+            return -1;
+        }
+    }
+    unlink(path);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) return -1;
+    if (bind(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0 ||
+        chmod(path, 0666) != 0 || listen(fd, SOMAXCONN) != 0) {
+        int saved = errno;
+        close(fd);
+        errno = saved;
+        return -1;
+    }
+    return fd;
+}
+
+static int add_fd(SubmitServer* s, int fd, void* tag) {
+    struct epoll_event ev;
+    ev.events = EPOLLIN;
+    ev.data.ptr = tag;
+    return epoll_ctl(s->epoll_fd, EPOLL_CTL_ADD, fd, &ev);
+}
+
+static void free_server(SubmitServer* s) {
+    for (int i = 0; i < SUBMIT_MAX_CLIENTS; i++) {
+        if (s->producers[i].fd >= 0) close_producer(s, &s->producers[i]);
+        free(s->producers[i].in);
+        free(s->producers[i].out);
+    }
+    if (s->listen_fd >= 0) close(s->listen_fd);
+    if (s->wake_fd >= 0) close(s->wake_fd);
+    if (s->epoll_fd >= 0) close(s->epoll_fd);
+    free(s);
+}
+
+SubmitServer* submit_server_start(TaskQueue* queue, const char* path) {
+    if (queue == NULL || path == NULL) return NULL;
+
+    SubmitServer* s = calloc(1, sizeof(*s));
+    if (s == NULL) return NULL;
+    s->queue = queue;
+    s->epoll_fd = s->wake_fd = -1;
+    for (int i = 0; i < SUBMIT_MAX_CLIENTS; i++) {
+        s->producers[i].fd = -1;
+    }
+
+    s->listen_fd = open_listener(path);
+    if (s->listen_fd < 0) {
+        LOG_ERROR_F("Submit: cannot listen on %s: %s", path, strerror(errno));
+        free_server(s);
+        return NULL;
+    }
+    snprintf(s->socket_path, sizeof(s->socket_path), "%s", path);
+
+    s->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    s->wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (s->epoll_fd < 0 || s->wake_fd < 0 ||
+        add_fd(s, s->listen_fd, &s->listen_tag) != 0 || add_fd(s, s->wake_fd, &s->wake_tag) != 0) {
+        LOG_ERROR_F("Submit: cannot set up event loop: %s", strerror(errno));
+        unlink(s->socket_path);
+        free_server(s);
+        return NULL;
+    }
+
+    s->running = 1;
+    if (pthread_create(&s->thread, NULL, submit_server_thread, s) != 0) {
+        unlink(s->socket_path);
+        free_server(s);
+        return NULL;
+    }
+
+    LOG_INFO_F("Submit: accepting tasks on %s", s->socket_path);
+    return s;
+}
+
+void submit_server_stop(SubmitServer* s) {
+    if (s == NULL) return;
+
+    uint64_t one = 1;
+    if (write(s->wake_fd, &one, sizeof(one)) < 0) {
+        LOG_WARN_F("Submit: failed to wake thread: %s", strerror(errno));
+    }
+    pthread_join(s->thread, NULL);
+
+    unlink(s->socket_path);
+    LOG_INFO_F("Submit: closed %s after %llu frames, %llu tasks added",
+               s->socket_path, s->frames_handled, s->tasks_added);
+    free_server(s);
+}
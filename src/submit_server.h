@@ -0,0 +1,21 @@
+#ifndef SUBMIT_SERVER_H
+#define SUBMIT_SERVER_H
+
+#include "common.h"
+#include "task_queue.h"
+
+// Scheduler side of the submission socket (wire format in submit_proto.h).
+// Each server has one thread serving every producer from an epoll loop;
+// each TASKS frame is enqueued under a single queue lock and acknowledged
+// in order. A scheduler runs one server per queue.
+typedef struct SubmitServer SubmitServer;
+
+// Listen on path for tasks bound for queue. A stale socket file is
+// replaced; one that still accepts connections belongs to another
+// scheduler and is an error. Returns NULL on failure.
+SubmitServer* submit_server_start(TaskQueue* queue, const char* path);
+
+// Stop the thread, drop producers, remove the socket file and free s
+void submit_server_stop(SubmitServer* s);
+
+#endif // SUBMIT_SERVER_H
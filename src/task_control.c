@@ -0,0 +1,351 @@
+#include "task_control.h"
+#include "logger.h"
+#include "worker_stats.h"
+#include <stdint.h>
+
+// Polls a cancel request may go unmatched before we stop looking for it. A
+// task is RUNNING slightly before its executor registers it, but a request
+// for a task that died with a previous worker of the same id never matches.
+#define CANCEL_MATCH_RETRIES 10
+
+struct TaskControlEntry {
+    int task_id;
+    uint64_t deadline_ns;          // CLOCK_MONOTONIC; 0 = no timeout
+    int heap_index;                // Slot in the deadline heap, -1 if absent
+    int fired;                     // Callback already ran
+    TaskCancelFn fn;
+    void* ctx;
+    TaskControlEntry* prev;
+    TaskControlEntry* next;
+};
+
+static TaskQueue* control_queue = NULL;
+static int control_worker_id = -1;
+static pthread_t control_thread;
+static int control_running = 0;
+
+// Everything below is protected by control_mutex
+static pthread_mutex_t control_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t control_cond;
+static TaskControlEntry* entries = NULL;
+static TaskControlEntry** heap = NULL;
+static int heap_size = 0;
+static int heap_capacity = 0;
+static int seen_cancel_seq = 0;
+static int unmatched_polls = 0;
+
+static uint64_t monotonic_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static struct timespec ns_to_timespec(uint64_t ns) {
+    struct timespec ts;
+    ts.tv_sec = (time_t)(ns / 1000000000ULL);
+    ts.tv_nsec = (long)(ns % 1000000000ULL);
+    return ts;
+}
+
+static void init_monotonic_cond(pthread_cond_t* cond) {
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(cond, &attr);
+    pthread_condattr_destroy(&attr);
+}
+
+static void heap_set(int i, TaskControlEntry* e) {
+    heap[i] = e;
+    e->heap_index = i;
+}
+
+static void heap_sift_up(int i) {
+    TaskControlEntry* e = heap[i];
+    while (i > 0) {
+        int parent = (i - 1) / 2;
+        if (heap[parent]->deadline_ns <= e->deadline_ns) break;
+        heap_set(i, heap[parent]);
+        i = parent;
+    }
+    heap_set(i, e);
+}
+
+static void heap_sift_down(int i) {
+    TaskControlEntry* e = heap[i];
+    for (;;) {
+        int child = 2 * i + 1;
+        if (child >= heap_size) break;
+        if (child + 1 < heap_size && heap[child + 1]->deadline_ns < heap[child]->deadline_ns) {
+            child++;
+        }
+        if (e->deadline_ns <= heap[child]->deadline_ns) break;
+        heap_set(i, heap[child]);
+        i = child;
+    }
+    heap_set(i, e);
+}
+
+static int heap_push(TaskControlEntry* e) {
+    if (heap_size == heap_capacity) {
+        int new_capacity = heap_capacity ? heap_capacity * 2 : 64;
+        TaskControlEntry** grown = realloc(heap, new_capacity * sizeof(TaskControlEntry*));
+        if (grown == NULL) return -1;
+        heap = grown;
+        heap_capacity = new_capacity;
+    }
+    heap_set(heap_size++, e);
+    heap_sift_up(e->heap_index);
+    return 0;
+}
+
+static void heap_remove(TaskControlEntry* e) {
+    int i = e->heap_index;
+    if (i < 0) return;
+    e->heap_index = -1;
+
+    TaskControlEntry* last = heap[--heap_size];
+    if (i == heap_size) return;
+    heap_set(i, last);
+    heap_sift_up(i);
+    heap_sift_down(last->heap_index);
+}
+
+static void fire_entry(TaskControlEntry* e, TaskCancelReason reason) {
+    heap_remove(e);
+    e->fired = 1;
+    e->fn(e->ctx, reason);
+}
+
+static TaskControlEntry* find_entry(int task_id) {
+    for (TaskControlEntry* e = entries; e != NULL; e = e->next) {
+        if (e->task_id == task_id) return e;
+    }
+    return NULL;
+}
+
+// Fire every cancel request aimed at this worker; returns how many RUNNING
+// tasks asked to stop are not registered here (control_mutex held)
+static int scan_cancel_requests(void) {
+    int unmatched = 0;
+
+    lock_queue(control_queue);
+    for (int i = 0; i < control_queue->size; i++) {
+        Task* task = &control_queue->tasks[i];
+        if (task->status != STATUS_RUNNING || task->worker_id != control_worker_id ||
+            !task->cancel_requested) {
+            continue;
+        }
+        TaskControlEntry* e = find_entry(task->id);
+        if (e == NULL) {
+            unmatched++;
+        } else if (!e->fired) {
+            fire_entry(e, CANCEL_REASON_REQUESTED);
+        }
+    }
+    unlock_queue(control_queue);
+
+    return unmatched;
+}
+
+static void* control_thread_main(void* arg) {
+    (void)arg;
+
+    pthread_mutex_lock(&control_mutex);
+    while (control_running) {
+        worker_stats_heartbeat();
+
+        uint64_t now = monotonic_ns();
+        while (heap_size > 0 && heap[0]->deadline_ns <= now) {
+            fire_entry(heap[0], CANCEL_REASON_TIMEOUT);
+        }
+
+        // Only walk the shared queue when someone actually asked for a cancel
+        int seq = __atomic_load_n(&control_queue->cancel_seq, __ATOMIC_ACQUIRE);
+        if (seq != seen_cancel_seq) {
+            if (scan_cancel_requests() == 0 || ++unmatched_polls >= CANCEL_MATCH_RETRIES) {
+                seen_cancel_seq = seq;
+                unmatched_polls = 0;
+            }
+        }
+
+        uint64_t wake = now + (uint64_t)CANCEL_POLL_INTERVAL_MS * 1000000ULL;
+        if (heap_size > 0 && heap[0]->deadline_ns < wake) {
+            wake = heap[0]->deadline_ns;
+        }
+        struct timespec ts = ns_to_timespec(wake);
+        pthread_cond_timedwait(&control_cond, &control_mutex, &ts);
+    }
+    pthread_mutex_unlock(&control_mutex);
+
+    return NULL;
+}
+
+int task_control_start(TaskQueue* queue, int worker_id) {
+    if (queue == NULL) return -1;
+
+    control_queue = queue;
+    control_worker_id = worker_id;
+    seen_cancel_seq = __atomic_load_n(&queue->cancel_seq, __ATOMIC_ACQUIRE);
+    init_monotonic_cond(&control_cond);
+
+    control_running = 1;
+    if (pthread_create(&control_thread, NULL, control_thread_main, NULL) != 0) {
+        control_running = 0;
+        pthread_cond_destroy(&control_cond);
+        return -1;
+    }
+    return 0;
+}
+
+void task_control_stop(void) {
+    pthread_mutex_lock(&control_mutex);
+    if (!control_running) {
+        pthread_mutex_unlock(&control_mutex);
+        return;
+    }
+    control_running = 0;
+    pthread_cond_signal(&control_cond);
+    pthread_mutex_unlock(&control_mutex);
+
+    pthread_join(control_thread, NULL);
+
+    // Detached task threads may still unregister, so entries and the heap
+    // stay valid until the process exits
+}
+
+TaskControlEntry* task_control_register(const Task* task, TaskCancelFn fn, void* ctx) {
+    if (task == NULL || fn == NULL) return NULL;
+
+    TaskControlEntry* e = malloc(sizeof(TaskControlEntry));
+    if (e == NULL) return NULL;
+    e->task_id = task->id;
+    e->deadline_ns = 0;
+    e->heap_index = -1;
+    e->fired = 0;
+    e->fn = fn;
+    e->ctx = ctx;
+    e->prev = NULL;
+
+    pthread_mutex_lock(&control_mutex);
+    e->next = entries;
+    if (entries != NULL) entries->prev = e;
+    entries = e;
+
+    if (task->timeout_ms > 0) {
+        e->deadline_ns = monotonic_ns() + (uint64_t)task->timeout_ms * 1000000ULL;
+        if (heap_push(e) != 0) {
+            LOG_WARN_F("Worker %d: Out of memory arming timeout for task %d",
+                       control_worker_id, task->id);
+        } else if (e->heap_index == 0 && control_running) {
+            // New earliest deadline: let the control thread re-arm
+            pthread_cond_signal(&control_cond);
+        }
+    }
+    pthread_mutex_unlock(&control_mutex);
+
+    return e;
+}
+
+void task_control_unregister(TaskControlEntry* e) {
+    if (e == NULL) return;
+
+    pthread_mutex_lock(&control_mutex);
+    heap_remove(e);
+    if (e->prev != NULL) {
+        e->prev->next = e->next;
+    } else {
+        entries = e->next;
+    }
+    if (e->next != NULL) e->next->prev = e->prev;
+    pthread_mutex_unlock(&control_mutex);
+
+    free(e);
+}
+
+int task_control_cancel_all(TaskCancelReason reason) {
+    int fired = 0;
+
+    pthread_mutex_lock(&control_mutex);
+    for (TaskControlEntry* e = entries; e != NULL; e = e->next) {
+        if (!e->fired) {
+            fire_entry(e, reason);
+            fired++;
+        }
+    }
+    pthread_mutex_unlock(&control_mutex);
+
+    return fired;
+}
+
+const char* cancel_reason_to_string(TaskCancelReason reason) {
+    switch (reason) {
+        case CANCEL_REASON_TIMEOUT: return "timed out";
+        case CANCEL_REASON_REQUESTED: return "cancelled";
+        case CANCEL_REASON_HANDBACK: return "handed back";
+        default: return "not cancelled";
+    }
+}
+
+void task_cancel_error(const Task* task, TaskCancelReason reason, char* buf, size_t size) {
+    if (reason == CANCEL_REASON_TIMEOUT) {
+        snprintf(buf, size, "timed out after %u ms", task->timeout_ms);
+    } else {
+        snprintf(buf, size, "%s", cancel_reason_to_string(reason));
+    }
+}
+
+int fail_task_logged(TaskQueue* queue, int worker_id, const Task* task, const char* error,
+                     const TaskUsage* usage) {
+    unsigned int delay = 0;
+    int outcome = fail_task(queue, task->id, error, usage, &delay);
+    if (outcome == STATUS_RETRY_WAIT) {
+        LOG_WARN_F("Worker %d: Task %d failed (%s), retry %u of %u in %u ms", worker_id,
+                   task->id, error, task->attempts, task->max_retries, delay);
+    } else {
+        LOG_WARN_F("Worker %d: Task %d failed (%s)", worker_id, task->id, error);
+    }
+    return outcome;
+}
+
+void cancel_token_init(CancelToken* token) {
+    pthread_mutex_init(&token->mutex, NULL);
+    init_monotonic_cond(&token->cond);
+    token->reason = CANCEL_REASON_NONE;
+}
+
+void cancel_token_destroy(CancelToken* token) {
+    pthread_cond_destroy(&token->cond);
+    pthread_mutex_destroy(&token->mutex);
+}
+
+void cancel_token_fire(void* ctx, TaskCancelReason reason) {
+    CancelToken* token = (CancelToken*)ctx;
+    pthread_mutex_lock(&token->mutex);
+    if (token->reason == CANCEL_REASON_NONE) {
+        token->reason = reason;
+    }
+    pthread_cond_broadcast(&token->cond);
+    pthread_mutex_unlock(&token->mutex);
+}
+
+TaskCancelReason cancel_token_reason(CancelToken* token) {
+    pthread_mutex_lock(&token->mutex);
+    TaskCancelReason reason = token->reason;
+    pthread_mutex_unlock(&token->mutex);
+    return reason;
+}
+
+TaskCancelReason cancel_token_sleep(CancelToken* token, unsigned int ms) {
+    struct timespec deadline = ns_to_timespec(monotonic_ns() + (uint64_t)ms * 1000000ULL);
+
+    pthread_mutex_lock(&token->mutex);
+    while (token->reason == CANCEL_REASON_NONE) {
+        if (pthread_cond_timedwait(&token->cond, &token->mutex, &deadline) == ETIMEDOUT) {
+            break;
+        }
+    }
+    TaskCancelReason reason = token->reason;
+    pthread_mutex_unlock(&token->mutex);
+    return reason;
+}
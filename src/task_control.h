@@ -0,0 +1,59 @@
+#ifndef TASK_CONTROL_H
+#define TASK_CONTROL_H
+
+#include "common.h"
+#include "task_queue.h"
+
+// Per-worker timeout and cancellation control. One control thread per
+// worker keeps a deadline heap of the tasks it runs and watches the queue
+// for cancel requests; whichever fires first invokes the task's cancel
+// callback exactly once.
+
+typedef enum {
+    CANCEL_REASON_NONE = 0,
+    CANCEL_REASON_TIMEOUT = 1,
+    CANCEL_REASON_REQUESTED = 2,
+    CANCEL_REASON_HANDBACK = 3     // Worker is draining: stop and requeue the task
+} TaskCancelReason;
+
+// Called with the control lock held: must not block or call back into
+// task_control_*
+typedef void (*TaskCancelFn)(void* ctx, TaskCancelReason reason);
+
+typedef struct TaskControlEntry TaskControlEntry;
+
+int task_control_start(TaskQueue* queue, int worker_id);
+void task_control_stop(void);
+
+// Track a claimed task; its timeout (if any) counts from now
+TaskControlEntry* task_control_register(const Task* task, TaskCancelFn fn, void* ctx);
+// After this returns the callback will not run for the entry
+void task_control_unregister(TaskControlEntry* entry);
+
+// Fire every registered task that has not been cancelled yet; returns how many
+int task_control_cancel_all(TaskCancelReason reason);
+
+const char* cancel_reason_to_string(TaskCancelReason reason);
+// Describe why a task was stopped, for its last_error
+void task_cancel_error(const Task* task, TaskCancelReason reason, char* buf, size_t size);
+
+// fail_task() for a claimed task, logging whether it will be retried
+int fail_task_logged(TaskQueue* queue, int worker_id, const Task* task, const char* error,
+                     const TaskUsage* usage);
+
+// Cooperative cancellation token for in-process task handlers
+typedef struct {
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    TaskCancelReason reason;
+} CancelToken;
+
+void cancel_token_init(CancelToken* token);
+void cancel_token_destroy(CancelToken* token);
+void cancel_token_fire(void* ctx, TaskCancelReason reason);  // A TaskCancelFn
+TaskCancelReason cancel_token_reason(CancelToken* token);
+
+// Sleep for ms unless cancelled first; returns the reason or CANCEL_REASON_NONE
+TaskCancelReason cancel_token_sleep(CancelToken* token, unsigned int ms);
+
+#endif // TASK_CONTROL_H
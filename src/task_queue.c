@@ -1,20 +1,171 @@
 #include "task_queue.h"
 #include "logger.h"
+#include "trace.h"
 #include <sys/stat.h>
+#include <sched.h>
+#include <stdint.h>
 
-static int shm_id = -1;
+int queue_name_valid(const char* name) {
+    size_t len = strlen(name);
+    if (len == 0 || len >= MAX_QUEUE_NAME_LEN) return 0;
+    for (size_t i = 0; i < len; i++) {
+        char c = name[i];
+        if (!((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') ||
+              c == '-' || c == '_')) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// Names end up in federation OFFER lines, CSV and JSON, so no control characters
+int task_name_valid(const char* name) {
+    if (name == NULL || name[0] == '\0') return 0;
+    for (const char* p = name; *p != '\0'; p++) {
+        if ((unsigned char)*p < 0x20 || *p == 0x7f) return 0;
+    }
+    return 1;
+}
+
+const char* queue_name(void) {
+    const char* env = getenv(QUEUE_NAME_ENV);
+    if (env != NULL && queue_name_valid(env)) return env;
+    return DEFAULT_QUEUE_NAME;
+}
+
+// FNV-1a of the name, kept off SHM_KEY and off the reserved IPC_PRIVATE (0)
+key_t queue_shm_key_for(const char* name) {
+    if (strcmp(name, DEFAULT_QUEUE_NAME) == 0) return SHM_KEY;
+    
+    uint32_t hash = 2166136261u;
+    for (const unsigned char* p = (const unsigned char*)name; *p != '\0'; p++) {
+        hash ^= *p;
+        hash *= 16777619u;
+    }
+    if (hash == 0 || hash == (uint32_t)SHM_KEY) hash ^= 0x5a5a5a5au;
+    return (key_t)hash;
+}
 
-int init_shared_memory(void) {
+key_t queue_shm_key(void) {
+    const char* env = getenv(SHM_KEY_ENV);
+    if (env != NULL && env[0] != '\0') {
+        char* end;
+        unsigned long key = strtoul(env, &end, 0);
+        if (*end == '\0') return (key_t)key;
+    }
+    return queue_shm_key_for(queue_name());
+}
+
+// Task indexes (mutex held). Each list is doubly linked through
+// task_index by position; worker selects the worker links.
+static int* index_link(TaskQueue* queue, int pos, int worker, int next) {
+    TaskIndexEntry* entry = &queue->task_index[pos];
+    if (worker) return next ? &entry->worker_next : &entry->worker_prev;
+    return next ? &entry->status_next : &entry->status_prev;
+}
+
+static void index_unlink(TaskQueue* queue, TaskIndexList* list, int pos, int worker) {
+    int prev = *index_link(queue, pos, worker, 0);
+    int next = *index_link(queue, pos, worker, 1);
+    if (prev >= 0) *index_link(queue, prev, worker, 1) = next;
+    else list->head = next;
+    if (next >= 0) *index_link(queue, next, worker, 0) = prev;
+    else list->tail = prev;
+    list->count--;
+    Priority priority = queue->tasks[pos].priority;
+    if (priority >= 0 && priority < PRIORITY_COUNT) list->priority_count[priority]--;
+}
+
+static void index_append(TaskQueue* queue, TaskIndexList* list, int pos, int worker) {
+    *index_link(queue, pos, worker, 0) = list->tail;
+    *index_link(queue, pos, worker, 1) = -1;
+    if (list->tail >= 0) *index_link(queue, list->tail, worker, 1) = pos;
+    else list->head = pos;
+    list->tail = pos;
+    list->count++;
+    Priority priority = queue->tasks[pos].priority;
+    if (priority >= 0 && priority < PRIORITY_COUNT) list->priority_count[priority]++;
+}
+
+// Move the task to the lists of its current status and worker
+static void index_update_locked(TaskQueue* queue, Task* task) {
+    int pos = (int)(task - queue->tasks);
+    TaskIndexEntry* entry = &queue->task_index[pos];
+    
+    int status = task->status >= 0 && task->status < TASK_STATUS_COUNT ? (int)task->status : -1;
+    if (entry->status != status) {
+        if (entry->status >= 0) index_unlink(queue, &queue->status_index[entry->status], pos, 0);
+        if (status >= 0) index_append(queue, &queue->status_index[status], pos, 0);
+        entry->status = status;
+    }
+    int worker = task->worker_id >= 0 && task->worker_id < MAX_WORKERS ? task->worker_id : -1;
+    if (entry->worker != worker) {
+        if (entry->worker >= 0) index_unlink(queue, &queue->worker_index[entry->worker], pos, 1);
+        if (worker >= 0) index_append(queue, &queue->worker_index[worker], pos, 1);
+        entry->worker = worker;
+    }
+}
+
+static void index_entry_clear(TaskIndexEntry* entry) {
+    entry->status_prev = entry->status_next = -1;
+    entry->worker_prev = entry->worker_next = -1;
+    entry->status = entry->worker = -1;
+}
+
+static void index_list_clear(TaskIndexList* list) {
+    list->head = list->tail = -1;
+    list->count = 0;
+    memset(list->priority_count, 0, sizeof(list->priority_count));
+}
+
+// Index every task afresh, after the array was compacted
+static void index_rebuild_locked(TaskQueue* queue) {
+    for (int s = 0; s < TASK_STATUS_COUNT; s++) index_list_clear(&queue->status_index[s]);
+    for (int w = 0; w < MAX_WORKERS; w++) index_list_clear(&queue->worker_index[w]);
+    for (int i = 0; i < queue->size; i++) {
+        index_entry_clear(&queue->task_index[i]);
+        index_update_locked(queue, &queue->tasks[i]);
+    }
+}
+
+// Open an unlisted entry at pos, where a task is being inserted: entries
+// from pos on move up one, and every link to them is renumbered
+static void index_insert_locked(TaskQueue* queue, int pos) {
+    if (pos < queue->size) {
+        memmove(&queue->task_index[pos + 1], &queue->task_index[pos],
+                (size_t)(queue->size - pos) * sizeof(TaskIndexEntry));
+        for (int i = 0; i <= queue->size; i++) {
+            TaskIndexEntry* entry = &queue->task_index[i];
+            if (entry->status_prev >= pos) entry->status_prev++;
+            if (entry->status_next >= pos) entry->status_next++;
+            if (entry->worker_prev >= pos) entry->worker_prev++;
+            if (entry->worker_next >= pos) entry->worker_next++;
+        }
+        for (int s = 0; s < TASK_STATUS_COUNT; s++) {
+            TaskIndexList* list = &queue->status_index[s];
+            if (list->head >= pos) list->head++;
+            if (list->tail >= pos) list->tail++;
+        }
+        for (int w = 0; w < MAX_WORKERS; w++) {
+            TaskIndexList* list = &queue->worker_index[w];
+            if (list->head >= pos) list->head++;
+            if (list->tail >= pos) list->tail++;
+        }
+    }
+    index_entry_clear(&queue->task_index[pos]);
+}
+
+int init_shared_memory(key_t key) {
     size_t shm_size = sizeof(TaskQueue);
     int created = 0;
     
     // Create shared memory segment
-    shm_id = shmget(SHM_KEY, shm_size, IPC_CREAT | IPC_EXCL | 0666);
+    int shm_id = shmget(key, shm_size, IPC_CREAT | IPC_EXCL | 0666);
     
     if (shm_id == -1) {
         if (errno == EEXIST) {
             // Already exists, try to get it
-            shm_id = shmget(SHM_KEY, shm_size, 0666);
+            shm_id = shmget(key, shm_size, 0666);
             if (shm_id == -1) {
                 perror("shmget: Failed to access existing shared memory");
                 return -1;
@@ -44,8 +195,30 @@ int init_shared_memory(void) {
         queue->completed_tasks = 0;
         queue->failed_tasks = 0;
         queue->num_active_workers = 0;
+        queue->min_workers = NUM_WORKERS;
+        queue->max_workers = NUM_WORKERS;
+        queue->config.threads_per_worker = MAX_THREADS_PER_WORKER;
+        queue->config.sched_policy = DEFAULT_SCHED_POLICY;
+        queue->config.cleanup_interval = CLEANUP_INTERVAL;
+        queue->config.completed_task_max_age = COMPLETED_TASK_MAX_AGE;
+        queue->config_generation = 0;
         queue->shutdown_flag = 0;
         queue->scheduler_pid = 0;
+        memset(queue->name, 0, sizeof(queue->name));
+        queue->cancel_seq = 0;
+        queue->snapshot_seq = 0;
+        memset(queue->workers, 0, sizeof(queue->workers));
+        queue->retry_count = 0;
+        queue->change_seq = 0;
+        queue->handoff_seq = 0;
+        struct timespec now;
+        clock_gettime(CLOCK_REALTIME, &now);
+        queue->incarnation = (unsigned long long)now.tv_sec * 1000000000ULL +
+                             (unsigned long long)now.tv_nsec;
+        queue->version = 0;
+        queue->created_at = time(NULL);
+        index_rebuild_locked(queue);
+        memset(&queue->metrics, 0, sizeof(queue->metrics));
         
         // Initialize mutex with process-shared attribute
         pthread_mutexattr_t mutex_attr;
@@ -59,6 +232,10 @@ int init_shared_memory(void) {
         pthread_condattr_init(&cond_attr);
         pthread_condattr_setpshared(&cond_attr, PTHREAD_PROCESS_SHARED);
         pthread_cond_init(&queue->queue_cond, &cond_attr);
+        
+        // Retry deadlines are monotonic so clock steps can't stall or rush them
+        pthread_condattr_setclock(&cond_attr, CLOCK_MONOTONIC);
+        pthread_cond_init(&queue->retry_cond, &cond_attr);
         pthread_condattr_destroy(&cond_attr);
     }
     
@@ -68,7 +245,7 @@ int init_shared_memory(void) {
 
 TaskQueue* attach_shared_memory(int shm_id_to_attach) {
     if (shm_id_to_attach == -1) {
-        shm_id_to_attach = shmget(SHM_KEY, sizeof(TaskQueue), 0666);
+        shm_id_to_attach = shmget(queue_shm_key(), sizeof(TaskQueue), 0666);
         if (shm_id_to_attach == -1) {
             perror("shmget: Failed to attach to shared memory");
             return NULL;
@@ -81,7 +258,6 @@ TaskQueue* attach_shared_memory(int shm_id_to_attach) {
         return NULL;
     }
     
-    shm_id = shm_id_to_attach;
     return queue;
 }
 
@@ -97,14 +273,140 @@ void destroy_shared_memory(int shm_id_to_destroy) {
     }
 }
 
-int enqueue_task(TaskQueue* queue, const char* name, Priority priority, unsigned int execution_time_ms) {
-    if (queue == NULL) return -1;
-    
+// snapshot_seq is only written with queue_mutex held: odd from lock to
+// unlock, so a reader that sees the same even value before and after its
+// copy knows no writer touched the queue in between
+static void begin_queue_write(TaskQueue* queue) {
+    __atomic_store_n(&queue->snapshot_seq, queue->snapshot_seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+static void end_queue_write(TaskQueue* queue) {
+    __atomic_store_n(&queue->snapshot_seq, queue->snapshot_seq + 1, __ATOMIC_RELEASE);
+}
+
+void lock_queue(TaskQueue* queue) {
     pthread_mutex_lock(&queue->queue_mutex);
+    begin_queue_write(queue);
+}
+
+void unlock_queue(TaskQueue* queue) {
+    end_queue_write(queue);
+    pthread_mutex_unlock(&queue->queue_mutex);
+}
+
+int wait_queue(TaskQueue* queue, pthread_cond_t* cond, const struct timespec* abstime) {
+    end_queue_write(queue);
+    int rc = abstime != NULL ? pthread_cond_timedwait(cond, &queue->queue_mutex, abstime)
+                             : pthread_cond_wait(cond, &queue->queue_mutex);
+    begin_queue_write(queue);
+    return rc;
+}
+
+static void copy_snapshot(const TaskQueue* queue, QueueSnapshot* snapshot) {
+    int size = queue->size;
+    if (size < 0 || size > MAX_TASKS) size = 0;  // Torn read; the seq check will catch it
+    snapshot->size = size;
+    snapshot->capacity = queue->capacity;
+    snapshot->total_tasks = queue->total_tasks;
+    snapshot->completed_tasks = queue->completed_tasks;
+    snapshot->failed_tasks = queue->failed_tasks;
+    snapshot->num_active_workers = queue->num_active_workers;
+    snapshot->min_workers = queue->min_workers;
+    snapshot->max_workers = queue->max_workers;
+    snapshot->config = queue->config;
+    memcpy(snapshot->tasks, queue->tasks, (size_t)size * sizeof(Task));
+}
+
+int snapshot_queue(TaskQueue* queue, QueueSnapshot* snapshot) {
+    if (queue == NULL || snapshot == NULL) return -1;
     
-    if (is_queue_full(queue)) {
-        pthread_mutex_unlock(&queue->queue_mutex);
-        return -1;
+    for (int attempt = 0; attempt < SNAPSHOT_MAX_RETRIES; attempt++) {
+        unsigned int before = __atomic_load_n(&queue->snapshot_seq, __ATOMIC_ACQUIRE);
+        if (before & 1) {
+            sched_yield();
+            continue;
+        }
+        copy_snapshot(queue, snapshot);
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&queue->snapshot_seq, __ATOMIC_RELAXED) == before) {
+            snapshot->seq = before;
+            return 0;
+        }
+    }
+    
+    // Writers kept overlapping our copy: take the lock. Plain mutex, so the
+    // seq stays even and a later snapshot of the same state compares equal.
+    pthread_mutex_lock(&queue->queue_mutex);
+    copy_snapshot(queue, snapshot);
+    snapshot->seq = queue->snapshot_seq;
+    pthread_mutex_unlock(&queue->queue_mutex);
+    return 0;
+}
+
+// Append to the change log and reindex the task, whose status and worker
+// must already be the new ones (mutex held)
+static void record_change_locked(TaskQueue* queue, Task* task, TaskChangeKind kind) {
+    TaskChange* entry = &queue->change_log[queue->change_seq % CHANGE_LOG_SIZE];
+    entry->task_id = task->id;
+    entry->kind = kind;
+    __atomic_store_n(&queue->change_seq, queue->change_seq + 1, __ATOMIC_RELEASE);
+    if (kind != TASK_CHANGE_REMOVED) index_update_locked(queue, task);
+    queue_modified(queue);
+}
+
+void queue_modified(TaskQueue* queue) {
+    __atomic_add_fetch(&queue->version, 1, __ATOMIC_RELEASE);
+}
+
+unsigned long long queue_version(TaskQueue* queue) {
+    return __atomic_load_n(&queue->version, __ATOMIC_ACQUIRE);
+}
+
+unsigned long long queue_clock_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec * 1000000000ULL + (unsigned long long)ts.tv_nsec;
+}
+
+void metrics_observe(LatencyHistogram* histogram, unsigned long long us) {
+    // Smallest i with us <= base << i: the bit length of (us - 1) / base
+    unsigned long long units = us > 0 ? (us - 1) / METRICS_BUCKET_BASE_US : 0;
+    int bucket = units > 0 ? 64 - __builtin_clzll(units) : 0;
+    if (bucket >= METRICS_BUCKETS) bucket = METRICS_BUCKETS - 1;
+    __atomic_add_fetch(&histogram->buckets[bucket], 1ULL, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&histogram->sum_us, us, __ATOMIC_RELAXED);
+}
+
+void metrics_read(TaskQueue* queue, QueueMetrics* out) {
+    const unsigned long long* from = (const unsigned long long*)&queue->metrics;
+    unsigned long long* to = (unsigned long long*)out;
+    for (size_t i = 0; i < sizeof(QueueMetrics) / sizeof(unsigned long long); i++) {
+        to[i] = __atomic_load_n(&from[i], __ATOMIC_RELAXED);
+    }
+}
+
+const char* task_change_to_string(int kind) {
+    switch (kind) {
+        case TASK_CHANGE_ENQUEUED: return "enqueued";
+        case TASK_CHANGE_STARTED: return "started";
+        case TASK_CHANGE_FINISHED: return "finished";
+        case TASK_CHANGE_CANCELLED: return "cancelled";
+        case TASK_CHANGE_REMOVED: return "removed";
+        default: return "updated";
+    }
+}
+
+int enqueue_task(TaskQueue* queue, const char* name, Priority priority, unsigned int execution_time_ms) {
+    return enqueue_task_ex(queue, name, priority, execution_time_ms, NULL);
+}
+
+// Insert a new PENDING task and wake a worker (mutex held). NULL if full
+// or the name fails task_name_valid.
+static Task* enqueue_task_locked(TaskQueue* queue, const char* name, Priority priority,
+                                 unsigned int execution_time_ms, const TaskOptions* options) {
+    if (!task_name_valid(name) || is_queue_full(queue)) {
+        return NULL;
     }
     
     // Use binary search to find insertion point (O(log n) instead of O(n))
@@ -129,6 +431,7 @@ int enqueue_task(TaskQueue* queue, const char* name, Priority priority, unsigned
     for (int i = queue->size; i > insert_pos; i--) {
         queue->tasks[i] = queue->tasks[i - 1];
     }
+    index_insert_locked(queue, insert_pos);
     
     // Insert new task
     Task* task = &queue->tasks[insert_pos];
@@ -143,61 +446,87 @@ int enqueue_task(TaskQueue* queue, const char* name, Priority priority, unsigned
     task->execution_time_ms = execution_time_ms;
     task->worker_id = -1;
     task->thread_id = 0;
+    memset(&task->usage, 0, sizeof(task->usage));
+    task->timeout_ms = options ? options->timeout_ms : 0;
+    task->cancel_requested = 0;
+    task->max_retries = options ? options->max_retries : 0;
+    task->backoff_base_ms = (options && options->backoff_base_ms) ? options->backoff_base_ms
+                                                                  : RETRY_BACKOFF_BASE_MS;
+    task->backoff_cap_ms = (options && options->backoff_cap_ms) ? options->backoff_cap_ms
+                                                                : RETRY_BACKOFF_CAP_MS;
+    task->backoff_jitter = (options && options->backoff_jitter) ? options->backoff_jitter
+                                                                : RETRY_BACKOFF_JITTER;
+    if (task->backoff_jitter > 100) task->backoff_jitter = 100;
+    task->attempts = 0;
+    task->retry_time = 0;
+    task->last_error[0] = '\0';
+    task->peer[0] = '\0';
+    task->peer_task_id = 0;
+    task->handoff_time = 0;
+    task->ready_ns = queue_clock_ns();
+    task->started_ns = 0;
+    task->ended_ns = 0;
     
     queue->size++;
+    __atomic_add_fetch(&queue->metrics.enqueued[priority], 1ULL, __ATOMIC_RELAXED);
     queue->total_tasks++;
+    TRACE(TRACE_TASK_SUBMIT, task->id, priority);
+    record_change_locked(queue, task, TASK_CHANGE_ENQUEUED);
     
     pthread_cond_signal(&queue->queue_cond);
-    pthread_mutex_unlock(&queue->queue_mutex);
+    return task;
+}
+
+int enqueue_task_ex(TaskQueue* queue, const char* name, Priority priority, unsigned int execution_time_ms,
+                    const TaskOptions* options) {
+    if (queue == NULL) return -1;
     
-    return task->id;
+    lock_queue(queue);
+    Task* task = enqueue_task_locked(queue, name, priority, execution_time_ms, options);
+    int id = task != NULL ? task->id : -1;
+    unlock_queue(queue);
+    
+    return id;
+}
+
+int enqueue_task_batch(TaskQueue* queue, const TaskSpec* specs, int count, int* ids) {
+    if (queue == NULL || specs == NULL || ids == NULL) return -1;
+    
+    int added = 0;
+    lock_queue(queue);
+    for (int i = 0; i < count; i++) {
+        Task* task = enqueue_task_locked(queue, specs[i].name, specs[i].priority,
+                                         specs[i].execution_time_ms, &specs[i].options);
+        ids[i] = task != NULL ? task->id : -1;
+        if (task != NULL) added++;
+    }
+    unlock_queue(queue);
+    
+    return added;
 }
 
 int dequeue_task(TaskQueue* queue, Task* task) {
     if (queue == NULL || task == NULL) return -1;
     
-    pthread_mutex_lock(&queue->queue_mutex);
-    
-    // Since array is sorted by priority, first pending task is highest priority
-    // This makes dequeue O(n) worst case, but O(1) best case (first task is pending)
-    int found_idx = -1;
-    for (int i = 0; i < queue->size; i++) {
-        if (queue->tasks[i].status == STATUS_PENDING) {
-            found_idx = i;
-            break;
-        }
-    }
+    lock_queue(queue);
     
+    int found_idx = find_next_pending_locked(queue);
     if (found_idx == -1) {
-        pthread_mutex_unlock(&queue->queue_mutex);
+        unlock_queue(queue);
         return -1;
     }
     
-    // Copy task
+    // Claim it in the queue, then hand the caller a copy
+    claim_task_locked(queue, &queue->tasks[found_idx], queue->tasks[found_idx].worker_id);
     *task = queue->tasks[found_idx];
-    task->status = STATUS_RUNNING;
-    task->start_time = time(NULL);
-    
-    // Update in queue
-    queue->tasks[found_idx].status = STATUS_RUNNING;
-    queue->tasks[found_idx].start_time = task->start_time;
     
-    pthread_mutex_unlock(&queue->queue_mutex);
+    unlock_queue(queue);
     
     return task->id;
 }
 
-int update_task_status(TaskQueue* queue, int task_id, TaskStatus new_status, time_t* time_field) {
-    if (queue == NULL) return -1;
-    
-    pthread_mutex_lock(&queue->queue_mutex);
-    
-    Task* task = find_task_by_id(queue, task_id);
-    if (task == NULL) {
-        pthread_mutex_unlock(&queue->queue_mutex);
-        return -1;
-    }
-    
+// Apply a status change and keep the global counters in step (mutex held)
+static void set_task_status_locked(TaskQueue* queue, Task* task, TaskStatus new_status, time_t* time_field) {
     // Get old status before updating
     TaskStatus old_status = task->status;
     
@@ -208,6 +537,15 @@ int update_task_status(TaskQueue* queue, int task_id, TaskStatus new_status, tim
             task->end_time = *time_field;
         }
     }
+    if (new_status == STATUS_COMPLETED || new_status == STATUS_FAILED) {
+        task->ended_ns = queue_clock_ns();
+    }
+    
+    TRACE(TRACE_TASK_FINISH, task->id, new_status);
+    record_change_locked(queue, task,
+                         new_status == STATUS_RUNNING ? TASK_CHANGE_STARTED :
+                         new_status == STATUS_COMPLETED || new_status == STATUS_FAILED ||
+                         new_status == STATUS_FORWARDED ? TASK_CHANGE_FINISHED : TASK_CHANGE_UPDATED);
     
     // Only increment counters if status actually changed from non-terminal to terminal
     // This prevents double-counting
@@ -224,24 +562,415 @@ int update_task_status(TaskQueue* queue, int task_id, TaskStatus new_status, tim
             queue->failed_tasks--;
         }
     }
+}
+
+int update_task_status(TaskQueue* queue, int task_id, TaskStatus new_status, time_t* time_field) {
+    if (queue == NULL) return -1;
     
-    pthread_mutex_unlock(&queue->queue_mutex);
+    lock_queue(queue);
+    
+    Task* task = find_task_by_id(queue, task_id);
+    if (task == NULL) {
+        unlock_queue(queue);
+        return -1;
+    }
+    
+    set_task_status_locked(queue, task, new_status, time_field);
+    
+    unlock_queue(queue);
+    
+    return 0;
+}
+
+int finish_task(TaskQueue* queue, int task_id, TaskStatus final_status, const TaskUsage* usage) {
+    if (queue == NULL) return -1;
+    
+    lock_queue(queue);
+    
+    Task* task = find_task_by_id(queue, task_id);
+    if (task == NULL) {
+        unlock_queue(queue);
+        return -1;
+    }
+    
+    time_t end_time;
+    set_task_status_locked(queue, task, final_status, &end_time);
+    if (usage != NULL) {
+        task->usage = *usage;
+    }
+    
+    unlock_queue(queue);
     
     return 0;
 }
 
+int find_next_pending_locked(TaskQueue* queue) {
+    int found_idx = -1;
+    
+    if (queue->config.sched_policy == SCHED_POLICY_FIFO) {
+        // Ids are handed out in submission order, retries keep theirs
+        for (int i = 0; i < queue->size; i++) {
+            if (queue->tasks[i].status == STATUS_PENDING &&
+                (found_idx == -1 || queue->tasks[i].id < queue->tasks[found_idx].id)) {
+                found_idx = i;
+            }
+        }
+        return found_idx;
+    }
+    
+    // Since array is sorted by priority, first pending task is highest priority
+    // This makes dequeue O(n) worst case, but O(1) best case (first task is pending)
+    for (int i = 0; i < queue->size; i++) {
+        if (queue->tasks[i].status == STATUS_PENDING) {
+            found_idx = i;
+            break;
+        }
+    }
+    return found_idx;
+}
+
+void claim_task_locked(TaskQueue* queue, Task* task, int worker_id) {
+    task->status = STATUS_RUNNING;
+    task->start_time = time(NULL);
+    task->started_ns = queue_clock_ns();
+    task->worker_id = worker_id;
+    task->attempts++;
+    TRACE(TRACE_TASK_CLAIM, task->id, task->attempts);
+    record_change_locked(queue, task, TASK_CHANGE_STARTED);
+}
+
+static unsigned long long monotonic_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec * 1000ULL + (unsigned long long)ts.tv_nsec / 1000000ULL;
+}
+
+// Exponential backoff for the retry after the task's latest attempt. Jitter
+// takes a random share off each delay so tasks that failed together (say,
+// during a downstream outage) don't all come back at the same instant.
+static unsigned int retry_delay_ms(const Task* task, unsigned int* seed) {
+    unsigned long long delay = task->backoff_base_ms;
+    for (unsigned int i = 1; i < task->attempts && delay < task->backoff_cap_ms; i++) {
+        delay *= 2;
+    }
+    if (delay > task->backoff_cap_ms) delay = task->backoff_cap_ms;
+    
+    unsigned long long spread = delay * task->backoff_jitter / 100;
+    if (spread > 0) {
+        delay -= (unsigned long long)rand_r(seed) % (spread + 1);
+    }
+    return (unsigned int)delay;
+}
+
+static void retry_heap_swap(TaskQueue* queue, int a, int b) {
+    RetryEntry tmp = queue->retry_heap[a];
+    queue->retry_heap[a] = queue->retry_heap[b];
+    queue->retry_heap[b] = tmp;
+}
+
+// Returns 1 if the entry became the earliest deadline (mutex held)
+static int retry_heap_push(TaskQueue* queue, unsigned long long due_ms, int task_id) {
+    int i = queue->retry_count++;
+    queue->retry_heap[i].due_ms = due_ms;
+    queue->retry_heap[i].task_id = task_id;
+    while (i > 0) {
+        int parent = (i - 1) / 2;
+        if (queue->retry_heap[parent].due_ms <= queue->retry_heap[i].due_ms) break;
+        retry_heap_swap(queue, i, parent);
+        i = parent;
+    }
+    return i == 0;
+}
+
+static RetryEntry retry_heap_pop(TaskQueue* queue) {
+    RetryEntry top = queue->retry_heap[0];
+    queue->retry_heap[0] = queue->retry_heap[--queue->retry_count];
+    int i = 0;
+    for (;;) {
+        int child = 2 * i + 1;
+        if (child >= queue->retry_count) break;
+        if (child + 1 < queue->retry_count &&
+            queue->retry_heap[child + 1].due_ms < queue->retry_heap[child].due_ms) {
+            child++;
+        }
+        if (queue->retry_heap[i].due_ms <= queue->retry_heap[child].due_ms) break;
+        retry_heap_swap(queue, i, child);
+        i = child;
+    }
+    return top;
+}
+
+int fail_task(TaskQueue* queue, int task_id, const char* error, const TaskUsage* usage,
+              unsigned int* retry_delay) {
+    if (queue == NULL) return -1;
+    
+    lock_queue(queue);
+    
+    Task* task = find_task_by_id(queue, task_id);
+    if (task == NULL) {
+        unlock_queue(queue);
+        return -1;
+    }
+    
+    if (error != NULL) {
+        strncpy(task->last_error, error, MAX_TASK_ERROR_LEN - 1);
+        task->last_error[MAX_TASK_ERROR_LEN - 1] = '\0';
+    }
+    if (usage != NULL) {
+        task->usage = *usage;
+    }
+    
+    // A cancelled task is never retried; neither is one that would overflow the heap
+    int retry = !task->cancel_requested && task->attempts <= task->max_retries &&
+                queue->retry_count < MAX_TASKS;
+    if (!retry) {
+        time_t end_time;
+        set_task_status_locked(queue, task, STATUS_FAILED, &end_time);
+        unlock_queue(queue);
+        return STATUS_FAILED;
+    }
+    
+    unsigned int seed = (unsigned int)(monotonic_ms() ^ ((unsigned int)task_id * 2654435761u) ^
+                                       (unsigned int)getpid());
+    unsigned int delay = retry_delay_ms(task, &seed);
+    if (retry_delay != NULL) *retry_delay = delay;
+    
+    task->status = STATUS_RETRY_WAIT;
+    task->worker_id = -1;
+    task->retry_time = time(NULL) + (delay + 999) / 1000;
+    TRACE(TRACE_TASK_RETRY_WAIT, task_id, delay);
+    record_change_locked(queue, task, TASK_CHANGE_UPDATED);
+    if (retry_heap_push(queue, monotonic_ms() + delay, task_id)) {
+        pthread_cond_signal(&queue->retry_cond);  // New earliest deadline
+    }
+    
+    unlock_queue(queue);
+    return STATUS_RETRY_WAIT;
+}
+
+// Release every due retry (mutex held); returns how many became PENDING
+static int release_due_retries(TaskQueue* queue, unsigned long long now_ms) {
+    int released = 0;
+    while (queue->retry_count > 0 && queue->retry_heap[0].due_ms <= now_ms) {
+        RetryEntry entry = retry_heap_pop(queue);
+        // Entries of tasks cancelled or cleaned up meanwhile are just dropped
+        Task* task = find_task_by_id(queue, entry.task_id);
+        if (task != NULL && task->status == STATUS_RETRY_WAIT) {
+            task->status = STATUS_PENDING;
+            task->retry_time = 0;
+            task->ready_ns = queue_clock_ns();
+            TRACE(TRACE_TASK_RETRY_READY, task->id, 0);
+            record_change_locked(queue, task, TASK_CHANGE_UPDATED);
+            released++;
+        }
+    }
+    if (released > 0) {
+        pthread_cond_broadcast(&queue->queue_cond);
+    }
+    return released;
+}
+
+int retry_timer_wait(TaskQueue* queue) {
+    if (queue == NULL) return -1;
+    
+    lock_queue(queue);
+    
+    int released = release_due_retries(queue, monotonic_ms());
+    while (released == 0 && !queue->shutdown_flag) {
+        if (queue->retry_count == 0) {
+            wait_queue(queue, &queue->retry_cond, NULL);
+        } else {
+            unsigned long long due = queue->retry_heap[0].due_ms;
+            struct timespec ts;
+            ts.tv_sec = (time_t)(due / 1000ULL);
+            ts.tv_nsec = (long)(due % 1000ULL) * 1000000L;
+            wait_queue(queue, &queue->retry_cond, &ts);
+        }
+        released = release_due_retries(queue, monotonic_ms());
+    }
+    int stopping = queue->shutdown_flag;
+    
+    unlock_queue(queue);
+    return stopping ? -1 : released;
+}
+
+// tasks[] is sorted by (priority, id), so each priority's range is
+// binary-searched in turn
 Task* find_task_by_id(TaskQueue* queue, int task_id) {
     if (queue == NULL) return NULL;
     
-    for (int i = 0; i < queue->size; i++) {
-        if (queue->tasks[i].id == task_id) {
-            return &queue->tasks[i];
+    int left = 0;
+    for (int p = 0; p < PRIORITY_COUNT; p++) {
+        int right = queue->size;
+        while (left < right) {
+            int mid = left + (right - left) / 2;
+            const Task* task = &queue->tasks[mid];
+            if ((int)task->priority < p || ((int)task->priority == p && task->id < task_id)) {
+                left = mid + 1;
+            } else {
+                right = mid;
+            }
+        }
+        if (left < queue->size && (int)queue->tasks[left].priority == p && queue->tasks[left].id == task_id) {
+            return &queue->tasks[left];
         }
     }
     
     return NULL;
 }
 
+long long task_sort_key(const Task* task, TaskSortKey sort) {
+    switch (sort) {
+        case TASK_SORT_CREATED:  return (long long)task->creation_time;
+        case TASK_SORT_STARTED:  return (long long)task->start_time;
+        case TASK_SORT_ENDED:    return (long long)task->end_time;
+        case TASK_SORT_PRIORITY: return (long long)task->priority;
+        default:                 return (long long)task->id;
+    }
+}
+
+// A match, by its sort key; pos is where it is in tasks[]
+typedef struct {
+    long long key;
+    int id;
+    int pos;
+} QueryHit;
+
+// Does a come before b in the query's order?
+static int hit_before(const QueryHit* a, const QueryHit* b, int descending) {
+    if (a->key != b->key) return descending ? a->key > b->key : a->key < b->key;
+    return descending ? a->id > b->id : a->id < b->id;
+}
+
+// Max-heap in query order: the root is the last of the hits kept
+static void hit_sift_down(QueryHit* heap, int n, int i, int descending) {
+    while (1) {
+        int last = i;
+        int left = 2 * i + 1;
+        int right = left + 1;
+        if (left < n && hit_before(&heap[last], &heap[left], descending)) last = left;
+        if (right < n && hit_before(&heap[last], &heap[right], descending)) last = right;
+        if (last == i) return;
+        QueryHit tmp = heap[i];
+        heap[i] = heap[last];
+        heap[last] = tmp;
+        i = last;
+    }
+}
+
+static void hit_sift_up(QueryHit* heap, int i, int descending) {
+    while (i > 0) {
+        int parent = (i - 1) / 2;
+        if (!hit_before(&heap[parent], &heap[i], descending)) return;
+        QueryHit tmp = heap[i];
+        heap[i] = heap[parent];
+        heap[parent] = tmp;
+        i = parent;
+    }
+}
+
+static int task_matches(const Task* task, const TaskQuery* query, size_t prefix_len) {
+    if (query->status >= 0 && (int)task->status != query->status) return 0;
+    if (query->priority >= 0 && (int)task->priority != query->priority) return 0;
+    if (query->worker_id >= 0 && task->worker_id != query->worker_id) return 0;
+    if (prefix_len > 0 && strncmp(task->name, query->name_prefix, prefix_len) != 0) return 0;
+    if (query->created_after > 0 && task->creation_time < query->created_after) return 0;
+    if (query->created_before > 0 && task->creation_time >= query->created_before) return 0;
+    return 1;
+}
+
+// First position whose priority is at least priority (mutex held)
+static int priority_lower_bound(TaskQueue* queue, int priority) {
+    int left = 0;
+    int right = queue->size;
+    while (left < right) {
+        int mid = left + (right - left) / 2;
+        if ((int)queue->tasks[mid].priority < priority) left = mid + 1;
+        else right = mid;
+    }
+    return left;
+}
+
+int query_tasks(TaskQueue* queue, const TaskQuery* query, Task* out, int* total, int* more) {
+    if (queue == NULL || query == NULL || out == NULL ||
+        query->limit < 1 || query->limit > TASK_QUERY_MAX_LIMIT) {
+        return -1;
+    }
+    
+    // The limit + 1 first hits; one past the page says another follows
+    QueryHit heap[TASK_QUERY_MAX_LIMIT + 1];
+    int kept = 0;
+    int matches = 0;
+    size_t prefix_len = strlen(query->name_prefix);
+    QueryHit cursor = { query->cursor_key, query->cursor_id, -1 };
+    
+    lock_queue(queue);
+    
+    // Candidates: the smallest of the status list, the worker list and
+    // the priority range that the query narrows to
+    const TaskIndexList* list = NULL;
+    int worker_links = 0;
+    int first = 0;
+    int end = queue->size;
+    if (query->priority >= 0) {
+        first = priority_lower_bound(queue, query->priority);
+        end = priority_lower_bound(queue, query->priority + 1);
+    }
+    int candidates = end - first;
+    if (query->status >= 0 && query->status < TASK_STATUS_COUNT &&
+        queue->status_index[query->status].count < candidates) {
+        list = &queue->status_index[query->status];
+        candidates = list->count;
+    }
+    if (query->worker_id >= 0 && query->worker_id < MAX_WORKERS &&
+        queue->worker_index[query->worker_id].count < candidates) {
+        list = &queue->worker_index[query->worker_id];
+        worker_links = 1;
+    }
+    
+    int pos = list != NULL ? list->head : first;
+    while (list != NULL ? pos >= 0 : pos < end) {
+        const Task* task = &queue->tasks[pos];
+        if (task_matches(task, query, prefix_len)) {
+            matches++;
+            QueryHit hit = { task_sort_key(task, query->sort), task->id, pos };
+            if (!query->has_cursor || hit_before(&cursor, &hit, query->descending)) {
+                if (kept <= query->limit) {
+                    heap[kept] = hit;
+                    hit_sift_up(heap, kept++, query->descending);
+                } else if (hit_before(&hit, &heap[0], query->descending)) {
+                    heap[0] = hit;
+                    hit_sift_down(heap, kept, 0, query->descending);
+                }
+            }
+        }
+        if (list == NULL) {
+            pos++;
+        } else {
+            const TaskIndexEntry* entry = &queue->task_index[pos];
+            pos = worker_links ? entry->worker_next : entry->status_next;
+        }
+    }
+    
+    // Heap order to query order
+    for (int n = kept - 1; n > 0; n--) {
+        QueryHit tmp = heap[0];
+        heap[0] = heap[n];
+        heap[n] = tmp;
+        hit_sift_down(heap, n, 0, query->descending);
+    }
+    int count = kept < query->limit ? kept : query->limit;
+    for (int i = 0; i < count; i++) {
+        out[i] = queue->tasks[heap[i].pos];
+    }
+    
+    unlock_queue(queue);
+    
+    if (total != NULL) *total = matches;
+    if (more != NULL) *more = kept > query->limit;
+    return count;
+}
+
 int is_queue_full(TaskQueue* queue) {
     if (queue == NULL) return 1;
     return queue->size >= queue->capacity;
@@ -286,25 +1015,25 @@ int get_running_task_count(TaskQueue* queue) {
 int get_pending_task_count_safe(TaskQueue* queue) {
     if (queue == NULL) return 0;
     
-    pthread_mutex_lock(&queue->queue_mutex);
+    lock_queue(queue);
     int count = get_pending_task_count(queue);
-    pthread_mutex_unlock(&queue->queue_mutex);
+    unlock_queue(queue);
     return count;
 }
 
 int get_running_task_count_safe(TaskQueue* queue) {
     if (queue == NULL) return 0;
     
-    pthread_mutex_lock(&queue->queue_mutex);
+    lock_queue(queue);
     int count = get_running_task_count(queue);
-    pthread_mutex_unlock(&queue->queue_mutex);
+    unlock_queue(queue);
     return count;
 }
 
 int remove_completed_tasks(TaskQueue* queue, int max_age_seconds) {
     if (queue == NULL) return -1;
     
-    pthread_mutex_lock(&queue->queue_mutex);
+    lock_queue(queue);
     
     time_t current_time = time(NULL);
     int removed = 0;
@@ -315,15 +1044,17 @@ int remove_completed_tasks(TaskQueue* queue, int max_age_seconds) {
         Task* task = &queue->tasks[read_idx];
         
         // Keep task if:
-        // 1. Not in terminal state (COMPLETED/FAILED), OR
+        // 1. Not in terminal state (COMPLETED/FAILED/FORWARDED), OR
         // 2. In terminal state but not old enough
         int should_keep = 1;
-        if (task->status == STATUS_COMPLETED || task->status == STATUS_FAILED) {
+        if (task->status == STATUS_COMPLETED || task->status == STATUS_FAILED ||
+            task->status == STATUS_FORWARDED) {
             if (task->end_time > 0) {
                 int age = (int)difftime(current_time, task->end_time);
                 if (age > max_age_seconds) {
                     should_keep = 0;
                     removed++;
+                    record_change_locked(queue, task, TASK_CHANGE_REMOVED);
                 }
             }
         }
@@ -337,8 +1068,9 @@ int remove_completed_tasks(TaskQueue* queue, int max_age_seconds) {
     }
     
     queue->size = write_idx;
+    if (removed > 0) index_rebuild_locked(queue);
     
-    pthread_mutex_unlock(&queue->queue_mutex);
+    unlock_queue(queue);
     
     return removed;
 }
@@ -346,27 +1078,304 @@ int remove_completed_tasks(TaskQueue* queue, int max_age_seconds) {
 int cancel_task(TaskQueue* queue, int task_id) {
     if (queue == NULL) return -1;
     
-    pthread_mutex_lock(&queue->queue_mutex);
+    lock_queue(queue);
     
     Task* task = find_task_by_id(queue, task_id);
     if (task == NULL) {
-        pthread_mutex_unlock(&queue->queue_mutex);
+        unlock_queue(queue);
         return -1; // Task not found
     }
     
-    // Only PENDING tasks can be cancelled
-    if (task->status != STATUS_PENDING) {
-        pthread_mutex_unlock(&queue->queue_mutex);
+    // RUNNING tasks are stopped by the worker that owns them
+    if (task->status == STATUS_RUNNING) {
+        if (!task->cancel_requested) {
+            task->cancel_requested = 1;
+            __atomic_add_fetch(&queue->cancel_seq, 1, __ATOMIC_RELEASE);
+            TRACE(TRACE_TASK_CANCEL, task_id, STATUS_RUNNING);
+            record_change_locked(queue, task, TASK_CHANGE_CANCELLED);
+        }
+        unlock_queue(queue);
+        return 1; // Cancellation requested
+    }
+    
+    // A RETRY_WAIT task's heap entry is dropped when it comes due
+    if (task->status != STATUS_PENDING && task->status != STATUS_RETRY_WAIT) {
+        unlock_queue(queue);
         return -2; // Task not in cancellable state
     }
     
     // Mark as failed (cancelled)
+    TRACE(TRACE_TASK_CANCEL, task_id, task->status);
     task->status = STATUS_FAILED;
     task->end_time = time(NULL);
+    task->ended_ns = queue_clock_ns();
     queue->failed_tasks++;
+    record_change_locked(queue, task, TASK_CHANGE_CANCELLED);
     
-    pthread_mutex_unlock(&queue->queue_mutex);
+    unlock_queue(queue);
     
     return 0; // Success
 }
 
+// Put a RUNNING task back to PENDING (caller holds the mutex)
+static void requeue_locked(TaskQueue* queue, Task* task) {
+    TRACE(TRACE_TASK_REQUEUE, task->id, task->worker_id);
+    task->status = STATUS_PENDING;
+    task->ready_ns = queue_clock_ns();
+    task->start_time = 0;
+    task->worker_id = -1;
+    task->cancel_requested = 0;
+    if (task->attempts > 0) task->attempts--;  // Handing back is not a failed attempt
+    memset(&task->usage, 0, sizeof(task->usage));
+    record_change_locked(queue, task, TASK_CHANGE_UPDATED);
+}
+
+int requeue_task(TaskQueue* queue, int task_id) {
+    if (queue == NULL) return -1;
+    
+    lock_queue(queue);
+    
+    Task* task = find_task_by_id(queue, task_id);
+    if (task == NULL || task->status != STATUS_RUNNING) {
+        unlock_queue(queue);
+        return -1;
+    }
+    
+    requeue_locked(queue, task);
+    pthread_cond_broadcast(&queue->queue_cond);
+    unlock_queue(queue);
+    
+    return 0;
+}
+
+int requeue_worker_tasks(TaskQueue* queue, int worker_id) {
+    if (queue == NULL) return -1;
+    
+    lock_queue(queue);
+    
+    int requeued = 0;
+    for (int i = 0; i < queue->size; i++) {
+        Task* task = &queue->tasks[i];
+        if (task->status == STATUS_RUNNING && task->worker_id == worker_id) {
+            requeue_locked(queue, task);
+            requeued++;
+        }
+    }
+    if (requeued > 0) {
+        pthread_cond_broadcast(&queue->queue_cond);
+    }
+    
+    unlock_queue(queue);
+    
+    return requeued;
+}
+
+int begin_handoff(TaskQueue* queue, const char* peer, int max, Task* out) {
+    if (queue == NULL || peer == NULL) return -1;
+    
+    lock_queue(queue);
+    
+    // The array is priority-sorted, so the back holds what would wait
+    // longest here. Tasks that came from a peer stay put (no ping-pong).
+    int count = 0;
+    time_t now = time(NULL);
+    for (int i = queue->size - 1; i >= 0 && count < max; i--) {
+        Task* task = &queue->tasks[i];
+        if (task->status != STATUS_PENDING || task->peer[0] != '\0') continue;
+        
+        task->status = STATUS_HANDOFF;
+        strncpy(task->peer, peer, MAX_PEER_NAME_LEN - 1);
+        task->peer[MAX_PEER_NAME_LEN - 1] = '\0';
+        task->peer_task_id = 0;
+        task->handoff_time = now;
+        TRACE(TRACE_TASK_HANDOFF, task->id, 0);
+        record_change_locked(queue, task, TASK_CHANGE_UPDATED);
+        out[count++] = *task;
+    }
+    
+    unlock_queue(queue);
+    return count;
+}
+
+int list_handoffs(TaskQueue* queue, const char* peer, int max, Task* out) {
+    if (queue == NULL || peer == NULL) return -1;
+    
+    lock_queue(queue);
+    int count = 0;
+    for (int i = 0; i < queue->size && count < max; i++) {
+        Task* task = &queue->tasks[i];
+        if (task->status == STATUS_HANDOFF && strcmp(task->peer, peer) == 0) {
+            out[count++] = *task;
+        }
+    }
+    unlock_queue(queue);
+    return count;
+}
+
+// The task offered to peer with this id, or NULL (mutex held)
+static Task* find_handoff_locked(TaskQueue* queue, int task_id, const char* peer) {
+    Task* task = find_task_by_id(queue, task_id);
+    if (task == NULL || task->status != STATUS_HANDOFF || strcmp(task->peer, peer) != 0) {
+        return NULL;
+    }
+    return task;
+}
+
+int complete_handoff(TaskQueue* queue, int task_id, const char* peer, int peer_task_id) {
+    if (queue == NULL || peer == NULL) return -1;
+    
+    lock_queue(queue);
+    Task* task = find_handoff_locked(queue, task_id, peer);
+    if (task == NULL) {
+        unlock_queue(queue);
+        return -1;
+    }
+    task->status = STATUS_FORWARDED;
+    task->peer_task_id = peer_task_id;
+    TRACE(TRACE_TASK_FORWARD, task_id, peer_task_id);
+    task->end_time = time(NULL);
+    task->ended_ns = queue_clock_ns();
+    record_change_locked(queue, task, TASK_CHANGE_FINISHED);
+    unlock_queue(queue);
+    return 0;
+}
+
+// Give an offered task back to the local workers (mutex held)
+static void abort_handoff_locked(TaskQueue* queue, Task* task) {
+    TRACE(TRACE_TASK_HANDOFF_ABORT, task->id, 0);
+    task->status = STATUS_PENDING;
+    task->ready_ns = queue_clock_ns();
+    task->peer[0] = '\0';
+    task->handoff_time = 0;
+    record_change_locked(queue, task, TASK_CHANGE_UPDATED);
+    pthread_cond_signal(&queue->queue_cond);
+}
+
+int abort_handoff(TaskQueue* queue, int task_id, const char* peer) {
+    if (queue == NULL || peer == NULL) return -1;
+    
+    lock_queue(queue);
+    Task* task = find_handoff_locked(queue, task_id, peer);
+    if (task != NULL) {
+        abort_handoff_locked(queue, task);
+    }
+    unlock_queue(queue);
+    return task != NULL ? 0 : -1;
+}
+
+int overdue_handoffs(TaskQueue* queue, time_t cutoff, int max, Task* out) {
+    if (queue == NULL) return -1;
+    
+    lock_queue(queue);
+    int count = 0;
+    time_t now = time(NULL);
+    for (int i = 0; i < queue->size && count < max; i++) {
+        Task* task = &queue->tasks[i];
+        if (task->status != STATUS_HANDOFF || task->handoff_time >= cutoff) continue;
+        task->handoff_time = now;
+        out[count++] = *task;
+    }
+    unlock_queue(queue);
+    return count;
+}
+
+// How we answered peer's offer of peer_task_id, or NULL (mutex held)
+static HandoffRecord* find_handoff_record_locked(TaskQueue* queue, const char* peer,
+                                                 unsigned long long incarnation,
+                                                 int peer_task_id) {
+    unsigned long long kept = queue->handoff_seq < HANDOFF_LOG_SIZE ? queue->handoff_seq
+                                                                     : HANDOFF_LOG_SIZE;
+    for (unsigned long long n = queue->handoff_seq; n > queue->handoff_seq - kept; n--) {
+        HandoffRecord* record = &queue->handoff_log[(n - 1) % HANDOFF_LOG_SIZE];
+        if (record->peer_task_id == peer_task_id && record->incarnation == incarnation &&
+            strcmp(record->peer, peer) == 0) {
+            return record;
+        }
+    }
+    return NULL;
+}
+
+// Remember our answer to peer's offer of peer_task_id (mutex held)
+static void add_handoff_record_locked(TaskQueue* queue, const char* peer,
+                                      unsigned long long incarnation, int peer_task_id,
+                                      int local_id) {
+    HandoffRecord* record = &queue->handoff_log[queue->handoff_seq % HANDOFF_LOG_SIZE];
+    strncpy(record->peer, peer, MAX_PEER_NAME_LEN - 1);
+    record->peer[MAX_PEER_NAME_LEN - 1] = '\0';
+    record->incarnation = incarnation;
+    record->peer_task_id = peer_task_id;
+    record->local_id = local_id;
+    queue->handoff_seq++;
+}
+
+int accept_handoff(TaskQueue* queue, const char* peer, unsigned long long incarnation,
+                   const Task* offered, int* fresh) {
+    if (queue == NULL || peer == NULL || offered == NULL) return -1;
+    
+    if (fresh != NULL) *fresh = 0;
+    lock_queue(queue);
+    
+    // The offer may be a resend after a lost answer, or one delayed past a
+    // RECLAIM we already answered; either way the first answer stands
+    HandoffRecord* record = find_handoff_record_locked(queue, peer, incarnation, offered->id);
+    if (record != NULL) {
+        int id = record->local_id > 0 ? record->local_id : -1;
+        unlock_queue(queue);
+        return id;
+    }
+    
+    TaskOptions options = {
+        .timeout_ms = offered->timeout_ms,
+        .max_retries = offered->max_retries,
+        .backoff_base_ms = offered->backoff_base_ms,
+        .backoff_cap_ms = offered->backoff_cap_ms,
+        .backoff_jitter = offered->backoff_jitter,
+    };
+    Task* task = enqueue_task_locked(queue, offered->name, offered->priority,
+                                     offered->execution_time_ms, &options);
+    int id = -1;
+    if (task != NULL) {
+        strncpy(task->peer, peer, MAX_PEER_NAME_LEN - 1);
+        task->peer[MAX_PEER_NAME_LEN - 1] = '\0';
+        task->peer_task_id = offered->id;
+        id = task->id;
+        record_change_locked(queue, task, TASK_CHANGE_UPDATED);
+        if (fresh != NULL) *fresh = 1;
+    }
+    // A refusal is remembered too: the peer runs the task itself once told,
+    // so a stale copy of this offer arriving later must not be taken
+    add_handoff_record_locked(queue, peer, incarnation, offered->id, id > 0 ? id : 0);
+    
+    unlock_queue(queue);
+    return id;
+}
+
+int reclaim_handoff(TaskQueue* queue, const char* peer, unsigned long long incarnation,
+                    int peer_task_id) {
+    if (queue == NULL || peer == NULL) return -1;
+    
+    lock_queue(queue);
+    HandoffRecord* record = find_handoff_record_locked(queue, peer, incarnation, peer_task_id);
+    int id = record != NULL ? record->local_id : 0;
+    if (record == NULL) {
+        add_handoff_record_locked(queue, peer, incarnation, peer_task_id, 0);
+    }
+    unlock_queue(queue);
+    return id;
+}
+
+int forget_handoffs(TaskQueue* queue, const char* peer, unsigned long long incarnation) {
+    if (queue == NULL || peer == NULL) return -1;
+    
+    lock_queue(queue);
+    int count = 0;
+    for (int i = 0; i < HANDOFF_LOG_SIZE; i++) {
+        HandoffRecord* record = &queue->handoff_log[i];
+        if (record->incarnation != incarnation && strcmp(record->peer, peer) == 0) {
+            record->peer[0] = '\0';  // Matches no peer name from now on
+            count++;
+        }
+    }
+    unlock_queue(queue);
+    return count;
+}
@@ -3,6 +3,18 @@
 
 #include "common.h"
 
+// Resources a task consumed while it ran, measured by the worker
+typedef struct {
+    unsigned long long cpu_time_us;     // Thread CPU clock (precise)
+    unsigned long long cpu_user_us;     // getrusage(RUSAGE_THREAD) split
+    unsigned long long cpu_system_us;
+    long max_rss_kb;                    // Worker process high-water mark at task end
+    long voluntary_ctx_switches;
+    long involuntary_ctx_switches;
+    unsigned long long io_read_bytes;   // rchar/wchar from /proc/thread-self/io
+    unsigned long long io_write_bytes;
+} TaskUsage;
+
 // Task Structure
 typedef struct {
     int id;
@@ -15,8 +27,180 @@ typedef struct {
     unsigned int execution_time_ms;
     int worker_id;
     pthread_t thread_id;
+    TaskUsage usage;
+    unsigned int timeout_ms;       // 0 = no limit; counted from when a worker starts it
+    int cancel_requested;          // Set on a RUNNING task; its worker stops it
+    unsigned int max_retries;      // Failed attempts retried this many times
+    unsigned int backoff_base_ms;  // Retry n waits base * 2^(n-1), capped, minus jitter
+    unsigned int backoff_cap_ms;
+    unsigned int backoff_jitter;   // Percent of the delay randomized away
+    unsigned int attempts;         // Times a worker started the task (hand-backs excluded)
+    time_t retry_time;             // When a RETRY_WAIT task becomes PENDING again
+    char last_error[MAX_TASK_ERROR_LEN];
+    // Federation: for HANDOFF/FORWARDED tasks the peer they went to and the
+    // id it gave them; for any other status, the peer they came from and
+    // their id there. Empty peer = a local task.
+    char peer[MAX_PEER_NAME_LEN];
+    int peer_task_id;
+    time_t handoff_time;           // When the current offer was made
+    unsigned long long ready_ns;   // CLOCK_MONOTONIC when it last became PENDING,
+    unsigned long long started_ns; // was last claimed
+    unsigned long long ended_ns;   // and reached COMPLETED, FAILED or FORWARDED (0 = not yet)
 } Task;
 
+// Optional per-task settings for enqueue_task_ex (zero = default)
+typedef struct {
+    unsigned int timeout_ms;
+    unsigned int max_retries;
+    unsigned int backoff_base_ms;
+    unsigned int backoff_cap_ms;
+    unsigned int backoff_jitter;
+} TaskOptions;
+
+// One task for enqueue_task_batch
+typedef struct {
+    char name[MAX_TASK_NAME_LEN];
+    Priority priority;
+    unsigned int execution_time_ms;
+    TaskOptions options;
+} TaskSpec;
+
+// Index entry of the task at the same position in tasks[]: it is on the
+// list of its status and, while it has one, of its worker. Links are
+// positions (-1 = none), and entries move with their tasks.
+typedef struct {
+    int status_prev;
+    int status_next;
+    int worker_prev;
+    int worker_next;
+    int status;                 // Status list it is on (-1 = none)
+    int worker;                 // Worker list it is on (-1 = none)
+} TaskIndexEntry;
+
+typedef struct {
+    int head;
+    int tail;
+    int count;
+    int priority_count[PRIORITY_COUNT]; // Of count, how many at each priority
+} TaskIndexList;
+
+typedef enum {
+    TASK_SORT_ID,
+    TASK_SORT_CREATED,
+    TASK_SORT_STARTED,
+    TASK_SORT_ENDED,
+    TASK_SORT_PRIORITY
+} TaskSortKey;
+
+// What query_tasks returns. Negative status/priority/worker_id and empty
+// name_prefix match anything; created_* are unix seconds, 0 = unbounded.
+typedef struct {
+    int status;
+    int priority;
+    int worker_id;
+    char name_prefix[MAX_TASK_NAME_LEN];
+    time_t created_after;       // Inclusive
+    time_t created_before;      // Exclusive
+    TaskSortKey sort;           // Ties are broken by id
+    int descending;
+    int limit;                  // 1..TASK_QUERY_MAX_LIMIT
+    int has_cursor;             // Page starts after (cursor_key, cursor_id)
+    long long cursor_key;
+    int cursor_id;
+} TaskQuery;
+
+// A failed attempt waiting in the retry heap; due is CLOCK_MONOTONIC ms
+typedef struct {
+    unsigned long long due_ms;
+    int task_id;
+} RetryEntry;
+
+// Live statistics for one worker id. Only the owning worker writes its slot
+// (bar drain_requested, set by the scheduler), using relaxed atomics; readers
+// go over MAX_WORKERS slots without taking the queue mutex or touching the
+// task array. Counters survive worker restarts.
+typedef struct {
+    pid_t pid;                          // 0 = no worker attached
+    int capacity;                       // Tasks this worker runs at once
+    int drain_requested;                // Set by the scheduler: stop claiming, finish, exit
+    time_t started_at;
+    time_t heartbeat;                   // Refreshed by the worker's control thread
+    time_t last_claim;
+    int busy_threads;                   // Threads currently running a task
+    int idle_threads;                   // Threads waiting for work
+    int inflight_tasks;
+    unsigned long long tasks_completed;
+    unsigned long long tasks_failed;
+    unsigned long long busy_time_us;    // Summed wall time of finished tasks
+} WorkerSlot;
+
+// Tunables the scheduler applies at runtime. It rewrites them under
+// queue_mutex and then bumps config_generation (release), so processes
+// notice a change with one atomic load and copy the fields only then.
+typedef struct {
+    int threads_per_worker;             // Thread-mode task threads per worker
+    SchedPolicy sched_policy;           // Which PENDING task is claimed next
+    int cleanup_interval;               // Seconds between completed-task cleanups
+    int completed_task_max_age;         // Age (s) at which finished tasks are removed
+} SharedConfig;
+
+// A federation peer as last heard by this node's scheduler
+typedef struct {
+    char name[MAX_PEER_NAME_LEN];
+    int connected;
+    time_t last_seen;                   // Last message of any kind
+    int pending;                        // Its last gossiped load
+    int running;
+    int capacity;
+    unsigned long long tasks_sent;      // Handed over to it
+    unsigned long long tasks_received;  // Taken over from it
+    unsigned long long incarnation;     // Its queue's, from its last HELLO
+} PeerSlot;
+
+// How this node answered one peer offer, kept in TaskQueue.handoff_log
+typedef struct {
+    char peer[MAX_PEER_NAME_LEN];
+    unsigned long long incarnation;     // The offering node's, when it offered
+    int peer_task_id;                   // The task's id on the offering node
+    int local_id;                       // Our copy, or 0 if we refused it
+} HandoffRecord;
+
+// What happened to a task, as recorded in the change log
+typedef enum {
+    TASK_CHANGE_ENQUEUED = 0,
+    TASK_CHANGE_STARTED = 1,
+    TASK_CHANGE_FINISHED = 2,           // COMPLETED, FAILED or FORWARDED
+    TASK_CHANGE_CANCELLED = 3,          // Failed at once, or a RUNNING task asked to stop
+    TASK_CHANGE_UPDATED = 4,            // Retry, requeue, handoff
+    TASK_CHANGE_REMOVED = 5             // Cleaned up; the task is gone
+} TaskChangeKind;
+
+typedef struct {
+    int task_id;
+    int kind;                           // TaskChangeKind
+} TaskChange;
+
+// Latency distribution with log2 buckets: bucket i counts observations of
+// at most METRICS_BUCKET_BASE_US << i, the last bucket everything longer
+#define METRICS_BUCKETS 24
+#define METRICS_BUCKET_BASE_US 1000ULL
+typedef struct {
+    unsigned long long buckets[METRICS_BUCKETS];
+    unsigned long long sum_us;
+} LatencyHistogram;
+
+// Totals for /metrics, by priority. Any process adds to them with relaxed
+// atomics and without the mutex, so a scrape reads a fixed number of
+// counters however many tasks went through.
+typedef struct {
+    unsigned long long enqueued[PRIORITY_COUNT];
+    unsigned long long claimed[PRIORITY_COUNT];
+    unsigned long long completed[PRIORITY_COUNT];
+    unsigned long long failed[PRIORITY_COUNT];
+    LatencyHistogram queue_wait[PRIORITY_COUNT];   // PENDING until claimed
+    LatencyHistogram execution[PRIORITY_COUNT];    // Claimed until finished
+} QueueMetrics;
+
 // Shared Memory Structure
 typedef struct {
     Task tasks[MAX_TASKS];
@@ -29,27 +213,138 @@ typedef struct {
     int completed_tasks;
     int failed_tasks;
     
-    // Synchronization
+    // Synchronization. Take queue_mutex through lock_queue/unlock_queue,
+    // which keep snapshot_seq odd while it is held, so readers can copy the
+    // queue without the mutex (see snapshot_queue).
     pthread_mutex_t queue_mutex;
     pthread_cond_t queue_cond;
+    unsigned int snapshot_seq;
     
     // Worker status
     pid_t scheduler_pid;
+    char name[MAX_QUEUE_NAME_LEN];      // Queue name, set by the scheduler
     int num_active_workers;
+    int min_workers;                    // Autoscaling bounds set by the scheduler
+    int max_workers;
+    
+    // Live configuration; see SharedConfig
+    SharedConfig config;
+    int config_generation;
     
     // Shutdown flag
     int shutdown_flag;
+    
+    // Bumped whenever a RUNNING task is asked to stop, so workers only scan
+    // the queue when there is something to find
+    int cancel_seq;
+    
+    // Per-worker live statistics, indexed by worker id
+    WorkerSlot workers[MAX_WORKERS];
+    
+    // Min-heap of RETRY_WAIT tasks by due time. The scheduler's retry timer
+    // sleeps on retry_cond (monotonic) until the earliest one is due.
+    RetryEntry retry_heap[MAX_TASKS];
+    int retry_count;
+    pthread_cond_t retry_cond;
+    
+    // Federation state, written by the scheduler (empty node_name = off).
+    // incarnation is set once per segment (its creation time in ns) and
+    // sent in HELLO: peers key our task ids by it, since a new segment
+    // numbers tasks from 1 again.
+    unsigned long long incarnation;
+    char node_name[MAX_PEER_NAME_LEN];
+    int federation_port;
+    PeerSlot peers[MAX_PEERS];
+    int peer_count;
+    
+    // Every offer this node answered, newest HANDOFF_LOG_SIZE kept: record
+    // n (1-based) lives at handoff_log[(n - 1) % HANDOFF_LOG_SIZE]. A resent
+    // OFFER or a RECLAIM gets the answer the first one did, even after our
+    // copy has run and been cleaned up.
+    unsigned long long handoff_seq;
+    HandoffRecord handoff_log[HANDOFF_LOG_SIZE];
+    
+    // Task change log. Every task state change appends an entry under
+    // queue_mutex; change_seq counts entries ever appended and entry n
+    // (1-based) lives at change_log[(n - 1) % CHANGE_LOG_SIZE]. A reader
+    // that remembers the last seq it saw finds what changed since, or
+    // learns it fell more than CHANGE_LOG_SIZE behind.
+    unsigned long long change_seq;
+    TaskChange change_log[CHANGE_LOG_SIZE];
+    
+    // Modification counter behind the web server's ETags: bumped through
+    // queue_modified() after every change to what the status, task and
+    // worker views show (worker heartbeats excepted). A new segment starts
+    // over at 0 with a new created_at.
+    unsigned long long version;
+    time_t created_at;
+    
+    // Indexes for query_tasks, kept up to date by every task change. The
+    // task array itself is sorted by (priority, id) and serves as the
+    // priority index.
+    TaskIndexEntry task_index[MAX_TASKS];
+    TaskIndexList status_index[TASK_STATUS_COUNT];
+    TaskIndexList worker_index[MAX_WORKERS];
+    
+    // Latency histograms and totals; see QueueMetrics
+    QueueMetrics metrics;
 } TaskQueue;
 
 // Function prototypes
-int init_shared_memory(void);
+int queue_name_valid(const char* name);         // Letters, digits, '-' and '_'
+int task_name_valid(const char* name);          // Non-empty, no control characters
+const char* queue_name(void);                   // QUEUE_NAME_ENV, else DEFAULT_QUEUE_NAME
+key_t queue_shm_key_for(const char* name);      // SHM_KEY for the default queue, else a hash
+key_t queue_shm_key(void);  // SHM_KEY_ENV if set, else queue_shm_key_for(queue_name())
+int init_shared_memory(key_t key);     // Create (or find) the segment; returns its id
 TaskQueue* attach_shared_memory(int shm_id);
 void detach_shared_memory(TaskQueue* queue);
 void destroy_shared_memory(int shm_id);
 
+void lock_queue(TaskQueue* queue);
+void unlock_queue(TaskQueue* queue);
+// pthread_cond_(timed)wait on a queue condvar (abstime NULL = no timeout)
+int wait_queue(TaskQueue* queue, pthread_cond_t* cond, const struct timespec* abstime);
+
+// A consistent copy of the task table and counters, read without the mutex
+typedef struct {
+    unsigned int seq;           // snapshot_seq it was taken at; equal seqs = same contents
+    int size;
+    int capacity;
+    int total_tasks;
+    int completed_tasks;
+    int failed_tasks;
+    int num_active_workers;
+    int min_workers;
+    int max_workers;
+    SharedConfig config;
+    Task tasks[MAX_TASKS];
+} QueueSnapshot;
+
+// Fill snapshot, retrying while writers are active; after
+// SNAPSHOT_MAX_RETRIES it takes the mutex instead. Returns 0 or -1.
+int snapshot_queue(TaskQueue* queue, QueueSnapshot* snapshot);
+
 int enqueue_task(TaskQueue* queue, const char* name, Priority priority, unsigned int execution_time_ms);
+int enqueue_task_ex(TaskQueue* queue, const char* name, Priority priority, unsigned int execution_time_ms,
+                    const TaskOptions* options);
+// Enqueue count tasks under one lock. ids[i] gets each task's id, or -1
+// once the queue is full or if its name is invalid. Returns how many were added.
+int enqueue_task_batch(TaskQueue* queue, const TaskSpec* specs, int count, int* ids);
 int dequeue_task(TaskQueue* queue, Task* task);
 int update_task_status(TaskQueue* queue, int task_id, TaskStatus new_status, time_t* time_field);
+// Move a task to a terminal status and store its resource usage in one step
+int finish_task(TaskQueue* queue, int task_id, TaskStatus final_status, const TaskUsage* usage);
+// Record a failed attempt. Returns STATUS_RETRY_WAIT if the task will be
+// retried after *retry_delay ms, STATUS_FAILED if it is out of retries (or
+// was cancelled), -1 if not found. retry_delay may be NULL.
+int fail_task(TaskQueue* queue, int task_id, const char* error, const TaskUsage* usage,
+              unsigned int* retry_delay);
+// Index of the PENDING task the current sched_policy claims next, or -1
+// (mutex held)
+int find_next_pending_locked(TaskQueue* queue);
+// Mark a task claimed by worker_id (mutex held)
+void claim_task_locked(TaskQueue* queue, Task* task, int worker_id);
 Task* find_task_by_id(TaskQueue* queue, int task_id);
 
 int is_queue_full(TaskQueue* queue);
@@ -62,8 +357,75 @@ int get_running_task_count_safe(TaskQueue* queue);  // Thread-safe, locks intern
 // Cleanup function for completed tasks
 int remove_completed_tasks(TaskQueue* queue, int max_age_seconds);
 
-// Cancel a task (only PENDING tasks can be cancelled)
+// Cancel a task. PENDING and RETRY_WAIT tasks fail immediately (returns 0);
+// RUNNING tasks are flagged for their worker to stop (returns 1).
+// -1 = not found, -2 = already finished.
 int cancel_task(TaskQueue* queue, int task_id);
 
+// Hand a RUNNING task back to the queue so another worker can run it from
+// the start. Returns 0, or -1 if the task is not running.
+int requeue_task(TaskQueue* queue, int task_id);
+// Requeue everything a dead worker left RUNNING; returns how many
+int requeue_worker_tasks(TaskQueue* queue, int worker_id);
+
+// Federation handoff. An offered task is HANDOFF, invisible to workers,
+// until the peer says it took it (FORWARDED, terminal here) or that it
+// never will (PENDING again). No answer leaves it HANDOFF: the peer may
+// have enqueued it, and running it here too would run it twice.
+// Move up to max PENDING local tasks to HANDOFF for peer, least urgent
+// first, copying them to out. Returns how many.
+int begin_handoff(TaskQueue* queue, const char* peer, int max, Task* out);
+// Copy up to max tasks still awaiting peer's answer, to offer them again
+int list_handoffs(TaskQueue* queue, const char* peer, int max, Task* out);
+// Copy up to max offers (to any peer) unanswered since before cutoff, and
+// restart their clocks, so their peers can be asked about them
+int overdue_handoffs(TaskQueue* queue, time_t cutoff, int max, Task* out);
+// peer took the task as its peer_task_id. -1 if it was no longer on offer.
+int complete_handoff(TaskQueue* queue, int task_id, const char* peer, int peer_task_id);
+// peer refused the task: give it back to our workers. -1 if it was no
+// longer on offer.
+int abort_handoff(TaskQueue* queue, int task_id, const char* peer);
+// The receiving side. Both record their answer in handoff_log and repeat
+// it for every later OFFER or RECLAIM of the same task, which is the same
+// peer, incarnation (its HELLO's) and id.
+// Enqueue a task offered by peer, or find the copy an earlier offer of it
+// made. Returns our id (*fresh set if just enqueued), or -1 if refused:
+// the queue was full, the name invalid, or the task refused before.
+int accept_handoff(TaskQueue* queue, const char* peer, unsigned long long incarnation,
+                   const Task* offered, int* fresh);
+// peer asks whether we took its task. Returns our id if so, else 0 after
+// recording that any later offer of it is refused.
+int reclaim_handoff(TaskQueue* queue, const char* peer, unsigned long long incarnation,
+                    int peer_task_id);
+// peer is now on incarnation: drop the records of its earlier ones, whose
+// task ids it reuses. Returns how many.
+int forget_handoffs(TaskQueue* queue, const char* peer, unsigned long long incarnation);
+
+const char* task_change_to_string(int kind);
+
+// Copy the page of tasks matching query into out (room for query->limit),
+// in sort order, and return how many. *total gets the number of matches
+// ignoring the cursor, *more whether further pages follow. The candidates
+// come from the smallest index that covers the query: the status list,
+// the worker list or the priority range, a full scan only without any of
+// them. -1 on a bad query.
+int query_tasks(TaskQueue* queue, const TaskQuery* query, Task* out, int* total, int* more);
+long long task_sort_key(const Task* task, TaskSortKey sort);   // Cursor value of task
+
+// Bump version (with or without the mutex held) / read it without the mutex
+void queue_modified(TaskQueue* queue);
+unsigned long long queue_version(TaskQueue* queue);
+
+// Metrics, with or without the mutex: count one observation in a histogram,
+// or copy all of them. queue_clock_ns is the clock ready_ns is on.
+void metrics_observe(LatencyHistogram* histogram, unsigned long long us);
+void metrics_read(TaskQueue* queue, QueueMetrics* out);
+unsigned long long queue_clock_ns(void);
+
+// Retry timer: sleep until at least one retry's backoff has expired and
+// release every due one back to PENDING. Returns how many were released,
+// or -1 once the queue is shutting down (retry_cond is broadcast then).
+int retry_timer_wait(TaskQueue* queue);
+
 #endif // TASK_QUEUE_H
 
@@ -0,0 +1,90 @@
+#include "trace.h"
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+TraceHeader* trace_header = NULL;
+static TraceRecord* trace_records;
+static int16_t trace_worker_id = -1;
+static __thread uint32_t trace_tid;
+
+int trace_open(const char* process_name, int worker_id) {
+    const char* enabled = getenv(TRACE_ENV);
+    if (enabled == NULL || *enabled == '\0' || strcmp(enabled, "0") == 0) return 0;
+    if (trace_header != NULL) return 0;
+
+    mkdir(LOG_DIR, 0700);
+    char path[512];
+    snprintf(path, sizeof(path), "%s/%s_%d.trace", LOG_DIR, process_name, getpid());
+
+    // Pages are only backed once events reach them
+    size_t size = sizeof(TraceHeader) + (size_t)TRACE_RECORDS * sizeof(TraceRecord);
+    int fd = open(path, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) return -1;
+    if (ftruncate(fd, (off_t)size) != 0) {
+        close(fd);
+        return -1;
+    }
+    void* map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) return -1;
+
+    TraceHeader* header = map;
+    memcpy(header->magic, TRACE_MAGIC, sizeof(header->magic));
+    header->version = TRACE_VERSION;
+    header->record_size = sizeof(TraceRecord);
+    header->capacity = TRACE_RECORDS;
+    header->pid = (uint32_t)getpid();
+    header->next = 0;
+    snprintf(header->process, sizeof(header->process), "%s", process_name);
+
+    trace_records = (TraceRecord*)(header + 1);
+    trace_worker_id = (int16_t)worker_id;
+    __atomic_store_n(&trace_header, header, __ATOMIC_RELEASE);
+    return 0;
+}
+
+void trace_close(void) {
+    // Stop recording but keep the mapping: a thread may still be writing
+    // its last record, and the kernel writes the shared pages back anyway
+    __atomic_store_n(&trace_header, NULL, __ATOMIC_RELEASE);
+}
+
+void trace_record(TraceEvent event, int task_id, uint32_t arg) {
+    TraceHeader* header = trace_header;
+    if (header == NULL) return;
+
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    if (trace_tid == 0) trace_tid = (uint32_t)syscall(SYS_gettid);
+
+    uint64_t index = __atomic_fetch_add(&header->next, 1, __ATOMIC_RELAXED);
+    TraceRecord* r = &trace_records[index & (TRACE_RECORDS - 1)];
+    r->time_ns = (uint64_t)now.tv_sec * 1000000000ULL + (uint64_t)now.tv_nsec;
+    r->task_id = task_id;
+    r->worker_id = trace_worker_id;
+    r->event = (uint16_t)event;
+    r->tid = trace_tid;
+    r->arg = arg;
+    // A reader skips records whose seq doesn't match their slot (torn or overwritten)
+    __atomic_store_n(&r->seq, (uint32_t)(index + 1), __ATOMIC_RELEASE);
+}
+
+const char* trace_event_name(int event) {
+    switch (event) {
+        case TRACE_TASK_SUBMIT:        return "submit";
+        case TRACE_TASK_CLAIM:         return "claim";
+        case TRACE_TASK_BEGIN:         return "begin";
+        case TRACE_TASK_END:           return "end";
+        case TRACE_TASK_FINISH:        return "finish";
+        case TRACE_TASK_RETRY_WAIT:    return "retry_wait";
+        case TRACE_TASK_RETRY_READY:   return "retry_ready";
+        case TRACE_TASK_CANCEL:        return "cancel";
+        case TRACE_TASK_REQUEUE:       return "requeue";
+        case TRACE_TASK_HANDOFF:       return "handoff";
+        case TRACE_TASK_FORWARD:       return "forward";
+        case TRACE_TASK_HANDOFF_ABORT: return "handoff_abort";
+        case TRACE_WORKER_START:       return "worker_start";
+        case TRACE_WORKER_STOP:        return "worker_stop";
+        default:                       return "unknown";
+    }
+}
@@ -0,0 +1,70 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include "common.h"
+#include <stdint.h>
+
+// Optional binary event log. Each process that calls trace_open with
+// TRACE_ENV set appends fixed-size records to logs/<process>_<pid>.trace,
+// an mmap'd ring of TRACE_RECORDS entries that keeps the newest events.
+// tracedump merges the files of all processes into one time-ordered stream.
+
+#define TRACE_MAGIC "TSTRACE1"
+#define TRACE_VERSION 1
+
+typedef enum {
+    TRACE_TASK_SUBMIT = 1,      // arg: priority
+    TRACE_TASK_CLAIM = 2,       // arg: attempt number
+    TRACE_TASK_BEGIN = 3,       // A worker thread or event loop starts running it
+    TRACE_TASK_END = 4,         // arg: status the worker left it in
+    TRACE_TASK_FINISH = 5,      // Status written to the queue; arg: status
+    TRACE_TASK_RETRY_WAIT = 6,  // arg: backoff in ms
+    TRACE_TASK_RETRY_READY = 7, // Backoff over, PENDING again
+    TRACE_TASK_CANCEL = 8,      // Cancel requested (or PENDING task failed at once)
+    TRACE_TASK_REQUEUE = 9,     // Back to PENDING from a worker
+    TRACE_TASK_HANDOFF = 10,    // Offered to a federation peer
+    TRACE_TASK_FORWARD = 11,    // arg: the peer's task id
+    TRACE_TASK_HANDOFF_ABORT = 12,
+    TRACE_WORKER_START = 13,
+    TRACE_WORKER_STOP = 14,
+    TRACE_EVENT_COUNT
+} TraceEvent;
+
+// File layout: a 64-byte header followed by capacity records
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t record_size;
+    uint32_t capacity;          // Power of 2
+    uint32_t pid;
+    uint64_t next;              // Records ever appended; the newest capacity are kept
+    char process[32];
+} TraceHeader;
+
+typedef struct {
+    uint64_t time_ns;           // CLOCK_MONOTONIC, comparable across processes
+    int32_t task_id;
+    int16_t worker_id;          // Of the tracing process; -1 outside workers
+    uint16_t event;
+    uint32_t tid;
+    uint32_t arg;
+    uint32_t seq;               // Low bits of the record's index + 1, written last
+    uint32_t reserved;
+} TraceRecord;
+
+// Start tracing this process if TRACE_ENV is set to a non-zero value.
+// Returns 0 when tracing (or not asked to), -1 if the file can't be made.
+int trace_open(const char* process_name, int worker_id);
+void trace_close(void);
+
+void trace_record(TraceEvent event, int task_id, uint32_t arg);
+
+extern TraceHeader* trace_header;
+
+// Costs one predictable branch when tracing is off
+#define TRACE(event, task_id, arg) \
+    do { if (trace_header != NULL) trace_record((event), (task_id), (uint32_t)(arg)); } while (0)
+
+const char* trace_event_name(int event);
+
+#endif // TRACE_H
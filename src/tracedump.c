@@ -0,0 +1,276 @@
+#include "common.h"
+#include "trace.h"
+#include <dirent.h>
+#include <getopt.h>
+#include <sys/mman.h>
+
+// tracedump: merge the .trace files of every process into one
+// time-ordered stream, as text or as Chrome trace JSON (chrome://tracing,
+// Perfetto). Works on the files of running processes too.
+
+typedef struct {
+    uint32_t pid;
+    char process[sizeof(((TraceHeader*)0)->process) + 1];
+} TraceSource;
+
+typedef struct {
+    TraceRecord record;
+    int source;
+} TraceEntry;
+
+static TraceSource* sources;
+static int source_count;
+static TraceEntry* entries;
+static size_t entry_count;
+static size_t entry_capacity;
+
+static void print_usage(const char* prog) {
+    fprintf(stderr, "Usage: %s [-c] [-t TASK_ID] [PATH...]\n", prog);
+    fprintf(stderr, "  PATH        .trace files or directories holding them (default %s/)\n", LOG_DIR);
+    fprintf(stderr, "  -c          Chrome trace JSON instead of text\n");
+    fprintf(stderr, "  -t TASK_ID  Only this task's events\n");
+    fprintf(stderr, "Traces are written by processes started with %s=1 (scheduler --trace).\n",
+            TRACE_ENV);
+}
+
+static int add_entry(const TraceRecord* record, int source) {
+    if (entry_count == entry_capacity) {
+        size_t capacity = entry_capacity ? entry_capacity * 2 : 4096;
+        TraceEntry* grown = realloc(entries, capacity * sizeof(TraceEntry));
+        if (grown == NULL) return -1;
+        entries = grown;
+        entry_capacity = capacity;
+    }
+    entries[entry_count].record = *record;
+    entries[entry_count].source = source;
+    entry_count++;
+    return 0;
+}
+
+// Append the intact records of one file, oldest first
+static int load_file(const char* path, int task_filter) {
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        fprintf(stderr, "tracedump: %s: %s\n", path, strerror(errno));
+        return -1;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(TraceHeader)) {
+        fprintf(stderr, "tracedump: %s: not a trace file\n", path);
+        close(fd);
+        return -1;
+    }
+    void* map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        fprintf(stderr, "tracedump: %s: %s\n", path, strerror(errno));
+        return -1;
+    }
+
+    const TraceHeader* header = map;
+    uint32_t capacity = header->capacity;
+    if (memcmp(header->magic, TRACE_MAGIC, sizeof(header->magic)) != 0 ||
+        header->version != TRACE_VERSION || header->record_size != sizeof(TraceRecord) ||
+        capacity == 0 || (capacity & (capacity - 1)) != 0 ||
+        (size_t)st.st_size < sizeof(TraceHeader) + (size_t)capacity * sizeof(TraceRecord)) {
+        fprintf(stderr, "tracedump: %s: not a version %d trace file\n", path, TRACE_VERSION);
+        munmap(map, (size_t)st.st_size);
+        return -1;
+    }
+
+    TraceSource* grown = realloc(sources, (size_t)(source_count + 1) * sizeof(TraceSource));
+    if (grown == NULL) {
+        munmap(map, (size_t)st.st_size);
+        return -1;
+    }
+    sources = grown;
+    TraceSource* source = &sources[source_count];
+    source->pid = header->pid;
+    memcpy(source->process, header->process, sizeof(header->process));
+    source->process[sizeof(header->process)] = '\0';
+
+    // Only the newest capacity records survive in the ring
+    const TraceRecord* records = (const TraceRecord*)(header + 1);
+    uint64_t next = __atomic_load_n(&header->next, __ATOMIC_ACQUIRE);
+    uint64_t first = next > capacity ? next - capacity : 0;
+    int rc = 0;
+    for (uint64_t i = first; i < next && rc == 0; i++) {
+        const TraceRecord* r = &records[i & (capacity - 1)];
+        if (__atomic_load_n(&r->seq, __ATOMIC_ACQUIRE) != (uint32_t)(i + 1)) continue;
+        TraceRecord copy = *r;
+        if (copy.seq != (uint32_t)(i + 1)) continue;  // Overwritten while copying
+        if (task_filter > 0 && copy.task_id != task_filter) continue;
+        rc = add_entry(&copy, source_count);
+    }
+
+    source_count++;
+    munmap(map, (size_t)st.st_size);
+    return rc;
+}
+
+static int load_path(const char* path, int task_filter) {
+    struct stat st;
+    if (stat(path, &st) != 0) {
+        fprintf(stderr, "tracedump: %s: %s\n", path, strerror(errno));
+        return -1;
+    }
+    if (!S_ISDIR(st.st_mode)) return load_file(path, task_filter);
+
+    DIR* dir = opendir(path);
+    if (dir == NULL) {
+        fprintf(stderr, "tracedump: %s: %s\n", path, strerror(errno));
+        return -1;
+    }
+    int rc = 0;
+    struct dirent* de;
+    while ((de = readdir(dir)) != NULL) {
+        size_t len = strlen(de->d_name);
+        if (len < 6 || strcmp(de->d_name + len - 6, ".trace") != 0) continue;
+        char file[1024];
+        snprintf(file, sizeof(file), "%s/%s", path, de->d_name);
+        if (load_file(file, task_filter) != 0) rc = -1;
+    }
+    closedir(dir);
+    return rc;
+}
+
+static int compare_entries(const void* a, const void* b) {
+    const TraceEntry* x = a;
+    const TraceEntry* y = b;
+    if (x->record.time_ns != y->record.time_ns) return x->record.time_ns < y->record.time_ns ? -1 : 1;
+    if (x->source != y->source) return x->source < y->source ? -1 : 1;
+    return x->record.seq < y->record.seq ? -1 : (x->record.seq > y->record.seq);
+}
+
+// What an event's arg means, for people
+static void describe_arg(const TraceRecord* r, char* buf, size_t size) {
+    switch (r->event) {
+        case TRACE_TASK_SUBMIT:
+            snprintf(buf, size, "priority=%s", priority_to_string((Priority)r->arg));
+            break;
+        case TRACE_TASK_CLAIM:
+            snprintf(buf, size, "attempt=%u", r->arg);
+            break;
+        case TRACE_TASK_END:
+        case TRACE_TASK_FINISH:
+            snprintf(buf, size, "status=%s", status_to_string((TaskStatus)r->arg));
+            break;
+        case TRACE_TASK_CANCEL:
+            snprintf(buf, size, "was=%s", status_to_string((TaskStatus)r->arg));
+            break;
+        case TRACE_TASK_RETRY_WAIT:
+            snprintf(buf, size, "delay_ms=%u", r->arg);
+            break;
+        case TRACE_TASK_REQUEUE:
+            snprintf(buf, size, "from_worker=%d", (int)r->arg);
+            break;
+        case TRACE_TASK_FORWARD:
+            snprintf(buf, size, "peer_task=%u", r->arg);
+            break;
+        case TRACE_WORKER_START:
+        case TRACE_WORKER_STOP:
+            snprintf(buf, size, "pid=%u", r->arg);
+            break;
+        default:
+            buf[0] = '\0';
+            break;
+    }
+}
+
+static void print_text(void) {
+    uint64_t origin = entry_count > 0 ? entries[0].record.time_ns : 0;
+    for (size_t i = 0; i < entry_count; i++) {
+        const TraceRecord* r = &entries[i].record;
+        const TraceSource* s = &sources[entries[i].source];
+        char arg[64];
+        describe_arg(r, arg, sizeof(arg));
+        char task[16] = "-";
+        if (r->task_id > 0) snprintf(task, sizeof(task), "%d", r->task_id);
+        printf("%12.6f  %-24s %7u/%-7u task %-7s %-13s %s\n",
+               (double)(r->time_ns - origin) / 1e9, s->process, s->pid, r->tid, task,
+               trace_event_name(r->event), arg);
+    }
+}
+
+// Task runs become async slices (matched by task id within a process);
+// everything else is an instant event on the thread that recorded it
+static void print_chrome(void) {
+    uint64_t origin = entry_count > 0 ? entries[0].record.time_ns : 0;
+    printf("{\"traceEvents\":[\n");
+    int first = 1;
+    for (int i = 0; i < source_count; i++) {
+        printf("%s{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%u,\"args\":{\"name\":\"%s\"}}",
+               first ? "" : ",\n", sources[i].pid, sources[i].process);
+        first = 0;
+    }
+    for (size_t i = 0; i < entry_count; i++) {
+        const TraceRecord* r = &entries[i].record;
+        const TraceSource* s = &sources[entries[i].source];
+        double ts = (double)(r->time_ns - origin) / 1e3;
+        char arg[64];
+        describe_arg(r, arg, sizeof(arg));
+        printf("%s", first ? "" : ",\n");
+        first = 0;
+
+        if (r->event == TRACE_TASK_BEGIN || r->event == TRACE_TASK_END) {
+            printf("{\"name\":\"task %d\",\"cat\":\"task\",\"ph\":\"%s\",\"id\":%d,"
+                   "\"pid\":%u,\"tid\":%u,\"ts\":%.3f,\"args\":{\"detail\":\"%s\"}}",
+                   r->task_id, r->event == TRACE_TASK_BEGIN ? "b" : "e", r->task_id,
+                   s->pid, r->tid, ts, arg);
+        } else {
+            printf("{\"name\":\"%s\",\"cat\":\"queue\",\"ph\":\"i\",\"s\":\"t\","
+                   "\"pid\":%u,\"tid\":%u,\"ts\":%.3f,\"args\":{\"task\":%d,\"detail\":\"%s\"}}",
+                   trace_event_name(r->event), s->pid, r->tid, ts, r->task_id, arg);
+        }
+    }
+    printf("\n],\"displayTimeUnit\":\"ms\"}\n");
+}
+
+int main(int argc, char* argv[]) {
+    int chrome = 0;
+    int task_filter = 0;
+    int opt;
+    while ((opt = getopt(argc, argv, "ct:h")) != -1) {
+        switch (opt) {
+            case 'c':
+                chrome = 1;
+                break;
+            case 't':
+                task_filter = atoi(optarg);
+                if (task_filter <= 0) {
+                    fprintf(stderr, "tracedump: bad task id %s\n", optarg);
+                    return 1;
+                }
+                break;
+            case 'h':
+                print_usage(argv[0]);
+                return 0;
+            default:
+                print_usage(argv[0]);
+                return 1;
+        }
+    }
+
+    int rc = 0;
+    if (optind == argc) {
+        rc = load_path(LOG_DIR, task_filter);
+    }
+    for (int i = optind; i < argc; i++) {
+        if (load_path(argv[i], task_filter) != 0) rc = 1;
+    }
+    if (source_count == 0) {
+        fprintf(stderr, "tracedump: no trace files found\n");
+        return 1;
+    }
+
+    qsort(entries, entry_count, sizeof(TraceEntry), compare_entries);
+    if (chrome) {
+        print_chrome();
+    } else {
+        print_text();
+    }
+
+    free(entries);
+    free(sources);
+    return rc != 0;
+}
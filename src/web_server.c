@@ -1,6 +1,9 @@
 #include "common.h"
 #include "task_queue.h"
 #include "logger.h"
+#include "worker_stats.h"
+#include "trace.h"
+#include "asset_cache.h"
 #include <sys/socket.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
@@ -11,14 +14,126 @@
 #include <strings.h>
 #include <ctype.h>
 #include <pthread.h>
+#include <sys/epoll.h>
+#include <sys/uio.h>
+#include <netinet/tcp.h>
+#include <stdarg.h>
+#include <limits.h>
+#include <stddef.h>
 
 #define PORT 8080
-#define BUFFER_SIZE 8192
-#define MAX_REQUEST_SIZE 4096
+#define MAX_REQUEST_SIZE 16384      // Request line, headers and body
+#define LISTEN_BACKLOG 1024
+#define KEEPALIVE_TIMEOUT 30        // Idle (or stalled) connections are closed after this (s)
+#define OUT_HIGH_WATER (256 * 1024) // Unsent response bytes before a connection's requests wait
+#define MAX_SERVER_THREADS 16
+#define MAX_EVENTS 64
+#define STREAM_EVENT_CACHE 8        // Distinct events one push builds before rebuilding
+#define EXPORT_BATCH 64             // Tasks copied per lock (and sent per chunk) by exports
 
-static TaskQueue* queue = NULL;
+// Queues served; /q/NAME/... picks one, anything else gets the first.
+// Each event-loop thread handles one request at a time, so queue is the
+// current request's on that thread.
+typedef struct {
+    char name[MAX_QUEUE_NAME_LEN];
+    TaskQueue* queue;
+} ServedQueue;
+
+static ServedQueue served[MAX_QUEUES];
+static int served_count = 0;
+static __thread TaskQueue* queue = NULL;
 static volatile int server_running = 1;
 
+typedef enum {
+    EXPORT_JSON,
+    EXPORT_CSV
+} ExportFormat;
+
+// A task list being streamed out in batches. The queue is kept ordered by
+// (priority, id), so the key of the last task sent says where the next
+// batch starts however the queue changed in between: every task present
+// for the whole export is sent once, in the state its batch found it.
+typedef struct {
+    TaskQueue* queue;           // NULL when no export is running
+    ExportFormat format;
+    int chunked;                // Else (HTTP/1.0) the body ends when we close
+    int sent;                   // Tasks so far
+    int priority;               // Key of the last one
+    int last_id;
+} ExportCursor;
+
+// One client connection, owned by the event loop that accepted it.
+// Requests are parsed out of in; responses are appended to out and
+// written as the socket allows, so pipelined requests are answered in order.
+// A static file's bytes are not copied into out: body follows it on the
+// wire straight from the asset cache.
+typedef struct HttpConn {
+    int fd;
+    char in[MAX_REQUEST_SIZE];
+    size_t in_len;
+    char* out;
+    size_t out_len;
+    size_t out_sent;
+    size_t out_cap;
+    int keep_alive;             // Of the request being answered
+    int close_after;            // Close once out is written
+    int peer_closed;            // Client shut down its side; answer what we have
+    int draining;               // We shut down ours; discard input until the client closes
+    TaskQueue* stream_queue;    // Set once this is an /api/events stream; requests stop
+    int stream_synced;          // The subscriber has a snapshot to apply deltas to
+    unsigned long long stream_seq;  // change_seq it is up to date with
+    ExportCursor export;        // Answered before any pipelined request
+    AssetBody* body;            // Sent after out; requests wait until it is
+    size_t body_sent;
+    time_t last_active;
+    struct HttpConn* prev;
+    struct HttpConn* next;
+} HttpConn;
+
+// A parsed request. headers points at the header lines (NUL-terminated).
+typedef struct {
+    char method[16];
+    char path[256];
+    char protocol[16];
+    char* query;                // After the '?' in path (cut off there), or NULL
+    const char* headers;
+    int content_length;
+} HttpRequest;
+
+// An epoll loop with its own SO_REUSEPORT listening socket
+typedef struct {
+    int index;
+    int listen_fd;
+    int epoll_fd;
+    HttpConn* conns;
+    time_t last_sweep;
+    int subscribers;            // Connections streaming /api/events
+    unsigned long long last_push_ms;
+    pthread_t thread;
+} ServerLoop;
+
+static ServerLoop loops[MAX_SERVER_THREADS];
+static int loop_count = 1;
+static __thread ServerLoop* this_loop = NULL;
+
+// A growable string for output of unknown size; failed is set (and the
+// contents are incomplete) if an allocation failed
+typedef struct {
+    char* data;
+    size_t len;
+    size_t cap;
+    int failed;
+} TextBuffer;
+
+// One /api/events message, shared by the subscribers it is for
+typedef struct {
+    TaskQueue* queue;
+    int synced;                 // Built for subscribers at since (else a snapshot)
+    unsigned long long since;
+    unsigned long long seq;     // Where it leaves them
+    TextBuffer text;
+} StreamEvent;
+
 void signal_handler(int sig) {
     if (sig == SIGINT || sig == SIGTERM) {
         server_running = 0;
@@ -26,146 +141,322 @@ void signal_handler(int sig) {
     }
 }
 
-// Read a line from socket
-int read_line(int sockfd, char* buffer, int max_len) {
-    int i = 0;
-    char c;
-    while (i < max_len - 1) {
-        if (recv(sockfd, &c, 1, 0) <= 0) {
-            return -1;
+static const char* status_reason(int status_code) {
+    switch (status_code) {
+        case 200: return "OK";
+        case 304: return "Not Modified";
+        case 400: return "Bad Request";
+        case 404: return "Not Found";
+        case 413: return "Payload Too Large";
+        case 431: return "Request Header Fields Too Large";
+        case 500: return "Internal Server Error";
+        case 501: return "Not Implemented";
+        default:  return "OK";
+    }
+}
+
+// Append raw bytes to the connection's output
+static int conn_append(HttpConn* conn, const void* data, size_t len) {
+    // Reuse the space of what was sent before growing, so a long stream
+    // to a slow client stays within about OUT_HIGH_WATER
+    if (conn->out_len + len > conn->out_cap && conn->out_sent > 0) {
+        memmove(conn->out, conn->out + conn->out_sent, conn->out_len - conn->out_sent);
+        conn->out_len -= conn->out_sent;
+        conn->out_sent = 0;
+    }
+    if (conn->out_len + len > conn->out_cap) {
+        size_t cap = conn->out_cap ? conn->out_cap : 4096;
+        while (cap < conn->out_len + len) cap *= 2;
+        char* grown = realloc(conn->out, cap);
+        if (grown == NULL) return -1;
+        conn->out = grown;
+        conn->out_cap = cap;
+    }
+    memcpy(conn->out + conn->out_len, data, len);
+    conn->out_len += len;
+    return 0;
+}
+
+static int conn_flush(HttpConn* conn);
+static const char* find_header(const HttpRequest* req, const char* name, char* value, size_t size);
+static void generate_snapshot_json(TextBuffer* out);
+static void start_task_export(HttpConn* conn, const HttpRequest* req, ExportFormat format,
+                              const char* etag);
+
+static void text_append(TextBuffer* buf, const char* data, size_t len) {
+    if (buf->failed) return;
+    if (buf->len + len + 1 > buf->cap) {
+        size_t cap = buf->cap ? buf->cap : 4096;
+        while (cap < buf->len + len + 1) cap *= 2;
+        char* grown = realloc(buf->data, cap);
+        if (grown == NULL) {
+            buf->failed = 1;
+            return;
         }
-        if (c == '\n') {
-            buffer[i] = '\0';
-            return i;
+        buf->data = grown;
+        buf->cap = cap;
+    }
+    memcpy(buf->data + buf->len, data, len);
+    buf->len += len;
+    buf->data[buf->len] = '\0';
+}
+
+static void text_printf(TextBuffer* buf, const char* format, ...) {
+    char chunk[2048];
+    va_list args;
+    va_start(args, format);
+    int len = vsnprintf(chunk, sizeof(chunk), format, args);
+    va_end(args);
+    if (len < 0) {
+        buf->failed = 1;
+    } else if ((size_t)len < sizeof(chunk)) {
+        text_append(buf, chunk, (size_t)len);
+    } else {
+        char* big = malloc((size_t)len + 1);
+        if (big == NULL) {
+            buf->failed = 1;
+            return;
         }
-        if (c != '\r') {
-            buffer[i++] = c;
+        va_start(args, format);
+        vsnprintf(big, (size_t)len + 1, format, args);
+        va_end(args);
+        text_append(buf, big, (size_t)len);
+        free(big);
+    }
+}
+
+// s as a JSON string literal, quotes included
+static void text_append_json_string(TextBuffer* buf, const char* s) {
+    text_append(buf, "\"", 1);
+    const char* run = s;
+    for (; *s != '\0'; s++) {
+        unsigned char c = (unsigned char)*s;
+        if (c >= 0x20 && c != '"' && c != '\\') continue;
+        text_append(buf, run, (size_t)(s - run));
+        if (c == '"' || c == '\\') {
+            char escaped[2] = { '\\', (char)c };
+            text_append(buf, escaped, 2);
+        } else {
+            text_printf(buf, "\\u%04x", c);
         }
+        run = s + 1;
     }
-    buffer[i] = '\0';
-    return i;
+    text_append(buf, run, (size_t)(s - run));
+    text_append(buf, "\"", 1);
 }
 
-// Send HTTP response
-void send_response(int sockfd, int status_code, const char* content_type, const char* body, int body_len) {
+// s as a quoted CSV field (RFC 4180: quotes doubled, newlines kept)
+static void text_append_csv_field(TextBuffer* buf, const char* s) {
+    text_append(buf, "\"", 1);
+    const char* quote;
+    while ((quote = strchr(s, '"')) != NULL) {
+        text_append(buf, s, (size_t)(quote - s + 1));
+        text_append(buf, "\"", 1);
+        s = quote + 1;
+    }
+    text_append(buf, s, strlen(s));
+    text_append(buf, "\"", 1);
+}
+
+// Queue an HTTP response. With an etag, clients are told to revalidate
+// (so browsers send If-None-Match by themselves); a 304 carries no body.
+static void send_response_etag(HttpConn* conn, int status_code, const char* content_type,
+                               const char* body, int body_len, const char* etag) {
     char header[512];
-    snprintf(header, sizeof(header),
-        "HTTP/1.1 %d OK\r\n"
-        "Content-Type: %s\r\n"
-        "Content-Length: %d\r\n"
+    int header_len = snprintf(header, sizeof(header), "HTTP/1.1 %d %s\r\n", status_code,
+                              status_reason(status_code));
+    if (status_code != 304) {
+        header_len += snprintf(header + header_len, sizeof(header) - header_len,
+            "Content-Type: %s\r\n"
+            "Content-Length: %d\r\n",
+            content_type, body_len);
+    }
+    if (etag != NULL) {
+        header_len += snprintf(header + header_len, sizeof(header) - header_len,
+            "ETag: %s\r\n"
+            "Cache-Control: no-cache\r\n",
+            etag);
+    }
+    header_len += snprintf(header + header_len, sizeof(header) - header_len,
         "Access-Control-Allow-Origin: *\r\n"
-        "Connection: close\r\n"
+        "Connection: %s\r\n"
         "\r\n",
-        status_code, content_type, body_len);
+        conn->keep_alive ? "keep-alive" : "close");
     
-    send(sockfd, header, strlen(header), 0);
-    if (body && body_len > 0) {
-        send(sockfd, body, body_len, 0);
+    if (conn_append(conn, header, header_len) != 0 ||
+        (body && body_len > 0 && conn_append(conn, body, body_len) != 0)) {
+        conn->close_after = 1;
+        return;
     }
+    if (!conn->keep_alive) conn->close_after = 1;
 }
 
-// Generate JSON for task status
-void generate_status_json(char* buffer, int buffer_size) {
-    if (queue == NULL) {
-        snprintf(buffer, buffer_size, "{\"error\":\"Queue not available\"}");
+void send_response(HttpConn* conn, int status_code, const char* content_type, const char* body, int body_len) {
+    send_response_etag(conn, status_code, content_type, body, body_len, NULL);
+}
+
+// A fixed body, its length taken from the literal rather than counted by hand
+#define send_literal(conn, status_code, content_type, literal) \
+    send_response((conn), (status_code), (content_type), (literal), (int)sizeof(literal) - 1)
+
+// Weak ETag of a queue view: the segment and its version counter, plus for
+// worker views which workers are alive, since heartbeats going stale do not
+// bump the version. Weak because running tasks' progress and heartbeat
+// ages move with the clock alone.
+static void view_etag(TaskQueue* q, int with_workers, char* etag, size_t size) {
+    unsigned long long version = queue_version(q);
+    if (!with_workers) {
+        snprintf(etag, size, "W/\"%lx-%llu\"", (unsigned long)q->created_at, version);
         return;
     }
-    
-    pthread_mutex_lock(&queue->queue_mutex);
-    
-    int pending = get_pending_task_count(queue);
-    int running = get_running_task_count(queue);
-    int completed = queue->completed_tasks;
-    int failed = queue->failed_tasks;
-    int total = queue->total_tasks;
+    time_t now = time(NULL);
+    unsigned long long alive = 0;
+    for (int i = 0; i < MAX_WORKERS; i++) {
+        WorkerSlot slot;
+        worker_stats_read(&q->workers[i], &slot);
+        alive = (alive << 1 | alive >> 63) ^ (unsigned long long)worker_stats_alive(&slot, now);
+    }
+    snprintf(etag, size, "W/\"%lx-%llu-%llx\"", (unsigned long)q->created_at, version, alive);
+}
+
+// If-None-Match: "*" or a list of (weak or strong) tags, compared weakly
+static int etag_matches(const char* if_none_match, const char* etag) {
+    if (if_none_match == NULL) return 0;
+    if (strcmp(if_none_match, "*") == 0) return 1;
+    if (strncmp(etag, "W/", 2) == 0) etag += 2;
+    size_t etag_len = strlen(etag);
+    const char* p = if_none_match;
+    while (*p != '\0') {
+        while (*p == ' ' || *p == ',') p++;
+        if (strncmp(p, "W/", 2) == 0) p += 2;
+        const char* end = strchr(p, ',');
+        size_t len = end ? (size_t)(end - p) : strlen(p);
+        while (len > 0 && p[len - 1] == ' ') len--;
+        if (len == etag_len && strncmp(p, etag, len) == 0) return 1;
+        if (end == NULL) break;
+        p = end + 1;
+    }
+    return 0;
+}
+
+// Queue counters as JSON (mutex held)
+static void format_status_json_locked(TaskQueue* q, char* buffer, int buffer_size) {
+    int pending = get_pending_task_count(q);
+    int running = get_running_task_count(q);
+    int retry_wait = 0, handoff = 0, forwarded = 0;
+    for (int i = 0; i < q->size; i++) {
+        if (q->tasks[i].status == STATUS_RETRY_WAIT) retry_wait++;
+        else if (q->tasks[i].status == STATUS_HANDOFF) handoff++;
+        else if (q->tasks[i].status == STATUS_FORWARDED) forwarded++;
+    }
     
     snprintf(buffer, buffer_size,
         "{"
+        "\"queue\":\"%s\","
         "\"total_tasks\":%d,"
         "\"completed_tasks\":%d,"
         "\"failed_tasks\":%d,"
         "\"pending_tasks\":%d,"
         "\"running_tasks\":%d,"
+        "\"retry_wait_tasks\":%d,"
+        "\"handoff_tasks\":%d,"
+        "\"forwarded_tasks\":%d,"
         "\"active_workers\":%d,"
         "\"queue_size\":%d,"
         "\"queue_capacity\":%d"
         "}",
-        total, completed, failed, pending, running,
-        queue->num_active_workers, queue->size, queue->capacity);
-    
-    pthread_mutex_unlock(&queue->queue_mutex);
+        q->name, q->total_tasks, q->completed_tasks, q->failed_tasks, pending, running,
+        retry_wait, handoff, forwarded, q->num_active_workers, q->size, q->capacity);
 }
 
-// Generate JSON for tasks list
-void generate_tasks_json(char* buffer, int buffer_size) {
+// Generate JSON for task status
+void generate_status_json(char* buffer, int buffer_size) {
     if (queue == NULL) {
         snprintf(buffer, buffer_size, "{\"error\":\"Queue not available\"}");
         return;
     }
     
-    pthread_mutex_lock(&queue->queue_mutex);
-    
-    strcpy(buffer, "{\"tasks\":[");
-    int first = 1;
+    lock_queue(queue);
+    format_status_json_locked(queue, buffer, buffer_size);
+    unlock_queue(queue);
+}
+
+// One task as a JSON object
+static void append_task_json(TextBuffer* out, const Task* task) {
+    char creation_time[64], start_time[64], end_time[64], retry_time[64] = "";
+    format_timestamp(task->creation_time, creation_time, sizeof(creation_time));
+    if (task->status == STATUS_RETRY_WAIT && task->retry_time > 0) {
+        format_timestamp(task->retry_time, retry_time, sizeof(retry_time));
+    }
+    if (task->start_time > 0) {
+        format_timestamp(task->start_time, start_time, sizeof(start_time));
+    } else {
+        strcpy(start_time, "");
+    }
+    if (task->end_time > 0) {
+        format_timestamp(task->end_time, end_time, sizeof(end_time));
+    } else {
+        strcpy(end_time, "");
+    }
     
-    for (int i = 0; i < queue->size; i++) {
-        Task* task = &queue->tasks[i];
-        
-        char creation_time[64], start_time[64], end_time[64];
-        format_timestamp(task->creation_time, creation_time, sizeof(creation_time));
-        if (task->start_time > 0) {
-            format_timestamp(task->start_time, start_time, sizeof(start_time));
-        } else {
-            strcpy(start_time, "");
-        }
-        if (task->end_time > 0) {
-            format_timestamp(task->end_time, end_time, sizeof(end_time));
-        } else {
-            strcpy(end_time, "");
-        }
-        
-        // Calculate progress for running tasks
-        double progress = 0.0;
-        if (task->status == STATUS_RUNNING && task->start_time > 0) {
-            time_t now = time(NULL);
-            time_t elapsed = now - task->start_time;
-            if (task->execution_time_ms > 0) {
-                progress = ((double)elapsed * 1000.0) / (double)task->execution_time_ms;
-                if (progress > 100.0) progress = 100.0;
-            }
-        } else if (task->status == STATUS_COMPLETED) {
-            progress = 100.0;
+    // Calculate progress for running tasks
+    double progress = 0.0;
+    if (task->status == STATUS_RUNNING && task->start_time > 0) {
+        time_t now = time(NULL);
+        time_t elapsed = now - task->start_time;
+        if (task->execution_time_ms > 0) {
+            progress = ((double)elapsed * 1000.0) / (double)task->execution_time_ms;
+            if (progress > 100.0) progress = 100.0;
         }
-        
-        if (!first) strcat(buffer, ",");
-        first = 0;
-        
-        char task_json[768];
-        snprintf(task_json, sizeof(task_json),
-            "{"
-            "\"id\":%d,"
-            "\"name\":\"%s\","
-            "\"priority\":\"%s\","
-            "\"status\":\"%s\","
-            "\"creation_time\":\"%s\","
-            "\"start_time\":\"%s\","
-            "\"end_time\":\"%s\","
-            "\"execution_time_ms\":%u,"
-            "\"worker_id\":%d,"
-            "\"progress\":%.2f"
-            "}",
-            task->id, task->name,
-            priority_to_string(task->priority),
-            status_to_string(task->status),
-            creation_time, start_time, end_time,
-            task->execution_time_ms, task->worker_id, progress);
-        
-        strcat(buffer, task_json);
+    } else if (task->status == STATUS_COMPLETED) {
+        progress = 100.0;
     }
     
-    strcat(buffer, "]}");
-    
-    pthread_mutex_unlock(&queue->queue_mutex);
+    text_printf(out, "{\"id\":%d,\"name\":", task->id);
+    text_append_json_string(out, task->name);
+    text_printf(out,
+        ","
+        "\"priority\":\"%s\","
+        "\"status\":\"%s\","
+        "\"creation_time\":\"%s\","
+        "\"start_time\":\"%s\","
+        "\"end_time\":\"%s\","
+        "\"execution_time_ms\":%u,"
+        "\"timeout_ms\":%u,"
+        "\"cancel_requested\":%s,"
+        "\"max_retries\":%u,"
+        "\"attempts\":%u,"
+        "\"retry_time\":\"%s\","
+        "\"last_error\":",
+        priority_to_string(task->priority),
+        status_to_string(task->status),
+        creation_time, start_time, end_time,
+        task->execution_time_ms, task->timeout_ms,
+        task->cancel_requested ? "true" : "false",
+        task->max_retries, task->attempts, retry_time);
+    text_append_json_string(out, task->last_error);
+    text_printf(out, ",\"worker_id\":%d,\"peer\":", task->worker_id);
+    text_append_json_string(out, task->peer);
+    text_printf(out,
+        ","
+        "\"peer_task_id\":%d,"
+        "\"progress\":%.2f,"
+        "\"usage\":{"
+        "\"cpu_time_us\":%llu,"
+        "\"cpu_user_us\":%llu,"
+        "\"cpu_system_us\":%llu,"
+        "\"max_rss_kb\":%ld,"
+        "\"voluntary_ctx_switches\":%ld,"
+        "\"involuntary_ctx_switches\":%ld,"
+        "\"io_read_bytes\":%llu,"
+        "\"io_write_bytes\":%llu"
+        "}"
+        "}",
+        task->peer_task_id, progress,
+        task->usage.cpu_time_us, task->usage.cpu_user_us, task->usage.cpu_system_us,
+        task->usage.max_rss_kb,
+        task->usage.voluntary_ctx_switches, task->usage.involuntary_ctx_switches,
+        task->usage.io_read_bytes, task->usage.io_write_bytes);
 }
 
 // Generate JSON for workers status
@@ -175,7 +466,15 @@ void generate_workers_json(char* buffer, int buffer_size) {
         return;
     }
     
-    pthread_mutex_lock(&queue->queue_mutex);
+    // Every attached process counts toward the total, draining ones included
+    int total_workers = 0;
+    for (int i = 0; i < MAX_WORKERS; i++) {
+        WorkerSlot slot;
+        worker_stats_read(&queue->workers[i], &slot);
+        if (slot.pid != 0) total_workers++;
+    }
+    
+    lock_queue(queue);
     
     int active_workers = queue->num_active_workers;
     
@@ -183,57 +482,266 @@ void generate_workers_json(char* buffer, int buffer_size) {
         "{"
         "\"active_workers\":%d,"
         "\"total_workers\":%d,"
+        "\"min_workers\":%d,"
+        "\"max_workers\":%d,"
+        "\"threads_per_worker\":%d,"
+        "\"sched_policy\":\"%s\","
+        "\"config_generation\":%d,"
         "\"scheduler_pid\":%d"
         "}",
-        active_workers, NUM_WORKERS, (int)queue->scheduler_pid);
+        active_workers, total_workers, queue->min_workers, queue->max_workers,
+        queue->config.threads_per_worker, sched_policy_to_string(queue->config.sched_policy),
+        queue->config_generation, (int)queue->scheduler_pid);
     
-    pthread_mutex_unlock(&queue->queue_mutex);
+    unlock_queue(queue);
 }
 
 
-// Serve static file
-void serve_file(int sockfd, const char* filepath, const char* content_type) {
-    // Prepend "web/" to filepath for web directory
-    char full_path[512];
-    snprintf(full_path, sizeof(full_path), "web/%s", filepath);
-    
-    FILE* file = fopen(full_path, "r");
-    if (file == NULL) {
-        send_response(sockfd, 404, "text/html", "<h1>404 Not Found</h1>", 21);
+// What one /metrics scrape takes from a queue
+typedef struct {
+    int tasks[TASK_STATUS_COUNT][PRIORITY_COUNT];
+    int capacity;
+    QueueMetrics metrics;
+    WorkerSlot workers[MAX_WORKERS];
+} MetricsSample;
+
+// Status and priority names as Prometheus label values
+static const char* metric_label(const char* name, char* buf, size_t size) {
+    size_t i = 0;
+    for (; name[i] != '\0' && i + 1 < size; i++) buf[i] = (char)tolower((unsigned char)name[i]);
+    buf[i] = '\0';
+    return buf;
+}
+
+static void metric_family(TextBuffer* out, const char* name, const char* type, const char* help) {
+    text_printf(out, "# HELP %s %s\n# TYPE %s %s\n", name, help, name, type);
+}
+
+static void metric_histogram(TextBuffer* out, const char* name, const char* labels,
+                             const LatencyHistogram* histogram) {
+    unsigned long long count = 0;
+    for (int b = 0; b < METRICS_BUCKETS; b++) {
+        count += histogram->buckets[b];
+        char le[32] = "+Inf";
+        if (b < METRICS_BUCKETS - 1) {
+            snprintf(le, sizeof(le), "%.10g", (double)(METRICS_BUCKET_BASE_US << b) / 1e6);
+        }
+        text_printf(out, "%s_bucket{%s,le=\"%s\"} %llu\n", name, labels, le, count);
+    }
+    text_printf(out, "%s_sum{%s} %.6f\n", name, labels, (double)histogram->sum_us / 1e6);
+    text_printf(out, "%s_count{%s} %llu\n", name, labels, count);
+}
+
+// Prometheus text format for every served queue. Task counts come from
+// the status indexes under one short lock per queue; totals, histograms
+// and worker figures are read with atomics. A scrape therefore costs the
+// same however many tasks the queue holds or has seen.
+static void generate_metrics(TextBuffer* out) {
+    MetricsSample* samples = calloc((size_t)served_count, sizeof(MetricsSample));
+    if (samples == NULL) {
+        out->failed = 1;
         return;
     }
+    for (int q = 0; q < served_count; q++) {
+        TaskQueue* tq = served[q].queue;
+        MetricsSample* sample = &samples[q];
+        lock_queue(tq);
+        for (int s = 0; s < TASK_STATUS_COUNT; s++) {
+            memcpy(sample->tasks[s], tq->status_index[s].priority_count, sizeof(sample->tasks[s]));
+        }
+        sample->capacity = tq->capacity;
+        unlock_queue(tq);
+        metrics_read(tq, &sample->metrics);
+        for (int w = 0; w < MAX_WORKERS; w++) {
+            worker_stats_read(&tq->workers[w], &sample->workers[w]);
+        }
+    }
     
-    fseek(file, 0, SEEK_END);
-    long file_size = ftell(file);
-    fseek(file, 0, SEEK_SET);
+    char status[32], priority[32], labels[128];
+    metric_family(out, "task_scheduler_tasks", "gauge", "Tasks in the queue by status and priority.");
+    for (int q = 0; q < served_count; q++) {
+        for (int s = 0; s < TASK_STATUS_COUNT; s++) {
+            for (int p = 0; p < PRIORITY_COUNT; p++) {
+                text_printf(out, "task_scheduler_tasks{queue=\"%s\",status=\"%s\",priority=\"%s\"} %d\n",
+                            served[q].name,
+                            metric_label(status_to_string((TaskStatus)s), status, sizeof(status)),
+                            metric_label(priority_to_string((Priority)p), priority, sizeof(priority)),
+                            samples[q].tasks[s][p]);
+            }
+        }
+    }
+    metric_family(out, "task_scheduler_queue_capacity", "gauge", "Task slots in the queue.");
+    for (int q = 0; q < served_count; q++) {
+        text_printf(out, "task_scheduler_queue_capacity{queue=\"%s\"} %d\n", served[q].name, samples[q].capacity);
+    }
     
-    char* content = malloc(file_size + 1);
-    if (content == NULL) {
-        fclose(file);
-        send_response(sockfd, 500, "text/html", "<h1>500 Internal Server Error</h1>", 33);
-        return;
+    static const struct {
+        const char* name;
+        const char* help;
+        size_t offset;
+    } totals[] = {
+        { "task_scheduler_tasks_enqueued_total", "Tasks submitted.", offsetof(QueueMetrics, enqueued) },
+        { "task_scheduler_tasks_claimed_total", "Task attempts started by workers.", offsetof(QueueMetrics, claimed) },
+        { "task_scheduler_tasks_completed_total", "Task attempts that completed.", offsetof(QueueMetrics, completed) },
+        { "task_scheduler_tasks_failed_total", "Task attempts that failed, timed out or were cancelled.",
+          offsetof(QueueMetrics, failed) },
+    };
+    for (size_t t = 0; t < sizeof(totals) / sizeof(totals[0]); t++) {
+        metric_family(out, totals[t].name, "counter", totals[t].help);
+        for (int q = 0; q < served_count; q++) {
+            const unsigned long long* values =
+                (const unsigned long long*)((const char*)&samples[q].metrics + totals[t].offset);
+            for (int p = 0; p < PRIORITY_COUNT; p++) {
+                text_printf(out, "%s{queue=\"%s\",priority=\"%s\"} %llu\n", totals[t].name, served[q].name,
+                            metric_label(priority_to_string((Priority)p), priority, sizeof(priority)), values[p]);
+            }
+        }
     }
     
-    fread(content, 1, file_size, file);
-    content[file_size] = '\0';
-    fclose(file);
+    metric_family(out, "task_scheduler_queue_wait_seconds", "histogram",
+                  "Time from becoming PENDING until a worker claimed the task.");
+    for (int q = 0; q < served_count; q++) {
+        for (int p = 0; p < PRIORITY_COUNT; p++) {
+            snprintf(labels, sizeof(labels), "queue=\"%s\",priority=\"%s\"", served[q].name,
+                     metric_label(priority_to_string((Priority)p), priority, sizeof(priority)));
+            metric_histogram(out, "task_scheduler_queue_wait_seconds", labels, &samples[q].metrics.queue_wait[p]);
+        }
+    }
+    metric_family(out, "task_scheduler_execution_seconds", "histogram",
+                  "Time from claim until the worker finished the attempt.");
+    for (int q = 0; q < served_count; q++) {
+        for (int p = 0; p < PRIORITY_COUNT; p++) {
+            snprintf(labels, sizeof(labels), "queue=\"%s\",priority=\"%s\"", served[q].name,
+                     metric_label(priority_to_string((Priority)p), priority, sizeof(priority)));
+            metric_histogram(out, "task_scheduler_execution_seconds", labels, &samples[q].metrics.execution[p]);
+        }
+    }
     
-    send_response(sockfd, 200, content_type, content, file_size);
-    free(content);
+    // Per worker id that ever ran; utilization is the share of its task
+    // slots in use right now, busy seconds its integral
+    time_t now = time(NULL);
+    metric_family(out, "task_scheduler_worker_up", "gauge", "Whether the worker's heartbeat is current.");
+    for (int q = 0; q < served_count; q++) {
+        for (int w = 0; w < MAX_WORKERS; w++) {
+            const WorkerSlot* slot = &samples[q].workers[w];
+            if (slot->started_at == 0) continue;
+            text_printf(out, "task_scheduler_worker_up{queue=\"%s\",worker=\"%d\"} %d\n", served[q].name, w,
+                        worker_stats_alive(slot, now));
+        }
+    }
+    metric_family(out, "task_scheduler_worker_inflight_tasks", "gauge", "Tasks the worker is running.");
+    for (int q = 0; q < served_count; q++) {
+        for (int w = 0; w < MAX_WORKERS; w++) {
+            const WorkerSlot* slot = &samples[q].workers[w];
+            if (slot->started_at == 0) continue;
+            text_printf(out, "task_scheduler_worker_inflight_tasks{queue=\"%s\",worker=\"%d\"} %d\n",
+                        served[q].name, w, slot->inflight_tasks);
+        }
+    }
+    metric_family(out, "task_scheduler_worker_utilization", "gauge",
+                  "Running tasks over the worker's capacity.");
+    for (int q = 0; q < served_count; q++) {
+        for (int w = 0; w < MAX_WORKERS; w++) {
+            const WorkerSlot* slot = &samples[q].workers[w];
+            if (slot->started_at == 0) continue;
+            double utilization = slot->capacity > 0 && worker_stats_alive(slot, now)
+                                 ? (double)slot->inflight_tasks / slot->capacity : 0.0;
+            text_printf(out, "task_scheduler_worker_utilization{queue=\"%s\",worker=\"%d\"} %.4f\n",
+                        served[q].name, w, utilization);
+        }
+    }
+    metric_family(out, "task_scheduler_worker_busy_seconds_total", "counter",
+                  "Summed run time of the tasks the worker finished.");
+    for (int q = 0; q < served_count; q++) {
+        for (int w = 0; w < MAX_WORKERS; w++) {
+            const WorkerSlot* slot = &samples[q].workers[w];
+            if (slot->started_at == 0) continue;
+            text_printf(out, "task_scheduler_worker_busy_seconds_total{queue=\"%s\",worker=\"%d\"} %.6f\n",
+                        served[q].name, w, (double)slot->busy_time_us / 1e6);
+        }
+    }
+    free(samples);
 }
 
-// Read HTTP body for POST requests
-int read_http_body(int sockfd, char* buffer, int max_len, int content_length) {
-    int total_read = 0;
-    char c;
-    while (total_read < content_length && total_read < max_len - 1) {
-        if (recv(sockfd, &c, 1, 0) <= 0) {
-            return -1;
+// Encodings the client takes, as an asset_lookup mask: those named in
+// Accept-Encoding without q=0, and with "*" any not named
+static unsigned accepted_encodings(const char* accept_encoding) {
+    unsigned accepted = 0, named = 0;
+    int star = 0;
+    const char* p = accept_encoding;
+    while (p != NULL && *p != '\0') {
+        while (*p == ' ' || *p == ',') p++;
+        size_t item_len = strcspn(p, ",");
+        size_t name_len = strcspn(p, ",; ");
+        int refused = 0;
+        const char* param = memchr(p, ';', item_len);
+        if (param != NULL) {
+            param++;
+            while (*param == ' ') param++;
+            refused = (*param == 'q' || *param == 'Q') && param[1] == '=' && strtod(param + 2, NULL) <= 0;
         }
-        buffer[total_read++] = c;
+        unsigned mask = 0;
+        if ((name_len == 4 && strncasecmp(p, "gzip", 4) == 0) ||
+            (name_len == 6 && strncasecmp(p, "x-gzip", 6) == 0)) {
+            mask = ASSET_ACCEPT(ASSET_GZIP);
+        } else if (name_len == 2 && strncasecmp(p, "br", 2) == 0) {
+            mask = ASSET_ACCEPT(ASSET_BROTLI);
+        } else if (name_len == 1 && *p == '*') {
+            star = !refused;
+        }
+        named |= mask;
+        if (!refused) accepted |= mask;
+        p += item_len;
     }
-    buffer[total_read] = '\0';
-    return total_read;
+    if (star) accepted |= (ASSET_ACCEPT(ASSET_GZIP) | ASSET_ACCEPT(ASSET_BROTLI)) & ~named;
+    return accepted;
+}
+
+// Serve a dashboard file from the asset cache in the best encoding the
+// client takes. The ETag names the bytes, so a reload changes it.
+static void serve_asset(HttpConn* conn, const HttpRequest* req, const char* name) {
+    char value[256];
+    AssetVariant variant;
+    unsigned accepted = accepted_encodings(find_header(req, "Accept-Encoding", value, sizeof(value)));
+    if (asset_lookup(name, accepted, &variant) != 0) {
+        send_literal(conn, 404, "text/html", "<h1>404 Not Found</h1>");
+        return;
+    }
+    int not_modified = etag_matches(find_header(req, "If-None-Match", value, sizeof(value)), variant.etag);
+    
+    char header[512];
+    int header_len = snprintf(header, sizeof(header), "HTTP/1.1 %d %s\r\n",
+                              not_modified ? 304 : 200, status_reason(not_modified ? 304 : 200));
+    if (!not_modified) {
+        header_len += snprintf(header + header_len, sizeof(header) - header_len,
+            "Content-Type: %s\r\n"
+            "Content-Length: %zu\r\n",
+            variant.content_type, variant.body->len);
+        if (variant.encoding != NULL) {
+            header_len += snprintf(header + header_len, sizeof(header) - header_len,
+                "Content-Encoding: %s\r\n", variant.encoding);
+        }
+    }
+    header_len += snprintf(header + header_len, sizeof(header) - header_len,
+        "Vary: Accept-Encoding\r\n"
+        "ETag: %s\r\n"
+        "Cache-Control: no-cache\r\n"
+        "Connection: %s\r\n"
+        "\r\n",
+        variant.etag, conn->keep_alive ? "keep-alive" : "close");
+    
+    if (conn_append(conn, header, header_len) != 0) {
+        asset_release(variant.body);
+        conn->close_after = 1;
+        return;
+    }
+    if (not_modified) {
+        asset_release(variant.body);
+    } else {
+        conn->body = variant.body;
+        conn->body_sent = 0;
+    }
+    if (!conn->keep_alive) conn->close_after = 1;
 }
 
 // Parse JSON from POST body (simple parsing for our needs)
@@ -268,23 +776,38 @@ int parse_json_field(const char* json, const char* field, char* value, int max_l
 }
 
 // Handle POST request to add task
-void handle_add_task_post(int sockfd, const char* body, int body_len) {
+void handle_add_task_post(HttpConn* conn, const char* body, int body_len) {
     (void)body_len;  // Suppress unused parameter warning
     if (queue == NULL) {
-        send_response(sockfd, 500, "application/json", "{\"error\":\"Queue not available\"}", 33);
+        send_literal(conn, 500, "application/json", "{\"error\":\"Queue not available\"}");
         return;
     }
     
     char name[256] = {0};
     char priority_str[32] = {0};
     char duration_str[32] = {0};
+    char timeout_str[32] = {0};
+    char retries_str[32] = {0};
+    char backoff_base_str[32] = {0};
+    char backoff_cap_str[32] = {0};
+    char backoff_jitter_str[32] = {0};
     
     parse_json_field(body, "name", name, sizeof(name));
     parse_json_field(body, "priority", priority_str, sizeof(priority_str));
     parse_json_field(body, "duration", duration_str, sizeof(duration_str));
+    parse_json_field(body, "timeout", timeout_str, sizeof(timeout_str));  // Optional, ms
+    // Optional retry policy; unset backoff fields take the config.h defaults
+    parse_json_field(body, "max_retries", retries_str, sizeof(retries_str));
+    parse_json_field(body, "backoff_base_ms", backoff_base_str, sizeof(backoff_base_str));
+    parse_json_field(body, "backoff_cap_ms", backoff_cap_str, sizeof(backoff_cap_str));
+    parse_json_field(body, "backoff_jitter", backoff_jitter_str, sizeof(backoff_jitter_str));
     
     if (strlen(name) == 0 || strlen(priority_str) == 0 || strlen(duration_str) == 0) {
-        send_response(sockfd, 400, "application/json", "{\"error\":\"Missing required fields\"}", 36);
+        send_literal(conn, 400, "application/json", "{\"error\":\"Missing required fields\"}");
+        return;
+    }
+    if (!task_name_valid(name)) {
+        send_literal(conn, 400, "application/json", "{\"error\":\"Invalid name\"}");
         return;
     }
     
@@ -293,23 +816,31 @@ void handle_add_task_post(int sockfd, const char* body, int body_len) {
     else if (strcasecmp(priority_str, "MEDIUM") == 0) priority = PRIORITY_MEDIUM;
     else if (strcasecmp(priority_str, "LOW") == 0) priority = PRIORITY_LOW;
     else {
-        send_response(sockfd, 400, "application/json", "{\"error\":\"Invalid priority\"}", 28);
+        send_literal(conn, 400, "application/json", "{\"error\":\"Invalid priority\"}");
         return;
     }
     
     unsigned int duration = (unsigned int)atoi(duration_str);
     if (duration == 0) {
-        send_response(sockfd, 400, "application/json", "{\"error\":\"Invalid duration\"}", 29);
+        send_literal(conn, 400, "application/json", "{\"error\":\"Invalid duration\"}");
         return;
     }
     
-    int task_id = enqueue_task(queue, name, priority, duration);
+    TaskOptions options;
+    memset(&options, 0, sizeof(options));
+    options.timeout_ms = (unsigned int)atoi(timeout_str);
+    options.max_retries = (unsigned int)atoi(retries_str);
+    options.backoff_base_ms = (unsigned int)atoi(backoff_base_str);
+    options.backoff_cap_ms = (unsigned int)atoi(backoff_cap_str);
+    options.backoff_jitter = (unsigned int)atoi(backoff_jitter_str);
+    
+    int task_id = enqueue_task_ex(queue, name, priority, duration, &options);
     if (task_id > 0) {
         char response[256];
         snprintf(response, sizeof(response), "{\"success\":true,\"task_id\":%d,\"message\":\"Task added successfully\"}", task_id);
-        send_response(sockfd, 200, "application/json", response, strlen(response));
+        send_response(conn, 200, "application/json", response, strlen(response));
     } else {
-        send_response(sockfd, 500, "application/json", "{\"error\":\"Failed to add task (queue might be full)\"}", 50);
+        send_literal(conn, 500, "application/json", "{\"error\":\"Failed to add task (queue might be full)\"}");
     }
 }
 
@@ -410,10 +941,10 @@ void* run_simulation_thread(void* arg) {
 }
 
 // Handle POST request to run simulation
-void handle_simulation_post(int sockfd, const char* body, int body_len) {
+void handle_simulation_post(HttpConn* conn, const char* body, int body_len) {
     (void)body_len;  // Suppress unused parameter warning
     if (queue == NULL) {
-        send_response(sockfd, 500, "application/json", "{\"error\":\"Queue not available\"}", 33);
+        send_literal(conn, 500, "application/json", "{\"error\":\"Queue not available\"}");
         return;
     }
     
@@ -432,7 +963,7 @@ void handle_simulation_post(int sockfd, const char* body, int body_len) {
     // Allocate thread data
     SimulationData* data = (SimulationData*)malloc(sizeof(SimulationData));
     if (data == NULL) {
-        send_response(sockfd, 500, "application/json", "{\"error\":\"Memory allocation failed\"}", 37);
+        send_literal(conn, 500, "application/json", "{\"error\":\"Memory allocation failed\"}");
         return;
     }
     
@@ -446,7 +977,7 @@ void handle_simulation_post(int sockfd, const char* body, int body_len) {
     pthread_t thread;
     if (pthread_create(&thread, NULL, run_simulation_thread, data) != 0) {
         free(data);
-        send_response(sockfd, 500, "application/json", "{\"error\":\"Failed to start simulation thread\"}", 45);
+        send_literal(conn, 500, "application/json", "{\"error\":\"Failed to start simulation thread\"}");
         return;
     }
     
@@ -457,14 +988,14 @@ void handle_simulation_post(int sockfd, const char* body, int body_len) {
     char response[256];
     snprintf(response, sizeof(response), "{\"success\":true,\"total\":%d,\"message\":\"Simulation started in background\"}", 
              task_count);
-    send_response(sockfd, 200, "application/json", response, strlen(response));
+    send_response(conn, 200, "application/json", response, strlen(response));
 }
 
 // Handle POST request to cancel task
-void handle_cancel_task_post(int sockfd, const char* body, int body_len) {
+void handle_cancel_task_post(HttpConn* conn, const char* body, int body_len) {
     (void)body_len;
     if (queue == NULL) {
-        send_response(sockfd, 500, "application/json", "{\"error\":\"Queue not available\"}", 33);
+        send_literal(conn, 500, "application/json", "{\"error\":\"Queue not available\"}");
         return;
     }
     
@@ -472,7 +1003,7 @@ void handle_cancel_task_post(int sockfd, const char* body, int body_len) {
     parse_json_field(body, "task_id", task_id_str, sizeof(task_id_str));
     
     if (strlen(task_id_str) == 0) {
-        send_response(sockfd, 400, "application/json", "{\"error\":\"Missing task_id\"}", 27);
+        send_literal(conn, 400, "application/json", "{\"error\":\"Missing task_id\"}");
         return;
     }
     
@@ -482,259 +1013,1275 @@ void handle_cancel_task_post(int sockfd, const char* body, int body_len) {
     if (result == 0) {
         char response[128];
         snprintf(response, sizeof(response), "{\"success\":true,\"task_id\":%d,\"message\":\"Task cancelled\"}", task_id);
-        send_response(sockfd, 200, "application/json", response, strlen(response));
+        send_response(conn, 200, "application/json", response, strlen(response));
+    } else if (result == 1) {
+        char response[128];
+        snprintf(response, sizeof(response), "{\"success\":true,\"task_id\":%d,\"message\":\"Cancellation requested\"}", task_id);
+        send_response(conn, 200, "application/json", response, strlen(response));
     } else if (result == -1) {
-        send_response(sockfd, 404, "application/json", "{\"error\":\"Task not found\"}", 26);
+        send_literal(conn, 404, "application/json", "{\"error\":\"Task not found\"}");
     } else if (result == -2) {
-        send_response(sockfd, 400, "application/json", "{\"error\":\"Only PENDING tasks can be cancelled\"}", 47);
+        send_literal(conn, 400, "application/json", "{\"error\":\"Task has already finished\"}");
     } else {
-        send_response(sockfd, 500, "application/json", "{\"error\":\"Failed to cancel task\"}", 34);
+        send_literal(conn, 500, "application/json", "{\"error\":\"Failed to cancel task\"}");
     }
 }
 
-// Generate JSON for worker utilization stats
+// Generate JSON for worker utilization stats. Reads only the per-worker
+// slots, so it costs O(MAX_WORKERS) and needs no queue lock.
 void generate_worker_stats_json(char* buffer, int buffer_size) {
     if (queue == NULL) {
         snprintf(buffer, buffer_size, "{\"error\":\"Queue not available\"}");
         return;
     }
     
-    pthread_mutex_lock(&queue->queue_mutex);
-    
-    // Count tasks per worker
-    int worker_completed[NUM_WORKERS] = {0};
-    int worker_running[NUM_WORKERS] = {0};
-    int worker_total[NUM_WORKERS] = {0};
+    time_t now = time(NULL);
+    strcpy(buffer, "{\"workers\":[");
+    size_t used = strlen(buffer);
+    int first = 1;
     
-    for (int i = 0; i < queue->size; i++) {
-        Task* task = &queue->tasks[i];
-        if (task->worker_id >= 0 && task->worker_id < NUM_WORKERS) {
-            worker_total[task->worker_id]++;
-            if (task->status == STATUS_COMPLETED) {
-                worker_completed[task->worker_id]++;
-            } else if (task->status == STATUS_RUNNING) {
-                worker_running[task->worker_id]++;
-            }
+    for (int i = 0; i < MAX_WORKERS; i++) {
+        WorkerSlot slot;
+        worker_stats_read(&queue->workers[i], &slot);
+        if (slot.started_at == 0) continue;  // This worker id never ran
+        
+        char last_claim[64] = "", started_at[64] = "";
+        if (slot.last_claim > 0) {
+            format_timestamp(slot.last_claim, last_claim, sizeof(last_claim));
         }
+        format_timestamp(slot.started_at, started_at, sizeof(started_at));
+        
+        char worker_json[512];
+        int len = snprintf(worker_json, sizeof(worker_json),
+            "{"
+            "\"id\":%d,"
+            "\"pid\":%d,"
+            "\"active\":%s,"
+            "\"heartbeat_age_s\":%ld,"
+            "\"busy_threads\":%d,"
+            "\"idle_threads\":%d,"
+            "\"running\":%d,"
+            "\"completed\":%llu,"
+            "\"failed\":%llu,"
+            "\"busy_time_ms\":%llu,"
+            "\"last_claim\":\"%s\","
+            "\"started_at\":\"%s\""
+            "}",
+            i, (int)slot.pid,
+            worker_stats_alive(&slot, now) ? "true" : "false",
+            (long)(now - slot.heartbeat),
+            slot.busy_threads, slot.idle_threads, slot.inflight_tasks,
+            slot.tasks_completed, slot.tasks_failed, slot.busy_time_us / 1000ULL,
+            last_claim, started_at);
+        
+        if (used + len + 4 > (size_t)buffer_size) break;
+        if (!first) buffer[used++] = ',';
+        first = 0;
+        memcpy(buffer + used, worker_json, len + 1);
+        used += len;
     }
     
-    int active_workers = queue->num_active_workers;
-    
-    pthread_mutex_unlock(&queue->queue_mutex);
-    
-    // Build JSON
-    strcpy(buffer, "{\"workers\":[");
-    for (int i = 0; i < NUM_WORKERS; i++) {
-        char worker_json[128];
-        snprintf(worker_json, sizeof(worker_json),
-            "%s{\"id\":%d,\"active\":%s,\"completed\":%d,\"running\":%d,\"total\":%d}",
-            (i > 0) ? "," : "",
-            i,
-            (i < active_workers) ? "true" : "false",
-            worker_completed[i],
-            worker_running[i],
-            worker_total[i]);
-        strcat(buffer, worker_json);
-    }
-    strcat(buffer, "]}");
-}
-
-// Generate CSV export of all tasks
-void generate_tasks_csv(char* buffer, int buffer_size) {
+    memcpy(buffer + used, "]}", 3);
+}
+
+// Generate JSON for this node's federation peers
+void generate_federation_json(char* buffer, int buffer_size) {
     if (queue == NULL) {
-        snprintf(buffer, buffer_size, "error,Queue not available\n");
+        snprintf(buffer, buffer_size, "{\"error\":\"Queue not available\"}");
         return;
     }
     
-    pthread_mutex_lock(&queue->queue_mutex);
+    lock_queue(queue);
     
-    // CSV header
-    int offset = snprintf(buffer, buffer_size,
-        "ID,Name,Priority,Status,Duration_ms,Worker_ID,Created,Started,Ended\n");
+    time_t now = time(NULL);
+    int used = snprintf(buffer, buffer_size,
+        "{\"enabled\":%s,\"node\":\"%s\",\"port\":%d,\"peers\":[",
+        queue->node_name[0] != '\0' ? "true" : "false",
+        queue->node_name, queue->federation_port);
     
-    for (int i = 0; i < queue->size && offset < buffer_size - 256; i++) {
-        Task* task = &queue->tasks[i];
+    for (int i = 0; i < queue->peer_count; i++) {
+        PeerSlot* peer = &queue->peers[i];
+        
+        char peer_json[512];
+        int len = snprintf(peer_json, sizeof(peer_json),
+            "{"
+            "\"name\":\"%s\","
+            "\"connected\":%s,"
+            "\"last_seen_age_s\":%ld,"
+            "\"pending\":%d,"
+            "\"running\":%d,"
+            "\"capacity\":%d,"
+            "\"tasks_sent\":%llu,"
+            "\"tasks_received\":%llu"
+            "}",
+            peer->name, peer->connected ? "true" : "false",
+            peer->last_seen > 0 ? (long)(now - peer->last_seen) : -1L,
+            peer->pending, peer->running, peer->capacity,
+            peer->tasks_sent, peer->tasks_received);
         
-        char creation_time[64] = "", start_time[64] = "", end_time[64] = "";
-        format_timestamp(task->creation_time, creation_time, sizeof(creation_time));
-        if (task->start_time > 0) {
-            format_timestamp(task->start_time, start_time, sizeof(start_time));
+        if (used + len + 4 > buffer_size) break;
+        if (i > 0) buffer[used++] = ',';
+        memcpy(buffer + used, peer_json, len + 1);
+        used += len;
+    }
+    
+    memcpy(buffer + used, "]}", 3);
+    
+    unlock_queue(queue);
+}
+
+#define TASKS_CSV_HEADER \
+    "ID,Name,Priority,Status,Duration_ms,Timeout_ms,Attempts,Max_Retries,Last_Error," \
+    "Worker_ID,Peer,Peer_Task_ID,Created,Started,Ended," \
+    "CPU_us,CPU_User_us,CPU_System_us,Max_RSS_KB,Voluntary_CS,Involuntary_CS," \
+    "IO_Read_Bytes,IO_Write_Bytes\n"
+
+// One task as a CSV record
+static void append_task_csv(TextBuffer* out, const Task* task) {
+    char creation_time[64] = "", start_time[64] = "", end_time[64] = "";
+    format_timestamp(task->creation_time, creation_time, sizeof(creation_time));
+    if (task->start_time > 0) {
+        format_timestamp(task->start_time, start_time, sizeof(start_time));
+    }
+    if (task->end_time > 0) {
+        format_timestamp(task->end_time, end_time, sizeof(end_time));
+    }
+    
+    text_printf(out, "%d,", task->id);
+    text_append_csv_field(out, task->name);
+    text_printf(out, ",%s,%s,%u,%u,%u,%u,",
+        priority_to_string(task->priority),
+        status_to_string(task->status),
+        task->execution_time_ms,
+        task->timeout_ms,
+        task->attempts, task->max_retries);
+    text_append_csv_field(out, task->last_error);
+    text_printf(out, ",%d,", task->worker_id);
+    text_append_csv_field(out, task->peer);
+    text_printf(out, ",%d,%s,%s,%s,%llu,%llu,%llu,%ld,%ld,%ld,%llu,%llu\n",
+        task->peer_task_id,
+        creation_time, start_time, end_time,
+        task->usage.cpu_time_us, task->usage.cpu_user_us, task->usage.cpu_system_us,
+        task->usage.max_rss_kb,
+        task->usage.voluntary_ctx_switches, task->usage.involuntary_ctx_switches,
+        task->usage.io_read_bytes, task->usage.io_write_bytes);
+}
+
+// Decode %XX escapes and '+' in place
+static void url_decode(char* s) {
+    char* out = s;
+    for (; *s != '\0'; s++) {
+        if (*s == '+') {
+            *out++ = ' ';
+        } else if (*s == '%' && isxdigit((unsigned char)s[1]) && isxdigit((unsigned char)s[2])) {
+            char hex[3] = { s[1], s[2], '\0' };
+            *out++ = (char)strtol(hex, NULL, 16);
+            s += 2;
+        } else {
+            *out++ = *s;
         }
-        if (task->end_time > 0) {
-            format_timestamp(task->end_time, end_time, sizeof(end_time));
+    }
+    *out = '\0';
+}
+
+// Split the next name=value pair off a query string, both decoded in
+// place. Returns the name, or NULL at the end.
+static char* next_query_param(char** params, char** value) {
+    while (**params == '&') (*params)++;
+    if (**params == '\0') return NULL;
+    char* name = *params;
+    char* end = strchr(name, '&');
+    if (end != NULL) {
+        *end = '\0';
+        *params = end + 1;
+    } else {
+        *params = name + strlen(name);
+    }
+    char* eq = strchr(name, '=');
+    if (eq != NULL) {
+        *eq = '\0';
+        *value = eq + 1;
+    } else {
+        *value = name + strlen(name);
+    }
+    url_decode(name);
+    url_decode(*value);
+    return name;
+}
+
+static int parse_query_number(const char* value, long long min, long long max, long long* out) {
+    char* end;
+    errno = 0;
+    long long n = strtoll(value, &end, 10);
+    if (value[0] == '\0' || *end != '\0' || errno != 0 || n < min || n > max) return -1;
+    *out = n;
+    return 0;
+}
+
+// Fill query from /api/tasks parameters; returns the offending parameter
+// name, or NULL if they are all valid
+static const char* parse_task_query(char* params, TaskQuery* query) {
+    static const char* const sort_names[] = { "id", "created", "started", "ended", "priority" };
+    memset(query, 0, sizeof(*query));
+    query->status = -1;
+    query->priority = -1;
+    query->worker_id = -1;
+    query->limit = TASK_QUERY_DEFAULT_LIMIT;
+    
+    char* name;
+    char* value;
+    while ((name = next_query_param(&params, &value)) != NULL) {
+        long long n;
+        int ok = 1;
+        if (strcmp(name, "status") == 0) {
+            TaskStatus status;
+            ok = parse_status(value, &status) == 0;
+            query->status = (int)status;
+        } else if (strcmp(name, "priority") == 0) {
+            Priority priority;
+            ok = parse_priority(value, &priority) == 0;
+            query->priority = (int)priority;
+        } else if (strcmp(name, "worker") == 0) {
+            ok = parse_query_number(value, 0, INT_MAX, &n) == 0;
+            query->worker_id = (int)n;
+        } else if (strcmp(name, "name") == 0) {
+            ok = strlen(value) < sizeof(query->name_prefix);
+            if (ok) strcpy(query->name_prefix, value);
+        } else if (strcmp(name, "created_after") == 0) {
+            ok = parse_query_number(value, 0, LLONG_MAX, &n) == 0;
+            query->created_after = (time_t)n;
+        } else if (strcmp(name, "created_before") == 0) {
+            ok = parse_query_number(value, 0, LLONG_MAX, &n) == 0;
+            query->created_before = (time_t)n;
+        } else if (strcmp(name, "sort") == 0) {
+            ok = 0;
+            for (size_t i = 0; i < sizeof(sort_names) / sizeof(sort_names[0]) && !ok; i++) {
+                if (strcmp(value, sort_names[i]) == 0) {
+                    query->sort = (TaskSortKey)i;
+                    ok = 1;
+                }
+            }
+        } else if (strcmp(name, "order") == 0) {
+            ok = strcmp(value, "asc") == 0 || strcmp(value, "desc") == 0;
+            query->descending = strcmp(value, "desc") == 0;
+        } else if (strcmp(name, "limit") == 0) {
+            ok = parse_query_number(value, 1, TASK_QUERY_MAX_LIMIT, &n) == 0;
+            query->limit = (int)n;
+        } else if (strcmp(name, "cursor") == 0) {
+            int used = 0;
+            ok = sscanf(value, "%lld.%d%n", &query->cursor_key, &query->cursor_id, &used) == 2 &&
+                 value[used] == '\0';
+            query->has_cursor = 1;
+        } else {
+            ok = 0;
         }
-        
-        offset += snprintf(buffer + offset, buffer_size - offset,
-            "%d,\"%s\",%s,%s,%u,%d,%s,%s,%s\n",
-            task->id, task->name,
-            priority_to_string(task->priority),
-            status_to_string(task->status),
-            task->execution_time_ms,
-            task->worker_id,
-            creation_time, start_time, end_time);
+        if (!ok) return name;
+    }
+    return NULL;
+}
+
+// GET /api/tasks?...: one page of the tasks matching the parameters, with
+// the cursor that continues it (null on the last page)
+static void handle_task_query(HttpConn* conn, char* params, const char* etag) {
+    static __thread Task* page = NULL;
+    TextBuffer out = {0};
+    
+    TaskQuery query;
+    const char* bad = parse_task_query(params, &query);
+    if (bad != NULL) {
+        text_printf(&out, "{\"error\":\"Bad query parameter\",\"parameter\":");
+        text_append_json_string(&out, bad);
+        text_append(&out, "}", 1);
+        if (out.failed) {
+            send_literal(conn, 400, "application/json", "{\"error\":\"Bad query parameter\"}");
+        } else {
+            send_response(conn, 400, "application/json", out.data, (int)out.len);
+        }
+        free(out.data);
+        return;
     }
     
-    pthread_mutex_unlock(&queue->queue_mutex);
+    if (page == NULL) page = malloc(TASK_QUERY_MAX_LIMIT * sizeof(Task));
+    if (queue == NULL || page == NULL) {
+        send_literal(conn, 500, "application/json", "{\"error\":\"Queue not available\"}");
+        return;
+    }
+    int total = 0;
+    int more = 0;
+    int count = query_tasks(queue, &query, page, &total, &more);
+    
+    text_append(&out, "{\"tasks\":[", 10);
+    for (int i = 0; i < count; i++) {
+        if (i > 0) text_append(&out, ",", 1);
+        append_task_json(&out, &page[i]);
+    }
+    text_printf(&out, "],\"total\":%d,\"next_cursor\":", total);
+    if (more && count > 0) {
+        const Task* last = &page[count - 1];
+        text_printf(&out, "\"%lld.%d\"}", task_sort_key(last, query.sort), last->id);
+    } else {
+        text_append(&out, "null}", 5);
+    }
+    
+    if (out.failed) {
+        send_literal(conn, 500, "application/json", "{\"error\":\"Out of memory\"}");
+    } else {
+        send_response_etag(conn, 200, "application/json", out.data, (int)out.len, etag);
+    }
+    free(out.data);
+}
+
+// Every served queue with its load
+void generate_queues_json(char* buffer, int buffer_size) {
+    int offset = snprintf(buffer, buffer_size, "{\"queues\":[");
+    for (int q = 0; q < served_count && offset < buffer_size - 256; q++) {
+        TaskQueue* served_queue = served[q].queue;
+        lock_queue(served_queue);
+        offset += snprintf(buffer + offset, buffer_size - offset,
+            "%s{\"name\":\"%s\",\"path\":\"/q/%s/\",\"pending_tasks\":%d,"
+            "\"running_tasks\":%d,\"queue_size\":%d,\"queue_capacity\":%d,"
+            "\"active_workers\":%d,\"scheduler_pid\":%d}",
+            q > 0 ? "," : "", served[q].name, served[q].name,
+            get_pending_task_count(served_queue), get_running_task_count(served_queue),
+            served_queue->size, served_queue->capacity, served_queue->num_active_workers,
+            (int)served_queue->scheduler_pid);
+        unlock_queue(served_queue);
+    }
+    snprintf(buffer + offset, buffer_size - offset, "]}");
 }
 
 // Handle API requests
-void handle_api_request(int sockfd, const char* path, const char* method, const char* body, int body_len) {
-    char json_buffer[16384];  // Increased for CSV export
+void handle_api_request(HttpConn* conn, const HttpRequest* req, const char* body) {
+    const char* path = req->path;
+    const char* method = req->method;
+    int body_len = req->content_length;
+    char json_buffer[16384];
+    
+    // Versioned views: a client holding the current ETag gets a 304
+    // without the mutex being taken or anything being formatted
+    char etag[96] = "";
+    if (queue != NULL && strcmp(method, "GET") == 0) {
+        int with_workers = strcmp(path, "/api/worker_stats") == 0 || strcmp(path, "/api/snapshot") == 0;
+        if (with_workers || strcmp(path, "/api/status") == 0 || strcmp(path, "/api/tasks") == 0) {
+            view_etag(queue, with_workers, etag, sizeof(etag));
+            char value[512];
+            if (etag_matches(find_header(req, "If-None-Match", value, sizeof(value)), etag)) {
+                send_response_etag(conn, 304, NULL, NULL, 0, etag);
+                return;
+            }
+        }
+    }
     
-    if (strcmp(path, "/api/status") == 0 && strcmp(method, "GET") == 0) {
+    if (strcmp(path, "/api/queues") == 0 && strcmp(method, "GET") == 0) {
+        generate_queues_json(json_buffer, sizeof(json_buffer));
+        send_response(conn, 200, "application/json", json_buffer, strlen(json_buffer));
+    } else if (strcmp(path, "/api/status") == 0 && strcmp(method, "GET") == 0) {
         generate_status_json(json_buffer, sizeof(json_buffer));
-        send_response(sockfd, 200, "application/json", json_buffer, strlen(json_buffer));
+        send_response_etag(conn, 200, "application/json", json_buffer, strlen(json_buffer), etag);
     } else if (strcmp(path, "/api/tasks") == 0 && strcmp(method, "GET") == 0) {
-        generate_tasks_json(json_buffer, sizeof(json_buffer));
-        send_response(sockfd, 200, "application/json", json_buffer, strlen(json_buffer));
+        if (req->query != NULL && req->query[0] != '\0') {
+            handle_task_query(conn, req->query, etag);
+        } else {
+            start_task_export(conn, req, EXPORT_JSON, etag);
+        }
     } else if (strcmp(path, "/api/workers") == 0 && strcmp(method, "GET") == 0) {
         generate_workers_json(json_buffer, sizeof(json_buffer));
-        send_response(sockfd, 200, "application/json", json_buffer, strlen(json_buffer));
+        send_response(conn, 200, "application/json", json_buffer, strlen(json_buffer));
     } else if (strcmp(path, "/api/worker_stats") == 0 && strcmp(method, "GET") == 0) {
         generate_worker_stats_json(json_buffer, sizeof(json_buffer));
-        send_response(sockfd, 200, "application/json", json_buffer, strlen(json_buffer));
+        send_response_etag(conn, 200, "application/json", json_buffer, strlen(json_buffer), etag);
+    } else if (strcmp(path, "/api/snapshot") == 0 && strcmp(method, "GET") == 0) {
+        TextBuffer snapshot = {0};
+        generate_snapshot_json(&snapshot);
+        if (snapshot.failed) {
+            send_literal(conn, 500, "application/json", "{\"error\":\"Out of memory\"}");
+        } else {
+            send_response_etag(conn, 200, "application/json", snapshot.data, (int)snapshot.len, etag);
+        }
+        free(snapshot.data);
+    } else if (strcmp(path, "/api/federation") == 0 && strcmp(method, "GET") == 0) {
+        generate_federation_json(json_buffer, sizeof(json_buffer));
+        send_response(conn, 200, "application/json", json_buffer, strlen(json_buffer));
     } else if (strcmp(path, "/api/export/csv") == 0 && strcmp(method, "GET") == 0) {
-        generate_tasks_csv(json_buffer, sizeof(json_buffer));
-        send_response(sockfd, 200, "text/csv", json_buffer, strlen(json_buffer));
+        start_task_export(conn, req, EXPORT_CSV, NULL);
     } else if (strcmp(path, "/api/export/json") == 0 && strcmp(method, "GET") == 0) {
-        generate_tasks_json(json_buffer, sizeof(json_buffer));
-        send_response(sockfd, 200, "application/json", json_buffer, strlen(json_buffer));
+        start_task_export(conn, req, EXPORT_JSON, NULL);
     } else if (strcmp(path, "/api/add_task") == 0 && strcmp(method, "POST") == 0) {
-        handle_add_task_post(sockfd, body, body_len);
+        handle_add_task_post(conn, body, body_len);
     } else if (strcmp(path, "/api/simulate") == 0 && strcmp(method, "POST") == 0) {
-        handle_simulation_post(sockfd, body, body_len);
+        handle_simulation_post(conn, body, body_len);
     } else if (strcmp(path, "/api/cancel_task") == 0 && strcmp(method, "POST") == 0) {
-        handle_cancel_task_post(sockfd, body, body_len);
+        handle_cancel_task_post(conn, body, body_len);
     } else {
-        send_response(sockfd, 404, "application/json", "{\"error\":\"Not found\"}", 19);
+        send_literal(conn, 404, "application/json", "{\"error\":\"Not found\"}");
     }
 }
 
-// Handle HTTP request
-void handle_request(int sockfd) {
-    char request[MAX_REQUEST_SIZE];
-    char method[16], path[256], protocol[16];
+// A task in a stream event, copied out of the queue
+typedef struct {
+    int kind;                   // TaskChangeKind; REMOVED once the task is gone
+    int task_id;
+    Task task;
+} StreamItem;
+
+#define STREAM_ITEMS (MAX_TASKS > CHANGE_LOG_SIZE ? MAX_TASKS : CHANGE_LOG_SIZE)
+static __thread StreamItem* stream_items = NULL;
+
+// This loop's scratch space for tasks copied out of the queue, or NULL
+static StreamItem* scratch_items(void) {
+    if (stream_items == NULL) {
+        stream_items = malloc(STREAM_ITEMS * sizeof(StreamItem));
+    }
+    return stream_items;
+}
+
+// Everything the dashboard shows in one response. Status and tasks are
+// copied under one lock, so they agree; formatting happens after.
+static void generate_snapshot_json(TextBuffer* out) {
+    if (queue == NULL) {
+        text_printf(out, "{\"error\":\"Queue not available\"}");
+        return;
+    }
+    StreamItem* items = scratch_items();
+    if (items == NULL) {
+        out->failed = 1;
+        return;
+    }
+    
+    char status[1024];
+    lock_queue(queue);
+    int count = queue->size;
+    for (int i = 0; i < count; i++) {
+        items[i].task = queue->tasks[i];
+    }
+    format_status_json_locked(queue, status, sizeof(status));
+    unlock_queue(queue);
+    
+    text_printf(out, "{\"status\":%s,\"tasks\":[", status);
+    for (int i = 0; i < count; i++) {
+        if (i > 0) text_append(out, ",", 1);
+        append_task_json(out, &items[i].task);
+    }
+    char json[16384];
+    generate_workers_json(json, sizeof(json));
+    text_printf(out, "],\"workers\":%s", json);
+    generate_worker_stats_json(json, sizeof(json));
+    text_printf(out, ",\"worker_stats\":%s}", json);
+}
+
+// Build the event that brings subscribers at ev->since up to date: every
+// task if they have nothing yet or the change log no longer reaches back
+// that far, otherwise each changed task's latest change and current state.
+// Only the copying is done under the mutex. Returns 0, or -1 without memory.
+static int build_stream_event(StreamEvent* ev) {
+    if (scratch_items() == NULL) return -1;
+    TaskQueue* q = ev->queue;
+    char status[1024];
+    int count = 0;
+    
+    lock_queue(q);
+    unsigned long long head = q->change_seq;
+    int snapshot = !ev->synced || ev->since > head || head - ev->since > CHANGE_LOG_SIZE;
+    if (snapshot) {
+        for (count = 0; count < q->size; count++) {
+            stream_items[count].task = q->tasks[count];
+        }
+    } else {
+        // Newest first, so each task keeps only its latest change
+        for (unsigned long long n = head; n > ev->since; n--) {
+            const TaskChange* change = &q->change_log[(n - 1) % CHANGE_LOG_SIZE];
+            int seen = 0;
+            for (int i = 0; i < count && !seen; i++) {
+                seen = stream_items[i].task_id == change->task_id;
+            }
+            if (seen) continue;
+            StreamItem* item = &stream_items[count++];
+            item->task_id = change->task_id;
+            item->kind = change->kind;
+            Task* task = change->kind == TASK_CHANGE_REMOVED ? NULL : find_task_by_id(q, change->task_id);
+            if (task != NULL) {
+                item->task = *task;
+            } else {
+                item->kind = TASK_CHANGE_REMOVED;
+            }
+        }
+    }
+    format_status_json_locked(q, status, sizeof(status));
+    unlock_queue(q);
+    
+    ev->seq = head;
+    text_printf(&ev->text, "id: %llu\nevent: %s\ndata: {\"seq\":%llu,\"status\":%s,\"%s\":[",
+                head, snapshot ? "snapshot" : "delta", head, status, snapshot ? "tasks" : "changes");
+    if (snapshot) {
+        for (int i = 0; i < count; i++) {
+            if (i > 0) text_append(&ev->text, ",", 1);
+            append_task_json(&ev->text, &stream_items[i].task);
+        }
+    } else {
+        for (int i = count - 1; i >= 0; i--) {  // Oldest change first
+            const StreamItem* item = &stream_items[i];
+            const char* separator = i > 0 ? "," : "";
+            if (item->kind == TASK_CHANGE_REMOVED) {
+                text_printf(&ev->text, "{\"change\":\"removed\",\"id\":%d}%s", item->task_id, separator);
+            } else {
+                text_printf(&ev->text, "{\"change\":\"%s\",\"task\":", task_change_to_string(item->kind));
+                append_task_json(&ev->text, &item->task);
+                text_printf(&ev->text, "}%s", separator);
+            }
+        }
+    }
+    text_append(&ev->text, "]}\n\n", 4);
+    return ev->text.failed ? -1 : 0;
+}
+
+// Bring one subscriber up to date, or keep an idle stream alive with a
+// comment line. Subscribers at the same point share an event through
+// cache. Returns -1 if the connection failed.
+static int stream_update(HttpConn* conn, StreamEvent* cache, int* cached, time_t now) {
+    // One that stops reading is skipped until it catches up; by then the
+    // log may have moved past it and it gets a fresh snapshot instead
+    if (conn->out_len - conn->out_sent >= OUT_HIGH_WATER) return 0;
+    
+    unsigned long long head = __atomic_load_n(&conn->stream_queue->change_seq, __ATOMIC_ACQUIRE);
+    if (conn->stream_synced && head == conn->stream_seq) {
+        if (now - conn->last_active < EVENT_PING_INTERVAL) return 0;
+        if (conn_append(conn, ": ping\n\n", 8) != 0) return -1;
+    } else {
+        StreamEvent* ev = NULL;
+        for (int i = 0; i < *cached && ev == NULL; i++) {
+            if (cache[i].queue == conn->stream_queue && cache[i].synced == conn->stream_synced &&
+                (!cache[i].synced || cache[i].since == conn->stream_seq)) {
+                ev = &cache[i];
+            }
+        }
+        if (ev == NULL) {
+            if (*cached == STREAM_EVENT_CACHE) {
+                free(cache[--*cached].text.data);
+            }
+            ev = &cache[(*cached)++];
+            memset(ev, 0, sizeof(*ev));
+            ev->queue = conn->stream_queue;
+            ev->synced = conn->stream_synced;
+            ev->since = conn->stream_seq;
+            if (build_stream_event(ev) != 0) return -1;
+        }
+        if (ev->text.failed || conn_append(conn, ev->text.data, ev->text.len) != 0) return -1;
+        conn->stream_synced = 1;
+        conn->stream_seq = ev->seq;
+    }
+    conn->last_active = now;
+    return conn_flush(conn);
+}
+
+// GET /api/events: from here on the connection is a server-sent event
+// stream of the queue's task changes. It starts with a snapshot unless a
+// reconnecting EventSource's Last-Event-ID is still covered by the log.
+static void start_event_stream(HttpConn* conn, const char* last_event_id) {
+    static const char header[] =
+        "HTTP/1.1 200 OK\r\n"
+        "Content-Type: text/event-stream\r\n"
+        "Cache-Control: no-cache\r\n"
+        "Access-Control-Allow-Origin: *\r\n"
+        "Connection: keep-alive\r\n"
+        "\r\n"
+        "retry: 2000\n\n";
     
-    // Read request line
-    if (read_line(sockfd, request, sizeof(request)) < 0) {
-        close(sockfd);
+    if (queue == NULL) {
+        send_literal(conn, 500, "application/json", "{\"error\":\"Queue not available\"}");
         return;
     }
+    if (conn_append(conn, header, sizeof(header) - 1) != 0) {
+        conn->close_after = 1;
+        return;
+    }
+    conn->stream_queue = queue;
+    this_loop->subscribers++;
+    if (last_event_id != NULL) {
+        char* end;
+        unsigned long long seq = strtoull(last_event_id, &end, 10);
+        if (end != last_event_id && *end == '\0') {
+            conn->stream_synced = 1;
+            conn->stream_seq = seq;
+        }
+    }
     
-    sscanf(request, "%s %s %s", method, path, protocol);
+    StreamEvent cache[1];
+    int cached = 0;
+    if (stream_update(conn, cache, &cached, time(NULL)) != 0) {
+        conn->close_after = 1;
+    }
+    if (cached > 0) free(cache[0].text.data);
+}
+
+// Task lists are streamed: a chunk per batch of EXPORT_BATCH tasks, made
+// only while the client keeps up, so any number of tasks takes the same
+// memory. Each batch is copied under the mutex and formatted after.
+static void start_task_export(HttpConn* conn, const HttpRequest* req, ExportFormat format,
+                              const char* etag) {
+    if (queue == NULL) {
+        send_literal(conn, 500, "application/json", "{\"error\":\"Queue not available\"}");
+        return;
+    }
     
-    // Read headers and find Content-Length for POST requests
-    int content_length = 0;
-    char line[256];
-    char body[MAX_REQUEST_SIZE] = {0};
+    // HTTP/1.0 has no chunked encoding; the body ends when we close
+    int chunked = strcmp(req->protocol, "HTTP/1.1") == 0;
+    if (!chunked) conn->keep_alive = 0;
     
-    do {
-        if (read_line(sockfd, line, sizeof(line)) < 0) {
-            close(sockfd);
-            return;
+    char header[512];
+    int header_len = snprintf(header, sizeof(header),
+        "HTTP/1.1 200 OK\r\n"
+        "Content-Type: %s\r\n"
+        "%s"
+        "Access-Control-Allow-Origin: *\r\n"
+        "Connection: %s\r\n",
+        format == EXPORT_CSV ? "text/csv" : "application/json",
+        chunked ? "Transfer-Encoding: chunked\r\n" : "",
+        conn->keep_alive ? "keep-alive" : "close");
+    if (etag != NULL) {
+        header_len += snprintf(header + header_len, sizeof(header) - header_len,
+            "ETag: %s\r\n"
+            "Cache-Control: no-cache\r\n",
+            etag);
+    }
+    header_len += snprintf(header + header_len, sizeof(header) - header_len, "\r\n");
+    if (conn_append(conn, header, header_len) != 0) {
+        conn->close_after = 1;
+        return;
+    }
+    
+    memset(&conn->export, 0, sizeof(conn->export));
+    conn->export.queue = queue;
+    conn->export.format = format;
+    conn->export.chunked = chunked;
+}
+
+// Position of the first task after the cursor's key (mutex held)
+static int export_position_locked(TaskQueue* q, const ExportCursor* cursor) {
+    if (cursor->sent == 0) return 0;
+    int left = 0;
+    int right = q->size;
+    while (left < right) {
+        int mid = left + (right - left) / 2;
+        const Task* task = &q->tasks[mid];
+        if ((int)task->priority < cursor->priority ||
+            ((int)task->priority == cursor->priority && task->id <= cursor->last_id)) {
+            left = mid + 1;
+        } else {
+            right = mid;
         }
-        if (strncasecmp(line, "Content-Length:", 15) == 0) {
-            content_length = atoi(line + 15);
+    }
+    return left;
+}
+
+// Queue the export's next chunk, and the end of the body after the last
+// batch. Returns -1 if memory ran out (the response can't be finished).
+static int export_continue(HttpConn* conn) {
+    static __thread TextBuffer text;
+    ExportCursor* cursor = &conn->export;
+    Task batch[EXPORT_BATCH];
+    
+    TaskQueue* q = cursor->queue;
+    lock_queue(q);
+    int pos = export_position_locked(q, cursor);
+    int count = q->size - pos < EXPORT_BATCH ? q->size - pos : EXPORT_BATCH;
+    memcpy(batch, &q->tasks[pos], (size_t)count * sizeof(Task));
+    unlock_queue(q);
+    
+    text.len = 0;
+    text.failed = 0;
+    if (cursor->sent == 0) {
+        if (cursor->format == EXPORT_CSV) {
+            text_append(&text, TASKS_CSV_HEADER, strlen(TASKS_CSV_HEADER));
+        } else {
+            text_append(&text, "{\"tasks\":[", 10);
         }
-    } while (strlen(line) > 0);
+    }
+    for (int i = 0; i < count; i++) {
+        if (cursor->format == EXPORT_CSV) {
+            append_task_csv(&text, &batch[i]);
+        } else {
+            if (cursor->sent + i > 0) text_append(&text, ",", 1);
+            append_task_json(&text, &batch[i]);
+        }
+    }
+    int done = count < EXPORT_BATCH;
+    if (done && cursor->format == EXPORT_JSON) {
+        text_append(&text, "]}", 2);
+    }
+    if (text.failed) return -1;
     
-    // Read body for POST requests
-    if (strcmp(method, "POST") == 0 && content_length > 0) {
-        read_http_body(sockfd, body, sizeof(body), content_length);
+    if (cursor->chunked && text.len > 0) {
+        char size_line[32];
+        int size_len = snprintf(size_line, sizeof(size_line), "%zx\r\n", text.len);
+        if (conn_append(conn, size_line, size_len) != 0) return -1;
+    }
+    if (conn_append(conn, text.data, text.len) != 0) return -1;
+    if (cursor->chunked && text.len > 0 && conn_append(conn, "\r\n", 2) != 0) return -1;
+    
+    if (count > 0) {
+        cursor->sent += count;
+        cursor->priority = (int)batch[count - 1].priority;
+        cursor->last_id = batch[count - 1].id;
+    }
+    if (done) {
+        if (cursor->chunked && conn_append(conn, "0\r\n\r\n", 5) != 0) return -1;
+        cursor->queue = NULL;
+        if (!conn->keep_alive) conn->close_after = 1;
+    }
+    return 0;
+}
+
+// Value of header name in req, or NULL. Names match case-insensitively.
+static const char* find_header(const HttpRequest* req, const char* name, char* value, size_t size) {
+    size_t name_len = strlen(name);
+    const char* line = req->headers;
+    while (*line != '\0') {
+        const char* eol = strchr(line, '\n');
+        size_t line_len = eol ? (size_t)(eol - line) : strlen(line);
+        if (line_len > name_len && strncasecmp(line, name, name_len) == 0 && line[name_len] == ':') {
+            const char* v = line + name_len + 1;
+            const char* v_end = line + line_len;
+            while (v < v_end && (*v == ' ' || *v == '\t')) v++;
+            while (v_end > v && (v_end[-1] == '\r' || v_end[-1] == ' ')) v_end--;
+            size_t len = (size_t)(v_end - v);
+            if (len >= size) len = size - 1;
+            memcpy(value, v, len);
+            value[len] = '\0';
+            return value;
+        }
+        if (eol == NULL) break;
+        line = eol + 1;
+    }
+    return NULL;
+}
+
+// Handle HTTP request
+void handle_request(HttpConn* conn, HttpRequest* req, const char* body) {
+    char* path = req->path;
+    const char* method = req->method;
+    req->query = strchr(path, '?');
+    if (req->query != NULL) *req->query++ = '\0';
+    
+    // /q/NAME/... is the same API and dashboard for queue NAME
+    queue = served[0].queue;
+    if (strncmp(path, "/q/", 3) == 0) {
+        char* name = path + 3;
+        char* rest = strchr(name, '/');
+        if (rest == NULL) {
+            rest = name + strlen(name);
+        }
+        int found = 0;
+        for (int q = 0; q < served_count; q++) {
+            if ((size_t)(rest - name) == strlen(served[q].name) &&
+                strncmp(name, served[q].name, rest - name) == 0) {
+                queue = served[q].queue;
+                found = 1;
+                break;
+            }
+        }
+        if (!found) {
+            send_literal(conn, 404, "application/json", "{\"error\":\"Unknown queue\"}");
+            return;
+        }
+        memmove(path, rest, strlen(rest) + 1);
+        if (path[0] == '\0') strcpy(path, "/");
     }
     
     // Handle API requests
-    if (strncmp(path, "/api/", 5) == 0) {
-        handle_api_request(sockfd, path, method, body, content_length);
+    if (strcmp(path, "/metrics") == 0 && strcmp(method, "GET") == 0) {
+        TextBuffer metrics = { NULL, 0, 0, 0 };
+        generate_metrics(&metrics);
+        if (metrics.failed) {
+            send_literal(conn, 500, "text/plain", "out of memory\n");
+        } else {
+            send_response(conn, 200, "text/plain; version=0.0.4; charset=utf-8", metrics.data, (int)metrics.len);
+        }
+        free(metrics.data);
+    } else if (strcmp(path, "/api/events") == 0 && strcmp(method, "GET") == 0) {
+        char last_event_id[32];
+        start_event_stream(conn, find_header(req, "Last-Event-ID", last_event_id, sizeof(last_event_id)));
+    } else if (strncmp(path, "/api/", 5) == 0) {
+        handle_api_request(conn, req, body);
     }
     // Handle static files
-    else if (strcmp(path, "/") == 0 || strcmp(path, "/index.html") == 0) {
-        serve_file(sockfd, "index.html", "text/html");
-    } else if (strcmp(path, "/dashboard.js") == 0) {
-        serve_file(sockfd, "dashboard.js", "application/javascript");
-    } else if (strcmp(path, "/dashboard.css") == 0) {
-        serve_file(sockfd, "dashboard.css", "text/css");
+    else if (strcmp(method, "GET") == 0) {
+        serve_asset(conn, req, strcmp(path, "/") == 0 ? "index.html" : path + 1);
     } else {
-        send_response(sockfd, 404, "text/html", "<h1>404 Not Found</h1>", 21);
+        send_literal(conn, 404, "text/html", "<h1>404 Not Found</h1>");
     }
-    
-    close(sockfd);
 }
 
-int main(int argc, char* argv[]) {
-    (void)argc;  // Suppress unused parameter warning
-    (void)argv;
-    // Initialize logger
-    init_logger("web_server");
-    LOG_INFO_F("Starting web server...");
+// End of the header block ("\n\n" or "\n\r\n"), as an offset past it, or 0
+static size_t header_block_end(const char* buf, size_t len) {
+    for (size_t i = 0; i + 1 < len; i++) {
+        if (buf[i] != '\n') continue;
+        if (buf[i + 1] == '\n') return i + 2;
+        if (buf[i + 1] == '\r' && i + 2 < len && buf[i + 2] == '\n') return i + 3;
+    }
+    return 0;
+}
+
+// Answer every complete request in conn->in, stopping early when the
+// output backs up or the connection is to be closed. Returns how many
+// requests and export chunks were handled.
+static int process_requests(HttpConn* conn) {
+    int handled = 0;
+    while (!conn->close_after && conn->stream_queue == NULL && conn->body == NULL &&
+           conn->out_len - conn->out_sent < OUT_HIGH_WATER) {
+        if (conn->export.queue != NULL) {
+            if (export_continue(conn) != 0) {
+                // Headers are out; all we can do is cut the body short
+                conn->export.queue = NULL;
+                conn->keep_alive = 0;
+                conn->close_after = 1;
+                break;
+            }
+            handled++;
+            continue;
+        }
+        
+        size_t header_len = header_block_end(conn->in, conn->in_len);
+        if (header_len == 0) {
+            if (conn->in_len == sizeof(conn->in)) {
+                conn->keep_alive = 0;
+                send_literal(conn, 431, "application/json", "{\"error\":\"Request too large\"}");
+            }
+            break;
+        }
+        
+        // Parse in place: the header block becomes a C string
+        char saved = conn->in[header_len - 1];
+        conn->in[header_len - 1] = '\0';
+        HttpRequest req;
+        memset(&req, 0, sizeof(req));
+        char* eol = strchr(conn->in, '\n');
+        req.headers = eol + 1;
+        if (sscanf(conn->in, "%15s %255s %15s", req.method, req.path, req.protocol) != 3) {
+            conn->keep_alive = 0;
+            send_literal(conn, 400, "application/json", "{\"error\":\"Bad request\"}");
+            break;
+        }
+        
+        char value[64];
+        req.content_length = find_header(&req, "Content-Length", value, sizeof(value)) ? atoi(value) : 0;
+        // HTTP/1.1 keeps the connection unless told otherwise; 1.0 only when asked
+        const char* connection = find_header(&req, "Connection", value, sizeof(value));
+        if (strcmp(req.protocol, "HTTP/1.1") == 0) {
+            conn->keep_alive = connection == NULL || strcasecmp(connection, "close") != 0;
+        } else {
+            conn->keep_alive = connection != NULL && strcasecmp(connection, "keep-alive") == 0;
+        }
+        if (find_header(&req, "Transfer-Encoding", value, sizeof(value)) != NULL) {
+            conn->keep_alive = 0;
+            send_literal(conn, 501, "application/json", "{\"error\":\"Chunked requests not supported\"}");
+            break;
+        }
+        if (req.content_length < 0 || (size_t)req.content_length > sizeof(conn->in) - header_len) {
+            conn->keep_alive = 0;
+            send_literal(conn, 413, "application/json", "{\"error\":\"Request too large\"}");
+            break;
+        }
+        if (conn->in_len < header_len + (size_t)req.content_length) {
+            conn->in[header_len - 1] = saved;  // Body still arriving
+            break;
+        }
+        
+        // Handlers expect a NUL-terminated body
+        char body[MAX_REQUEST_SIZE];
+        memcpy(body, conn->in + header_len, req.content_length);
+        body[req.content_length] = '\0';
+        
+        handle_request(conn, &req, body);
+        handled++;
+        
+        size_t consumed = header_len + (size_t)req.content_length;
+        memmove(conn->in, conn->in + consumed, conn->in_len - consumed);
+        conn->in_len -= consumed;
+    }
+    return handled;
+}
+
+// Read what the socket has. Returns -1 on a connection error.
+static int conn_read(HttpConn* conn) {
+    while (conn->in_len < sizeof(conn->in)) {
+        ssize_t n = recv(conn->fd, conn->in + conn->in_len, sizeof(conn->in) - conn->in_len, 0);
+        if (n > 0) {
+            conn->in_len += (size_t)n;
+            continue;
+        }
+        if (n == 0) {
+            conn->peer_closed = 1;
+            return 0;
+        }
+        if (errno == EINTR) continue;
+        return errno == EAGAIN || errno == EWOULDBLOCK ? 0 : -1;
+    }
+    return 0;
+}
+
+// Write queued output, and the asset body behind it, until done or the
+// socket is full. Both go in one gather write, so a small file leaves in
+// the same segment as its headers. -1 on error.
+static int conn_flush(HttpConn* conn) {
+    while (conn->out_sent < conn->out_len || conn->body != NULL) {
+        struct iovec iov[2];
+        size_t head = conn->out_len - conn->out_sent;
+        int count = 0;
+        if (head > 0) {
+            iov[count].iov_base = conn->out + conn->out_sent;
+            iov[count++].iov_len = head;
+        }
+        if (conn->body != NULL) {
+            iov[count].iov_base = conn->body->data + conn->body_sent;
+            iov[count++].iov_len = conn->body->len - conn->body_sent;
+        }
+        // sendmsg rather than writev for MSG_NOSIGNAL
+        struct msghdr msg = { .msg_iov = iov, .msg_iovlen = (size_t)count };
+        ssize_t n = sendmsg(conn->fd, &msg, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return errno == EAGAIN || errno == EWOULDBLOCK ? 0 : -1;
+        }
+        if ((size_t)n < head) {
+            conn->out_sent += (size_t)n;
+            continue;
+        }
+        conn->out_sent = conn->out_len;
+        if (conn->body != NULL) {
+            conn->body_sent += (size_t)n - head;
+            if (conn->body_sent == conn->body->len) {
+                asset_release(conn->body);
+                conn->body = NULL;
+            }
+        }
+    }
+    conn->out_len = conn->out_sent = 0;
+    return 0;
+}
+
+static void conn_close(ServerLoop* loop, HttpConn* conn) {
+    if (conn->prev) conn->prev->next = conn->next;
+    else loop->conns = conn->next;
+    if (conn->next) conn->next->prev = conn->prev;
+    if (conn->stream_queue != NULL) loop->subscribers--;
+    close(conn->fd);
+    asset_release(conn->body);
+    free(conn->out);
+    free(conn);
+}
+
+// Edge-triggered: keep reading, answering and writing until the socket
+// has nothing more for us or can take nothing more
+static void conn_service(ServerLoop* loop, HttpConn* conn) {
+    conn->last_active = time(NULL);
+    while (conn->draining) {
+        conn->in_len = 0;
+        if (conn_read(conn) != 0 || conn->peer_closed) {
+            conn_close(loop, conn);
+            return;
+        }
+        if (conn->in_len < sizeof(conn->in)) return;
+    }
     
-    // Set up signal handlers
-    signal(SIGINT, signal_handler);
-    signal(SIGTERM, signal_handler);
+    while (1) {
+        if (!conn->peer_closed && conn_read(conn) != 0) {
+            conn_close(loop, conn);
+            return;
+        }
+        if (conn->stream_queue != NULL) conn->in_len = 0;  // Nothing more is expected
+        int handled = process_requests(conn);
+        size_t unsent = conn->out_len - conn->out_sent;
+        if (conn_flush(conn) != 0) {
+            conn_close(loop, conn);
+            return;
+        }
+        if (conn->out_len > 0) break;  // EPOLLOUT brings us back
+        // Requests held back at OUT_HIGH_WATER can go now; no event will say so
+        if (handled == 0 && unsent == 0) break;
+    }
+    if (conn->out_len == 0 && conn->peer_closed) {
+        conn_close(loop, conn);
+    } else if (conn->out_len == 0 && conn->close_after) {
+        // Closing with unread input would reset the connection and could
+        // destroy the response; let the client see it and hang up first
+        shutdown(conn->fd, SHUT_WR);
+        conn->draining = 1;
+        conn_service(loop, conn);
+    }
+}
+
+static void accept_connections(ServerLoop* loop) {
+    while (1) {
+        int fd = accept4(loop->listen_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) {
+            if (errno == EINTR) continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                LOG_ERROR_F("Failed to accept connection: %s", strerror(errno));
+            }
+            return;
+        }
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        
+        HttpConn* conn = calloc(1, sizeof(HttpConn));
+        if (conn == NULL) {
+            close(fd);
+            continue;
+        }
+        conn->fd = fd;
+        conn->last_active = time(NULL);
+        
+        struct epoll_event ev;
+        ev.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+        ev.data.ptr = conn;
+        if (epoll_ctl(loop->epoll_fd, EPOLL_CTL_ADD, fd, &ev) != 0) {
+            close(fd);
+            free(conn);
+            continue;
+        }
+        conn->next = loop->conns;
+        if (loop->conns) loop->conns->prev = conn;
+        loop->conns = conn;
+    }
+}
+
+// Close connections idle (or stuck mid-request) for KEEPALIVE_TIMEOUT
+static void sweep_idle(ServerLoop* loop, time_t now) {
+    HttpConn* conn = loop->conns;
+    while (conn != NULL) {
+        HttpConn* next = conn->next;
+        if (now - conn->last_active >= KEEPALIVE_TIMEOUT) {
+            conn_close(loop, conn);
+        }
+        conn = next;
+    }
+    loop->last_sweep = now;
+}
+
+// Send each /api/events subscriber what changed since its last event
+static void push_events(ServerLoop* loop, time_t now) {
+    StreamEvent cache[STREAM_EVENT_CACHE];
+    int cached = 0;
+    HttpConn* conn = loop->conns;
+    while (conn != NULL) {
+        HttpConn* next = conn->next;
+        if (conn->stream_queue != NULL && !conn->close_after &&
+            stream_update(conn, cache, &cached, now) != 0) {
+            conn_close(loop, conn);
+        }
+        conn = next;
+    }
+    for (int i = 0; i < cached; i++) {
+        free(cache[i].text.data);
+    }
+}
+
+static unsigned long long monotonic_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec * 1000ULL + (unsigned long long)ts.tv_nsec / 1000000ULL;
+}
+
+static void* server_loop_thread(void* arg) {
+    ServerLoop* loop = arg;
+    struct epoll_event events[MAX_EVENTS];
+    this_loop = loop;
     
-    // Attach to shared memory
-    queue = attach_shared_memory(-1);
-    if (queue == NULL) {
-        LOG_ERROR_F("Failed to attach to shared memory");
-        return 1;
+    while (server_running) {
+        // Subscribers get changes in batches, EVENT_PUSH_INTERVAL_MS apart
+        int timeout = loop->subscribers > 0 ? EVENT_PUSH_INTERVAL_MS : 1000;
+        int n = epoll_wait(loop->epoll_fd, events, MAX_EVENTS, timeout);
+        if (n < 0 && errno != EINTR) {
+            LOG_ERROR_F("Loop %d: epoll_wait failed: %s", loop->index, strerror(errno));
+            break;
+        }
+        for (int i = 0; i < n; i++) {
+            if (events[i].data.ptr == NULL) {
+                accept_connections(loop);
+                continue;
+            }
+            HttpConn* conn = events[i].data.ptr;
+            if (events[i].events & EPOLLERR) {
+                conn_close(loop, conn);
+            } else {
+                conn_service(loop, conn);
+            }
+        }
+        time_t now = time(NULL);
+        unsigned long long now_ms = monotonic_ms();
+        if (loop->subscribers > 0 && now_ms - loop->last_push_ms >= EVENT_PUSH_INTERVAL_MS) {
+            push_events(loop, now);
+            loop->last_push_ms = now_ms;
+        }
+        if (now != loop->last_sweep) sweep_idle(loop, now);
     }
     
-    // Create socket
-    int server_fd = socket(AF_INET, SOCK_STREAM, 0);
-    if (server_fd < 0) {
+    while (loop->conns != NULL) {
+        conn_close(loop, loop->conns);
+    }
+    return NULL;
+}
+
+// A non-blocking listening socket on PORT; with several loops each gets
+// its own and the kernel spreads connections across them
+static int open_listener(void) {
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
         LOG_ERROR_F("Failed to create socket");
-        return 1;
+        return -1;
     }
     
-    // Set socket options
     int opt = 1;
-    setsockopt(server_fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+    if (loop_count > 1 && setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &opt, sizeof(opt)) != 0) {
+        LOG_ERROR_F("Failed to set SO_REUSEPORT: %s", strerror(errno));
+        close(fd);
+        return -1;
+    }
     
-    // Bind socket
     struct sockaddr_in address;
+    memset(&address, 0, sizeof(address));
     address.sin_family = AF_INET;
     address.sin_addr.s_addr = INADDR_ANY;
     address.sin_port = htons(PORT);
     
-    if (bind(server_fd, (struct sockaddr*)&address, sizeof(address)) < 0) {
+    if (bind(fd, (struct sockaddr*)&address, sizeof(address)) < 0) {
         LOG_ERROR_F("Failed to bind socket to port %d", PORT);
-        close(server_fd);
-        return 1;
+        close(fd);
+        return -1;
     }
-    
-    // Listen
-    if (listen(server_fd, 10) < 0) {
+    if (listen(fd, LISTEN_BACKLOG) < 0) {
         LOG_ERROR_F("Failed to listen on socket");
-        close(server_fd);
-        return 1;
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static int init_loop(ServerLoop* loop, int index) {
+    loop->index = index;
+    loop->conns = NULL;
+    loop->last_sweep = time(NULL);
+    loop->subscribers = 0;
+    loop->last_push_ms = 0;
+    loop->listen_fd = open_listener();
+    if (loop->listen_fd < 0) return -1;
+    
+    loop->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    struct epoll_event ev;
+    ev.events = EPOLLIN | EPOLLET;
+    ev.data.ptr = NULL;
+    if (loop->epoll_fd < 0 || epoll_ctl(loop->epoll_fd, EPOLL_CTL_ADD, loop->listen_fd, &ev) != 0) {
+        LOG_ERROR_F("Failed to set up event loop %d: %s", index, strerror(errno));
+        if (loop->epoll_fd >= 0) close(loop->epoll_fd);
+        close(loop->listen_fd);
+        return -1;
+    }
+    return 0;
+}
+
+// Attach to a queue by name; SHM_KEY_ENV still applies to the one it is
+// meant for (the default, or QUEUE_NAME_ENV's)
+static TaskQueue* attach_queue(const char* name) {
+    key_t key = strcmp(name, queue_name()) == 0 ? queue_shm_key() : queue_shm_key_for(name);
+    int shm_id = shmget(key, sizeof(TaskQueue), 0666);
+    if (shm_id == -1) {
+        LOG_ERROR_F("Queue %s: no shared memory at key 0x%x", name, (unsigned)key);
+        return NULL;
+    }
+    return attach_shared_memory(shm_id);
+}
+
+static void print_usage(const char* prog) {
+    fprintf(stderr, "Usage: %s [--queue NAME]... [--threads N]\n", prog);
+    fprintf(stderr, "  --queue NAME   Serve this queue under /q/NAME/ (repeatable, max %d)\n", MAX_QUEUES);
+    fprintf(stderr, "  --threads N    Event-loop threads sharing port %d (default 1, max %d)\n",
+            PORT, MAX_SERVER_THREADS);
+}
+
+int main(int argc, char* argv[]) {
+    // Queues to serve: --queue NAME (repeatable), else $QUEUE_NAME_ENV or the default
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--queue") == 0 && i + 1 < argc && queue_name_valid(argv[i + 1]) &&
+            served_count < MAX_QUEUES) {
+            strcpy(served[served_count++].name, argv[++i]);
+        } else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc && atoi(argv[i + 1]) >= 1 &&
+                   atoi(argv[i + 1]) <= MAX_SERVER_THREADS) {
+            loop_count = atoi(argv[++i]);
+        } else {
+            print_usage(argv[0]);
+            return 1;
+        }
+    }
+    if (served_count == 0) {
+        strcpy(served[served_count++].name, queue_name());
     }
     
-    LOG_INFO_F("Web server listening on http://localhost:%d", PORT);
+    // Initialize logger
+    init_logger("web_server");
+    if (trace_open("web_server", -1) != 0) {
+        LOG_WARN_F("Failed to open trace file: %s", strerror(errno));
+    }
+    LOG_INFO_F("Starting web server...");
+    
+    // Set up signal handlers
+    signal(SIGINT, signal_handler);
+    signal(SIGTERM, signal_handler);
+    
+    // Dashboard files are read once here and again when they change
+    if (asset_cache_start("web") != 0) {
+        LOG_WARN_F("Dashboard unavailable; serving the API only");
+    }
+    
+    // Attach to shared memory
+    for (int q = 0; q < served_count; q++) {
+        served[q].queue = attach_queue(served[q].name);
+        if (served[q].queue == NULL) {
+            LOG_ERROR_F("Failed to attach to shared memory");
+            return 1;
+        }
+    }
+    
+    for (int i = 0; i < loop_count; i++) {
+        if (init_loop(&loops[i], i) != 0) {
+            return 1;
+        }
+    }
+    
+    LOG_INFO_F("Web server listening on http://localhost:%d (%d event loop%s)",
+               PORT, loop_count, loop_count == 1 ? "" : "s");
     LOG_INFO_F("Dashboard available at http://localhost:%d", PORT);
+    for (int q = 1; q < served_count; q++) {
+        LOG_INFO_F("Queue %s at http://localhost:%d/q/%s/", served[q].name, PORT, served[q].name);
+    }
     
-    // Accept connections
-    while (server_running) {
-        struct sockaddr_in client_addr;
-        socklen_t addr_len = sizeof(client_addr);
-        
-        int client_fd = accept(server_fd, (struct sockaddr*)&client_addr, &addr_len);
-        if (client_fd < 0) {
-            if (server_running) {
-                LOG_ERROR_F("Failed to accept connection");
-            }
-            continue;
+    // Loop 0 runs here; the rest get threads
+    int started = 1;
+    for (int i = 1; i < loop_count; i++, started++) {
+        if (pthread_create(&loops[i].thread, NULL, server_loop_thread, &loops[i]) != 0) {
+            LOG_ERROR_F("Failed to start event loop %d", i);
+            server_running = 0;
+            break;
         }
-        
-        // Handle request (for simplicity, handle synchronously)
-        // In production, would fork or use threads
-        handle_request(client_fd);
+    }
+    if (server_running) {
+        server_loop_thread(&loops[0]);
+    }
+    server_running = 0;
+    for (int i = 1; i < started; i++) {
+        pthread_join(loops[i].thread, NULL);
     }
     
     LOG_INFO_F("Web server shutting down...");
-    close(server_fd);
-    detach_shared_memory(queue);
+    for (int i = 0; i < loop_count; i++) {
+        close(loops[i].epoll_fd);
+        close(loops[i].listen_fd);
+    }
+    for (int q = 0; q < served_count; q++) {
+        detach_shared_memory(served[q].queue);
+    }
+    asset_cache_stop();
     close_logger();
     
     return 0;
 }
-
@@ -1,53 +1,171 @@
 #include "common.h"
 #include "task_queue.h"
 #include "logger.h"
+#include "async_executor.h"
+#include "affinity.h"
+#include "resource_usage.h"
+#include "task_control.h"
+#include "worker_stats.h"
+#include "trace.h"
 #include <sys/wait.h>
+#include <getopt.h>
 
 static TaskQueue* queue = NULL;
 static int worker_id = -1;
+static ExecMode exec_mode = EXEC_MODE_THREAD;
+static ThreadPlacement placement;
+static int task_thread_seq = 0;
 static volatile int shutdown_requested = 0;
 
+// Thread mode runs at most task_threads_limit task threads at once; the
+// limit follows threads_per_worker in the shared config
+static pthread_mutex_t task_threads_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t task_threads_cond = PTHREAD_COND_INITIALIZER;
+static int task_threads_active = 0;
+static int task_threads_limit = MAX_THREADS_PER_WORKER;
+static int seen_config_generation = -1;
+
 // Thread data structure
 typedef struct {
     Task task;
     TaskQueue* queue;
     int worker_id;
+    int thread_seq;
 } ThreadData;
 
+// Stops this worker only; the pool-wide shutdown flag belongs to the scheduler
 void signal_handler(int sig) {
     if (sig == SIGINT || sig == SIGTERM) {
         shutdown_requested = 1;
         LOG_INFO_F("Worker %d: Shutdown signal received", worker_id);
         
         if (queue != NULL) {
-            queue->shutdown_flag = 1;
             pthread_cond_broadcast(&queue->queue_cond);
         }
     }
 }
 
+// Stop claiming on shutdown, or when the scheduler asks this worker to drain
+static int worker_should_stop(void) {
+    return shutdown_requested || queue->shutdown_flag || worker_stats_drain_requested();
+}
+
+// Pick up a new shared config generation. Cheap enough to call on every
+// loop: fields are only copied once the generation has moved.
+static void refresh_config(void) {
+    int generation = __atomic_load_n(&queue->config_generation, __ATOMIC_ACQUIRE);
+    if (generation == seen_config_generation) return;
+    seen_config_generation = generation;
+    
+    int threads = __atomic_load_n(&queue->config.threads_per_worker, __ATOMIC_RELAXED);
+    SchedPolicy policy = __atomic_load_n(&queue->config.sched_policy, __ATOMIC_RELAXED);
+    if (threads < 1) threads = 1;
+    
+    if (exec_mode == EXEC_MODE_THREAD) {
+        __atomic_store_n(&task_threads_limit, threads, __ATOMIC_RELAXED);
+        worker_stats_set_capacity(threads);
+        LOG_INFO_F("Worker %d: Config generation %d (threads %d, policy %s)", worker_id,
+                   generation, threads, sched_policy_to_string(policy));
+    } else {
+        LOG_INFO_F("Worker %d: Config generation %d (policy %s)", worker_id, generation,
+                   sched_policy_to_string(policy));
+    }
+}
+
+static void task_threads_adjust(int delta) {
+    pthread_mutex_lock(&task_threads_mutex);
+    task_threads_active += delta;
+    pthread_cond_broadcast(&task_threads_cond);
+    pthread_mutex_unlock(&task_threads_mutex);
+}
+
+// Block until a task thread may start, or the worker should stop claiming
+static void wait_task_thread_slot(void) {
+    pthread_mutex_lock(&task_threads_mutex);
+    for (;;) {
+        refresh_config();  // A raised limit frees a slot too
+        if (task_threads_active < __atomic_load_n(&task_threads_limit, __ATOMIC_RELAXED) ||
+            worker_should_stop()) {
+            break;
+        }
+        // Bounded wait so shutdown, drain and config changes are noticed promptly
+        struct timespec ts;
+        clock_gettime(CLOCK_REALTIME, &ts);
+        ts.tv_nsec += 100000000L;
+        if (ts.tv_nsec >= 1000000000L) {
+            ts.tv_sec++;
+            ts.tv_nsec -= 1000000000L;
+        }
+        pthread_cond_timedwait(&task_threads_cond, &task_threads_mutex, &ts);
+    }
+    pthread_mutex_unlock(&task_threads_mutex);
+}
+
 void* task_executor_thread(void* arg) {
     ThreadData* data = (ThreadData*)arg;
     Task task = data->task;
     TaskQueue* q = data->queue;
     int wid = data->worker_id;
     
+    worker_stats_threads(1, 0);
+    struct timespec started, ended;
+    clock_gettime(CLOCK_MONOTONIC, &started);
+    
+    // Place ourselves before doing any work (isolated cores for HIGH tasks)
+    if (placement_apply(&placement, pthread_self(), task.priority, data->thread_seq) != 0) {
+        LOG_WARN_F("Worker %d: Failed to set CPU affinity for task %d", wid, task.id);
+    }
+    
+    TRACE(TRACE_TASK_BEGIN, task.id, 0);
     LOG_INFO_F("Worker %d: Thread executing task %d: %s (priority: %s, duration: %u ms)",
                wid, task.id, task.name, priority_to_string(task.priority), task.execution_time_ms);
     
-    // Simulate task execution by sleeping
-    usleep(task.execution_time_ms * 1000); // Convert ms to microseconds
+    UsageSample start_sample, end_sample;
+    usage_sample_thread(&start_sample, 1);
+    
+    // Timeouts and cancel requests wake us through the token
+    CancelToken token;
+    cancel_token_init(&token);
+    TaskControlEntry* control = task_control_register(&task, cancel_token_fire, &token);
+    
+    // Simulate task execution by sleeping (cancellable)
+    TaskCancelReason cancelled = cancel_token_sleep(&token, task.execution_time_ms);
+    
+    task_control_unregister(control);
+    cancel_token_destroy(&token);
+    
+    TaskUsage usage;
+    memset(&usage, 0, sizeof(usage));
+    usage_sample_thread(&end_sample, 1);
+    usage_accumulate(&usage, &start_sample, &end_sample);
     
-    // Update task status to completed
-    time_t end_time;
-    if (update_task_status(q, task.id, STATUS_COMPLETED, &end_time) == 0) {
+    TaskStatus final_status = STATUS_COMPLETED;
+    if (cancelled == CANCEL_REASON_HANDBACK) {
+        final_status = STATUS_PENDING;
+        requeue_task(q, task.id);
+        LOG_WARN_F("Worker %d: Task %d handed back to the queue", wid, task.id);
+    } else if (cancelled != CANCEL_REASON_NONE) {
+        final_status = STATUS_FAILED;
+        char error[MAX_TASK_ERROR_LEN];
+        task_cancel_error(&task, cancelled, error, sizeof(error));
+        fail_task_logged(q, wid, &task, error, &usage);
+    } else if (finish_task(q, task.id, STATUS_COMPLETED, &usage) == 0) {
         LOG_INFO_F("Worker %d: Task %d completed successfully", wid, task.id);
     } else {
+        final_status = STATUS_FAILED;
         LOG_ERROR_F("Worker %d: Failed to update status for task %d", wid, task.id);
         update_task_status(q, task.id, STATUS_FAILED, NULL);
     }
     
+    clock_gettime(CLOCK_MONOTONIC, &ended);
+    long long busy_us = (long long)(ended.tv_sec - started.tv_sec) * 1000000LL +
+                        (ended.tv_nsec - started.tv_nsec) / 1000;
+    worker_stats_task_finished(task.priority, final_status, (unsigned long long)busy_us);
+    worker_stats_threads(-1, 0);
+    TRACE(TRACE_TASK_END, task.id, final_status);
+    
     free(data);
+    task_threads_adjust(-1);  // Capacity is back as soon as the task is done
     return NULL;
 }
 
@@ -57,23 +175,38 @@ int execute_task(TaskQueue* queue, Task* task) {
     // Worker ID and status already set in worker_main_loop
     // No need to lock here again
     
+    if (exec_mode == EXEC_MODE_ASYNC) {
+        if (async_executor_submit(task) != 0) {
+            LOG_ERROR_F("Worker %d: Failed to submit task %d to event loop", worker_id, task->id);
+            fail_task_logged(queue, worker_id, task, "event loop submit failed", NULL);
+            worker_stats_task_finished(task->priority, STATUS_FAILED, 0);
+            return -1;
+        }
+        return 0;
+    }
+    
     // Create thread data
     ThreadData* data = (ThreadData*)malloc(sizeof(ThreadData));
     if (data == NULL) {
         LOG_ERROR_F("Worker %d: Failed to allocate thread data", worker_id);
-        update_task_status(queue, task->id, STATUS_FAILED, NULL);
+        fail_task_logged(queue, worker_id, task, "out of memory", NULL);
+        worker_stats_task_finished(task->priority, STATUS_FAILED, 0);
         return -1;
     }
     
     data->task = *task;
     data->queue = queue;
     data->worker_id = worker_id;
+    data->thread_seq = task_thread_seq++;
     
     // Create thread to execute task
+    task_threads_adjust(1);
     pthread_t thread;
     if (pthread_create(&thread, NULL, task_executor_thread, data) != 0) {
         LOG_ERROR_F("Worker %d: Failed to create thread for task %d", worker_id, task->id);
-        update_task_status(queue, task->id, STATUS_FAILED, NULL);
+        fail_task_logged(queue, worker_id, task, "thread creation failed", NULL);
+        worker_stats_task_finished(task->priority, STATUS_FAILED, 0);
+        task_threads_adjust(-1);
         free(data);
         return -1;
     }
@@ -87,49 +220,56 @@ int execute_task(TaskQueue* queue, Task* task) {
 void worker_main_loop(void) {
     LOG_INFO_F("Worker %d: Starting main loop", worker_id);
     
-    while (!shutdown_requested && !(queue && queue->shutdown_flag)) {
+    while (!worker_should_stop()) {
         Task task;
         
+        refresh_config();
+        
+        // Both modes bound in-flight tasks; don't claim what we can't run
+        if (exec_mode == EXEC_MODE_ASYNC) {
+            async_executor_wait_capacity(&shutdown_requested);
+        } else {
+            wait_task_thread_slot();
+        }
+        if (worker_should_stop()) break;
+        
         // Use condition variable to wait for tasks instead of polling
-        pthread_mutex_lock(&queue->queue_mutex);
+        lock_queue(queue);
         
         // Wait for tasks to become available or shutdown
+        worker_stats_threads(0, 1);
         while ((is_queue_empty(queue) || get_pending_task_count(queue) == 0) 
-               && !shutdown_requested 
-               && !queue->shutdown_flag) {
-            pthread_cond_wait(&queue->queue_cond, &queue->queue_mutex);
+               && !worker_should_stop() && queue->config_generation == seen_config_generation) {
+            wait_queue(queue, &queue->queue_cond, NULL);
         }
+        worker_stats_threads(0, -1);
         
         // Check if we should exit
-        if (shutdown_requested || queue->shutdown_flag) {
-            pthread_mutex_unlock(&queue->queue_mutex);
+        if (worker_should_stop()) {
+            unlock_queue(queue);
             break;
         }
         
-        // Try to dequeue a task (mutex still locked)
-        int found_idx = -1;
-        for (int i = 0; i < queue->size; i++) {
-            if (queue->tasks[i].status == STATUS_PENDING) {
-                found_idx = i;
-                break;
-            }
+        // Woken by a config change: apply it before claiming anything
+        if (queue->config_generation != seen_config_generation) {
+            unlock_queue(queue);
+            continue;
         }
         
+        // Try to dequeue a task (mutex still locked)
+        int found_idx = find_next_pending_locked(queue);
         if (found_idx == -1) {
-            pthread_mutex_unlock(&queue->queue_mutex);
+            unlock_queue(queue);
             continue;
         }
         
-        // Copy task and update status
+        // Update status and copy task
+        claim_task_locked(queue, &queue->tasks[found_idx], worker_id);
         task = queue->tasks[found_idx];
-        task.status = STATUS_RUNNING;
-        task.start_time = time(NULL);
-        task.worker_id = worker_id;
-        queue->tasks[found_idx].status = STATUS_RUNNING;
-        queue->tasks[found_idx].start_time = task.start_time;
-        queue->tasks[found_idx].worker_id = worker_id;
         
-        pthread_mutex_unlock(&queue->queue_mutex);
+        unlock_queue(queue);
+        
+        worker_stats_task_claimed(&task);
         
         // Execute the task (outside of lock)
         execute_task(queue, &task);
@@ -138,20 +278,108 @@ void worker_main_loop(void) {
     LOG_INFO_F("Worker %d: Main loop exiting", worker_id);
 }
 
+static int inflight_task_count(void) {
+    if (exec_mode == EXEC_MODE_ASYNC) {
+        return async_executor_inflight();
+    }
+    pthread_mutex_lock(&task_threads_mutex);
+    int count = task_threads_active;
+    pthread_mutex_unlock(&task_threads_mutex);
+    return count;
+}
+
+// Every exit goes through here once claiming has stopped. In-flight tasks
+// get WORKER_DRAIN_TIMEOUT seconds to finish; whatever is still running then
+// is handed back to the queue as PENDING for another worker to pick up.
+static void drain_inflight_tasks(void) {
+    int remaining = inflight_task_count();
+    if (remaining == 0) return;
+    
+    LOG_INFO_F("Worker %d: Draining, waiting for %d in-flight tasks", worker_id, remaining);
+    time_t deadline = time(NULL) + WORKER_DRAIN_TIMEOUT;
+    while (inflight_task_count() > 0 && time(NULL) < deadline) {
+        usleep(100000);
+    }
+    
+    // Keep firing: a task claimed just before we stopped may register late
+    int handed_back = 0;
+    while (inflight_task_count() > 0) {
+        handed_back += task_control_cancel_all(CANCEL_REASON_HANDBACK);
+        usleep(100000);
+    }
+    if (handed_back > 0) {
+        LOG_WARN_F("Worker %d: Drain timed out, handed back %d tasks", worker_id, handed_back);
+    }
+    LOG_INFO_F("Worker %d: Drained", worker_id);
+}
+
+static void print_usage(const char* prog) {
+    fprintf(stderr, "Usage: %s <worker_id> [thread|async] [--pin-threads] [--isolated-cpus LIST]\n", prog);
+}
+
 int main(int argc, char* argv[]) {
-    if (argc < 2) {
-        fprintf(stderr, "Usage: %s <worker_id>\n", argv[0]);
+    static struct option long_options[] = {
+        {"pin-threads",   no_argument,       NULL, 'p'},
+        {"isolated-cpus", required_argument, NULL, 'i'},
+        {NULL, 0, NULL, 0}
+    };
+    
+    int pin_threads = 0;
+    const char* isolated_cpus = NULL;
+    int opt;
+    while ((opt = getopt_long(argc, argv, "pi:", long_options, NULL)) != -1) {
+        switch (opt) {
+            case 'p': pin_threads = 1; break;
+            case 'i': isolated_cpus = optarg; break;
+            default:
+                print_usage(argv[0]);
+                return 1;
+        }
+    }
+    
+    if (optind >= argc) {
+        print_usage(argv[0]);
         return 1;
     }
     
-    worker_id = atoi(argv[1]);
+    worker_id = atoi(argv[optind]);
+    if (optind + 1 < argc && parse_exec_mode(argv[optind + 1], &exec_mode) != 0) {
+        fprintf(stderr, "Unknown execution mode: %s\n", argv[optind + 1]);
+        return 1;
+    }
+    
+    if (placement_init(&placement, pin_threads, isolated_cpus) != 0) {
+        fprintf(stderr, "Invalid thread placement (isolated CPUs: %s)\n",
+                isolated_cpus ? isolated_cpus : "none");
+        return 1;
+    }
     
     // Initialize logger
+    // Workers of a named queue log as worker_NAME_ID
     char log_name[64];
-    snprintf(log_name, sizeof(log_name), "worker_%d", worker_id);
+    if (strcmp(queue_name(), DEFAULT_QUEUE_NAME) == 0) {
+        snprintf(log_name, sizeof(log_name), "worker_%d", worker_id);
+    } else {
+        snprintf(log_name, sizeof(log_name), "worker_%s_%d", queue_name(), worker_id);
+    }
     init_logger(log_name);
+    if (trace_open(log_name, worker_id) != 0) {
+        LOG_WARN_F("Worker %d: Failed to open trace file: %s", worker_id, strerror(errno));
+    }
     
-    LOG_INFO_F("Worker %d starting (PID: %d)", worker_id, getpid());
+    LOG_INFO_F("Worker %d starting (PID: %d, mode: %s)", worker_id, getpid(),
+               exec_mode_to_string(exec_mode));
+    
+    char cpus[256];
+    format_cpu_list(&placement.general_cpus, cpus, sizeof(cpus));
+    LOG_INFO_F("Worker %d: General CPUs %s%s", worker_id, cpus,
+               placement.pin_threads ? ", pool threads pinned" : "");
+    if (placement.has_isolated) {
+        format_cpu_list(&placement.isolated_cpus, cpus, sizeof(cpus));
+        LOG_INFO_F("Worker %d: Isolated CPUs %s reserved for HIGH-priority tasks", worker_id, cpus);
+        // Keep the claim loop off the isolated cores
+        placement_apply(&placement, pthread_self(), PRIORITY_MEDIUM, 0);
+    }
     
     // Set up signal handlers
     signal(SIGINT, signal_handler);
@@ -166,25 +394,65 @@ int main(int argc, char* argv[]) {
     
     LOG_INFO_F("Worker %d: Attached to shared memory", worker_id);
     
+    // The first refresh_config() logs the generation and may correct this
+    int capacity = exec_mode == EXEC_MODE_ASYNC ? ASYNC_MAX_INFLIGHT
+                                                : __atomic_load_n(&queue->config.threads_per_worker,
+                                                                  __ATOMIC_RELAXED);
+    if (capacity < 1) capacity = 1;
+    if (worker_stats_attach(queue, worker_id, capacity) != 0) {
+        LOG_ERROR_F("Worker %d: Worker id must be below %d", worker_id, MAX_WORKERS);
+        detach_shared_memory(queue);
+        return 1;
+    }
+    
+    if (task_control_start(queue, worker_id) != 0) {
+        LOG_ERROR_F("Worker %d: Failed to start task control thread", worker_id);
+        worker_stats_detach();
+        detach_shared_memory(queue);
+        return 1;
+    }
+    
+    if (exec_mode == EXEC_MODE_ASYNC &&
+        async_executor_start(queue, worker_id, ASYNC_LOOP_THREADS, &placement) != 0) {
+        LOG_ERROR_F("Worker %d: Failed to start async executor", worker_id);
+        task_control_stop();
+        worker_stats_detach();
+        detach_shared_memory(queue);
+        return 1;
+    }
+    
     // Register worker as active
-    pthread_mutex_lock(&queue->queue_mutex);
+    lock_queue(queue);
     queue->num_active_workers++;
-    pthread_mutex_unlock(&queue->queue_mutex);
+    queue_modified(queue);
+    unlock_queue(queue);
+    TRACE(TRACE_WORKER_START, -1, getpid());
     
     // Main worker loop
     worker_main_loop();
     
+    drain_inflight_tasks();
+    
+    if (exec_mode == EXEC_MODE_ASYNC) {
+        async_executor_stop();
+    }
+    task_control_stop();
+    worker_stats_detach();
+    
     // Unregister worker
-    pthread_mutex_lock(&queue->queue_mutex);
+    lock_queue(queue);
     if (queue->num_active_workers > 0) {
         queue->num_active_workers--;
     }
-    pthread_mutex_unlock(&queue->queue_mutex);
+    queue_modified(queue);
+    unlock_queue(queue);
     
     // Detach from shared memory
     detach_shared_memory(queue);
     
     LOG_INFO_F("Worker %d: Shutting down", worker_id);
+    TRACE(TRACE_WORKER_STOP, -1, getpid());
+    trace_close();
     close_logger();
     
     return 0;
@@ -0,0 +1,132 @@
+#include "worker_stats.h"
+
+#define STAT_ADD(field, delta) __atomic_add_fetch(&(field), (delta), __ATOMIC_RELAXED)
+#define STAT_SET(field, value) __atomic_store_n(&(field), (value), __ATOMIC_RELAXED)
+#define STAT_GET(field) __atomic_load_n(&(field), __ATOMIC_RELAXED)
+
+static WorkerSlot* own_slot = NULL;
+static TaskQueue* own_queue = NULL;     // Its version is bumped after each change (not heartbeats)
+
+int worker_stats_attach(TaskQueue* queue, int worker_id, int capacity) {
+    if (queue == NULL || worker_id < 0 || worker_id >= MAX_WORKERS) return -1;
+
+    WorkerSlot* slot = &queue->workers[worker_id];
+    time_t now = time(NULL);
+
+    // Gauges belonged to the previous process with this id; totals carry on
+    STAT_SET(slot->busy_threads, 0);
+    STAT_SET(slot->idle_threads, 0);
+    STAT_SET(slot->inflight_tasks, 0);
+    STAT_SET(slot->capacity, capacity);
+    STAT_SET(slot->drain_requested, 0);
+    STAT_SET(slot->started_at, now);
+    STAT_SET(slot->heartbeat, now);
+    STAT_SET(slot->pid, getpid());
+
+    own_slot = slot;
+    own_queue = queue;
+    queue_modified(queue);
+    return 0;
+}
+
+void worker_stats_detach(void) {
+    if (own_slot == NULL) return;
+
+    STAT_SET(own_slot->busy_threads, 0);
+    STAT_SET(own_slot->idle_threads, 0);
+    STAT_SET(own_slot->inflight_tasks, 0);
+    STAT_SET(own_slot->pid, 0);
+    queue_modified(own_queue);
+    own_slot = NULL;
+    own_queue = NULL;
+}
+
+void worker_stats_heartbeat(void) {
+    if (own_slot == NULL) return;
+    STAT_SET(own_slot->heartbeat, time(NULL));
+}
+
+void worker_stats_set_capacity(int capacity) {
+    if (own_slot == NULL) return;
+    STAT_SET(own_slot->capacity, capacity);
+    queue_modified(own_queue);
+}
+
+int worker_stats_drain_requested(void) {
+    if (own_slot == NULL) return 0;
+    return STAT_GET(own_slot->drain_requested);
+}
+
+void worker_stats_threads(int busy_delta, int idle_delta) {
+    if (own_slot == NULL) return;
+    if (busy_delta != 0) STAT_ADD(own_slot->busy_threads, busy_delta);
+    if (idle_delta != 0) STAT_ADD(own_slot->idle_threads, idle_delta);
+    queue_modified(own_queue);
+}
+
+static int priority_valid(Priority priority) {
+    return priority >= 0 && priority < PRIORITY_COUNT;
+}
+
+void worker_stats_task_claimed(const Task* task) {
+    if (own_slot == NULL) return;
+    STAT_ADD(own_slot->inflight_tasks, 1);
+    STAT_SET(own_slot->last_claim, time(NULL));
+
+    if (priority_valid(task->priority)) {
+        QueueMetrics* metrics = &own_queue->metrics;
+        unsigned long long now = queue_clock_ns();
+        STAT_ADD(metrics->claimed[task->priority], 1ULL);
+        metrics_observe(&metrics->queue_wait[task->priority],
+                        now > task->ready_ns ? (now - task->ready_ns) / 1000ULL : 0);
+    }
+    queue_modified(own_queue);
+}
+
+void worker_stats_task_finished(Priority priority, TaskStatus status, unsigned long long busy_us) {
+    if (own_slot == NULL) return;
+
+    STAT_ADD(own_slot->inflight_tasks, -1);
+    if (status == STATUS_COMPLETED) {
+        STAT_ADD(own_slot->tasks_completed, 1ULL);
+    } else if (status != STATUS_PENDING) {
+        STAT_ADD(own_slot->tasks_failed, 1ULL);
+    }
+    STAT_ADD(own_slot->busy_time_us, busy_us);
+
+    if (priority_valid(priority) && status != STATUS_PENDING) {
+        QueueMetrics* metrics = &own_queue->metrics;
+        if (status == STATUS_COMPLETED) {
+            STAT_ADD(metrics->completed[priority], 1ULL);
+        } else {
+            STAT_ADD(metrics->failed[priority], 1ULL);
+        }
+        // Tasks that never got to run (busy_us 0) have no execution time
+        if (busy_us > 0) metrics_observe(&metrics->execution[priority], busy_us);
+    }
+    queue_modified(own_queue);
+}
+
+void worker_stats_request_drain(WorkerSlot* slot) {
+    STAT_SET(slot->drain_requested, 1);
+}
+
+void worker_stats_read(const WorkerSlot* slot, WorkerSlot* out) {
+    WorkerSlot* s = (WorkerSlot*)slot;
+    out->pid = STAT_GET(s->pid);
+    out->capacity = STAT_GET(s->capacity);
+    out->drain_requested = STAT_GET(s->drain_requested);
+    out->started_at = STAT_GET(s->started_at);
+    out->heartbeat = STAT_GET(s->heartbeat);
+    out->last_claim = STAT_GET(s->last_claim);
+    out->busy_threads = STAT_GET(s->busy_threads);
+    out->idle_threads = STAT_GET(s->idle_threads);
+    out->inflight_tasks = STAT_GET(s->inflight_tasks);
+    out->tasks_completed = STAT_GET(s->tasks_completed);
+    out->tasks_failed = STAT_GET(s->tasks_failed);
+    out->busy_time_us = STAT_GET(s->busy_time_us);
+}
+
+int worker_stats_alive(const WorkerSlot* snapshot, time_t now) {
+    return snapshot->pid != 0 && now - snapshot->heartbeat <= WORKER_HEARTBEAT_TIMEOUT;
+}
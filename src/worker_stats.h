@@ -0,0 +1,31 @@
+#ifndef WORKER_STATS_H
+#define WORKER_STATS_H
+
+#include "common.h"
+#include "task_queue.h"
+
+// Writer side, used inside a worker process. worker_stats_attach() picks
+// the slot for this worker id; every other call updates that slot with
+// relaxed atomics and is a no-op before attach.
+int worker_stats_attach(TaskQueue* queue, int worker_id, int capacity);
+void worker_stats_detach(void);
+void worker_stats_heartbeat(void);
+void worker_stats_set_capacity(int capacity);  // After a config change
+int worker_stats_drain_requested(void);
+
+void worker_stats_threads(int busy_delta, int idle_delta);
+// Also feed the queue's metrics: the claim ends the task's queue wait,
+// the finish its execution time
+void worker_stats_task_claimed(const Task* task);
+// Every claimed task is reported exactly once as finished; STATUS_PENDING
+// means it was handed back to the queue and counts as neither outcome
+void worker_stats_task_finished(Priority priority, TaskStatus status, unsigned long long busy_us);
+
+// Scheduler side: ask the worker owning a slot to drain and exit
+void worker_stats_request_drain(WorkerSlot* slot);
+
+// Reader side: consistent-enough copy of a slot without any locking
+void worker_stats_read(const WorkerSlot* slot, WorkerSlot* out);
+int worker_stats_alive(const WorkerSlot* snapshot, time_t now);
+
+#endif // WORKER_STATS_H
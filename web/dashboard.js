@@ -1,9 +1,14 @@
 // Dashboard JavaScript for real-time updates
 
-const API_BASE = '';
+// Under /q/NAME/ the dashboard shows queue NAME
+const API_BASE = (window.location.pathname.match(/^\/q\/[^/]+/) || [''])[0];
 const REFRESH_INTERVAL = 2000; // 2 seconds
 let autoRefresh = true;
 let refreshIntervalId = null;
+// Task changes arrive over /api/events (server-sent events) where the
+// browser supports it; the interval then only refreshes workers and charts
+let eventSource = null;
+let latestStatus = null;
 let throughputData = [];
 let maxDataPoints = 30;
 
@@ -12,8 +17,8 @@ let throughputChart = null;
 let statusChart = null;
 let workerChart = null;
 
-// Current tasks data for modal
-let currentTasks = [];
+// Tasks by id, kept current by the event stream (or each poll)
+let taskMap = new Map();
 
 // Initialize dashboard
 document.addEventListener('DOMContentLoaded', () => {
@@ -21,7 +26,8 @@ document.addEventListener('DOMContentLoaded', () => {
     setupEventListeners();
     setupForms();
     startAutoRefresh();
-    updateDashboard();
+    // The event stream brings the tasks and counters
+    if (eventSource) refreshWorkers(); else updateDashboard();
 });
 
 // Initialize Chart.js charts
@@ -170,8 +176,8 @@ function setupEventListeners() {
         }
     });
 
-    document.getElementById('statusFilter').addEventListener('change', () => updateTaskTable(currentTasks));
-    document.getElementById('priorityFilter').addEventListener('change', () => updateTaskTable(currentTasks));
+    document.getElementById('statusFilter').addEventListener('change', () => updateTaskTable(Array.from(taskMap.values())));
+    document.getElementById('priorityFilter').addEventListener('change', () => updateTaskTable(Array.from(taskMap.values())));
     
     // Export buttons
     document.getElementById('exportCsvBtn').addEventListener('click', exportCSV);
@@ -198,11 +204,13 @@ function setupForms() {
         const formData = {
             name: document.getElementById('taskName').value,
             priority: document.getElementById('taskPriority').value,
-            duration: parseInt(document.getElementById('taskDuration').value)
+            duration: parseInt(document.getElementById('taskDuration').value),
+            timeout: parseInt(document.getElementById('taskTimeout').value) || 0,
+            max_retries: parseInt(document.getElementById('taskMaxRetries').value) || 0
         };
         
         try {
-            const response = await fetch('/api/add_task', {
+            const response = await fetch(`${API_BASE}/api/add_task`, {
                 method: 'POST',
                 headers: {
                     'Content-Type': 'application/json'
@@ -216,8 +224,8 @@ function setupForms() {
                 addTaskMessage.textContent = `✅ ${result.message} (Task ID: ${result.task_id})`;
                 addTaskMessage.className = 'message success';
                 addTaskForm.reset();
-                // Refresh dashboard after a short delay
-                setTimeout(() => updateDashboard(), 500);
+                // Refresh dashboard after a short delay (the stream shows it by itself)
+                if (!eventSource) setTimeout(() => updateDashboard(), 500);
             } else {
                 addTaskMessage.textContent = `❌ Error: ${result.error || 'Failed to add task'}`;
                 addTaskMessage.className = 'message error';
@@ -251,7 +259,7 @@ function setupForms() {
         };
         
         try {
-            const response = await fetch('/api/simulate', {
+            const response = await fetch(`${API_BASE}/api/simulate`, {
                 method: 'POST',
                 headers: {
                     'Content-Type': 'application/json'
@@ -265,7 +273,7 @@ function setupForms() {
                 simulationMessage.textContent = `✅ ${result.message || 'Simulation started in background'} (${result.total} tasks)`;
                 simulationMessage.className = 'message success';
                 // Refresh dashboard after a short delay to see tasks appear
-                setTimeout(() => updateDashboard(), 500);
+                if (!eventSource) setTimeout(() => updateDashboard(), 500);
             } else {
                 simulationMessage.textContent = `❌ Error: ${result.error || 'Failed to start simulation'}`;
                 simulationMessage.className = 'message error';
@@ -286,8 +294,14 @@ function setupForms() {
 // Start auto-refresh
 function startAutoRefresh() {
     if (refreshIntervalId) clearInterval(refreshIntervalId);
+    startEventStream();
     refreshIntervalId = setInterval(() => {
-        if (autoRefresh) {
+        if (!autoRefresh) return;
+        if (eventSource) {
+            refreshWorkers();
+            if (latestStatus) updateCharts(latestStatus);
+            updateRunningProgress();
+        } else {
             updateDashboard();
         }
     }, REFRESH_INTERVAL);
@@ -299,23 +313,92 @@ function stopAutoRefresh() {
         clearInterval(refreshIntervalId);
         refreshIntervalId = null;
     }
+    stopEventStream();
 }
 
-// Update entire dashboard
-async function updateDashboard() {
+// Subscribe to task changes. The server sends a snapshot, then batches of
+// changed tasks; after a reconnect it resumes from the last event id.
+function startEventStream() {
+    if (eventSource || !window.EventSource) return;
+    eventSource = new EventSource(`${API_BASE}/api/events`);
+
+    eventSource.addEventListener('snapshot', (e) => {
+        const data = JSON.parse(e.data);
+        taskMap = new Map(data.tasks.map(t => [t.id, t]));
+        applyStatus(data.status);
+        updateTaskTable(data.tasks);
+        updateLastUpdateTime();
+    });
+
+    eventSource.addEventListener('delta', (e) => {
+        const data = JSON.parse(e.data);
+        data.changes.forEach(change => {
+            if (change.change === 'removed') {
+                taskMap.delete(change.id);
+                updateTaskRow(change.id, null, false);
+            } else {
+                taskMap.set(change.task.id, change.task);
+                updateTaskRow(change.task.id, change.task, change.change === 'enqueued');
+            }
+        });
+        applyStatus(data.status);
+        updateLastUpdateTime();
+    });
+
+    eventSource.onerror = () => {
+        // EventSource reconnects by itself
+        document.getElementById('statusIndicator').style.color = '#e74c3c';
+    };
+}
+
+function stopEventStream() {
+    if (eventSource) {
+        eventSource.close();
+        eventSource = null;
+    }
+}
+
+function applyStatus(status) {
+    latestStatus = status;
+    updateStatistics(status);
+    statusChart.data.datasets[0].data = [
+        status.pending_tasks,
+        status.running_tasks,
+        status.completed_tasks,
+        status.failed_tasks
+    ];
+    statusChart.update('none');
+}
+
+async function refreshWorkers() {
     try {
-        const [status, tasks, workers, workerStats] = await Promise.all([
-            fetch(`${API_BASE}/api/status`).then(r => r.json()),
-            fetch(`${API_BASE}/api/tasks`).then(r => r.json()),
+        const [workers, workerStats] = await Promise.all([
             fetch(`${API_BASE}/api/workers`).then(r => r.json()),
             fetch(`${API_BASE}/api/worker_stats`).then(r => r.json())
         ]);
+        updateWorkers(workers, workerStats);
+        updateWorkerChart(workerStats);
+    } catch (error) {
+        console.error('Error updating workers:', error);
+    }
+}
 
-        currentTasks = tasks.tasks || [];
+// Update entire dashboard
+async function updateDashboard() {
+    try {
+        // One consistent view per poll; the browser revalidates it with
+        // If-None-Match, so an unchanged queue costs a bodiless 304
+        const snapshot = await fetch(`${API_BASE}/api/snapshot`).then(r => r.json());
+        const { status, workers } = snapshot;
+        const workerStats = snapshot.worker_stats;
+
+        const taskList = snapshot.tasks || [];
+        taskMap = new Map(taskList.map(t => [t.id, t]));
+        latestStatus = status;
         updateStatistics(status);
-        updateTaskTable(currentTasks);
-        updateWorkers(workers);
-        updateCharts(status, currentTasks);
+        updateTaskTable(taskList);
+        updateWorkers(workers, workerStats);
+        updateCharts(status);
         updateWorkerChart(workerStats);
         updateLastUpdateTime();
         
@@ -367,44 +450,34 @@ function animateValue(elementId, newValue) {
 // Update task table
 let previousTasks = new Map();
 
-function updateTaskTable(tasks) {
-    const tbody = document.getElementById('tasksTableBody');
+function taskMatchesFilters(task) {
     const statusFilter = document.getElementById('statusFilter').value;
     const priorityFilter = document.getElementById('priorityFilter').value;
-    
-    // Filter tasks
-    let filteredTasks = tasks;
-    if (statusFilter !== 'all') {
-        filteredTasks = filteredTasks.filter(t => t.status === statusFilter);
-    }
-    if (priorityFilter !== 'all') {
-        filteredTasks = filteredTasks.filter(t => t.priority === priorityFilter);
-    }
-    
-    // Sort by ID descending (newest first)
-    filteredTasks.sort((a, b) => b.id - a.id);
-    
-    if (filteredTasks.length === 0) {
-        tbody.innerHTML = '<tr><td colspan="8" class="loading">No tasks found</td></tr>';
-        return;
+    return (statusFilter === 'all' || task.status === statusFilter) &&
+        (priorityFilter === 'all' || task.priority === priorityFilter);
+}
+
+// Running tasks' progress from their start time, so it moves between events
+function taskProgress(task) {
+    if (task.status === 'RUNNING' && task.start_time && task.execution_time_ms > 0) {
+        const elapsed = Date.now() - new Date(task.start_time).getTime();
+        return Math.max(0, Math.min(100, elapsed * 100 / task.execution_time_ms));
     }
-    
-    let html = '';
-    
-    filteredTasks.forEach(task => {
-        const isNew = !previousTasks.has(task.id);
-        const rowClass = isNew ? 'new-task' : '';
-        
-        const canCancel = task.status === 'PENDING';
-        html += `
-            <tr class="${rowClass}">
+    return task.progress || 0;
+}
+
+function renderTaskRow(task, isNew) {
+    const canCancel = task.status === 'PENDING' || task.status === 'RETRY_WAIT' ||
+        (task.status === 'RUNNING' && !task.cancel_requested);
+    return `
+            <tr class="${isNew ? 'new-task' : ''}" data-task-id="${task.id}">
                 <td>${task.id}</td>
                 <td class="task-name-cell" onclick="openTaskModal(${task.id})" style="cursor:pointer;">${escapeHtml(task.name)}</td>
                 <td><span class="priority-badge priority-${task.priority.toLowerCase()}">${task.priority}</span></td>
                 <td><span class="status-badge status-${task.status.toLowerCase()}">${task.status}</span></td>
                 <td>
                     <div class="progress-bar">
-                        <div class="progress-fill" style="width: ${task.progress || 0}%"></div>
+                        <div class="progress-fill" style="width: ${taskProgress(task)}%"></div>
                     </div>
                 </td>
                 <td>${task.worker_id >= 0 ? `Worker ${task.worker_id}` : '-'}</td>
@@ -415,40 +488,104 @@ function updateTaskTable(tasks) {
                 </td>
             </tr>
         `;
+}
+
+function updateTaskTable(tasks) {
+    const tbody = document.getElementById('tasksTableBody');
+    
+    // Filter tasks
+    let filteredTasks = tasks.filter(taskMatchesFilters);
+    
+    // Sort by ID descending (newest first)
+    filteredTasks.sort((a, b) => b.id - a.id);
+    
+    if (filteredTasks.length === 0) {
+        tbody.innerHTML = '<tr><td colspan="8" class="loading">No tasks found</td></tr>';
+        return;
+    }
+    
+    let html = '';
+    
+    filteredTasks.forEach(task => {
+        html += renderTaskRow(task, !previousTasks.has(task.id));
     });
     
     tbody.innerHTML = html;
     previousTasks = new Map(tasks.map(t => [t.id, t]));
 }
 
-// Update workers section
-function updateWorkers(workers) {
+// Apply one task's change to the table without redrawing the rest
+// (task null = removed). Rows stay sorted by id, newest first.
+function updateTaskRow(taskId, task, isNew) {
+    const tbody = document.getElementById('tasksTableBody');
+    const existing = tbody.querySelector(`tr[data-task-id="${taskId}"]`);
+    if (task === null || !taskMatchesFilters(task)) {
+        if (existing) existing.remove();
+    } else {
+        const template = document.createElement('tbody');
+        template.innerHTML = renderTaskRow(task, isNew).trim();
+        const row = template.firstElementChild;
+        if (existing) {
+            existing.replaceWith(row);
+        } else {
+            const placeholder = tbody.querySelector('td.loading');
+            if (placeholder) placeholder.parentElement.remove();
+            const before = Array.from(tbody.rows).find(r => Number(r.dataset.taskId) < taskId);
+            tbody.insertBefore(row, before || null);
+        }
+    }
+    if (tbody.rows.length === 0) {
+        tbody.innerHTML = '<tr><td colspan="8" class="loading">No tasks found</td></tr>';
+    }
+    if (task === null) {
+        previousTasks.delete(taskId);
+    } else {
+        previousTasks.set(taskId, task);
+    }
+}
+
+// Move the progress bars of running tasks along between events
+function updateRunningProgress() {
+    document.querySelectorAll('#tasksTableBody tr[data-task-id]').forEach(row => {
+        const task = taskMap.get(Number(row.dataset.taskId));
+        if (task && task.status === 'RUNNING') {
+            row.querySelector('.progress-fill').style.width = `${taskProgress(task)}%`;
+        }
+    });
+}
+
+// Update workers section from the per-worker stat slots
+function updateWorkers(workers, workerStats) {
     const grid = document.getElementById('workersGrid');
-    const active = workers.active_workers || 0;
-    const total = workers.total_workers || 0;
+    const slots = (workerStats && workerStats.workers) || [];
     
     let html = '';
-    for (let i = 0; i < total; i++) {
-        const isActive = i < active;
+    slots.forEach(w => {
+        const isActive = w.active;
         html += `
             <div class="worker-card">
-                <h4>Worker ${i}</h4>
+                <h4>Worker ${w.id}</h4>
                 <div class="worker-info">
                     <span>Status: <strong style="color: ${isActive ? '#2ecc71' : '#e74c3c'}">
                         ${isActive ? 'Active' : 'Inactive'}
                     </strong></span>
+                    <span>PID: ${w.pid || '-'}</span>
+                    <span>Threads: ${w.busy_threads} busy / ${w.idle_threads} idle</span>
+                    <span>Running: ${w.running}</span>
+                    <span>Done: ${w.completed} ok / ${w.failed} failed</span>
+                    <span>Last claim: ${w.last_claim ? formatTime(w.last_claim) : '-'}</span>
                 </div>
             </div>
         `;
-    }
+    });
     
-    grid.innerHTML = html || '<div class="loading">No workers</div>';
+    grid.innerHTML = html || `<div class="loading">No workers (${workers.active_workers || 0} registered)</div>`;
 }
 
 // Update charts
 let lastCompletedCount = null;
 
-function updateCharts(status, tasks) {
+function updateCharts(status) {
     // Update throughput chart
     const now = new Date();
     const timeLabel = now.toLocaleTimeString();
@@ -520,7 +657,7 @@ function updateWorkerChart(workerStats) {
 // Export functions
 async function exportCSV() {
     try {
-        const response = await fetch('/api/export/csv');
+        const response = await fetch(`${API_BASE}/api/export/csv`);
         const csv = await response.text();
         downloadFile(csv, 'tasks.csv', 'text/csv');
     } catch (error) {
@@ -531,7 +668,7 @@ async function exportCSV() {
 
 async function exportJSON() {
     try {
-        const response = await fetch('/api/export/json');
+        const response = await fetch(`${API_BASE}/api/export/json`);
         const json = await response.text();
         downloadFile(json, 'tasks.json', 'application/json');
     } catch (error) {
@@ -554,16 +691,30 @@ function downloadFile(content, filename, type) {
 
 // Task modal functions
 function openTaskModal(taskId) {
-    const task = currentTasks.find(t => t.id === taskId);
+    const task = taskMap.get(taskId);
     if (!task) return;
     
     document.getElementById('modalTaskName').textContent = task.name;
     document.getElementById('modalTaskId').textContent = task.id;
     document.getElementById('modalTaskPriority').innerHTML = `<span class="priority-badge priority-${task.priority.toLowerCase()}">${task.priority}</span>`;
     document.getElementById('modalTaskStatus').innerHTML = `<span class="status-badge status-${task.status.toLowerCase()}">${task.status}</span>`;
-    document.getElementById('modalTaskWorker').textContent = task.worker_id >= 0 ? `Worker ${task.worker_id}` : 'Not assigned';
+    let worker = task.worker_id >= 0 ? `Worker ${task.worker_id}` : 'Not assigned';
+    if (task.peer) {
+        // Handed to or taken from another scheduler in the federation
+        const direction = task.status === 'HANDOFF' || task.status === 'FORWARDED' ? 'to' : 'from';
+        worker += ` (${direction} ${task.peer}` + (task.peer_task_id > 0 ? ` as task ${task.peer_task_id})` : ')');
+    }
+    document.getElementById('modalTaskWorker').textContent = worker;
     document.getElementById('modalTaskDuration').textContent = `${task.execution_time_ms} ms`;
-    document.getElementById('modalTaskProgress').textContent = `${(task.progress || 0).toFixed(1)}%`;
+    document.getElementById('modalTaskTimeout').textContent =
+        task.timeout_ms > 0 ? `${task.timeout_ms} ms` : 'None';
+    let attempts = `${task.attempts} of ${task.max_retries + 1}`;
+    if (task.status === 'RETRY_WAIT' && task.retry_time) {
+        attempts += ` (next at ${formatTime(task.retry_time)})`;
+    }
+    document.getElementById('modalTaskAttempts').textContent = attempts;
+    document.getElementById('modalTaskLastError').textContent = task.last_error || '-';
+    document.getElementById('modalTaskProgress').textContent = `${taskProgress(task).toFixed(1)}%`;
     
     // Timeline
     document.getElementById('modalTimeCreated').textContent = task.creation_time || '-';
@@ -598,9 +749,32 @@ function openTaskModal(taskId) {
     document.getElementById('modalExecTime').textContent = execTime;
     document.getElementById('modalTurnaroundTime').textContent = turnaroundTime;
     
+    // Resource usage (recorded by the worker when the task finishes)
+    const usage = task.usage;
+    const finished = task.status === 'COMPLETED' || task.status === 'FAILED';
+    if (usage && finished) {
+        document.getElementById('modalCpuTime').textContent =
+            `${(usage.cpu_time_us / 1000).toFixed(2)}ms (${(usage.cpu_user_us / 1000).toFixed(1)} / ${(usage.cpu_system_us / 1000).toFixed(1)})`;
+        document.getElementById('modalMaxRss').textContent = `${(usage.max_rss_kb / 1024).toFixed(1)} MB`;
+        document.getElementById('modalCtxSwitches').textContent =
+            `${usage.voluntary_ctx_switches} vol / ${usage.involuntary_ctx_switches} invol`;
+        document.getElementById('modalIoBytes').textContent =
+            `${formatBytes(usage.io_read_bytes)} / ${formatBytes(usage.io_write_bytes)}`;
+    } else {
+        ['modalCpuTime', 'modalMaxRss', 'modalCtxSwitches', 'modalIoBytes'].forEach(id => {
+            document.getElementById(id).textContent = '-';
+        });
+    }
+    
     document.getElementById('taskModal').classList.add('active');
 }
 
+function formatBytes(bytes) {
+    if (bytes < 1024) return `${bytes} B`;
+    if (bytes < 1024 * 1024) return `${(bytes / 1024).toFixed(1)} KB`;
+    return `${(bytes / (1024 * 1024)).toFixed(1)} MB`;
+}
+
 function closeModal() {
     document.getElementById('taskModal').classList.remove('active');
 }
@@ -610,7 +784,7 @@ async function cancelTask(taskId) {
     if (!confirm(`Cancel task ${taskId}?`)) return;
     
     try {
-        const response = await fetch('/api/cancel_task', {
+        const response = await fetch(`${API_BASE}/api/cancel_task`, {
             method: 'POST',
             headers: { 'Content-Type': 'application/json' },
             body: JSON.stringify({ task_id: taskId })
@@ -619,7 +793,7 @@ async function cancelTask(taskId) {
         const result = await response.json();
         
         if (result.success) {
-            updateDashboard();
+            if (!eventSource) updateDashboard();
         } else {
             alert(result.error || 'Failed to cancel task');
         }
@@ -635,7 +809,7 @@ document.addEventListener('visibilitychange', () => {
         stopAutoRefresh();
     } else if (autoRefresh) {
         startAutoRefresh();
-        updateDashboard();
+        if (eventSource) refreshWorkers(); else updateDashboard();
     }
 });
 